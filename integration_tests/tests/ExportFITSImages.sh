@@ -0,0 +1,67 @@
+#!/usr/bin/env bash
+
+set -eux
+set -o pipefail
+
+# Test that an image array survives an export-then-reload round trip through a multi-extension FITS file.
+#
+# Note: each image is written as a separate image extension, so all images should be recovered from one file,
+#       along with their metadata.
+printf 'Test 1\n' |
+  tee -a fullstdout
+"${DCMA_BIN}" \
+  -o GenerateSyntheticImages \
+     -p NumberOfImages=10 \
+     -p NumberOfRows=8 \
+     -p NumberOfColumns=6 \
+     -p VoxelValue=1.5 \
+     -p StipleValue=-2.0 \
+     -p Metadata='PatientID@fits_round_trip' \
+  -o ExportFITSImages \
+     -p FilenameBase=single |
+  tee -a fullstdout
+
+"${DCMA_BIN}" \
+  single_*.fits \
+  -o DroverDebug |
+  tee -a fullstdout > reloaded
+
+grep -i 'has 10 image slices' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+[ "$(grep -c 'Loaded FITS image with dimensions 8 x 6 and 1 channels' reloaded)" == "10" ]
+grep -i 'pixel value range = \[-2,1.5\]' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+grep -i "'PatientID' : 'fits_round_trip'" reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+
+
+# Test that multi-channel images survive a round trip.
+printf 'Test 2\n' |
+  tee -a fullstdout
+"${DCMA_BIN}" \
+  -o GenerateSyntheticImages \
+     -p NumberOfImages=10 \
+     -p NumberOfRows=8 \
+     -p NumberOfColumns=6 \
+     -p NumberOfChannels=3 \
+     -p VoxelValue=1.5 \
+     -p StipleValue=-2.0 \
+  -o ExportFITSImages \
+     -p FilenameBase=channels |
+  tee -a fullstdout
+
+"${DCMA_BIN}" \
+  channels_*.fits \
+  -o DroverDebug |
+  tee -a fullstdout > reloaded
+
+grep -i 'has 10 image slices' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+[ "$(grep -c 'Loaded FITS image with dimensions 8 x 6 and 3 channels' reloaded)" == "10" ]
+grep -i 'pixel value range = \[-2,1.5\]' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
@@ -0,0 +1,149 @@
+#!/usr/bin/env bash
+
+set -eux
+set -o pipefail
+
+# Test that a single-channel volume survives an export-then-reload round trip.
+printf 'Test 1\n' |
+  tee -a fullstdout
+"${DCMA_BIN}" \
+  -o GenerateSyntheticImages \
+     -p NumberOfImages=10 \
+     -p NumberOfRows=8 \
+     -p NumberOfColumns=6 \
+     -p VoxelValue=1.5 \
+     -p StipleValue=-2.0 \
+  -o ExportNIfTIImages \
+     -p FilenameBase=raw \
+     -p Compression=none |
+  tee -a fullstdout
+
+"${DCMA_BIN}" \
+  raw_*.nii \
+  -o DroverDebug |
+  tee -a fullstdout > reloaded
+
+grep -i 'Loaded NIfTI-1 .* 6 x 8 x 10, 1 time points, and 1 channels' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+grep -i 'pixel value range = \[-2,1.5\]' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+
+
+# Test that gzip-compressed volumes survive a round trip.
+#
+# Note: the volume is large enough that the voxel data span several BGZF blocks, which are inflated in parallel.
+printf 'Test 2\n' |
+  tee -a fullstdout
+"${DCMA_BIN}" \
+  -o GenerateSyntheticImages \
+     -p NumberOfImages=20 \
+     -p NumberOfRows=64 \
+     -p NumberOfColumns=64 \
+     -p VoxelValue=1.5 \
+     -p StipleValue=-2.0 \
+  -o ExportNIfTIImages \
+     -p FilenameBase=compressed \
+     -p Compression=gzip |
+  tee -a fullstdout
+
+"${DCMA_BIN}" \
+  compressed_*.nii.gz \
+  -o DroverDebug |
+  tee -a fullstdout > reloaded
+
+grep -i 'Loaded NIfTI-1 .* 64 x 64 x 20, 1 time points, and 1 channels' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+grep -i 'pixel value range = \[-2,1.5\]' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+
+
+# Test that gzip streams not made of BGZF blocks (e.g., from the gzip utility) can also be read.
+printf 'Test 3\n' |
+  tee -a fullstdout
+gzip -c raw_*.nii > plain.nii.gz
+
+"${DCMA_BIN}" \
+  plain.nii.gz \
+  -o DroverDebug |
+  tee -a fullstdout > reloaded
+
+grep -i 'Loaded NIfTI-1 .* 6 x 8 x 10, 1 time points, and 1 channels' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+grep -i 'pixel value range = \[-2,1.5\]' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+
+
+# Test that multi-channel volumes survive a round trip.
+printf 'Test 4\n' |
+  tee -a fullstdout
+"${DCMA_BIN}" \
+  -o GenerateSyntheticImages \
+     -p NumberOfImages=10 \
+     -p NumberOfRows=8 \
+     -p NumberOfColumns=6 \
+     -p NumberOfChannels=3 \
+     -p VoxelValue=1.5 \
+     -p StipleValue=-2.0 \
+  -o ExportNIfTIImages \
+     -p FilenameBase=channels \
+     -p Compression=gzip |
+  tee -a fullstdout
+
+"${DCMA_BIN}" \
+  channels_*.nii.gz \
+  -o DroverDebug |
+  tee -a fullstdout > reloaded
+
+grep -i 'Loaded NIfTI-1 .* 6 x 8 x 10, 1 time points, and 3 channels' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+grep -i 'pixel value range = \[-2,1.5\]' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+
+
+# Test that 4D volumes survive a round trip.
+#
+# Note: images sharing a position are exported as separate time points.
+printf 'Test 5\n' |
+  tee -a fullstdout
+"${DCMA_BIN}" \
+  -o GenerateSyntheticImages \
+     -p NumberOfImages=10 \
+     -p NumberOfRows=8 \
+     -p NumberOfColumns=6 \
+     -p VoxelValue=1.0 \
+  -o GenerateSyntheticImages \
+     -p NumberOfImages=10 \
+     -p NumberOfRows=8 \
+     -p NumberOfColumns=6 \
+     -p VoxelValue=2.0 \
+  -o GroupImages:KeysCommon='Modality' \
+  -o ExportNIfTIImages \
+     -p FilenameBase=temporal \
+     -p Compression=gzip |
+  tee -a fullstdout
+
+"${DCMA_BIN}" \
+  temporal_*.nii.gz \
+  -o DroverDebug |
+  tee -a fullstdout > reloaded
+
+grep -i 'Loaded NIfTI-1 .* 6 x 8 x 10, 2 time points, and 1 channels' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+grep -i 'has 20 image slices' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+grep -i "'TemporalPositionIndex' : '2'" reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
+grep -i 'pixel value range = \[2,2\]' reloaded |
+  `# Note: ensures the output stream is not empty. ` \
+  grep .
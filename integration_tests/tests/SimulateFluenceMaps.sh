@@ -0,0 +1,26 @@
+#!/usr/bin/env bash
+
+set -eux
+set -o pipefail
+
+# Test that device positions omitted from step-and-shoot control points are carried forward correctly.
+#
+# Note: the plan delivers half of the meterset through y in [-10,0] mm, then the Y jaws step to [0,10] mm for the
+#       remainder. Control points omit device positions that do not change, so the maximum fluence should be 0.5.
+#       If stale jaw positions are carried forward, all meterset is delivered through one aperture instead.
+printf 'Test 1\n' |
+  tee -a fullstdout
+"${DCMA_BIN}" \
+  -v \
+  "${TEST_FILES_ROOT}"/RTPLAN_step_and_shoot_omitted_devices.dcm \
+  -o SimulateFluenceMaps \
+     -p Rows=40 \
+     -p Columns=40 \
+     -p PixelSpacing=1.0 \
+  -o DroverDebug |
+  tee -a fullstdout |
+  grep 'pixel value range' |
+  grep '\[0,0.5\]' |
+  `# Note: ensures the output stream is not empty. ` \
+  grep . 
+
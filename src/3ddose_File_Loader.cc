@@ -3,16 +3,21 @@
 // This program loads ASCII DOSXYZnrc 3ddose files.
 //
 
+#include <array>
+#include <cerrno>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <exception>
-#include <fstream>
+#include <functional>
 #include <numeric>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>    
+#include <vector>
 
 #include <filesystem>
 #include <cstdlib>            //Needed for exit() calls.
@@ -21,12 +26,83 @@
 #include "YgorStats.h"        //Needed for Median().
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 #include "YgorLog.h"
-#include "YgorString.h"       //Needed for SplitStringToVector, Canonicalize_String2, SplitVector functions.
+#include "YgorString.h"       //Needed for Generate_Random_String_of_Length().
 
 #include "Structs.h"
+#include "Thread_Pool.h"
+#include "Raw_Volume_IO.h"    //Needed for mapped_file.
 #include "Imebra_Shim.h"      //Needed for Collate_Image_Arrays().
 
 
+// Numbers are separated by whitespace. Comments begin with '#' and extend to the end of the line.
+static bool is_3ddose_space(char c){
+    return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') || (c == '\v') || (c == '\f');
+}
+
+// Returns the start of the next number, or 'end' if there are none.
+static const char * skip_3ddose_separators(const char *p, const char *end){
+    while(p != end){
+        if(is_3ddose_space(*p)){
+            ++p;
+        }else if(*p == '#'){
+            const auto *nl = static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+            p = (nl == nullptr) ? end : nl;
+        }else{
+            break;
+        }
+    }
+    return p;
+}
+
+static const char * end_of_3ddose_number(const char *p, const char *end){
+    while( (p != end) && !is_3ddose_space(*p) && (*p != '#') ) ++p;
+    return p;
+}
+
+static double parse_3ddose_number(const char *b, const char *e){
+    // std::strtod requires a NUL-terminated string, so the token is copied. Tokens are almost always short enough to
+    // avoid allocation.
+    const auto N = static_cast<size_t>(e - b);
+    std::array<char, 64> small_buf;
+    std::string large_buf;
+    char *buf = small_buf.data();
+    if(small_buf.size() <= N){
+        large_buf.assign(b, e);
+        buf = large_buf.data();
+    }else{
+        std::memcpy(buf, b, N);
+        buf[N] = '\0';
+    }
+
+    char *ptr = nullptr;
+    errno = 0;
+    const double x = std::strtod(buf, &ptr);
+    if( (N == 0)
+    ||  (ptr != (buf + N))
+    ||  ( (errno == ERANGE) && (std::abs(x) == HUGE_VAL) ) ){
+        throw std::runtime_error("Unable to parse number '"_s + std::string(b, e) + "'");
+    }
+    return x;
+}
+
+// Partitions the text into chunks that end at line boundaries, so that comments are not split.
+static std::vector<std::pair<const char *, const char *>> partition_3ddose_text(const char *b, const char *e){
+    constexpr size_t target_chunk_size = static_cast<size_t>(1) << 20;
+    std::vector<std::pair<const char *, const char *>> chunks;
+    while(b != e){
+        const char *c = e;
+        if(target_chunk_size < static_cast<size_t>(e - b)){
+            const auto *nl = static_cast<const char *>(std::memchr(b + target_chunk_size, '\n',
+                                                                   static_cast<size_t>(e - b) - target_chunk_size));
+            c = (nl == nullptr) ? e : (nl + 1);
+        }
+        chunks.emplace_back(b, c);
+        b = c;
+    }
+    return chunks;
+}
+
+
 bool Load_From_3ddose_Files( Drover &DICOM_data,
                           std::map<std::string,std::string> & /* InvocationMetadata */,
                           const std::string &,
@@ -51,21 +127,6 @@ bool Load_From_3ddose_Files( Drover &DICOM_data,
     //
     if(Filenames.empty()) return true;
 
-    const auto extract_separated_numbers = [](const std::string &in) -> std::vector<double> {
-            // This rountine extracts numerical function parameters.
-            auto split = SplitStringToVector(in, ' ', 'd');
-            split = SplitVector(split, '\t', 'd');
-
-            std::vector<double> numbers;
-            for(const auto &w : split){
-               try{
-                   const auto x = std::stod(w);
-                   numbers.emplace_back(x);
-               }catch(const std::exception &){ }
-            }
-            return numbers;
-    };
-
     size_t i = 0;
     const size_t N = Filenames.size();
 
@@ -78,12 +139,13 @@ bool Load_From_3ddose_Files( Drover &DICOM_data,
         try{
             //////////////////////////////////////////////////////////////
             // Attempt to load the file.
-            std::fstream FI(Filename, std::ios::in);
-            if(!FI.good()){
-                throw std::runtime_error("Unable to read file.");
-            }
+            //
+            // The file is memory-mapped. The (small) header is parsed serially, and the voxel data are parsed in
+            // parallel chunks directly into image buffers.
+            const mapped_file mf(Filename);
+            const char *p = reinterpret_cast<const char *>(mf.data());
+            const char *end = p + mf.size();
 
-            bool dims_known = false;
             int64_t N_x = -1;
             int64_t N_y = -1;
             int64_t N_z = -1;
@@ -92,123 +154,73 @@ bool Load_From_3ddose_Files( Drover &DICOM_data,
             std::vector<double> spatial_y;
             std::vector<double> spatial_z;
 
-            std::vector<double> doses;
-
-/*
-            try{
-                double shtl;
-                FI >> N_x >> N_y >> N_z;
-                for(int64_t i = 0; i <= N_x; ++i){ // Intentionally reads N_x+1 values.
-                    FI >> shtl;
-                    spatial_x.emplace_back(shtl);
-                }
-                for(int64_t i = 0; i <= N_x; ++i){ // Intentionally reads N_y+1 values.
-                    FI >> shtl;
-                    spatial_x.emplace_back(shtl);
-                }
-                for(int64_t i = 0; i <= N_x; ++i){ // Intentionally reads N_z+1 values.
-                    FI >> shtl;
-                    spatial_x.emplace_back(shtl);
-                }
-                while(!FI.eof()){
-                    FI >> shtl;
-                    doses.emplace_back(shtl);
-                }
-            }catch(const std::exception &){ }
-            FI.close();
-*/            
-            std::string aline;
-            while(!FI.eof()){
-                std::getline(FI, aline);
-
-                // Ignore comments.
-                const auto hash_pos = aline.find_first_of('#');
-                if(hash_pos != std::string::npos){
-                    aline = aline.substr(0, hash_pos);
-                }
-
-                // Extract all numbers separated by whitespace.
-                const auto numbers = extract_separated_numbers(aline);
-                if(numbers.empty()) continue;
-
-                // If the matrix dimensions are not yet known, seek this info before reading any other information.
-                //
-                // Dimensional consistency is the only way to validate 3ddose files, so we use the dimensions to ensure
-                // the correct amount of data has been received at the end.
-                //
-                // Since there is no 3ddose file header or magic numbers we have to ruthlessly reject files that do
-                // not immediately present sane dimensions.
-                if(!dims_known){
-                    if(numbers.size() != 3) throw std::runtime_error("Dimensions not understood.");
-
-                    N_x = static_cast<int64_t>(numbers.at(0));
-                    N_y = static_cast<int64_t>(numbers.at(1));
-                    N_z = static_cast<int64_t>(numbers.at(2));
-                    if((N_x <= 0) || (N_y <= 0) || (N_z <= 0)){
-                        throw std::runtime_error("Dimensions invalid.");
+            // Since there is no 3ddose file header or magic numbers we have to ruthlessly reject files that do
+            // not immediately present sane dimensions. The dimensions must be the only numbers on the first
+            // non-empty line.
+            {
+                std::vector<double> numbers;
+                while( (p != end) && numbers.empty() ){
+                    const auto *nl = static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+                    const char *eol = (nl == nullptr) ? end : nl;
+                    for(p = skip_3ddose_separators(p, eol); p != eol; p = skip_3ddose_separators(p, eol)){
+                        const auto *e = end_of_3ddose_number(p, eol);
+                        numbers.emplace_back( parse_3ddose_number(p, e) );
+                        p = e;
                     }
-                    dims_known = true;
-                    continue;
-
-                // Attempt to parse spatial information.
-                }else if( dims_known 
-                      && (static_cast<int64_t>(spatial_x.size()) != (N_x + 1)) ){
-
-                    for(const auto &n : numbers){
-                        if(!std::isfinite(n)) continue;
-                    }
-                    spatial_x.insert( std::end(spatial_x), std::begin(numbers), std::end(numbers) );
-
-                }else if( dims_known 
-                      && (static_cast<int64_t>(spatial_x.size()) == (N_x + 1))
-                      && (static_cast<int64_t>(spatial_y.size()) != (N_y + 1)) ){
-
-                    for(const auto &n : numbers){
-                        if(!std::isfinite(n)) continue;
-                    }
-                    spatial_y.insert( std::end(spatial_y), std::begin(numbers), std::end(numbers) );
-
-                }else if( dims_known 
-                      && (static_cast<int64_t>(spatial_x.size()) == (N_x + 1))
-                      && (static_cast<int64_t>(spatial_y.size()) == (N_y + 1))
-                      && (static_cast<int64_t>(spatial_z.size()) != (N_z + 1)) ){
-
-                    for(const auto &n : numbers){
-                        if(!std::isfinite(n)) continue;
-                    }
-                    spatial_z.insert( std::end(spatial_z), std::begin(numbers), std::end(numbers) );
-
-                // Continue reading in all dose and trailing dose uncertainties.
-                //
-                // If the final number of voxels differs from the stated dimensions, then this file is not valid.
-                }else if( dims_known 
-                      && (static_cast<int64_t>(spatial_x.size()) == (N_x + 1))
-                      && (static_cast<int64_t>(spatial_y.size()) == (N_y + 1))
-                      && (static_cast<int64_t>(spatial_z.size()) == (N_z + 1)) ){
-                    for(const auto &n : numbers){
-                        if(!std::isfinite(n)) continue;
-                    }
-
-                    // Append the doses.
-                    doses.insert( std::end(doses), std::begin(numbers), std::end(numbers) );
+                    p = (eol == end) ? end : (eol + 1);
+                }
+                if(numbers.size() != 3) throw std::runtime_error("Dimensions not understood.");
 
-                // Unexpected scenario.
-                }else{
-                    YLOGWARN("Unable to read 3ddose file.");
-                    return false;
+                N_x = static_cast<int64_t>(numbers.at(0));
+                N_y = static_cast<int64_t>(numbers.at(1));
+                N_z = static_cast<int64_t>(numbers.at(2));
+                if((N_x <= 0) || (N_y <= 0) || (N_z <= 0)){
+                    throw std::runtime_error("Dimensions invalid.");
                 }
+            }
 
+            // Voxel boundaries. Intentionally reads (N+1) values for each axis.
+            for(auto [v, n] : { std::make_pair(&spatial_x, N_x),
+                                std::make_pair(&spatial_y, N_y),
+                                std::make_pair(&spatial_z, N_z) }){
+                v->reserve(static_cast<size_t>(n + 1));
+                while(static_cast<int64_t>(v->size()) != (n + 1)){
+                    p = skip_3ddose_separators(p, end);
+                    if(p == end) throw std::runtime_error("Voxel boundaries are truncated.");
+                    const auto *e = end_of_3ddose_number(p, end);
+                    v->emplace_back( parse_3ddose_number(p, e) );
+                    p = e;
+                }
             }
-            FI.close();
 
-            // Validate that the file has been fully read.
-            if( (static_cast<int64_t>(doses.size()) != (N_x * N_y * N_z))   // Dose data only.
-            &&  (static_cast<int64_t>(doses.size()) != (N_x * N_y * N_z * 2L)) ){  // Dose data and uncertainties.
+            // The remainder of the file holds the doses, optionally followed by the dose uncertainties.
+            //
+            // Count the numbers in each chunk so the position of each number is known before any are parsed. If the
+            // number of voxels differs from the stated dimensions, then this file is not valid.
+            const auto chunks = partition_3ddose_text(p, end);
+            std::vector<int64_t> chunk_counts(chunks.size(), 0);
+            {
+                work_queue<std::function<void(void)>> wq;
+                for(size_t n = 0; n < chunks.size(); ++n){
+                    wq.submit_task([&,n]() -> void {
+                        int64_t count = 0;
+                        const char *c_end = chunks[n].second;
+                        for(const char *q = skip_3ddose_separators(chunks[n].first, c_end);
+                            q != c_end;
+                            q = skip_3ddose_separators(end_of_3ddose_number(q, c_end), c_end)){
+                            ++count;
+                        }
+                        chunk_counts[n] = count;
+                    });
+                }
+            } // Wait for all tasks to complete.
+
+            const int64_t N_voxels = N_x * N_y * N_z;
+            const int64_t N_numbers = std::accumulate(std::begin(chunk_counts), std::end(chunk_counts), static_cast<int64_t>(0));
+            if( (N_numbers != N_voxels)           // Dose data only.
+            &&  (N_numbers != (N_voxels * 2L)) ){ // Dose data and uncertainties.
                 throw std::runtime_error("Unable to read file.");
             }
-            if( static_cast<int64_t>(doses.size()) == (N_x * N_y * N_z * 2L) ){
-                doses.resize( static_cast<size_t>(N_x * N_y * N_z) );
-            }
 
             //--------------------------------------------------------
             // Construct an Image_Array to hold the dose data.
@@ -297,6 +309,7 @@ bool Load_From_3ddose_Files( Drover &DICOM_data,
             const std::string Modality = "RTDOSE";
 
             loaded_imgs_storage.emplace_back();
+            std::vector<float *> slice_buffers;
             for(int64_t img_index = 0; img_index < NumberOfImages; ++img_index){
                 const std::string SOPInstanceUID = Generate_Random_String_of_Length(6);
 
@@ -344,13 +357,7 @@ bool Load_From_3ddose_Files( Drover &DICOM_data,
                 out->imagecoll.images.back().init_buffer(NumberOfRows, NumberOfColumns, NumberOfChannels);
                 out->imagecoll.images.back().init_spatial(VoxelWidth, VoxelHeight, SliceThickness, ImageAnchor, ImagePosition);
 
-                for(int64_t y = 0; y < N_y; ++y){
-                    for(int64_t x = 0; x < N_x; ++x){
-                        const auto index = (N_x * N_y * img_index) + (N_x * y) + x;
-
-                        out->imagecoll.images.back().reference(y, x, 0L) = doses.at(index);
-                    }
-                }
+                slice_buffers.emplace_back( out->imagecoll.images.back().data.data() );
 
                 ImagePosition += ImageOrientationOrtho * SpacingBetweenSlices;
                 ++InstanceNumber;
@@ -358,6 +365,42 @@ bool Load_From_3ddose_Files( Drover &DICOM_data,
                 loaded_imgs_storage.back().push_back( std::move( out ) );
             }
 
+            // Parse the doses directly into the image buffers. Voxels within each image are ordered the same way as in
+            // the file (i.e., x varies fastest), so each dose maps to a single image and offset. Uncertainties are
+            // ignored.
+            {
+                const int64_t N_per_slice = N_x * N_y;
+                std::mutex saver_printer;
+                std::exception_ptr failure;
+                {
+                    work_queue<std::function<void(void)>> wq;
+                    int64_t first = 0;
+                    for(size_t n = 0; n < chunks.size(); ++n){
+                        if(N_voxels <= first) break;
+                        wq.submit_task([&,n,first]() -> void {
+                            try{
+                                int64_t index = first;
+                                const char *c_end = chunks[n].second;
+                                for(const char *q = skip_3ddose_separators(chunks[n].first, c_end);
+                                    (q != c_end) && (index < N_voxels);
+                                    q = skip_3ddose_separators(q, c_end)){
+                                    const auto *e = end_of_3ddose_number(q, c_end);
+                                    slice_buffers[static_cast<size_t>(index / N_per_slice)][index % N_per_slice]
+                                        = static_cast<float>( parse_3ddose_number(q, e) );
+                                    q = e;
+                                    ++index;
+                                }
+                            }catch(const std::exception &){
+                                std::lock_guard<std::mutex> lock(saver_printer);
+                                failure = std::current_exception();
+                            }
+                        });
+                        first += chunk_counts[n];
+                    }
+                } // Wait for all tasks to complete.
+                if(failure) std::rethrow_exception(failure);
+            }
+
             //Collate each group of images into a single set, if possible. Also stuff the correct contour data in the same set.
             for(auto &loaded_img_set : loaded_imgs_storage){
                 if(loaded_img_set.empty()) continue;
@@ -1,6 +1,7 @@
 //Alignment_Field.cc - A part of DICOMautomaton 2021. Written by hal clark.
 
 #include <algorithm>
+#include <cstdint>
 #include <optional>
 #include <fstream>
 #include <iterator>
@@ -15,6 +16,9 @@
 #include <utility>            //Needed for std::pair.
 #include <vector>
 #include <functional>
+#include <limits>
+
+#include <zlib.h>
 
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -111,13 +115,137 @@ deformation_field::apply_to(planar_image_collection<float, double> &img) const {
     return;
 }
 
+// Binary serialization.
+//
+// The format consists of a short text header followed by one block per image. Each block holds the image geometry and
+// metadata as text, then the number of stored bytes and the voxel data. Voxel data are stored little-endian, as either
+// 64-bit or 32-bit floats. When compressed, the bytes of each value are first grouped by significance (i.e., 'shuffled')
+// since neighbouring vectors tend to share high-order bytes, which substantially improves compression.
+static bool host_is_little_endian(){
+    const uint16_t test = 0x01;
+    return (*reinterpret_cast<const unsigned char *>(&test) == 0x01);
+}
+
+template <class T>
+static void to_little_endian_bytes(const double *in, size_t N, unsigned char *out){
+    const bool le = host_is_little_endian();
+    for(size_t i = 0; i < N; ++i){
+        const T v = static_cast<T>(in[i]);
+        const auto *b = reinterpret_cast<const unsigned char *>(&v);
+        for(size_t j = 0; j < sizeof(T); ++j){
+            out[i * sizeof(T) + j] = b[le ? j : (sizeof(T) - 1 - j)];
+        }
+    }
+    return;
+}
+
+template <class T>
+static void from_little_endian_bytes(const unsigned char *in, size_t N, double *out){
+    const bool le = host_is_little_endian();
+    for(size_t i = 0; i < N; ++i){
+        T v;
+        auto *b = reinterpret_cast<unsigned char *>(&v);
+        for(size_t j = 0; j < sizeof(T); ++j){
+            b[le ? j : (sizeof(T) - 1 - j)] = in[i * sizeof(T) + j];
+        }
+        out[i] = static_cast<double>(v);
+    }
+    return;
+}
+
+// Groups the k-th byte of every element together, or reverses the grouping.
+static std::vector<unsigned char> shuffle_bytes(const std::vector<unsigned char> &in, size_t elem_size, bool forward){
+    std::vector<unsigned char> out(in.size());
+    const size_t N = in.size() / elem_size;
+    for(size_t i = 0; i < N; ++i){
+        for(size_t j = 0; j < elem_size; ++j){
+            if(forward){
+                out[j * N + i] = in[i * elem_size + j];
+            }else{
+                out[i * elem_size + j] = in[j * N + i];
+            }
+        }
+    }
+    return out;
+}
+
 bool
 deformation_field::write_to( std::ostream &os ) const {
+    return this->write_to(os, deformation_field_write_opts());
+}
+
+bool
+deformation_field::write_to( std::ostream &os, const deformation_field_write_opts &opts ) const {
     // Maximize precision prior to emitting any floating-point numbers.
     const auto original_precision = os.precision();
     os.precision( std::numeric_limits<double>::max_digits10 );
-    
-    throw std::logic_error("Not yet implemented");
+
+    const size_t elem_size = (opts.single_precision) ? sizeof(float) : sizeof(double);
+    if( (sizeof(float) != 4) || (sizeof(double) != 8) ){
+        throw std::logic_error("Unsupported floating-point representation");
+    }
+
+    // Encode (and compress) the voxel data for each image in parallel.
+    std::vector<const planar_image<double,double>*> imgs;
+    for(const auto &img : this->field.images) imgs.push_back( &img );
+    std::vector<std::vector<unsigned char>> blocks(imgs.size());
+    {
+        std::mutex saver_printer;
+        bool ok = true;
+        {
+            work_queue<std::function<void(void)>> wq;
+            for(size_t n = 0; n < imgs.size(); ++n){
+                wq.submit_task([&,n]() -> void {
+                    const auto &img = *(imgs[n]);
+                    const size_t N = img.data.size();
+                    std::vector<unsigned char> raw(N * elem_size);
+                    if(opts.single_precision){
+                        to_little_endian_bytes<float>(img.data.data(), N, raw.data());
+                    }else{
+                        to_little_endian_bytes<double>(img.data.data(), N, raw.data());
+                    }
+                    if(!opts.compress){
+                        blocks[n] = std::move(raw);
+                        return;
+                    }
+
+                    raw = shuffle_bytes(raw, elem_size, true);
+                    uLongf stored_len = compressBound(static_cast<uLong>(raw.size()));
+                    std::vector<unsigned char> stored(stored_len);
+                    const auto res = compress2(stored.data(), &stored_len,
+                                               raw.data(), static_cast<uLong>(raw.size()),
+                                               Z_DEFAULT_COMPRESSION);
+                    if(res != Z_OK){
+                        std::lock_guard<std::mutex> lock(saver_printer);
+                        YLOGWARN("Unable to compress deformation field voxel data");
+                        ok = false;
+                        return;
+                    }
+                    stored.resize(stored_len);
+                    blocks[n] = std::move(stored);
+                });
+            }
+        } // Wait for all tasks to complete.
+        if(!ok) return false;
+    }
+
+    os << "DCMA_DEFORMATION_FIELD 1" << '\n';
+    os << imgs.size() << " "
+       << ((opts.single_precision) ? "float32" : "float64") << " "
+       << ((opts.compress) ? "zlib" : "none") << '\n';
+    for(size_t n = 0; n < imgs.size(); ++n){
+        const auto &img = *(imgs[n]);
+        os << img.rows << " " << img.columns << " " << img.channels << " "
+           << img.pxl_dx << " " << img.pxl_dy << " " << img.pxl_dz << " "
+           << img.anchor << " " << img.offset << " " << img.row_unit << " " << img.col_unit << '\n';
+        os << img.metadata.size() << '\n';
+        for(const auto &kv : img.metadata){
+            os << encode_metadata_kv_pair(kv) << '\n';
+        }
+        os << blocks[n].size() << '\n';
+        os.write(reinterpret_cast<const char *>(blocks[n].data()), static_cast<std::streamsize>(blocks[n].size()));
+        os << '\n';
+    }
 
     os.precision( original_precision );
     os.flush();
@@ -126,7 +254,167 @@ deformation_field::write_to( std::ostream &os ) const {
 
 bool
 deformation_field::read_from( std::istream &is ){
-    throw std::logic_error("Not yet implemented");
+    const auto finish_line = [&]() -> bool {
+        std::string shtl;
+        std::getline(is, shtl);
+        return !is.fail() && Canonicalize_String2(shtl, CANONICALIZE::TRIM).empty();
+    };
+
+    std::string magic;
+    int64_t version = 0;
+    is >> magic >> version;
+    if( is.fail()
+    ||  (magic != "DCMA_DEFORMATION_FIELD")
+    ||  (version != 1) ){
+        YLOGWARN("Deformation field header not understood");
+        return false;
+    }
+
+    int64_t N_imgs = 0;
+    std::string encoding;
+    std::string compression;
+    is >> N_imgs >> encoding >> compression;
+    if( is.fail()
+    ||  !isininc(1, N_imgs, 1'000'000)
+    ||  ((encoding != "float64") && (encoding != "float32"))
+    ||  ((compression != "none") && (compression != "zlib"))
+    ||  !finish_line() ){
+        YLOGWARN("Deformation field encoding not understood");
+        return false;
+    }
+    const bool single_precision = (encoding == "float32");
+    const bool compressed = (compression == "zlib");
+    const size_t elem_size = (single_precision) ? sizeof(float) : sizeof(double);
+
+    planar_image_collection<double,double> coll;
+    std::vector<std::vector<unsigned char>> blocks;
+    for(int64_t n = 0; n < N_imgs; ++n){
+        coll.images.emplace_back();
+        auto &img = coll.images.back();
+
+        int64_t rows = 0;
+        int64_t columns = 0;
+        int64_t channels = 0;
+        double pxl_dx = 0.0;
+        double pxl_dy = 0.0;
+        double pxl_dz = 0.0;
+        vec3<double> anchor;
+        vec3<double> offset;
+        vec3<double> row_unit;
+        vec3<double> col_unit;
+        try{
+            is >> rows >> columns >> channels >> pxl_dx >> pxl_dy >> pxl_dz;
+            is >> anchor >> offset >> row_unit >> col_unit;
+        }catch(const std::exception &e){
+            YLOGWARN("Failed to read deformation field image geometry: " << e.what());
+            return false;
+        }
+        if( is.fail()
+        ||  !isininc(1, rows, 1'000'000)
+        ||  !isininc(1, columns, 1'000'000)
+        ||  (channels != 3)
+        ||  !finish_line() ){
+            YLOGWARN("Deformation field image geometry could not be read, or is invalid");
+            return false;
+        }
+        img.init_orientation(row_unit, col_unit);
+        img.init_buffer(rows, columns, channels);
+        img.init_spatial(pxl_dx, pxl_dy, pxl_dz, anchor, offset);
+
+        int64_t N_metadata = 0;
+        is >> N_metadata;
+        if( is.fail()
+        ||  (N_metadata < 0)
+        ||  !finish_line() ){
+            YLOGWARN("Deformation field image metadata could not be read");
+            return false;
+        }
+        for(int64_t i = 0; i < N_metadata; ++i){
+            std::string aline;
+            std::getline(is, aline);
+            auto kvp_opt = decode_metadata_kv_pair(aline);
+            if(is.fail() || !kvp_opt){
+                YLOGWARN("Deformation field image metadata could not be parsed");
+                return false;
+            }
+            img.metadata.insert(kvp_opt.value());
+        }
+
+        int64_t stored_len = 0;
+        is >> stored_len;
+        const auto raw_len = static_cast<int64_t>(img.data.size() * elem_size);
+        if( is.fail()
+        ||  (stored_len < 0)
+        ||  (!compressed && (stored_len != raw_len))
+        ||  !finish_line() ){
+            YLOGWARN("Deformation field voxel data length is invalid");
+            return false;
+        }
+
+        // Uncompressed 64-bit data on a little-endian host can be read directly into the image.
+        if( !compressed
+        &&  !single_precision
+        &&  host_is_little_endian() ){
+            is.read(reinterpret_cast<char *>(img.data.data()), static_cast<std::streamsize>(stored_len));
+            blocks.emplace_back();
+        }else{
+            blocks.emplace_back(static_cast<size_t>(stored_len));
+            is.read(reinterpret_cast<char *>(blocks.back().data()), static_cast<std::streamsize>(stored_len));
+        }
+        if(is.fail() || !finish_line()){
+            YLOGWARN("Deformation field voxel data could not be read");
+            return false;
+        }
+    }
+
+    // Decode (and decompress) the voxel data for each image in parallel.
+    std::vector<planar_image<double,double>*> imgs;
+    for(auto &img : coll.images) imgs.push_back( &img );
+    {
+        std::mutex saver_printer;
+        bool ok = true;
+        {
+            work_queue<std::function<void(void)>> wq;
+            for(size_t n = 0; n < imgs.size(); ++n){
+                if(blocks[n].empty()) continue;
+                wq.submit_task([&,n]() -> void {
+                    auto &img = *(imgs[n]);
+                    const size_t N = img.data.size();
+                    std::vector<unsigned char> raw;
+                    if(compressed){
+                        raw.resize(N * elem_size);
+                        uLongf raw_len = static_cast<uLongf>(raw.size());
+                        const auto res = uncompress(raw.data(), &raw_len,
+                                                    blocks[n].data(), static_cast<uLong>(blocks[n].size()));
+                        if( (res != Z_OK)
+                        ||  (raw_len != raw.size()) ){
+                            std::lock_guard<std::mutex> lock(saver_printer);
+                            YLOGWARN("Unable to decompress deformation field voxel data");
+                            ok = false;
+                            return;
+                        }
+                        raw = shuffle_bytes(raw, elem_size, false);
+                    }else{
+                        raw.swap(blocks[n]);
+                    }
+
+                    if(single_precision){
+                        from_little_endian_bytes<float>(raw.data(), N, img.data.data());
+                    }else{
+                        from_little_endian_bytes<double>(raw.data(), N, img.data.data());
+                    }
+                });
+            }
+        } // Wait for all tasks to complete.
+        if(!ok) return false;
+    }
+
+    try{
+        this->swap_and_rebuild(coll);
+    }catch(const std::exception &e){
+        YLOGWARN("Deformation field is invalid: " << e.what());
+        return false;
+    }
 
     return (!is.fail());
 }
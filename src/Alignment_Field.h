@@ -13,6 +13,12 @@
 #include "YgorImages.h"       //Needed for vec3 class.
 
 
+// Options for serializing deformation fields.
+struct deformation_field_write_opts {
+    bool single_precision = false; // Store vectors as 32-bit floats (lossy) rather than 64-bit floats.
+    bool compress = true;          // Compress voxel data using zlib.
+};
+
 class deformation_field {
     private:
         // These are private so they stay synchronized. The adjacency index is rebuilt when the field is altered.
@@ -39,8 +45,10 @@ class deformation_field {
         void apply_to(planar_image<float, double> &img) const;
         void apply_to(planar_image_collection<float, double> &img) const;
 
-        // Serialize and deserialize to a human- and machine-readable format.
+        // Serialize and deserialize to a compact binary format. The image geometry is stored as text, but voxel data are
+        // stored in binary, so streams should be opened in binary mode.
         bool write_to( std::ostream &os ) const;
+        bool write_to( std::ostream &os, const deformation_field_write_opts &opts ) const;
         bool read_from( std::istream &is );
 };
 
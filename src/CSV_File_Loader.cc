@@ -31,6 +31,7 @@
 
 #include "Metadata.h"
 #include "Structs.h"
+#include "Raw_Volume_IO.h"    //Needed for mapped_file.
 //#include "Imebra_Shim.h"      //Needed for Collate_Image_Arrays().
 
 
@@ -60,8 +61,8 @@ bool Load_From_CSV_Files( Drover &DICOM_data,
             DICOM_data.table_data.emplace_back( std::make_shared<Sparse_Table>() );
             auto* tab_ptr = &( DICOM_data.table_data.back()->table );
 
-            std::ifstream is(Filename.string(), std::ios::in | std::ios::binary);
-            tab_ptr->read_csv(is);
+            const mapped_file mf(Filename);
+            tab_ptr->read_csv(reinterpret_cast<const char *>(mf.data()), mf.size());
 
             // Ensure a minimal amount of metadata is present for image purposes.
             auto l_meta = coalesce_metadata_for_basic_table(tab_ptr->metadata);
@@ -9,10 +9,13 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>    
 #include <filesystem>
+#include <functional>
 #include <cstdlib>
+#include <vector>
 
 #include "YgorImages.h"
 #include "YgorImagesIO.h"
@@ -22,6 +25,7 @@
 
 #include "Metadata.h"
 #include "Structs.h"
+#include "Thread_Pool.h"
 #include "STB_Shim.h"
 
 bool Load_From_Common_Image_Files( Drover &DICOM_data,
@@ -39,6 +43,31 @@ bool Load_From_Common_Image_Files( Drover &DICOM_data,
 
     DICOM_data.image_data.emplace_back( std::make_shared<Image_Array>() );
 
+    // Decode all files concurrently. Metadata are assigned afterward in file order so that results are deterministic.
+    const std::vector<std::filesystem::path> paths(std::begin(Filenames), std::end(Filenames));
+    std::vector<planar_image_collection<float, double>> decoded(paths.size());
+    std::mutex saver_printer;
+    std::exception_ptr failure;
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(size_t j = 0; j < paths.size(); ++j){
+            wq.submit_task([&,j]() -> void {
+                try{
+                    decoded[j] = ReadImageUsingSTB(paths[j].string());
+                }catch(const std::exception &){
+                    std::lock_guard<std::mutex> lock(saver_printer);
+                    if(!failure) failure = std::current_exception();
+                }
+            });
+        }
+    } // Wait for all tasks to complete.
+
+    // The queue does not propagate exceptions, so decoding failures are rethrown here to fail the load.
+    if(failure){
+        DICOM_data.image_data.pop_back();
+        std::rethrow_exception(failure);
+    }
+
     size_t i = 0;
     const size_t N = Filenames.size();
     auto l_meta = coalesce_metadata_for_basic_image({});
@@ -46,10 +75,10 @@ bool Load_From_Common_Image_Files( Drover &DICOM_data,
     auto bfit = Filenames.begin();
     while(bfit != Filenames.end()){
         YLOGINFO("Parsing file #" << i+1 << "/" << N << " = " << 100*(i+1)/N << "%");
+        auto &imgcoll = decoded[i];
         ++i;
         const auto Filename = *bfit;
 
-        auto imgcoll = ReadImageUsingSTB(Filename.string());
         bool read_successfully = !imgcoll.images.empty();
         if(read_successfully){
 
@@ -0,0 +1,258 @@
+//Contour_Index.cc - A part of DICOMautomaton 2026.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "YgorMath.h"
+#include "YgorMisc.h"
+#include "YgorLog.h"
+
+#include "Thread_Pool.h"
+#include "Contour_Index.h"
+
+
+contour_index::contour_index( const std::list<cop_refw_t> &cops,
+                              const vec3<double> &N,
+                              double l_plane_tolerance,
+                              double l_bucket_width,
+                              uint32_t l_properties )
+        : plane_tolerance(l_plane_tolerance),
+          bucket_width(l_bucket_width),
+          computed(l_properties) {
+
+    if( !N.isfinite() || (N.length() <= 0.0) ){
+        throw std::invalid_argument("Contour index normal is not valid. Cannot continue.");
+    }
+    if( !std::isfinite(this->plane_tolerance) || (this->plane_tolerance <= 0.0) ){
+        throw std::invalid_argument("Contour index plane tolerance must be positive. Cannot continue.");
+    }
+    this->normal = N.unit();
+
+    // Build an orthonormal in-plane basis using whichever cardinal axis is least aligned with the normal.
+    const vec3<double> x_axis(1.0, 0.0, 0.0);
+    const vec3<double> y_axis(0.0, 1.0, 0.0);
+    const auto helper = (std::abs(this->normal.Dot(x_axis)) < 0.9) ? x_axis : y_axis;
+    this->u_unit = this->normal.Cross(helper).unit();
+    this->v_unit = this->normal.Cross(this->u_unit).unit();
+
+    // Compute contour properties in parallel. Each task fills a disjoint range of the table.
+    for(const auto &cop_refw : cops){
+        this->props.push_back( contour_properties{ cop_refw } );
+    }
+    const auto N_props = this->props.size();
+    const bool want_area = ((this->computed & property::area) != 0);
+    const bool want_perimeter = ((this->computed & property::perimeter) != 0);
+    const bool want_geometry = ((this->computed & property::geometry) != 0);
+    {
+        const size_t N_tasks = std::max<size_t>(1, std::min<size_t>(N_props, 4 * std::max(1U, std::thread::hardware_concurrency())));
+        const size_t chunk = (N_props + N_tasks - 1) / N_tasks;
+
+        std::mutex saver_printer;
+        std::exception_ptr failure;
+        {
+            work_queue<std::function<void(void)>> wq;
+            for(size_t begin = 0; begin < N_props; begin += chunk){
+                const auto end = std::min(N_props, begin + chunk);
+                wq.submit_task([&,begin,end]() -> void {
+                    try{
+                        for(size_t i = begin; i < end; ++i){
+                            auto &p = this->props[i];
+                            const auto &c = p.contour.get();
+                            if(c.points.empty()) continue;
+
+                            if(want_area) p.area = std::abs(c.Get_Signed_Area());
+                            if(want_perimeter) p.perimeter = c.Perimeter();
+                            if(!want_geometry) continue;
+
+                            p.centroid = c.Centroid();
+                            p.plane_offset = this->offset_of(p.centroid);
+
+                            p.u_min = p.v_min = p.plane_min = std::numeric_limits<double>::infinity();
+                            p.u_max = p.v_max = p.plane_max = -std::numeric_limits<double>::infinity();
+                            for(const auto &v : c.points){
+                                const auto n_pos = this->offset_of(v);
+                                p.plane_min = std::min(p.plane_min, n_pos);
+                                p.plane_max = std::max(p.plane_max, n_pos);
+
+                                const auto u_pos = v.Dot(this->u_unit);
+                                const auto v_pos = v.Dot(this->v_unit);
+                                p.u_min = std::min(p.u_min, u_pos);
+                                p.u_max = std::max(p.u_max, u_pos);
+                                p.v_min = std::min(p.v_min, v_pos);
+                                p.v_max = std::max(p.v_max, v_pos);
+                            }
+                        }
+                    }catch(const std::exception &){
+                        std::lock_guard<std::mutex> lock(saver_printer);
+                        if(!failure) failure = std::current_exception();
+                    }
+                });
+            }
+        } // Wait for all tasks to complete.
+        if(failure) std::rethrow_exception(failure);
+    }
+    if(!want_geometry) return;
+
+    // Estimate the bucket width so that a typical contour spans roughly one bucket.
+    if( !std::isfinite(this->bucket_width) || (this->bucket_width <= 0.0) ){
+        double total_extent = 0.0;
+        int64_t N_extents = 0;
+        for(const auto &p : this->props){
+            if(p.contour.get().points.empty()) continue;
+            total_extent += std::max(p.u_max - p.u_min, p.v_max - p.v_min);
+            ++N_extents;
+        }
+        this->bucket_width = (0 < N_extents) ? total_extent / static_cast<double>(N_extents) : 1.0;
+        if( !std::isfinite(this->bucket_width) || (this->bucket_width <= 0.0) ) this->bucket_width = 1.0;
+    }
+
+    // Insert planar contours into the buckets overlapping their bounding box. Contours that extend beyond their plane
+    // are kept aside so they do not widen queries for every other plane.
+    for(size_t i = 0; i < N_props; ++i){
+        const auto &p = this->props[i];
+        if(p.contour.get().points.empty()) continue;
+        if( (this->plane_tolerance < (p.plane_max - p.plane_offset))
+        ||  (this->plane_tolerance < (p.plane_offset - p.plane_min)) ){
+            this->oblique.push_back(i);
+            continue;
+        }
+
+        auto &buckets = this->planes[ this->plane_key(p.plane_offset) ];
+        const auto i_lo = this->bucket_key(p.u_min);
+        const auto i_hi = this->bucket_key(p.u_max);
+        const auto j_lo = this->bucket_key(p.v_min);
+        const auto j_hi = this->bucket_key(p.v_max);
+        for(auto bi = i_lo; bi <= i_hi; ++bi){
+            for(auto bj = j_lo; bj <= j_hi; ++bj){
+                buckets[ std::make_pair(bi, bj) ].push_back(i);
+            }
+        }
+    }
+}
+
+int64_t contour_index::plane_key(double offset) const {
+    return static_cast<int64_t>( std::floor(offset / this->plane_tolerance) );
+}
+
+int64_t contour_index::bucket_key(double x) const {
+    return static_cast<int64_t>( std::floor(x / this->bucket_width) );
+}
+
+void contour_index::require_geometry() const {
+    if((this->computed & property::geometry) == 0){
+        throw std::logic_error("Contour index was built without geometry. Unable to perform spatial queries.");
+    }
+}
+
+const std::vector<contour_properties> & contour_index::properties() const {
+    return this->props;
+}
+
+double contour_index::offset_of(const vec3<double> &X) const {
+    return X.Dot(this->normal);
+}
+
+std::vector<size_t> contour_index::near(const vec3<double> &X, double distance) const {
+    this->require_geometry();
+    std::vector<size_t> out;
+    if( !X.isfinite() || !std::isfinite(distance) || (distance < 0.0) ) return out;
+
+    const auto offset = this->offset_of(X);
+    const auto u_pos = X.Dot(this->u_unit);
+    const auto v_pos = X.Dot(this->v_unit);
+    const auto is_near_in_plane = [&](const contour_properties &p) -> bool {
+        const auto du = std::max({ 0.0, p.u_min - u_pos, u_pos - p.u_max });
+        const auto dv = std::max({ 0.0, p.v_min - v_pos, v_pos - p.v_max });
+        return ((du * du + dv * dv) <= (distance * distance));
+    };
+
+    const auto i_lo = this->bucket_key(u_pos - distance);
+    const auto i_hi = this->bucket_key(u_pos + distance);
+    const auto j_lo = this->bucket_key(v_pos - distance);
+    const auto j_hi = this->bucket_key(v_pos + distance);
+
+    // Adjacent plane keys are also checked since the plane tolerance boundary could split coplanar contours.
+    const auto key = this->plane_key(offset);
+    for(auto k = key - 1; k <= key + 1; ++k){
+        const auto p_it = this->planes.find(k);
+        if(p_it == std::end(this->planes)) continue;
+        const auto &buckets = p_it->second;
+
+        // Iterate over whichever is smaller: the queried buckets or the populated buckets.
+        const auto N_query = (i_hi - i_lo + 1) * (j_hi - j_lo + 1);
+        const auto consider = [&](const std::vector<size_t> &idxs){
+            for(const auto i : idxs){
+                const auto &p = this->props[i];
+                if(this->plane_tolerance < std::abs(p.plane_offset - offset)) continue;
+                if(is_near_in_plane(p)) out.push_back(i);
+            }
+        };
+        if(N_query < static_cast<int64_t>(buckets.size())){
+            for(auto bi = i_lo; bi <= i_hi; ++bi){
+                for(auto bj = j_lo; bj <= j_hi; ++bj){
+                    const auto b_it = buckets.find( std::make_pair(bi, bj) );
+                    if(b_it != std::end(buckets)) consider(b_it->second);
+                }
+            }
+        }else{
+            for(const auto &b : buckets){
+                if( (b.first.first < i_lo) || (i_hi < b.first.first)
+                ||  (b.first.second < j_lo) || (j_hi < b.first.second) ) continue;
+                consider(b.second);
+            }
+        }
+    }
+
+    // Oblique contours are on the point's plane if they span it.
+    for(const auto i : this->oblique){
+        const auto &p = this->props[i];
+        if( (offset < (p.plane_min - this->plane_tolerance))
+        ||  ((p.plane_max + this->plane_tolerance) < offset) ) continue;
+        if(is_near_in_plane(p)) out.push_back(i);
+    }
+
+    std::sort(std::begin(out), std::end(out));
+    out.erase( std::unique(std::begin(out), std::end(out)), std::end(out) );
+    return out;
+}
+
+std::vector<size_t> contour_index::within_planes(double offset_lo, double offset_hi) const {
+    this->require_geometry();
+    std::vector<size_t> out;
+    if(offset_hi < offset_lo) std::swap(offset_lo, offset_hi);
+    offset_lo -= this->plane_tolerance;
+    offset_hi += this->plane_tolerance;
+    const auto overlaps = [&](const contour_properties &p) -> bool {
+        return (offset_lo <= p.plane_max) && (p.plane_min <= offset_hi);
+    };
+
+    // Bucketed contours are keyed by their centroid and extend at most the plane tolerance beyond it.
+    const auto p_begin = this->planes.lower_bound( this->plane_key(offset_lo - this->plane_tolerance) );
+    const auto p_end = this->planes.upper_bound( this->plane_key(offset_hi + this->plane_tolerance) );
+    for(auto p_it = p_begin; p_it != p_end; ++p_it){
+        for(const auto &b : p_it->second){
+            for(const auto i : b.second){
+                if(overlaps(this->props[i])) out.push_back(i);
+            }
+        }
+    }
+    for(const auto i : this->oblique){
+        if(overlaps(this->props[i])) out.push_back(i);
+    }
+
+    std::sort(std::begin(out), std::end(out));
+    out.erase( std::unique(std::begin(out), std::end(out)), std::end(out) );
+    return out;
+}
+
@@ -0,0 +1,97 @@
+//Contour_Index.h.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "YgorMath.h"
+
+
+// Geometric properties of a single contour, computed once and cached.
+struct contour_properties {
+    std::reference_wrapper<contour_of_points<double>> contour;
+
+    double area = 0.0;       // Unsigned area.
+    double perimeter = 0.0;
+    vec3<double> centroid;
+
+    double plane_offset = 0.0; // Position of the centroid along the index normal.
+    double plane_min = 0.0;    // Extent of the vertices along the index normal.
+    double plane_max = 0.0;
+
+    // Bounding box in the in-plane (u, v) coordinate system of the index.
+    double u_min = 0.0;
+    double u_max = 0.0;
+    double v_min = 0.0;
+    double v_max = 0.0;
+};
+
+
+// Flat table of contour properties with a per-plane spatial bucket index.
+//
+// Contours are grouped into planes by their position along a common normal. Within each plane, contours are inserted
+// into a uniform 2D grid of buckets covering their in-plane bounding box, so queries only need to consider contours in
+// nearby buckets rather than every contour. Contours that are not confined to a single plane (e.g., oblique contours)
+// are kept aside and checked individually, so they do not widen queries for the planar contours.
+class contour_index {
+  public:
+    using cop_refw_t = std::reference_wrapper<contour_of_points<double>>;
+
+    // The properties to compute. Spatial queries require the geometry.
+    enum property : uint32_t {
+        area      = 1U << 0,
+        perimeter = 1U << 1,
+        geometry  = 1U << 2, // Centroid, extents, and spatial buckets.
+        all       = area | perimeter | geometry,
+    };
+
+  private:
+    vec3<double> normal;
+    vec3<double> u_unit;
+    vec3<double> v_unit;
+    double plane_tolerance;
+    double bucket_width;
+    uint32_t computed;
+
+    std::vector<contour_properties> props;
+
+    // plane key -> (bucket (i, j) -> contour indices). Only contours confined to their plane are bucketed.
+    std::map<int64_t, std::map<std::pair<int64_t, int64_t>, std::vector<size_t>>> planes;
+
+    // Contours that extend beyond their plane by more than the plane tolerance.
+    std::vector<size_t> oblique;
+
+    int64_t plane_key(double offset) const;
+    int64_t bucket_key(double x) const;
+    void require_geometry() const;
+
+  public:
+    // Contour properties are computed in parallel.
+    //
+    // Contours whose centroids differ by less than the plane tolerance along the normal are considered coplanar. If
+    // the bucket width is not positive, it is estimated from the average contour extent.
+    contour_index( const std::list<cop_refw_t> &cops,
+                   const vec3<double> &normal,
+                   double plane_tolerance = 1E-3,
+                   double bucket_width = -1.0,
+                   uint32_t properties = property::all );
+
+    const std::vector<contour_properties> & properties() const;
+
+    // Indices of contours on the same plane as the point whose in-plane bounding box is within the given distance of
+    // the point. Results are sorted.
+    std::vector<size_t> near(const vec3<double> &X, double distance) const;
+
+    // Indices of contours with any vertex whose offset lies within [offset_lo, offset_hi] (widened by the plane
+    // tolerance). Results are sorted.
+    std::vector<size_t> within_planes(double offset_lo, double offset_hi) const;
+
+    // Position of a point along the index normal, for use with within_planes().
+    double offset_of(const vec3<double> &X) const;
+};
+
@@ -17,7 +17,7 @@
 #include <algorithm>
 #include <cstdlib>            //Needed for exit() calls.
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "Imebra_Shim.h"      //Wrapper for Imebra library. Black-boxed to speed up compilation.
 #include "Structs.h"
 #include "YgorImages.h"
@@ -187,7 +187,7 @@ if(std::get_if<std::monostate>(&(t->transform)) != nullptr) YLOGWARN("(std::get_
 
     //Attempt contour name normalization using the selected lexicon.
     {
-        Explicator X(FilenameLex);
+        Shared_Lexicon X(FilenameLex);
         for(auto & cc : loaded_contour_data_storage->ccs){
              for(auto & c : cc.contours){
                  const auto NormalizedROIName = X(c.metadata["ROIName"]); //Could be cached, externally or internally.
@@ -35,6 +35,7 @@
 #include "Lexicon_Loader.h"
 
 #include "Operation_Dispatcher.h"
+#include "Write_File.h"
 #include "DCMA_Version.h"
 
 //extern const std::string DCMA_VERSION_STR;
@@ -435,7 +436,17 @@ try{
         throw std::runtime_error("No data was loaded, and virtual data switch was not provided. Refusing to proceed");
     }
 
-    if(!Operation_Dispatcher(DICOM_data, InvocationMetadata, FilenameLex, Operations)){
+    // Exports may be written in the background, so ensure they complete (and report any errors) even when the
+    // analysis fails.
+    bool ok = false;
+    try{
+        ok = Operation_Dispatcher(DICOM_data, InvocationMetadata, FilenameLex, Operations);
+    }catch(const std::exception &){
+        Flush_Write_Behind();
+        throw;
+    }
+    Flush_Write_Behind();
+    if(!ok){
         throw std::runtime_error("Analysis failed. Cannot continue");
     }
 
@@ -59,6 +59,7 @@
 #include "XYZ_File_Loader.h"
 #include "Lexicon_Loader.h"
 #include "Operation_Dispatcher.h"
+#include "Write_File.h"
 #include "Structs.h"
 #include "Regex_Selectors.h"
 #include "YgorFilesDirs.h"    //Needed for Does_File_Exist_And_Can_Be_Read(...), etc..
@@ -1178,6 +1179,14 @@ void BaseWebServerApplication::createComputeGB(){
             AllSuccessful = false;
             //return;
         }
+
+        // Ensure exported files are complete before they are offered to the user.
+        try{
+            Flush_Write_Behind();
+        }catch(const std::exception &e){
+            feedback->setText("<p>Export failed: "_s + e.what() + ".</p>");
+            AllSuccessful = false;
+        }
     }
     if(AllSuccessful){
         feedback->setText("<p>Operation successful.</p>");
@@ -16,7 +16,7 @@
 #include <filesystem>
 #include <cstdlib>            //Needed for exit() calls.
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "Structs.h"
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -83,7 +83,7 @@ void Consume_BOM(std::istream &is){
 }
 
 std::map<std::string, std::string> Read_Header_Block(std::istream &is,
-                                                     Explicator &X,
+                                                     const Shared_Lexicon &X,
                                                      std::map<std::string, std::string> metadata){
     // Parses a metadata block, reading a block of lines until a whitespace-only line is encountered.
     // The provided metadata will be combined with (and overwritten by) the locally parsed metadata.
@@ -332,7 +332,7 @@ bool Load_From_DVH_Files( Drover &DICOM_data,
     //
     if(Filenames.empty()) return true;
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     size_t i = 0;
     const size_t N = Filenames.size();
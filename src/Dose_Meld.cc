@@ -12,16 +12,20 @@
 // computing the min/max dose).
 //
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
 #include <list>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 #include <cstdint>
-//#include <utility>   //For std::pair.
-//#include <algorithm> //std::min_element/max_element.
 //#include <tuple>
 
 #include "Structs.h"
 #include "Regex_Selectors.h"
+#include "Thread_Pool.h"
 
 #include "Dose_Meld.h"
 
@@ -94,90 +98,180 @@ Drover Meld_Only_Dose_Data(Drover d){
     
 }
 
-//This routine will attempt to meld all data into a single unit. It may not be possible, so multiple data *may* be returned. 
-std::list<std::shared_ptr<Image_Array>>  Meld_Image_Data(const std::list<std::shared_ptr<Image_Array>> &dalist){
-    //Cycle through the data, checking if neighbouring collections have identical geometry. 
-    // If they do, it is fairly safe to combine them. 
-    //
-    //We need to check if the dose volumes and voxels overlap exactly or not. If they do, we can compute the mean within each
-    // separately and sum them afterward. If they don't, the situation becomes very tricky. It is possible to compute it, but
-    // it is not done here (if they overlap with zero volume then it is again easy, but it doesn't fit this routine terribly well).
-    //
-    std::list<std::shared_ptr<Image_Array>> out(dalist);
-    out.remove_if([](auto dap){
-        return (dap == nullptr);
-    });
-
-    if(out.size() == 0) return out;
-    if(out.size() == 1) return out;
-
-    auto d2_it = out.begin(); //Note: d*_it are ~ std::list<std::shared_ptr<Image_Array>>::iterator
-    auto d1_it = --(out.end());
-    while((d1_it != out.end()) && (d2_it != out.end()) && (d1_it != d2_it)){
-        //If the geometry is the same, we can easily meld the data. Do so and erase the superfluous data.
-        if((*d1_it)->imagecoll.Spatially_eq((*d2_it)->imagecoll)){
-            YLOGINFO("Image images are spatially equal. Performing the equivalent-geometry meld routine");
-
-            //Put the melded data into the first position.
-            *d1_it = Meld_Equal_Geom_Image_Data(*d1_it, *d2_it);
-            d2_it = out.erase(d2_it);
-            continue;
-
-        //If the geometry is not the same, we have to further investigate whether we can handle it or not. 
-        }else{
-            YLOGINFO("Image images are not spatially equal. Performing the nonequivalent-geometry meld routine");
-
-            *d1_it = Meld_Unequal_Geom_Image_Data(*d1_it, *d2_it);
-            if(*d1_it != nullptr){
-                d2_it = out.erase(d2_it);
-                continue;
-            }else{
-                YLOGERR("Unable to meld nonequivalent-geometry images");
+//Sums the voxels of all provided arrays onto the grid of the array with the largest volume, in a single pass.
+//
+// Arrays that share the output geometry are summed directly. Arrays that do not are sampled (nearest-voxel) at the
+// output voxel positions; voxels outside of an array contribute nothing. Sampling locations depend only on geometry, so
+// they are computed once and shared by all arrays with the same geometry.
+static std::unique_ptr<Image_Array>
+Sum_Image_Arrays(const std::vector<std::shared_ptr<Image_Array>> &arrays, bool &resampled){
+    resampled = false;
+    if(arrays.empty()) return nullptr;
+
+    size_t ref_n = 0;
+    for(size_t i = 1; i < arrays.size(); ++i){
+        if(arrays[ref_n]->imagecoll.volume() < arrays[i]->imagecoll.volume()) ref_n = i;
+    }
+    auto out = std::make_unique<Image_Array>();
+    *out = *(arrays[ref_n]); //Make a deep copy of the data.
+
+    std::vector<planar_image<float,double>*> out_imgs;
+    for(auto &img : out->imagecoll.images) out_imgs.push_back( &img );
+
+    //Partition the remaining arrays into groups with identical geometry.
+    struct geom_group {
+        std::shared_ptr<Image_Array> rep;
+        bool aligned = false; // Whether voxels coincide with the output voxels.
+        std::vector<std::vector<const planar_image<float,double>*>> members; // Images of each member, in order.
+        vec3<double> normal; // Normal of the first image, used to order the image planes.
+        std::vector<std::pair<double, int64_t>> planes; // (Offset along the normal, image ordinal), sorted.
+    };
+    std::vector<geom_group> groups;
+    for(size_t i = 0; i < arrays.size(); ++i){
+        if(i == ref_n) continue;
+        const auto &a = arrays[i];
+
+        auto g_it = std::find_if(std::begin(groups), std::end(groups), [&](const geom_group &g){
+            return g.rep->imagecoll.Spatially_eq(a->imagecoll);
+        });
+        if(g_it == std::end(groups)){
+            groups.emplace_back();
+            g_it = std::prev(std::end(groups));
+            g_it->rep = a;
+
+            g_it->aligned = out->imagecoll.Spatially_eq(a->imagecoll)
+                         && (out->imagecoll.images.size() == a->imagecoll.images.size())
+                         && std::equal(std::begin(out->imagecoll.images), std::end(out->imagecoll.images),
+                                       std::begin(a->imagecoll.images),
+                                       [](const planar_image<float,double> &A, const planar_image<float,double> &B){
+                                           return (A.rows == B.rows)
+                                               && (A.columns == B.columns)
+                                               && (A.channels == B.channels);
+                                       });
+            if(!g_it->aligned){
+                resampled = true;
+                const auto &img_f = a->imagecoll.images.front();
+                g_it->normal = img_f.row_unit.Cross(img_f.col_unit).unit();
+                int64_t n = 0;
+                for(const auto &img : a->imagecoll.images){
+                    g_it->planes.emplace_back( img.center().Dot(g_it->normal), n++ );
+                }
+                std::sort(std::begin(g_it->planes), std::end(g_it->planes));
             }
         }
+
+        g_it->members.emplace_back();
+        for(const auto &img : a->imagecoll.images) g_it->members.back().push_back( &img );
     }
-  
+
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(size_t n = 0; n < out_imgs.size(); ++n){
+            wq.submit_task([n,&out_imgs,&groups]() -> void {
+                auto &img = *(out_imgs[n]);
+
+                // Accumulate in double precision so many arrays can be summed without loss of precision.
+                std::vector<double> acc(std::begin(img.data), std::end(img.data));
+                const auto N = acc.size();
+
+                std::vector<std::pair<int64_t, int64_t>> samples; // (image ordinal, flat index) for each output voxel.
+                for(const auto &g : groups){
+                    if(g.aligned){
+                        // Spatially equal image collections are ordered identically, so voxels correspond one-to-one.
+                        for(const auto &m : g.members){
+                            const auto &d = m[n]->data;
+                            for(size_t i = 0; i < N; ++i) acc[i] += static_cast<double>(d[i]);
+                        }
+                        continue;
+                    }
+
+                    // Locate the source voxel for every output voxel once, then re-use it for all members.
+                    samples.assign(N, { -1, -1 });
+                    const auto &imgs = g.members.front();
+                    for(int64_t r = 0; r < img.rows; ++r){
+                        for(int64_t c = 0; c < img.columns; ++c){
+                            const auto pos = img.position(r, c);
+
+                            // Find the nearest image planes by bisection and check the immediate neighbours.
+                            const auto offset = pos.Dot(g.normal);
+                            const auto p_it = std::lower_bound(std::begin(g.planes), std::end(g.planes),
+                                                               std::make_pair(offset, static_cast<int64_t>(-1)));
+                            const auto p_n = std::distance(std::begin(g.planes), p_it);
+                            for(auto k = p_n - 1; k <= p_n; ++k){
+                                if( (k < 0) || (static_cast<int64_t>(g.planes.size()) <= k) ) continue;
+                                const auto ord = g.planes[k].second;
+                                const auto &src = *(imgs[ord]);
+                                const auto l_max = std::min(img.channels, src.channels);
+                                if(src.index(pos, 0) < 0) continue;
+                                for(int64_t l = 0; l < l_max; ++l){
+                                    samples[img.index(r, c, l)] = { ord, src.index(pos, l) };
+                                }
+                                break;
+                            }
+                        }
+                    }
+
+                    for(const auto &m : g.members){
+                        for(size_t i = 0; i < N; ++i){
+                            const auto &s = samples[i];
+                            if(s.first < 0) continue;
+                            acc[i] += static_cast<double>(m[s.first]->data[s.second]);
+                        }
+                    }
+                }
+
+                for(size_t i = 0; i < N; ++i) img.data[i] = static_cast<float>(acc[i]);
+            });
+        }
+    } // Wait for all tasks to complete.
+
+    const std::string desc = (resampled) ? "Unequal-geometry dose melded." : "Equal-geometry dose melded.";
+    for(auto &img : out->imagecoll.images){
+        img.metadata["Description"] = desc;
+    }
+
     return out;
 }
 
-std::unique_ptr<Image_Array> Meld_Equal_Geom_Image_Data(const std::shared_ptr<Image_Array>& A, const std::shared_ptr<Image_Array>& B){
-    auto out = std::make_unique<Image_Array>();
-    *out = *A; //Performs a deep copy.
-
-    //Now cycle through the voxel data, adjusting the integer dose. We can run through all data 
-    // in one pass (each) because the geometry is the same.
-    auto i0_it = out->imagecoll.images.begin();
-    auto i1_it = A->imagecoll.images.begin();
-    auto i2_it = B->imagecoll.images.begin();
-    for(   ;    (i0_it != out->imagecoll.images.end()) 
-             && (i1_it !=   A->imagecoll.images.end()) 
-             && (i2_it !=   B->imagecoll.images.end()); ++i0_it, ++i1_it, ++i2_it){
-
-        const auto rows     = i0_it->rows;
-        const auto columns  = i0_it->columns;
-        const auto channels = i0_it->channels;
-        for(int64_t r = 0; r < rows; ++r){
-            for(int64_t c = 0; c < columns; ++c){
-                for(int64_t l = 0; l < channels; ++l){
-                    //Get the (floating-point) dose from each image.
-                    const double dose = static_cast<double>(i1_it->value(r,c,l)) 
-                                      + static_cast<double>(i2_it->value(r,c,l));
-                    const auto dose_int = static_cast<decltype(i0_it->value(r,c,l))>( dose );                  
-
-                    //Set the new value of the channel.
-                    i0_it->reference(r,c,l) = dose_int;
-                }
-            }
+//This routine will attempt to meld all data into a single unit. It may not be possible, so multiple data *may* be returned. 
+std::list<std::shared_ptr<Image_Array>>  Meld_Image_Data(const std::list<std::shared_ptr<Image_Array>> &dalist){
+    //All arrays are summed in a single pass onto the largest grid. Arrays with identical geometry are summed directly.
+    // Arrays with differing geometry are resampled, which is lossy, but the resampling is only worked out once per
+    // distinct geometry.
+    //
+    // Arrays without any images cannot be melded and are passed through as-is.
+    std::list<std::shared_ptr<Image_Array>> out;
+    std::vector<std::shared_ptr<Image_Array>> to_meld;
+    for(const auto &dap : dalist){
+        if(dap == nullptr) continue;
+        if(dap->imagecoll.images.empty()){
+            out.push_back(dap);
+        }else{
+            to_meld.push_back(dap);
         }
     }
 
-    for(auto &img : out->imagecoll.images){
-        img.metadata["Description"] = "Equal-geometry dose melded.";
+    if(to_meld.size() <= 1){
+        out.insert(std::end(out), std::begin(to_meld), std::end(to_meld));
+        return out;
     }
 
+    bool resampled = false;
+    std::shared_ptr<Image_Array> melded = Sum_Image_Arrays(to_meld, resampled);
+    if(resampled){
+        YLOGINFO("Image arrays are not all spatially equal. Performed the nonequivalent-geometry meld routine");
+    }else{
+        YLOGINFO("Image arrays are spatially equal. Performed the equivalent-geometry meld routine");
+    }
+    out.push_front(melded);
     return out;
 }
 
+std::unique_ptr<Image_Array> Meld_Equal_Geom_Image_Data(const std::shared_ptr<Image_Array>& A, const std::shared_ptr<Image_Array>& B){
+    bool resampled = false;
+    return Sum_Image_Arrays({ A, B }, resampled);
+}
+
 /*
 //A typical case where dose data collections do *not* have the same geometry.
 
@@ -232,59 +326,9 @@ std::unique_ptr<Image_Array> Meld_Unequal_Geom_Image_Data(std::shared_ptr<Image_
     }
 
 
-    //------------------------------------- Preparation for melding ----------------------------------------
-
-    //Get the larger of the two images.
-    decltype(A) larger = B;
-    if( A->imagecoll.volume() >= B->imagecoll.volume() ){
-        larger = A;
-    }
-
-    *out = *larger; //Make a deep copy of the data.
-
-    //Now cycle through the voxel data, collecting the dose contributions from either A or B. 
-    auto i0_it = out->imagecoll.images.begin();
-    auto i1_it = A->imagecoll.images.begin();
-    auto i2_it = B->imagecoll.images.begin();
-    for(   ;    (i0_it != out->imagecoll.images.end())
-             && (i1_it !=   A->imagecoll.images.end())
-             && (i2_it !=   B->imagecoll.images.end()); ++i0_it, ++i1_it, ++i2_it){
-
-        const auto rows     = i0_it->rows;
-        const auto columns  = i0_it->columns;
-        const auto channels = i0_it->channels;
-        for(int64_t r = 0; r < rows; ++r){
-            for(int64_t c = 0; c < columns; ++c){
-                for(int64_t l = 0; l < channels; ++l){
-                    //Clear the value in the channel.
-                    const auto zero = static_cast<decltype(i0_it->value(r,c,l))>(0);
-                    i0_it->reference(r,c,l) = zero;
-
-                    //Get the (floating-point) dose from each image. If out of bounds, we will 
-                    // get a safe zero. 
-                    const auto pos = i0_it->position(r,c);
-                    auto dose_sum = zero;
-
-                    const auto indexA = i1_it->index(pos,l);
-                    if(indexA != -1){
-                        dose_sum += i1_it->value(indexA);
-                    }
-
-                    const auto indexB = i2_it->index(pos,l);
-                    if(indexB != -1){
-                        dose_sum += i2_it->value(indexB);
-                    }
-
-                    //Set the new value.
-                    i0_it->reference(r,c,l) = dose_sum;
-                }
-            }
-        }
-    }
-
-    for(auto &img : out->imagecoll.images){
-        img.metadata["Description"] = "Unequal-geometry dose melded.";
-    }
+    //------------------------------------------------ Melding ---------------------------------------------------
+    bool resampled = false;
+    out = Sum_Image_Arrays({ A, B }, resampled);
 
     return out;
 }
@@ -1,18 +1,29 @@
 //FITS_File_Loader.cc - A part of DICOMautomaton 2016. Written by hal clark.
 //
-// This program loads image data FITS files. It is basic and can only currently deal with FITS files 
-// containing a single image slice (and probably only images exported using the Ygor exporter).
+// This program loads image data FITS files. Files written by DICOMautomaton (multi-extension files with one image per
+// extension) and basic image arrays, including 3D and 4D cubes, are decoded directly. Other files (e.g., single images
+// exported using the Ygor exporter) are read using Ygor's FITS routines so that embedded metadata is recovered.
 //
 
+#include <algorithm>
+#include <cctype>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <exception>
 #include <fstream>
+#include <functional>
+#include <limits>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
 #include <stdexcept>
 #include <string>    
+#include <thread>
+#include <vector>
 //#include <cfenv>              //Needed for std::feclearexcept(FE_ALL_EXCEPT).
 
 #include <filesystem>
@@ -20,18 +31,512 @@
 
 #include "Metadata.h"
 #include "Structs.h"
+#include "Raw_Volume_IO.h"    //Needed for mapped_file and Byteswap_Buffer.
+#include "Thread_Pool.h"
 #include "YgorImages.h"
 #include "YgorImagesIO.h"
 #include "YgorMath.h"         //Needed for vec3 class.
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 #include "YgorLog.h"
 
+#include "FITS_File_Loader.h"
+
 template <typename... T_list, typename F>
 constexpr void for_types(F&& f){
     ( f.template operator()<T_list>(), ... );
 }
 
 
+// FITS files consist of header-data units (HDUs). Headers are sequences of 80-character ASCII cards terminated by an
+// 'END' card, and both headers and data are padded to a multiple of 2880 bytes. Data are big-endian.
+//
+// Image geometry is stored in DICOMautomaton-specific keywords, and metadata is stored in 'COMMENT' cards prefixed
+// with 'DCMA ' (first piece) or 'DCMA+' (continuation). Metadata keys and values are percent-encoded so that arbitrary
+// bytes survive.
+namespace {
+
+constexpr size_t fits_block_size = 2880;
+constexpr size_t fits_card_size = 80;
+constexpr size_t fits_meta_piece_size = 64;
+
+size_t fits_padded_size(size_t n){
+    return ((n + fits_block_size - 1) / fits_block_size) * fits_block_size;
+}
+
+void append_fits_card(std::string &hdr, std::string card){
+    card.resize(fits_card_size, ' ');
+    hdr += card;
+    return;
+}
+
+std::string fits_keyword(std::string k){
+    k.resize(8, ' ');
+    return k;
+}
+
+// Fixed-format numeric and logical values are right-justified in columns 11-30.
+void append_fits_fixed(std::string &hdr, const std::string &key, const std::string &val){
+    std::string v = val;
+    if(v.size() < 20) v.insert(0, 20 - v.size(), ' ');
+    append_fits_card(hdr, fits_keyword(key) + "= " + v);
+    return;
+}
+
+void append_fits_logical(std::string &hdr, const std::string &key, bool val){
+    append_fits_fixed(hdr, key, val ? "T" : "F");
+    return;
+}
+
+void append_fits_integer(std::string &hdr, const std::string &key, int64_t val){
+    append_fits_fixed(hdr, key, std::to_string(val));
+    return;
+}
+
+void append_fits_real(std::string &hdr, const std::string &key, double val){
+    if(!std::isfinite(val)) return; // Not representable in a header.
+    std::stringstream ss;
+    ss.precision( std::numeric_limits<double>::max_digits10 );
+    ss << std::uppercase << (val + 0.0); // Adding zero avoids emitting negative zeros.
+    auto s = ss.str();
+    if(s.find_first_of(".E") == std::string::npos) s += ".0";
+    append_fits_fixed(hdr, key, s);
+    return;
+}
+
+void append_fits_string(std::string &hdr, const std::string &key, const std::string &val){
+    std::string v;
+    for(const auto c : val){
+        v.push_back(c);
+        if(c == '\'') v.push_back(c);
+    }
+    if(v.size() < 8) v.resize(8, ' ');
+    append_fits_card(hdr, fits_keyword(key) + "= '" + v + "'");
+    return;
+}
+
+std::string fits_meta_escape(const std::string &in){
+    static const char *hex = "0123456789ABCDEF";
+    std::string out;
+    for(const auto c : in){
+        const auto u = static_cast<unsigned char>(c);
+        if( std::isgraph(u)
+        &&  (c != '%')
+        &&  (c != '=') ){
+            out.push_back(c);
+        }else{
+            out.push_back('%');
+            out.push_back(hex[u >> 4]);
+            out.push_back(hex[u & 0x0F]);
+        }
+    }
+    return out;
+}
+
+std::string fits_meta_unescape(const std::string &in){
+    const auto from_hex = [](char c) -> int {
+        if(('0' <= c) && (c <= '9')) return c - '0';
+        if(('A' <= c) && (c <= 'F')) return c - 'A' + 10;
+        if(('a' <= c) && (c <= 'f')) return c - 'a' + 10;
+        throw std::invalid_argument("Invalid escape sequence in metadata");
+    };
+    std::string out;
+    for(size_t i = 0; i < in.size(); ++i){
+        if(in[i] == '%'){
+            if(in.size() < (i + 3)) throw std::invalid_argument("Truncated escape sequence in metadata");
+            out.push_back(static_cast<char>(from_hex(in[i+1]) * 16 + from_hex(in[i+2])));
+            i += 2;
+        }else{
+            out.push_back(in[i]);
+        }
+    }
+    return out;
+}
+
+void append_fits_metadata(std::string &hdr, const metadata_map_t &metadata){
+    for(const auto &kv : metadata){
+        const auto entry = fits_meta_escape(kv.first) + "=" + fits_meta_escape(kv.second);
+        for(size_t i = 0; i < entry.size(); i += fits_meta_piece_size){
+            append_fits_card(hdr, fits_keyword("COMMENT") + ((i == 0) ? "DCMA " : "DCMA+")
+                                  + entry.substr(i, fits_meta_piece_size));
+        }
+    }
+    return;
+}
+
+void finish_fits_header(std::string &hdr){
+    append_fits_card(hdr, "END");
+    hdr.resize(fits_padded_size(hdr.size()), ' ');
+    return;
+}
+
+// Encodes an image as a complete image extension HDU. Channels are stored as separate planes along the third axis.
+std::vector<unsigned char> encode_fits_image(const planar_image<float,double> &img){
+    const bool has_chnls = (1 < img.channels);
+
+    std::string hdr;
+    append_fits_string(hdr, "XTENSION", "IMAGE");
+    append_fits_integer(hdr, "BITPIX", -32);
+    append_fits_integer(hdr, "NAXIS", has_chnls ? 3 : 2);
+    append_fits_integer(hdr, "NAXIS1", img.columns);
+    append_fits_integer(hdr, "NAXIS2", img.rows);
+    if(has_chnls) append_fits_integer(hdr, "NAXIS3", img.channels);
+    append_fits_integer(hdr, "PCOUNT", 0);
+    append_fits_integer(hdr, "GCOUNT", 1);
+    if(has_chnls) append_fits_logical(hdr, "DCMACHAN", true);
+
+    append_fits_real(hdr, "PXL_DX", img.pxl_dx);
+    append_fits_real(hdr, "PXL_DY", img.pxl_dy);
+    append_fits_real(hdr, "PXL_DZ", img.pxl_dz);
+    for(const auto &[name, v] : { std::make_pair(std::string("ANCHOR"),  img.anchor),
+                                  std::make_pair(std::string("OFFSET"),  img.offset),
+                                  std::make_pair(std::string("ROWUNIT"), img.row_unit),
+                                  std::make_pair(std::string("COLUNIT"), img.col_unit) }){
+        append_fits_real(hdr, name + "1", v.x);
+        append_fits_real(hdr, name + "2", v.y);
+        append_fits_real(hdr, name + "3", v.z);
+    }
+    append_fits_metadata(hdr, img.metadata);
+    finish_fits_header(hdr);
+
+    const auto N_rows = static_cast<size_t>(img.rows);
+    const auto N_cols = static_cast<size_t>(img.columns);
+    const auto N_chnls = static_cast<size_t>(img.channels);
+    const size_t N = N_rows * N_cols * N_chnls;
+    if(img.data.size() != N){
+        throw std::invalid_argument("Image buffer does not match its dimensions");
+    }
+
+    std::vector<unsigned char> out(hdr.size() + fits_padded_size(N * sizeof(float)), 0);
+    std::memcpy(out.data(), hdr.data(), hdr.size());
+    auto *d = out.data() + hdr.size();
+    if(!has_chnls){
+        std::memcpy(d, img.data.data(), N * sizeof(float));
+    }else{
+        std::vector<float> plane(N_rows * N_cols);
+        for(size_t c = 0; c < N_chnls; ++c){
+            for(size_t i = 0; i < plane.size(); ++i) plane[i] = img.data[i * N_chnls + c];
+            std::memcpy(d + c * plane.size() * sizeof(float), plane.data(), plane.size() * sizeof(float));
+        }
+    }
+    if(host_is_little_endian()){
+        Byteswap_Buffer(d, N, sizeof(float));
+    }
+    return out;
+}
+
+
+struct fits_hdu {
+    std::map<std::string, std::string> values; // Keyword to value. Strings are unquoted.
+    metadata_map_t metadata;
+    size_t data_offset = 0;
+    size_t data_size = 0;
+};
+
+std::string parse_fits_value(const std::string &field){
+    auto i = field.find_first_not_of(' ');
+    if(i == std::string::npos) return "";
+    std::string out;
+    if(field[i] == '\''){
+        for(++i; i < field.size(); ++i){
+            if(field[i] == '\''){
+                if( ((i + 1) < field.size())
+                &&  (field[i + 1] == '\'') ){
+                    out.push_back('\'');
+                    ++i;
+                    continue;
+                }
+                break;
+            }
+            out.push_back(field[i]);
+        }
+    }else{
+        const auto e = field.find('/', i);
+        out = field.substr(i, (e == std::string::npos) ? e : (e - i));
+    }
+    out.erase(out.find_last_not_of(' ') + 1); // Trailing spaces are not significant.
+    return out;
+}
+
+std::optional<int64_t> fits_integer(const fits_hdu &hdu, const std::string &key){
+    const auto it = hdu.values.find(key);
+    if(it == std::end(hdu.values)) return {};
+    size_t pos = 0;
+    const auto v = std::stoll(it->second, &pos);
+    if(pos != it->second.size()) throw std::invalid_argument("Unable to parse integer keyword '" + key + "'");
+    return static_cast<int64_t>(v);
+}
+
+std::optional<double> fits_real(const fits_hdu &hdu, const std::string &key){
+    const auto it = hdu.values.find(key);
+    if(it == std::end(hdu.values)) return {};
+    auto s = it->second;
+    std::replace(std::begin(s), std::end(s), 'D', 'E'); // Fortran-style exponents are permitted.
+    return std::stod(s);
+}
+
+bool fits_logical(const fits_hdu &hdu, const std::string &key){
+    const auto it = hdu.values.find(key);
+    return (it != std::end(hdu.values)) && (it->second == "T");
+}
+
+// Parses the headers of all HDUs in a file. Throws if the file is not a valid FITS file.
+std::vector<fits_hdu> scan_fits_hdus(const unsigned char *data, size_t size){
+    std::vector<fits_hdu> out;
+    size_t off = 0;
+    while((off + fits_block_size) <= size){
+        fits_hdu hdu;
+        std::string meta_entry;
+        const auto finish_meta_entry = [&](){
+            if(meta_entry.empty()) return;
+            const auto eq = meta_entry.find('=');
+            if(eq == std::string::npos) throw std::invalid_argument("Invalid metadata entry");
+            hdu.metadata[fits_meta_unescape(meta_entry.substr(0, eq))] = fits_meta_unescape(meta_entry.substr(eq + 1));
+            meta_entry.clear();
+        };
+
+        bool found_end = false;
+        size_t c = off;
+        for( ; (c + fits_card_size) <= size; c += fits_card_size){
+            const std::string card(reinterpret_cast<const char *>(data + c), fits_card_size);
+            auto key = card.substr(0, 8);
+            key.erase(key.find_last_not_of(' ') + 1);
+
+            if((c == off) && (key != (out.empty() ? "SIMPLE" : "XTENSION"))){
+                if(out.empty()) throw std::invalid_argument("Not a FITS file");
+                return out; // Trailing data that is not an extension is permitted.
+            }
+
+            if(key == "END"){
+                found_end = true;
+                c += fits_card_size;
+                break;
+
+            }else if(key == "COMMENT"){
+                auto text = card.substr(8);
+                text.erase(text.find_last_not_of(' ') + 1);
+                if(text.rfind("DCMA ", 0) == 0){
+                    finish_meta_entry();
+                    meta_entry = text.substr(5);
+                }else if(text.rfind("DCMA+", 0) == 0){
+                    meta_entry += text.substr(5);
+                }
+
+            }else if(card.compare(8, 2, "= ") == 0){
+                hdu.values[key] = parse_fits_value(card.substr(10));
+            }
+        }
+        finish_meta_entry();
+        if(!found_end) throw std::invalid_argument("FITS header is not terminated");
+        if( out.empty()
+        &&  !fits_logical(hdu, "SIMPLE") ){
+            throw std::invalid_argument("FITS file does not conform to the standard");
+        }
+
+        // Determine the data size.
+        const auto bitpix = fits_integer(hdu, "BITPIX");
+        const auto naxis = fits_integer(hdu, "NAXIS");
+        if(!bitpix || !naxis || (*naxis < 0) || (999 < *naxis)){
+            throw std::invalid_argument("FITS header is missing required keywords");
+        }
+        const auto bitpix_v = *bitpix;
+        if( (bitpix_v !=   8) && (bitpix_v !=  16) && (bitpix_v != 32) && (bitpix_v != 64)
+        &&  (bitpix_v != -32) && (bitpix_v != -64) ){
+            throw std::invalid_argument("FITS BITPIX is invalid");
+        }
+        const auto pcount = fits_integer(hdu, "PCOUNT").value_or(0);
+        const auto gcount = fits_integer(hdu, "GCOUNT").value_or(1);
+        if( (pcount < 0)
+        ||  (gcount < 1) ){
+            throw std::invalid_argument("FITS PCOUNT or GCOUNT is invalid");
+        }
+
+        // All sizes are bounded by the file size before multiplying so that malicious headers cannot overflow.
+        const auto max_N = static_cast<int64_t>(std::min<size_t>(size, std::numeric_limits<int64_t>::max() / 2));
+        int64_t N = (*naxis == 0) ? 0 : 1;
+        for(int64_t i = 1; i <= *naxis; ++i){
+            const auto n = fits_integer(hdu, "NAXIS" + std::to_string(i));
+            if(!n || (*n < 0)) throw std::invalid_argument("FITS axis length is invalid");
+            if( (*n != 0)
+            &&  ((max_N / *n) < N) ){
+                throw std::runtime_error("FITS data are truncated");
+            }
+            N *= *n;
+        }
+        if(0 < N){
+            if( ((max_N - N) < pcount)
+            ||  ((max_N / gcount) < (N + pcount)) ){
+                throw std::runtime_error("FITS data are truncated");
+            }
+            N = (N + pcount) * gcount;
+        }
+        const auto bytes_per_elem = static_cast<size_t>(std::abs(bitpix_v) / 8);
+        if((size / bytes_per_elem) < static_cast<size_t>(N)){
+            throw std::runtime_error("FITS data are truncated");
+        }
+
+        hdu.data_offset = fits_padded_size(c);
+        hdu.data_size = static_cast<size_t>(N) * bytes_per_elem;
+        if( (size < hdu.data_offset)
+        ||  ((size - hdu.data_offset) < hdu.data_size) ){
+            throw std::runtime_error("FITS data are truncated");
+        }
+        off = hdu.data_offset + std::min(fits_padded_size(hdu.data_size), size - hdu.data_offset);
+        out.emplace_back(std::move(hdu));
+    }
+    if(out.empty()) throw std::invalid_argument("Not a FITS file");
+    return out;
+}
+
+// Whether an HDU holds a (non-empty) image that can be decoded. Tables are not supported.
+bool fits_hdu_has_image(const fits_hdu &hdu, bool is_primary){
+    if( !is_primary
+    &&  (hdu.values.count("XTENSION") != 0)
+    &&  (hdu.values.at("XTENSION") != "IMAGE") ){
+        return false;
+    }
+    const auto naxis = fits_integer(hdu, "NAXIS").value();
+    if(naxis < 2) return false;
+    for(int64_t i = 1; i <= naxis; ++i){
+        if(fits_integer(hdu, "NAXIS" + std::to_string(i)).value() == 0) return false;
+    }
+    return true;
+}
+
+// Whether a file should be decoded directly, based on its headers alone. Files written by DICOMautomaton and files
+// with image extensions are handled directly. Other files are handled by Ygor's routines first since they may embed
+// metadata in Ygor's format.
+bool fits_prefer_direct(const std::vector<fits_hdu> &hdus){
+    if(fits_integer(hdus.front(), "DCMAFITS").has_value()) return true;
+    for(size_t h = 1; h < hdus.size(); ++h){
+        if(fits_hdu_has_image(hdus[h], false)) return true;
+    }
+    return false;
+}
+
+// Decodes all images in a file. Images are converted sequentially since files are decoded concurrently.
+planar_image_collection<float,double> decode_fits_images(const unsigned char *data, const std::vector<fits_hdu> &hdus){
+    planar_image_collection<float,double> out;
+    for(size_t h = 0; h < hdus.size(); ++h){
+        const auto &hdu = hdus[h];
+        if(!fits_hdu_has_image(hdu, h == 0)) continue;
+        const auto naxis = fits_integer(hdu, "NAXIS").value();
+
+        raw_volume_layout L;
+        switch(fits_integer(hdu, "BITPIX").value()){
+            case   8: L.type = raw_voxel_type::uint8;   break;
+            case  16: L.type = raw_voxel_type::int16;   break;
+            case  32: L.type = raw_voxel_type::int32;   break;
+            case  64: L.type = raw_voxel_type::int64;   break;
+            case -32: L.type = raw_voxel_type::float32; break;
+            case -64: L.type = raw_voxel_type::float64; break;
+            default: throw std::invalid_argument("FITS BITPIX is invalid");
+        }
+        L.big_endian = true;
+        L.slope = fits_real(hdu, "BSCALE").value_or(1.0);
+        L.intercept = fits_real(hdu, "BZERO").value_or(0.0);
+
+        // The third axis holds channels for files written by DICOMautomaton, and otherwise slices.
+        const bool chnl_axis = fits_logical(hdu, "DCMACHAN");
+        L.N_cols = fits_integer(hdu, "NAXIS1").value();
+        L.N_rows = fits_integer(hdu, "NAXIS2").value();
+        for(int64_t i = 3; i <= naxis; ++i){
+            const auto n = fits_integer(hdu, "NAXIS" + std::to_string(i)).value();
+            if(i == 3){
+                (chnl_axis ? L.N_chnls : L.N_slices) = n;
+            }else if((i == 4) && !chnl_axis){
+                L.N_times = n;
+            }else if(n != 1){
+                throw std::invalid_argument("FITS images with more than four axes are not supported");
+            }
+        }
+        if(L.N_voxels() == 0) continue;
+        L.set_planar_strides();
+
+        auto imagecoll = Raw_Volume_To_Images(L, data + hdu.data_offset, hdu.data_size, false);
+
+        // Restore the exact geometry, if available.
+        const auto pxl_dx = fits_real(hdu, "PXL_DX");
+        const auto pxl_dy = fits_real(hdu, "PXL_DY");
+        const auto pxl_dz = fits_real(hdu, "PXL_DZ");
+        std::vector<std::optional<vec3<double>>> vecs;
+        for(const std::string name : { "ANCHOR", "OFFSET", "ROWUNIT", "COLUNIT" }){
+            const auto x = fits_real(hdu, name + "1");
+            const auto y = fits_real(hdu, name + "2");
+            const auto z = fits_real(hdu, name + "3");
+            vecs.emplace_back();
+            if(x && y && z) vecs.back() = vec3<double>(x.value(), y.value(), z.value());
+        }
+        const bool has_geom = pxl_dx && pxl_dy && pxl_dz
+                           && std::all_of(std::begin(vecs), std::end(vecs), [](const auto &v){ return v.has_value(); });
+        for(auto &img : imagecoll.images){
+            if( has_geom
+            &&  (imagecoll.images.size() == 1) ){
+                img.init_orientation(vecs[2].value(), vecs[3].value());
+                img.init_spatial(pxl_dx.value(), pxl_dy.value(), pxl_dz.value(), vecs[0].value(), vecs[1].value());
+            }
+            img.metadata = hdu.metadata;
+        }
+
+        out.images.splice(std::end(out.images), imagecoll.images);
+    }
+    if(out.images.empty()){
+        throw std::invalid_argument("FITS file contains no images");
+    }
+    return out;
+}
+
+} // namespace
+
+
+bool Write_Images_To_FITS( const planar_image_collection<float,double> &imagecoll,
+                           const std::filesystem::path &filename ){
+    std::string hdr;
+    append_fits_logical(hdr, "SIMPLE", true);
+    append_fits_integer(hdr, "BITPIX", 8);
+    append_fits_integer(hdr, "NAXIS", 0);
+    append_fits_logical(hdr, "EXTEND", true);
+    append_fits_integer(hdr, "NEXTEND", static_cast<int64_t>(imagecoll.images.size()));
+    append_fits_string(hdr, "ORIGIN", "DICOMautomaton");
+    append_fits_integer(hdr, "DCMAFITS", 1);
+    finish_fits_header(hdr);
+
+    std::ofstream FO(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    FO.write(hdr.data(), static_cast<std::streamsize>(hdr.size()));
+
+    // Images are encoded concurrently in batches, which bounds the memory used for encoded copies.
+    std::vector<const planar_image<float,double>*> imgs;
+    for(const auto &img : imagecoll.images) imgs.emplace_back(&img);
+    const size_t batch_size = std::max<size_t>(2, 2 * std::thread::hardware_concurrency());
+
+    for(size_t b = 0; b < imgs.size(); b += batch_size){
+        const size_t N = std::min(batch_size, imgs.size() - b);
+        std::vector<std::vector<unsigned char>> encoded(N);
+        std::mutex saver_printer;
+        std::exception_ptr failure;
+        {
+            work_queue<std::function<void(void)>> wq;
+            for(size_t n = 0; n < N; ++n){
+                wq.submit_task([&,n]() -> void {
+                    try{
+                        encoded[n] = encode_fits_image(*(imgs[b + n]));
+                    }catch(const std::exception &){
+                        std::lock_guard<std::mutex> lock(saver_printer);
+                        if(!failure) failure = std::current_exception();
+                    }
+                });
+            }
+        } // Wait for all tasks to complete.
+        if(failure) std::rethrow_exception(failure);
+
+        for(const auto &e : encoded){
+            FO.write(reinterpret_cast<const char *>(e.data()), static_cast<std::streamsize>(e.size()));
+        }
+    }
+    FO.flush();
+    return (!FO.fail());
+}
+
+
 bool Load_From_FITS_Files( Drover &DICOM_data,
                            std::map<std::string,std::string> & /* InvocationMetadata */,
                            const std::string &,
@@ -51,16 +556,77 @@ bool Load_From_FITS_Files( Drover &DICOM_data,
     const size_t N = Filenames.size();
     auto l_meta = coalesce_metadata_for_basic_image({});
 
+    // Parse all headers concurrently, and decode only the files that are handled directly. Other files are handled by
+    // Ygor's routines and are only decoded here if that fails. Metadata are assigned afterward, in order, since they
+    // evolve from file to file.
+    const std::vector<std::filesystem::path> paths(std::begin(Filenames), std::end(Filenames));
+    std::vector<std::optional<std::vector<fits_hdu>>> headers(N);
+    std::vector<std::optional<planar_image_collection<float,double>>> decoded(N);
+    const auto decode_file = [&](size_t n){
+        try{
+            const mapped_file mf(paths[n]);
+            decoded[n] = decode_fits_images(mf.data(), headers[n].value());
+        }catch(const std::exception &e){
+            YLOGINFO("Unable to decode '" << paths[n].string() << "' as a FITS file: '" << e.what() << "'");
+        }
+    };
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(size_t n = 0; n < N; ++n){
+            wq.submit_task([&,n]() -> void {
+                try{
+                    const mapped_file mf(paths[n]);
+                    headers[n] = scan_fits_hdus(mf.data(), mf.size());
+                }catch(const std::exception &e){
+                    YLOGINFO("Unable to parse '" << paths[n].string() << "' as a FITS file: '" << e.what() << "'");
+                    return;
+                }
+                if(fits_prefer_direct(headers[n].value())) decode_file(n);
+            });
+        }
+    } // Wait for all tasks to complete.
+
+    const auto append_image = [&](planar_image<float,double> &&img, const std::filesystem::path &Filename){
+        // Fill in any missing metadata in a consistent way, but honour any existing metadata that might be present.
+        // Evolve the metadata so images loaded together stay linked, but allow existing metadata to take
+        // precendent.
+        auto ll_meta = img.metadata;
+        inject_metadata( l_meta, std::move(ll_meta) ); // ll_meta takes priority.
+        img.metadata = l_meta;
+        img.metadata["Filename"] = Filename.string();
+        l_meta = coalesce_metadata_for_basic_image(l_meta, meta_evolve::iterate); // Evolve for next image.
+
+        YLOGINFO("Loaded FITS image with dimensions " 
+                 << img.rows << " x " << img.columns
+                 << " and " << img.channels << " channels");
+
+        DICOM_data.image_data.back()->imagecoll.images.emplace_back( std::move(img) );
+    };
+    const auto append_decoded = [&](planar_image_collection<float,double> &d, const std::filesystem::path &Filename){
+        for(auto &img : d.images) append_image(std::move(img), Filename);
+        d.images.clear();
+    };
+
     auto bfit = Filenames.begin();
     while(bfit != Filenames.end()){
         YLOGINFO("Parsing file #" << i+1 << "/" << N << " = " << 100*(i+1)/N << "%");
+        const size_t n = i;
+        auto &d = decoded[n];
         ++i;
         const auto Filename = *bfit;
 
+        // Files written by DICOMautomaton and multi-extension files were decoded directly.
+        if(d){
+            append_decoded(*d, Filename);
+            bfit = Filenames.erase( bfit ); 
+            continue;
+        }
+
         //First, try planar_images that have been exported in the expected format (float, double).
         //Then try the most likely formats as exported by other programs.
         bool read_successfully = false;
         for_types<float, uint8_t, double>( [&]<typename T>(){
+            if(read_successfully) return;
 
             try{
                 auto imgcoll = ReadFromFITS<T,double>(Filename.string());
@@ -100,20 +666,7 @@ bool Load_From_FITS_Files( Drover &DICOM_data,
                         fimg_ptr = &(fimg);
                     }
 
-                    // Fill in any missing metadata in a consistent way, but honour any existing metadata that might be present.
-                    // Evolve the metadata so images loaded together stay linked, but allow existing metadata to take
-                    // precendent.
-                    auto ll_meta = fimg_ptr->metadata;
-                    inject_metadata( l_meta, std::move(ll_meta) ); // ll_meta takes priority.
-                    fimg_ptr->metadata = l_meta;
-                    fimg_ptr->metadata["Filename"] = Filename.string();
-                    l_meta = coalesce_metadata_for_basic_image(l_meta, meta_evolve::iterate); // Evolve for next image.
-
-                    YLOGINFO("Loaded FITS image with dimensions " 
-                             << fimg_ptr->rows << " x " << fimg_ptr->columns
-                             << " and " << fimg_ptr->channels << " channels");
-
-                    DICOM_data.image_data.back()->imagecoll.images.emplace_back( *fimg_ptr );
+                    append_image( std::move(*fimg_ptr), Filename );
                 }
 
                 bfit = Filenames.erase( bfit ); 
@@ -131,6 +684,16 @@ bool Load_From_FITS_Files( Drover &DICOM_data,
         });
         if(read_successfully) continue;
 
+        if( headers[n]
+        &&  !fits_prefer_direct(headers[n].value()) ){
+            decode_file(n);
+        }
+        if(d){
+            append_decoded(*d, Filename);
+            bfit = Filenames.erase( bfit ); 
+            continue;
+        }
+
         //Skip the file. It might be destined for some other loader.
         ++bfit;
     }
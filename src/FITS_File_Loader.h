@@ -8,9 +8,16 @@
 
 #include <filesystem>
 
+#include "YgorImages.h"
+
 #include "Structs.h"
 
 bool Load_From_FITS_Files( Drover &DICOM_data,
                            std::map<std::string,std::string> &InvocationMetadata,
                            const std::string &FilenameLex,
                            std::list<std::filesystem::path> &Filenames );
+
+// Writes images to a multi-extension FITS file with one image extension per image. Voxels are stored as big-endian
+// 32-bit floats, and image geometry and metadata are stored in header cards.
+bool Write_Images_To_FITS( const planar_image_collection<float,double> &imagecoll,
+                           const std::filesystem::path &filename );
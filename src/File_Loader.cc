@@ -1,11 +1,18 @@
 //File_Loader.cc - A part of DICOMautomaton 2019, 2021. Written by hal clark.
 
+#include <algorithm>
+#include <array>
+#include <cctype>
 #include <exception>
-//#include <functional>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <list>
 #include <map>
-//#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <sstream>
 #include <string>    
 #include <vector>
 //#include <cfenv>              //Needed for std::feclearexcept(FE_ALL_EXCEPT).
@@ -14,7 +21,6 @@
 
 #include <filesystem>
 //#include <cstdlib>            //Needed for exit() calls.
-//#include <utility>            //Needed for std::pair.
 
 #include "YgorFilesDirs.h"    //Needed for Does_File_Exist_And_Can_Be_Read(...), etc..
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
@@ -22,10 +28,15 @@
 #include "YgorString.h"       //Needed for GetFirstRegex(...)
 
 #include "Structs.h"
+#include "Thread_Pool.h"
 
 #include "Boost_Serialization_File_Loader.h"
 #include "DICOM_File_Loader.h"
 #include "FITS_File_Loader.h"
+#include "NRRD_File_Loader.h"
+#include "NIfTI_File_Loader.h"
+#include "MetaImage_File_Loader.h"
+#include "Raw_Volume_IO.h"
 #include "XYZ_File_Loader.h"
 #include "XIM_File_Loader.h"
 #include "SNC_File_Loader.h"
@@ -43,97 +54,215 @@
 #include "Contour_Collection_File_Loader.h"
 #include "Common_Image_File_Loader.h"
 
+// Formats that can be identified from the leading bytes of a file.
 enum class file_magic {
     unknown,
     dicom,
+    fits,
+    nrrd,
+    nifti,
+    metaimage,
+    tar,
+    gzip,
+    boost_archive,
+    ply,
     off,
-    ply
+    obj,
+    stl_ascii,
+    stl_binary,
+    xim,
+    dose_3d,
+    dcma_script,
+    dcma_transform,
+    png,
+    jpeg,
+    bmp,
+    gif
 };
 
-template <int64_t preamble_length, int64_t magic_length> 
-std::optional<std::array<char, magic_length>>
-read_header_bytes( std::ifstream &in,
-                   const std::ifstream::pos_type file_size ){
-
-    std::array<char, magic_length> actual;
-    actual.fill('\0');
-
-    if( (preamble_length + magic_length) > static_cast<int64_t>(file_size) ) return {};
+// Number of leading bytes read from each file for format identification.
+constexpr int64_t file_magic_sniff_length = 4096;
+
+// Splits the leading lines of a text header into whitespace-separated tokens, skipping empty lines and lines that begin
+// with '#'. The final line is discarded if it might have been truncated.
+static std::vector<std::vector<std::string>> header_text_lines(const std::string &buf, bool truncated, size_t max_lines){
+    std::vector<std::vector<std::string>> out;
+    std::stringstream ss(buf);
+    std::string line;
+    while( (out.size() < max_lines) && std::getline(ss, line) ){
+        if(truncated && ss.eof()) break;
+
+        std::stringstream ls(line);
+        std::vector<std::string> tokens;
+        std::string token;
+        while(ls >> token) tokens.push_back(token);
+        if(tokens.empty() || (tokens.front().front() == '#')) continue;
+        out.push_back(tokens);
+    }
+    return out;
+}
 
-    in.seekg(preamble_length, std::ios::beg); // Seek past the preamble.
-    in.read(actual.data(), magic_length);
-    if(!in) return {};
-    return actual;
+static bool is_integer_token(const std::string &s){
+    return !s.empty() && std::all_of(std::begin(s), std::end(s), [](unsigned char c){ return std::isdigit(c); });
 }
 
+// Identifies the format of a file from its leading bytes. The file is opened and read once.
 static file_magic has_known_magic(const std::filesystem::path &p){
-    file_magic out = file_magic::unknown;
-
-    // Open the file at the end.
     std::ifstream in(p.string().c_str(), std::ios::in | std::ios::binary | std::ios::ate);
-    if(!in) return out;
-
-    const std::ifstream::pos_type file_size = in.tellg();  // Grab the size of the file.
-
-    // Check for DICOM.
-    if(out == file_magic::unknown){
-        // DICOM files have a 128 byte nominally null-filled block (which *might* be occupied by something other than
-        // null) followed by 'DICM'.
-        constexpr int64_t preamble_length = 128;
-        constexpr int64_t magic_length = 4;
-        auto header_opt = read_header_bytes<preamble_length, magic_length>(in, file_size);
-
-        constexpr std::array<char, magic_length> expected { { 'D', 'I', 'C', 'M' } };
-        if( header_opt
-        &&  (expected == header_opt.value()) ){
-            out = file_magic::dicom;
+    if(!in) return file_magic::unknown;
+
+    const int64_t file_size = static_cast<int64_t>(in.tellg());
+    if(file_size <= 0) return file_magic::unknown;
+    const int64_t N = std::min<int64_t>(file_size, file_magic_sniff_length);
+
+    std::string buf(static_cast<size_t>(N), '\0');
+    in.seekg(0, std::ios::beg);
+    in.read(buf.data(), N);
+    if(!in) return file_magic::unknown;
+    in.close();
+
+    const auto has_at = [&](int64_t offset, const std::string &magic) -> bool {
+        return (static_cast<int64_t>(offset + magic.size()) <= N)
+            && (buf.compare(static_cast<size_t>(offset), magic.size(), magic) == 0);
+    };
+
+    // DICOM files have a 128 byte nominally null-filled block (which *might* be occupied by something other than
+    // null) followed by 'DICM'.
+    if(has_at(128, "DICM")) return file_magic::dicom;
+
+    // Binary formats with fixed signatures.
+    if(has_at(0, "SIMPLE  =")) return file_magic::fits;
+    if(has_at(0, "VMS.XI")) return file_magic::xim;
+    if(has_at(0, "NRRD000")) return file_magic::nrrd;
+    if(Identify_NIfTI_Header(reinterpret_cast<const unsigned char *>(buf.data()), buf.size())) return file_magic::nifti;
+    if(has_at(257, "ustar")) return file_magic::tar;
+    if(has_at(0, "\x1F\x8B")){
+        // Compressed NIfTI files are common, so peek at the decompressed header.
+        const auto h = Inflate_Prefix(reinterpret_cast<const unsigned char *>(buf.data()), buf.size(), 540);
+        if(Identify_NIfTI_Header(h.data(), h.size())) return file_magic::nifti;
+        return file_magic::gzip;
+    }
+    if(has_at(0, "\x89PNG\r\n\x1A\n")) return file_magic::png;
+    if(has_at(0, "\xFF\xD8\xFF")) return file_magic::jpeg;
+    if(has_at(0, "GIF87a") || has_at(0, "GIF89a")) return file_magic::gif;
+
+    // Boost.Serialization archives embed a signature near the start of the file, regardless of the archive type.
+    if( (buf.find("serialization::archive") != std::string::npos)
+    ||  (buf.find("<boost_serialization") != std::string::npos) ){
+        return file_magic::boost_archive;
+    }
+
+    // Binary STL files have an 80 byte header followed by the number of triangles, which determines the file size.
+    // The header can contain anything (including 'solid'), so this check has to preceed the ASCII STL check.
+    if(84 <= N){
+        uint32_t N_tris = 0;
+        for(size_t i = 0; i < 4; ++i){
+            N_tris |= static_cast<uint32_t>(static_cast<unsigned char>(buf[80 + i])) << (8 * i);
         }
+        if(file_size == (84 + 50 * static_cast<int64_t>(N_tris))) return file_magic::stl_binary;
     }
 
-    // Check for OFF.
-    if(out == file_magic::unknown){
-        // OFF files have an optional 'OFF' signature at the beginning of the file.
-        constexpr int64_t preamble_length = 0;
-        constexpr int64_t magic_length = 3;
-        auto header_opt = read_header_bytes<preamble_length, magic_length>(in, file_size);
-
-        constexpr std::array<char, magic_length> expected { { 'O', 'F', 'F' } };
-        if( header_opt
-        &&  (expected == header_opt.value()) ){
-            out = file_magic::off;
+    // BMP has a short signature, so also confirm the file size recorded in the header.
+    if(has_at(0, "BM") && (6 <= N)){
+        uint32_t bmp_size = 0;
+        for(size_t i = 0; i < 4; ++i){
+            bmp_size |= static_cast<uint32_t>(static_cast<unsigned char>(buf[2 + i])) << (8 * i);
         }
+        if(static_cast<int64_t>(bmp_size) == file_size) return file_magic::bmp;
     }
 
-    // Check for PLY.
-    if(out == file_magic::unknown){
-        // PLY files have an required 'PLY\r' signature at the beginning of the file.
-        // To provide some flexibility, the trailing carriage return is not checked here.
-        constexpr int64_t preamble_length = 0;
-        constexpr int64_t magic_length = 3;
-        auto header_opt = read_header_bytes<preamble_length, magic_length>(in, file_size);
-
-        constexpr std::array<char, magic_length> expected1 { { 'P', 'L', 'Y' } };
-        constexpr std::array<char, magic_length> expected2 { { 'p', 'l', 'y' } };
-        if( header_opt
-        &&  ( (expected1 == header_opt.value()) || (expected2 == header_opt.value()) ) ){
-            out = file_magic::off;
+    // PLY files have a required 'PLY\r' signature at the beginning of the file.
+    // To provide some flexibility, the trailing carriage return is not checked here.
+    if(has_at(0, "ply") || has_at(0, "PLY")) return file_magic::ply;
+
+    // DICOMautomaton scripts can be identified by a shebang-like statement on the first line.
+    {
+        const auto first_line = buf.substr(0, buf.find('\n'));
+        if( has_at(0, "#")
+        &&  (first_line.find("dicomautomaton") != std::string::npos) ){
+            return file_magic::dcma_script;
         }
     }
 
-    in.close();
-    return out;
+    // MetaImage headers consist of 'Key = Value' lines, and conventionally begin with the object type or dimensionality.
+    {
+        const auto first_line = buf.substr(0, buf.find('\n'));
+        if( (has_at(0, "ObjectType") || has_at(0, "NDims"))
+        &&  (first_line.find('=') != std::string::npos) ){
+            return file_magic::metaimage;
+        }
+    }
+
+    // Transform files begin with a fixed signature line.
+    if( has_at(0, "DCMA_TRANSFORM\n")
+    ||  has_at(0, "DCMA_TRANSFORM\r\n") ) return file_magic::dcma_transform;
+
+    // Text formats are identified by the structure of the first few non-comment lines.
+    const bool truncated = (N < file_size);
+    const auto lines = header_text_lines(buf, truncated, 3);
+    if(lines.empty()) return file_magic::unknown;
+    const auto &first = lines.front();
+
+    // OFF files have an optional 'OFF' signature, possibly with a prefix (e.g., 'COFF', 'NOFF').
+    if( (first.front().size() <= 6)
+    &&  (3 <= first.front().size())
+    &&  (first.front().compare(first.front().size() - 3, 3, "OFF") == 0) ){
+        return file_magic::off;
+    }
+
+    // ASCII STL files begin with a 'solid' statement and consist of facets.
+    if( (first.front() == "solid")
+    &&  ( (buf.find("facet") != std::string::npos) || (buf.find("endsolid") != std::string::npos) ) ){
+        return file_magic::stl_ascii;
+    }
+
+    // OBJ files consist of keyword-prefixed statements.
+    {
+        const auto &k = first.front();
+        if( (k == "v") || (k == "vn") || (k == "vt") || (k == "f") || (k == "o") || (k == "g")
+        ||  (k == "mtllib") || (k == "usemtl") ){
+            return file_magic::obj;
+        }
+    }
+
+    // 3ddose files begin with the number of voxels along each axis, followed by the (N+1) voxel boundaries along x.
+    if( (first.size() == 3)
+    &&  std::all_of(std::begin(first), std::end(first), [](const std::string &t){
+                        return is_integer_token(t) && (t.size() < 10);
+                    })
+    &&  (2 <= lines.size()) ){
+        const auto N_x = std::stoll(first.front());
+        if( (0 < N_x)
+        &&  (static_cast<int64_t>(lines[1].size()) == (N_x + 1)) ){
+            return file_magic::dose_3d;
+        }
+    }
+
+    return file_magic::unknown;
 }
 
 
-using loader_func_t = std::function<bool(std::list<std::filesystem::path>&)>;
+// Destination for loaded data. Each loading task gets its own so that tasks can be performed concurrently.
+struct load_target_t {
+    Drover DICOM_data;
+    std::map<std::string,std::string> InvocationMetadata;
+    std::list<OperationArgPkg> Operations;
+};
+
+using loader_func_t = std::function<bool(load_target_t &, std::list<std::filesystem::path>&)>;
 struct file_loader_t {
     std::list<std::string> exts;
+    std::list<file_magic> magics; // Formats identified by has_known_magic() that this loader handles.
     int64_t priority;
     loader_func_t f;
 };
 
 // This routine loads files. In order for it to return true, all files need to be successfully read.
 // If a file cannot be read, all others are tried before returning false.
+//
+// Files are first identified by their leading bytes and routed directly to the appropriate loader. Files that cannot be
+// identified this way are grouped by extension and passed through a priority list of loaders. Independent groups of files
+// are loaded concurrently and the results are merged in the order the files were provided.
 bool
 Load_Files( Drover &DICOM_data,
             std::map<std::string,std::string> &InvocationMetadata,
@@ -150,9 +279,9 @@ Load_Files( Drover &DICOM_data,
         int64_t priority = 0;
 
         //Standalone file loading: TAR files.
-        loaders.emplace_back(file_loader_t{{".tar", ".gz", ".tar.gz", ".tgz"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".tar", ".gz", ".tar.gz", ".tgz"}, {file_magic::tar, file_magic::gzip}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_TAR_Files( DICOM_data, InvocationMetadata, FilenameLex, Operations, p )){
+            && !Load_From_TAR_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, t.Operations, p )){
                 YLOGWARN("Failed to load TAR file");
                 return false;
             }
@@ -160,9 +289,9 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: Boost.Serialization archives.
-        loaders.emplace_back(file_loader_t{{".gz", ".tar", ".tar.gz", ".tgz", ".xml", ".xml.gz", ".txt", ".txt.gz"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".gz", ".tar", ".tar.gz", ".tgz", ".xml", ".xml.gz", ".txt", ".txt.gz"}, {file_magic::boost_archive, file_magic::gzip}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_Boost_Serialization_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_Boost_Serialization_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load Boost.Serialization archive");
                 return false;
             }
@@ -170,9 +299,9 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: DICOM files.
-        loaders.emplace_back(file_loader_t{{".dcm"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".dcm"}, {file_magic::dicom}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_DICOM_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_DICOM_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load DICOM file");
                 return false;
             }
@@ -180,9 +309,9 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: XIM files.
-        loaders.emplace_back(file_loader_t{{".xim"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".xim"}, {file_magic::xim}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_XIM_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_XIM_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load XIM file");
                 return false;
             }
@@ -190,9 +319,9 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: SNC files.
-        loaders.emplace_back(file_loader_t{{".snc"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".snc"}, {}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_SNC_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_SNC_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load ASCII SNC file");
                 return false;
             }
@@ -200,9 +329,9 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: (ASCII or binary) PLY (mesh or point cloud) files.
-        loaders.emplace_back(file_loader_t{{".ply"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".ply"}, {file_magic::ply}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_PLY_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_PLY_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load ASCII/binary PLY mesh or point cloud file");
                 return false;
             }
@@ -212,9 +341,9 @@ Load_Files( Drover &DICOM_data,
         //Standalone file loading: ASCII STL mesh files.
         //
         // Note: should preceed 'tabular DVH' line sample files.
-        loaders.emplace_back(file_loader_t{{".stl"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".stl"}, {file_magic::stl_ascii}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_Mesh_From_ASCII_STL_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_Mesh_From_ASCII_STL_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load ASCII STL mesh file");
                 return false;
             }
@@ -222,9 +351,9 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: binary STL mesh files.
-        loaders.emplace_back(file_loader_t{{".stl"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".stl"}, {file_magic::stl_binary}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_Mesh_From_Binary_STL_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_Mesh_From_Binary_STL_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load binary STL mesh file");
                 return false;
             }
@@ -232,9 +361,9 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: plaintext contour collection files.
-        loaders.emplace_back(file_loader_t{{".dat", ".txt"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".dat", ".txt"}, {}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_Contour_Collection_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_Contour_Collection_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load contour collection file");
                 return false;
             }
@@ -242,9 +371,9 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: 'tabular DVH' line sample files.
-        loaders.emplace_back(file_loader_t{{".dvh", ".txt", ".dat"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".dvh", ".txt", ".dat"}, {}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_DVH_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_DVH_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load DVH file");
                 return false;
             }
@@ -252,9 +381,9 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: script files.
-        loaders.emplace_back(file_loader_t{{".dcma", ".dsc", ".dscr", ".scr", ".txt"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".dcma", ".dsc", ".dscr", ".scr", ".txt"}, {file_magic::dcma_script}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_Script_Files( Operations, p )){
+            && !Load_From_Script_Files( t.Operations, p )){
                 YLOGWARN("Failed to load script file");
                 return false;
             }
@@ -262,19 +391,51 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: FITS files.
-        loaders.emplace_back(file_loader_t{{".fit", ".fits"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".fit", ".fits"}, {file_magic::fits}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_FITS_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_FITS_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load FITS file");
                 return false;
             }
             return true;
         }});
 
+        //Standalone file loading: NRRD files.
+        loaders.emplace_back(file_loader_t{{".nrrd", ".nhdr"}, {file_magic::nrrd}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
+            if(!p.empty()
+            && !Load_From_NRRD_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
+                YLOGWARN("Failed to load NRRD file");
+                return false;
+            }
+            return true;
+        }});
+
+        //Standalone file loading: NIfTI files.
+        //
+        // Note: compressed NIfTI files have a '.gz' extension, so they are only routed here by content.
+        loaders.emplace_back(file_loader_t{{".nii", ".hdr"}, {file_magic::nifti}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
+            if(!p.empty()
+            && !Load_From_NIfTI_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
+                YLOGWARN("Failed to load NIfTI file");
+                return false;
+            }
+            return true;
+        }});
+
+        //Standalone file loading: MetaImage files.
+        loaders.emplace_back(file_loader_t{{".mha", ".mhd"}, {file_magic::metaimage}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
+            if(!p.empty()
+            && !Load_From_MetaImage_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
+                YLOGWARN("Failed to load MetaImage file");
+                return false;
+            }
+            return true;
+        }});
+
         //Standalone file loading: DOSXYZnrc 3ddose files.
-        loaders.emplace_back(file_loader_t{{".3ddose"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".3ddose"}, {file_magic::dose_3d}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_3ddose_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_3ddose_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load 3ddose file");
                 return false;
             }
@@ -284,9 +445,9 @@ Load_Files( Drover &DICOM_data,
         //Standalone file loading: OFF point cloud files.
         //
         // Note: should preceed the OFF mesh loader.
-        loaders.emplace_back(file_loader_t{{".off"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".off"}, {file_magic::off}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_Points_From_OFF_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_Points_From_OFF_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load OFF point cloud file");
                 return false;
             }
@@ -294,9 +455,9 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: OFF mesh files.
-        loaders.emplace_back(file_loader_t{{".off"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".off"}, {file_magic::off}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_Mesh_From_OFF_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_Mesh_From_OFF_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load OFF mesh file");
                 return false;
             }
@@ -306,9 +467,9 @@ Load_Files( Drover &DICOM_data,
         //Standalone file loading: OBJ point cloud files.
         //
         // Note: should preceed the OBJ mesh loader.
-        loaders.emplace_back(file_loader_t{{".obj"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".obj"}, {file_magic::obj}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_Points_From_OBJ_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_Points_From_OBJ_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load OBJ point cloud file");
                 return false;
             }
@@ -316,9 +477,9 @@ Load_Files( Drover &DICOM_data,
         }});
 
         //Standalone file loading: OBJ mesh files.
-        loaders.emplace_back(file_loader_t{{".obj"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".obj"}, {file_magic::obj}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_Mesh_From_OBJ_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_Mesh_From_OBJ_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load OBJ mesh file");
                 return false;
             }
@@ -331,9 +492,9 @@ Load_Files( Drover &DICOM_data,
                                             ".bmp",
                                             ".tga",
                                             ".gif",
-                                            ".pnm", ".ppm", ".pgm"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+                                            ".pnm", ".ppm", ".pgm"}, {file_magic::png, file_magic::jpeg, file_magic::bmp, file_magic::gif}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_Common_Image_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_Common_Image_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load STB file");
                 return false;
             }
@@ -343,9 +504,9 @@ Load_Files( Drover &DICOM_data,
         //Standalone file loading: XYZ point cloud files.
         //
         // Note: XYZ can be confused with many other formats, so it should be near the end.
-        loaders.emplace_back(file_loader_t{{".xyz", ".txt"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".xyz", ".txt"}, {}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_XYZ_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_XYZ_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load XYZ file");
                 return false;
             }
@@ -355,9 +516,9 @@ Load_Files( Drover &DICOM_data,
         //Standalone file loading: transformation files.
         //
         // Note: this file can be confused with many other formats, so it should be near the end.
-        loaders.emplace_back(file_loader_t{{".trans", ".txt"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".trans", ".txt"}, {file_magic::dcma_transform}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_Transforms_From_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_Transforms_From_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load transformation file");
                 return false;
             }
@@ -367,9 +528,9 @@ Load_Files( Drover &DICOM_data,
         //Standalone file loading: line sample files.
         //
         // Note: this file can be confused with many other formats, so it should be near the end.
-        loaders.emplace_back(file_loader_t{{".lsamp", ".lsamps", ".txt"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".lsamp", ".lsamps", ".txt"}, {}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_Line_Sample_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_Line_Sample_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load line sample file");
                 return false;
             }
@@ -379,9 +540,9 @@ Load_Files( Drover &DICOM_data,
         //Standalone file loading: CSV files.
         //
         // Note: this file can be confused with many other formats, so it should be near the end.
-        loaders.emplace_back(file_loader_t{{".csv", ".tsv"}, ++priority, [&](std::list<std::filesystem::path> &p) -> bool {
+        loaders.emplace_back(file_loader_t{{".csv", ".tsv"}, {}, ++priority, [&](load_target_t &t, std::list<std::filesystem::path> &p) -> bool {
             if(!p.empty()
-            && !Load_From_CSV_Files( DICOM_data, InvocationMetadata, FilenameLex, p )){
+            && !Load_From_CSV_Files( t.DICOM_data, t.InvocationMetadata, FilenameLex, p )){
                 YLOGWARN("Failed to load CSV/TSV file");
                 return false;
             }
@@ -405,10 +566,9 @@ Load_Files( Drover &DICOM_data,
 
     // Convert directories to filenames and remove non-existent filenames and directories.
     bool contained_unresolvable = false;
+    std::vector<std::pair<std::filesystem::path, bool>> candidates; // (path, whether it was explicitly specified).
     {
-        auto loaders = get_default_loaders();
         std::list<std::filesystem::path> recursed_Paths;
-        std::list<std::filesystem::path> l_Paths;
         while(!recursed_Paths.empty() || !Paths.empty()){
             const auto is_orig = !Paths.empty();
             auto p = (is_orig) ? Paths.front() : recursed_Paths.front();
@@ -434,64 +594,124 @@ Load_Files( Drover &DICOM_data,
                     }
 
                 }else{
-                    const auto ext = p.extension().string();
-                    if( is_orig 
-                    ||  has_recognized_extension(ext) ){
-                        l_Paths.push_back(p);
-
-                    }else if( has_known_magic(p) != file_magic::unknown ){
-                        YLOGINFO("Detected header magic bytes for file '" << p.string() << "'. Specifying file explicitly will speed loading");
-                        l_Paths.push_back(p);
-
-                    }else{
-                        YLOGWARN("Ignoring file '" << p.string() << "' because file extension is not recognized. Specify file explicitly to attempt loading");
-                    }
+                    candidates.emplace_back(p, is_orig);
                 }
             }catch(const std::filesystem::filesystem_error &e){
                 YLOGWARN(e.what());
                 contained_unresolvable = true;
             }
         }
-        Paths = l_Paths;
     }
 
-    // Partition the paths by file extension.
+    // Identify the format of every file. Each file is opened once and only the leading bytes are read.
+    std::vector<file_magic> magics(candidates.size(), file_magic::unknown);
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(size_t i = 0; i < candidates.size(); ++i){
+            wq.submit_task([i,&candidates,&magics]() -> void {
+                magics[i] = has_known_magic(candidates[i].first);
+            });
+        }
+    } // Wait for all tasks to complete.
+
+    // Partition the files into loading tasks.
     //
-    // If we can detect files in other ways (e.g., magic bytes), then we can override simplistic extension-based
-    // detection here.
-    icase_map_t<std::list<std::filesystem::path>> extensions(icase_str_lt);
-    for(auto &p : Paths){
-        auto ext = p.extension().string();
+    // Identified files are routed to the loaders for their format. Files are grouped by format, except for formats where
+    // each file is independent, which are loaded individually. Unidentified files are grouped by extension.
+    //
+    // Tasks are ordered by the first file they contain so that results can be merged deterministically.
+    struct load_task_t {
+        std::string key;
+        file_magic magic = file_magic::unknown;
+        std::string ext;
+        std::list<std::filesystem::path> paths;
+
+        load_target_t target;
+        bool success = true;
+    };
+    std::list<load_task_t> tasks;
+    {
+        const auto is_independent = [](file_magic m) -> bool {
+            return (m == file_magic::tar)
+                || (m == file_magic::nrrd)
+                || (m == file_magic::nifti)
+                || (m == file_magic::metaimage)
+                || (m == file_magic::gzip)
+                || (m == file_magic::boost_archive)
+                || (m == file_magic::ply)
+                || (m == file_magic::off)
+                || (m == file_magic::obj)
+                || (m == file_magic::stl_ascii)
+                || (m == file_magic::stl_binary)
+                || (m == file_magic::dose_3d)
+                || (m == file_magic::dcma_script)
+                || (m == file_magic::dcma_transform);
+        };
+
+        std::map<std::string, load_task_t*> task_by_key;
+        for(size_t i = 0; i < candidates.size(); ++i){
+            const auto &p = candidates[i].first;
+            const auto is_orig = candidates[i].second;
+            const auto m = magics[i];
+            const auto ext = p.extension().string();
+
+            if( !is_orig
+            &&  (m == file_magic::unknown)
+            &&  !has_recognized_extension(ext) ){
+                YLOGWARN("Ignoring file '" << p.string() << "' because file extension is not recognized. Specify file explicitly to attempt loading");
+                continue;
+            }
+            if( !is_orig
+            &&  (m != file_magic::unknown)
+            &&  !has_recognized_extension(ext) ){
+                YLOGINFO("Detected header magic bytes for file '" << p.string() << "'");
+            }
 
-        // If there is no extension, check whether magic bytes are present.
-        //
-        // DICOM files often come in DICOMDIR format, generally without file extensions.
-        if( ext.empty() && (has_known_magic(p) == file_magic::dicom) ){
-            ext = ".dcm";
-        }
+            std::string key;
+            if(m == file_magic::unknown){
+                key = "ext:" + ext;
+                std::transform(std::begin(key), std::end(key), std::begin(key), [](unsigned char c){ return std::tolower(c); });
+            }else{
+                key = "magic:" + std::to_string(static_cast<int64_t>(m));
+                if(is_independent(m)) key += ":" + std::to_string(i);
+            }
 
-        // OFF files have an optional signature.
-        if( ext.empty() && (has_known_magic(p) == file_magic::off) ){
-            ext = ".off";
+            auto &t = task_by_key[key];
+            if(t == nullptr){
+                tasks.emplace_back();
+                t = &(tasks.back());
+                t->key = key;
+                t->magic = m;
+                t->ext = ext;
+                t->target.InvocationMetadata = InvocationMetadata;
+            }
+            t->paths.push_back(p);
         }
+    }
 
-        // PLY files have a required signature.
-        if( ext.empty() && (has_known_magic(p) == file_magic::ply) ){
-            ext = ".ply";
+    // Attempts to load files using the provided loaders, in priority order. Files that are loaded are removed.
+    const auto try_loaders = [](load_task_t &task, std::list<file_loader_t> &loaders, const std::string &desc) -> bool {
+        loaders.sort( [](const file_loader_t &l, const file_loader_t &r){
+            return (l.priority < r.priority);
+        });
+        for(const auto &l : loaders){
+            if(task.paths.empty()) break;
+            std::stringstream ss;
+            for(const auto &e : l.exts) ss << (ss.str().empty() ? "" : ", ") << "'" << e << "'";
+            YLOGINFO("Trying loader for extensions: " << ss.str() << " for " << desc);
+            if(!l.f(task.target, task.paths)){
+                return false;
+            }
         }
+        return true;
+    };
 
-        extensions[ext].push_back(p);
-    }
-    Paths.clear();
-
-    for(auto &ep : extensions){
-        const auto ext = ep.first;
-        auto &&l_Paths = ep.second;
-        
+    // Falls back on file extensions to select loaders.
+    const auto try_extension_loaders = [&](load_task_t &task, const std::string &ext) -> bool {
         // Warn if the file extension is not recognized.
         if(!has_recognized_extension(ext)){
-            for(const auto &p : l_Paths){
-                YLOGINFO("Unrecognized file extension '" << ext << "'. Attempting to load because it was explicitly specified");
+            for(const auto &p : task.paths){
+                YLOGINFO("Unrecognized file extension '" << ext << "' for file '" << p.string() << "'. Attempting to load because it was explicitly specified");
             }
         }
                                                   
@@ -516,6 +736,9 @@ Load_Files( Drover &DICOM_data,
              || icase_str_eq(ext, ".gz")
              || icase_str_eq(ext, ".tar.gz")
              || icase_str_eq(ext, ".3ddose")
+             || icase_str_eq(ext, ".nrrd")
+             || icase_str_eq(ext, ".nii")
+             || icase_str_eq(ext, ".mha")
              || icase_str_eq(ext, ".stl")
              || icase_str_eq(ext, ".obj")
              || icase_str_eq(ext, ".off")
@@ -537,24 +760,83 @@ Load_Files( Drover &DICOM_data,
                                 } );
         }
 
-        // Re-sort using the modified priorities.
-        loaders.sort( [](const file_loader_t &l, const file_loader_t &r){
-            return (l.priority < r.priority);
-        });
+        return try_loaders(task, loaders, "file(s) with extension '"_s + ext + "'");
+    };
 
-        // Attempt to load the files using the remaining loaders in priority order.
-        for(const auto &l : loaders){
-            if(l_Paths.empty()) break;
-            std::stringstream ss;
-            for(const auto &e : l.exts) ss << (ss.str().empty() ? "" : ", ") << "'" << e << "'";
-            YLOGINFO("Trying loader for extensions: " << ss.str() << " for file(s) with extension '" << ext << "'");
-            if(!l_Paths.empty() && !l.f(l_Paths)){
-                return false;
+    const auto load = [&](load_task_t &task) -> bool {
+        if(task.magic == file_magic::unknown){
+            return try_extension_loaders(task, task.ext);
+        }
+
+        // Route identified files directly to the loaders for their format.
+        auto loaders = get_default_loaders();
+        loaders.remove_if( [&](const file_loader_t &l){
+                               return std::none_of( std::begin(l.magics),
+                                                    std::end(l.magics),
+                                                    [&](file_magic m){ return (m == task.magic); });
+                           } );
+        if(!try_loaders(task, loaders, "identified file(s) with extension '"_s + task.ext + "'")){
+            return false;
+        }
+
+        // If the format was misidentified, fall back on the file extension. This should be rare.
+        if(!task.paths.empty()){
+            YLOGWARN("Unable to load file(s) using the loader for the identified format. Falling back on file extension");
+            std::list<std::filesystem::path> remaining;
+            std::list<std::filesystem::path> unloaded;
+            remaining.swap(task.paths);
+            while(!remaining.empty()){
+                const auto ext = remaining.front().extension().string();
+                const auto it = std::stable_partition( std::begin(remaining), std::end(remaining),
+                                                       [&](const std::filesystem::path &p){
+                                                           return icase_str_eq(p.extension().string(), ext);
+                                                       });
+                task.paths.splice( std::end(task.paths), remaining, std::begin(remaining), it );
+                if(!try_extension_loaders(task, ext)){
+                    return false;
+                }
+                unloaded.splice( std::end(unloaded), task.paths );
             }
+            task.paths.swap(unloaded);
         }
+        return true;
+    };
 
-        // Return any remaining files to the user's container.
-        Paths.splice( std::end(Paths), l_Paths );
+    // Load the files. Tasks are independent, so they are performed concurrently.
+    {
+        std::mutex saver_printer;
+        work_queue<std::function<void(void)>> wq;
+        for(auto &task : tasks){
+            wq.submit_task([&task,&load,&saver_printer]() -> void {
+                try{
+                    task.success = load(task);
+                }catch(const std::exception &e){
+                    std::lock_guard<std::mutex> lock(saver_printer);
+                    YLOGWARN("Failed to load file(s): " << e.what());
+                    task.success = false;
+                }
+            });
+        }
+    } // Wait for all tasks to complete.
+
+    // Merge the results in a deterministic order.
+    bool success = true;
+    const auto InvocationMetadata_orig = InvocationMetadata;
+    for(auto &task : tasks){
+        DICOM_data.Consume(std::move(task.target.DICOM_data));
+        for(const auto &kv : task.target.InvocationMetadata){
+            const auto it = InvocationMetadata_orig.find(kv.first);
+            if( (it == std::end(InvocationMetadata_orig))
+            ||  (it->second != kv.second) ){
+                InvocationMetadata[kv.first] = kv.second;
+            }
+        }
+        Operations.splice( std::end(Operations), task.target.Operations );
+        Paths.splice( std::end(Paths), task.paths );
+        success = success && task.success;
+    }
+    if(!success){
+        return false;
     }
 
     if(!Paths.empty()){
@@ -563,4 +845,3 @@ Load_Files( Drover &DICOM_data,
 
     return (Paths.empty() && !contained_unresolvable);
 }
-
@@ -4,6 +4,13 @@
 #include <string>
 #include <list> 
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
 
 #include "Explicator.h"       //Needed for Explicator class.
 
@@ -12,6 +19,8 @@
 #include "YgorString.h"       //Needed for SplitStringToVector, Canonicalize_String2, SplitVector functions.
 #include "YgorFilesDirs.h"
 
+#include "Lexicon_Loader.h"
+
 // This function attempts to locate a lexicon file. If none are available, an empty string is returned.
 std::string Locate_Lexicon_File(){
 
@@ -175,3 +184,65 @@ std::string Create_Default_Lexicon_File(){
     return p;
 }
 
+
+
+// Registry entries are shared by all borrowers, and are only replaced when the lexicon file changes.
+struct lexicon_registry_entry {
+    // Explicator is not thread-safe, so translations are serialized. Memoized translations avoid the lock.
+    std::mutex explicator_mutex;
+    Explicator X;
+
+    std::shared_mutex memo_mutex;
+    std::unordered_map<std::string, std::string> memo;
+
+    explicit lexicon_registry_entry(const std::string &filename) : X(filename) {}
+};
+
+// Limits the number of memoized translations per lexicon, which bounds memory in long-running processes.
+constexpr size_t lexicon_memo_limit = 100'000;
+
+Shared_Lexicon::Shared_Lexicon(const std::string &filename){
+    using registry_t = std::map<std::string, std::pair<std::filesystem::file_time_type,
+                                                       std::shared_ptr<lexicon_registry_entry>>>;
+    static std::mutex registry_mutex;
+    static registry_t registry;
+
+    // If the modification time cannot be determined the lexicon is parsed without caching, which also preserves any
+    // error reporting for missing files.
+    std::error_code ec;
+    const auto mtime = std::filesystem::last_write_time(filename, ec);
+    if(ec){
+        this->entry = std::make_shared<lexicon_registry_entry>(filename);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto it = registry.find(filename);
+    if( (it == std::end(registry))
+    ||  (it->second.first != mtime) ){
+        YLOGINFO("Parsing lexicon '" << filename << "'");
+        registry[filename] = std::make_pair(mtime, std::make_shared<lexicon_registry_entry>(filename));
+        it = registry.find(filename);
+    }
+    this->entry = it->second.second;
+}
+
+std::string Shared_Lexicon::operator()(const std::string &in) const {
+    auto &e = *(this->entry);
+    {
+        std::shared_lock<std::shared_mutex> lock(e.memo_mutex);
+        const auto it = e.memo.find(in);
+        if(it != std::end(e.memo)) return it->second;
+    }
+
+    std::string out;
+    {
+        std::lock_guard<std::mutex> lock(e.explicator_mutex);
+        out = e.X(in);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(e.memo_mutex);
+    if(lexicon_memo_limit <= e.memo.size()) e.memo.clear();
+    e.memo.emplace(in, out);
+    return out;
+}
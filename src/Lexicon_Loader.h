@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>    
 
 // This function attempts to locate a lexicon file. If none are available, an empty string is returned.
@@ -10,3 +11,20 @@ std::string Locate_Lexicon_File();
 // This function creates a default lexicon file in a temporary location. The full path is returned.
 std::string Create_Default_Lexicon_File();
 
+struct lexicon_registry_entry;
+
+// A lexicon borrowed from a process-wide registry.
+//
+// Lexicon files are parsed once and shared until the file is modified, so constructing this class is cheap after the
+// first use of a given file. Translations are memoized since the same names tend to be translated many times.
+// Translation is thread-safe.
+class Shared_Lexicon {
+    private:
+        std::shared_ptr<lexicon_registry_entry> entry;
+
+    public:
+        explicit Shared_Lexicon(const std::string &filename);
+
+        // Translates a string using the lexicon, like Explicator::operator().
+        std::string operator()(const std::string &in) const;
+};
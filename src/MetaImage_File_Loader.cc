@@ -0,0 +1,385 @@
+//MetaImage_File_Loader.cc - A part of DICOMautomaton 2026.
+//
+// This program loads and writes MetaImage files. Both combined ('.mha') and detached ('.mhd') headers are supported,
+// as are zlib-compressed voxel data.
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <filesystem>
+
+#include "YgorImages.h"
+#include "YgorMath.h"         //Needed for vec3 class.
+#include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
+#include "YgorLog.h"
+#include "YgorString.h"       //Needed for Canonicalize_String2().
+
+#include "Metadata.h"
+#include "Structs.h"
+#include "Raw_Volume_IO.h"
+#include "MetaImage_File_Loader.h"
+
+
+static std::string mi_lowercase(std::string s){
+    std::transform(std::begin(s), std::end(s), std::begin(s), [](unsigned char c){ return std::tolower(c); });
+    return s;
+}
+
+static std::vector<std::string> mi_tokens(const std::string &s){
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string token;
+    while(ss >> token) out.push_back(token);
+    return out;
+}
+
+static std::vector<double> mi_numbers(const std::string &s){
+    std::vector<double> out;
+    for(const auto &t : mi_tokens(s)) out.push_back(std::stod(t));
+    return out;
+}
+
+static bool mi_is_true(const std::string &s){
+    const auto l = mi_lowercase(s);
+    return (l == "true") || (l == "1");
+}
+
+static std::optional<raw_voxel_type> mi_parse_type(const std::string &s){
+    // Note: MetaImage 'long' types are 32 bits wide regardless of the platform.
+    static const std::map<std::string, raw_voxel_type> types = {
+        { "MET_CHAR",       raw_voxel_type::int8    },
+        { "MET_UCHAR",      raw_voxel_type::uint8   },
+        { "MET_SHORT",      raw_voxel_type::int16   },
+        { "MET_USHORT",     raw_voxel_type::uint16  },
+        { "MET_INT",        raw_voxel_type::int32   },
+        { "MET_UINT",       raw_voxel_type::uint32  },
+        { "MET_LONG",       raw_voxel_type::int32   },
+        { "MET_ULONG",      raw_voxel_type::uint32  },
+        { "MET_LONG_LONG",  raw_voxel_type::int64   },
+        { "MET_ULONG_LONG", raw_voxel_type::uint64  },
+        { "MET_FLOAT",      raw_voxel_type::float32 },
+        { "MET_DOUBLE",     raw_voxel_type::float64 },
+    };
+    const auto it = types.find(s);
+    if(it == std::end(types)) return {};
+    return it->second;
+}
+
+// Checks whether the buffer begins with a MetaImage header. Only the first line is inspected.
+static bool mi_has_header(const unsigned char *d, size_t size){
+    const auto *nl = static_cast<const unsigned char *>(std::memchr(d, '\n', std::min<size_t>(size, 1024)));
+    if(nl == nullptr) return false;
+    const std::string line(reinterpret_cast<const char *>(d), static_cast<size_t>(nl - d));
+    return ( (line.rfind("ObjectType", 0) == 0) || (line.rfind("NDims", 0) == 0) )
+        && (line.find('=') != std::string::npos);
+}
+
+static planar_image_collection<float,double>
+Read_MetaImage( const std::filesystem::path &Filename,
+                const unsigned char *d,
+                size_t size ){
+
+    // Parse the header. The 'ElementDataFile' field is always the last field in the header.
+    std::map<std::string, std::string> fields;
+    size_t pos = 0;
+    bool header_ended = false;
+    while(pos < size){
+        const auto *nl = static_cast<const unsigned char *>(std::memchr(d + pos, '\n', size - pos));
+        const size_t end = (nl == nullptr) ? size : static_cast<size_t>(nl - d);
+        std::string line(reinterpret_cast<const char *>(d + pos), end - pos);
+        pos = (nl == nullptr) ? size : (end + 1);
+        if(!line.empty() && (line.back() == '\r')) line.pop_back();
+
+        const auto eq = line.find('=');
+        if(eq == std::string::npos){
+            if(Canonicalize_String2(line, CANONICALIZE::TRIM).empty()) continue;
+            throw std::runtime_error("Unable to parse header line '"_s + line + "'");
+        }
+        const auto key = mi_lowercase(Canonicalize_String2(line.substr(0, eq), CANONICALIZE::TRIM));
+        fields[key] = Canonicalize_String2(line.substr(eq + 1), CANONICALIZE::TRIM);
+        if(key == "elementdatafile"){
+            header_ended = true;
+            break;
+        }
+    }
+    if(!header_ended){
+        throw std::runtime_error("Header is not terminated");
+    }
+
+    const auto get = [&](const std::string &k) -> std::optional<std::string> {
+        const auto it = fields.find(k);
+        if(it == std::end(fields)) return {};
+        return it->second;
+    };
+    const auto require = [&](const std::string &k) -> std::string {
+        const auto v = get(k);
+        if(!v) throw std::runtime_error("Required field '"_s + k + "' is missing");
+        return v.value();
+    };
+    // Several fields have aliases.
+    const auto get_any = [&](const std::vector<std::string> &ks) -> std::optional<std::string> {
+        for(const auto &k : ks){
+            if(const auto v = get(k)) return v;
+        }
+        return {};
+    };
+
+    if(const auto ot = get("objecttype")){
+        if(mi_lowercase(ot.value()) != "image") throw std::runtime_error("Object type is not supported");
+    }
+    if(const auto bd = get("binarydata")){
+        if(!mi_is_true(bd.value())) throw std::runtime_error("ASCII voxel data are not supported");
+    }
+
+    const auto dim = static_cast<size_t>(std::stoll(require("ndims")));
+    std::vector<int64_t> sizes;
+    for(const auto &t : mi_tokens(require("dimsize"))) sizes.push_back(std::stoll(t));
+    if( (dim < 2)
+    ||  (4 < dim)
+    ||  (sizes.size() != dim)
+    ||  std::any_of(std::begin(sizes), std::end(sizes), [](int64_t s){ return (s < 1); }) ){
+        throw std::runtime_error("Dimensions are invalid or not supported");
+    }
+
+    raw_volume_layout layout;
+    const auto type = mi_parse_type(Canonicalize_String2(require("elementtype"), CANONICALIZE::TRIM));
+    if(!type){
+        throw std::runtime_error("Element type is not supported");
+    }
+    layout.type = type.value();
+    if(const auto msb = get_any({ "binarydatabyteordermsb", "elementbyteordermsb" })){
+        layout.big_endian = mi_is_true(msb.value());
+    }
+
+    layout.N_cols   = sizes[0];
+    layout.N_rows   = sizes[1];
+    layout.N_slices = (2 < dim) ? sizes[2] : 1;
+    layout.N_times  = (3 < dim) ? sizes[3] : 1;
+    layout.N_chnls  = std::stoll(get("elementnumberofchannels").value_or("1"));
+    if(layout.N_chnls < 1){
+        throw std::runtime_error("Number of channels is invalid");
+    }
+    layout.set_interleaved_strides();
+
+    // Geometry. The physical coordinate system is LPS, matching DICOM.
+    std::vector<double> spacing(dim, 1.0);
+    if(const auto s = get_any({ "elementspacing", "elementsize" })){
+        const auto v = mi_numbers(s.value());
+        for(size_t i = 0; (i < dim) && (i < v.size()); ++i){
+            if(std::isfinite(v[i]) && (0.0 < v[i])) spacing[i] = v[i];
+        }
+    }
+    std::vector<vec3<double>> axes = { vec3<double>(1.0, 0.0, 0.0),
+                                       vec3<double>(0.0, 1.0, 0.0),
+                                       vec3<double>(0.0, 0.0, 1.0) };
+    if(const auto m = get_any({ "transformmatrix", "rotation", "orientation" })){
+        // Each consecutive group of 'NDims' values holds the direction of one axis.
+        const auto v = mi_numbers(m.value());
+        if(v.size() != (dim * dim)){
+            throw std::runtime_error("Transform matrix is invalid");
+        }
+        for(size_t i = 0; (i < dim) && (i < 3); ++i){
+            axes[i] = vec3<double>( v[i * dim + 0],
+                                    v[i * dim + 1],
+                                    (2 < dim) ? v[i * dim + 2] : 0.0 );
+        }
+        if(dim == 2) axes[2] = axes[0].Cross(axes[1]).unit();
+    }
+    layout.col_dir   = axes[0] * spacing[0];
+    layout.row_dir   = axes[1] * spacing[1];
+    layout.slice_dir = axes[2] * ((2 < dim) ? spacing[2] : 1.0);
+    if(const auto o = get_any({ "offset", "position", "origin" })){
+        const auto v = mi_numbers(o.value());
+        if(v.size() < std::min<size_t>(dim, 3)){
+            throw std::runtime_error("Offset is invalid");
+        }
+        layout.origin = vec3<double>(v[0], v[1], (2 < v.size()) ? v[2] : 0.0);
+    }
+
+    // Locate the voxel data, which follow the header or are stored in a separate file.
+    std::unique_ptr<mapped_file> detached;
+    const unsigned char *src = d + pos;
+    size_t src_size = size - pos;
+    const auto df = require("elementdatafile");
+    if(mi_lowercase(df) != "local"){
+        if( (mi_tokens(df).size() != 1)
+        ||  (df.find('%') != std::string::npos) ){
+            throw std::runtime_error("Multiple detached data files are not supported");
+        }
+        auto dp = std::filesystem::path(df);
+        if(dp.is_relative()) dp = Filename.parent_path() / dp;
+        detached = std::make_unique<mapped_file>(dp);
+        src = detached->data();
+        src_size = detached->size();
+    }
+
+    const auto N_bytes = static_cast<size_t>(layout.N_bytes());
+    const bool compressed = mi_is_true(get("compresseddata").value_or("false"));
+    const auto header_size = std::stoll(get("headersize").value_or("0"));
+    if(header_size == -1){
+        // The data are located at the end of the file.
+        if( compressed
+        ||  (src_size < N_bytes) ){
+            throw std::runtime_error("Unable to locate voxel data");
+        }
+        src += src_size - N_bytes;
+        src_size = N_bytes;
+    }else if( (header_size < 0)
+          ||  (src_size < static_cast<size_t>(header_size)) ){
+        throw std::runtime_error("Header size is invalid");
+    }else{
+        src += header_size;
+        src_size -= static_cast<size_t>(header_size);
+    }
+
+    std::vector<unsigned char> inflated;
+    if(compressed){
+        if(const auto cs = get("compresseddatasize")){
+            const auto n = std::stoll(cs.value());
+            if( (n < 0)
+            ||  (src_size < static_cast<size_t>(n)) ){
+                throw std::runtime_error("Compressed data size is invalid");
+            }
+            src_size = static_cast<size_t>(n);
+        }
+        inflated = Inflate_Buffer(src, src_size, N_bytes);
+        src = inflated.data();
+        src_size = inflated.size();
+    }
+
+    auto imagecoll = Raw_Volume_To_Images(layout, src, src_size);
+    Attach_Volume_Metadata(imagecoll, {}, Filename, layout.N_slices);
+
+    YLOGINFO("Loaded MetaImage file with dimensions "
+             << layout.N_cols << " x " << layout.N_rows << " x " << layout.N_slices
+             << ", " << layout.N_times << " time points, and " << layout.N_chnls << " channels");
+    return imagecoll;
+}
+
+
+bool Load_From_MetaImage_Files( Drover &DICOM_data,
+                                std::map<std::string,std::string> & /* InvocationMetadata */,
+                                const std::string &,
+                                std::list<std::filesystem::path> &Filenames ){
+
+    //This routine will attempt to load MetaImage files. Each file is loaded as a separate image array. Files that are
+    // not MetaImage files are not consumed so that they can be passed on to the next loading stage as needed.
+    //
+    // Note: This routine returns false only iff a file is suspected of being suited for this loader, but could not be
+    //       loaded (e.g., the file seems appropriate, but a parsing failure was encountered).
+    //
+    if(Filenames.empty()) return true;
+
+    size_t i = 0;
+    const size_t N = Filenames.size();
+
+    auto bfit = Filenames.begin();
+    while(bfit != Filenames.end()){
+        YLOGINFO("Parsing file #" << i+1 << "/" << N << " = " << 100*(i+1)/N << "%");
+        ++i;
+        const auto Filename = *bfit;
+
+        std::unique_ptr<mapped_file> mf;
+        try{
+            mf = std::make_unique<mapped_file>(Filename);
+        }catch(const std::exception &e){
+            YLOGINFO("Unable to load as MetaImage file: '" << e.what() << "'");
+            ++bfit;
+            continue;
+        }
+        if(!mi_has_header(mf->data(), mf->size())){
+            //Skip the file. It might be destined for some other loader.
+            ++bfit;
+            continue;
+        }
+
+        try{
+            auto imagecoll = Read_MetaImage(Filename, mf->data(), mf->size());
+            DICOM_data.image_data.emplace_back( std::make_shared<Image_Array>() );
+            DICOM_data.image_data.back()->imagecoll = std::move(imagecoll);
+        }catch(const std::exception &e){
+            YLOGWARN("Unable to load MetaImage file '" << Filename.string() << "': " << e.what());
+            return false;
+        }
+        bfit = Filenames.erase( bfit );
+    }
+
+    return true;
+}
+
+
+bool Write_Images_To_MetaImage( const planar_image_collection<float,double> &imagecoll,
+                                const std::filesystem::path &filename,
+                                bool compress ){
+
+    const auto vol = Images_To_Volume(imagecoll);
+    const auto raw = Volume_To_Raw_Float32(vol, false);
+
+    const bool has_times = (1 < vol.N_times);
+    const size_t dim = has_times ? 4 : 3;
+
+    std::vector<unsigned char> packed;
+    if(compress){
+        packed = Deflate_Buffer(raw.data(), raw.size(), deflate_format::zlib);
+    }
+    const auto &payload = (compress) ? packed : raw;
+
+    std::stringstream ss;
+    ss.precision( std::numeric_limits<double>::max_digits10 );
+
+    ss << "ObjectType = Image" << '\n';
+    ss << "NDims = " << dim << '\n';
+    ss << "BinaryData = True" << '\n';
+    ss << "BinaryDataByteOrderMSB = False" << '\n';
+    ss << "CompressedData = " << (compress ? "True" : "False") << '\n';
+    if(compress) ss << "CompressedDataSize = " << payload.size() << '\n';
+
+    // Each row of the matrix holds the unit direction of one axis. Adding zero avoids emitting negative zeros.
+    ss << "TransformMatrix =";
+    for(const auto &v : { vol.col_dir.unit(), vol.row_dir.unit(), vol.slice_dir.unit() }){
+        ss << " " << (v.x + 0.0) << " " << (v.y + 0.0) << " " << (v.z + 0.0);
+        if(has_times) ss << " 0";
+    }
+    if(has_times) ss << " 0 0 0 1";
+    ss << '\n';
+
+    ss << "Offset = " << (vol.origin.x + 0.0) << " " << (vol.origin.y + 0.0) << " " << (vol.origin.z + 0.0);
+    if(has_times) ss << " 0";
+    ss << '\n';
+    ss << "CenterOfRotation = 0 0 0";
+    if(has_times) ss << " 0";
+    ss << '\n';
+    ss << "AnatomicalOrientation = RAI" << '\n';
+
+    ss << "ElementSpacing = " << vol.col_dir.length() << " " << vol.row_dir.length() << " " << vol.slice_dir.length();
+    if(has_times) ss << " 1";
+    ss << '\n';
+    ss << "DimSize = " << vol.N_cols << " " << vol.N_rows << " " << vol.N_slices;
+    if(has_times) ss << " " << vol.N_times;
+    ss << '\n';
+    if(1 < vol.N_chnls) ss << "ElementNumberOfChannels = " << vol.N_chnls << '\n';
+    ss << "ElementType = MET_FLOAT" << '\n';
+    ss << "ElementDataFile = LOCAL" << '\n';
+
+    std::ofstream FO(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    FO << ss.str();
+    FO.write(reinterpret_cast<const char *>(payload.data()), static_cast<std::streamsize>(payload.size()));
+    FO.flush();
+    return (!FO.fail());
+}
+
@@ -0,0 +1,24 @@
+//MetaImage_File_Loader.h.
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <list>
+
+#include <filesystem>
+
+#include "YgorImages.h"
+
+#include "Structs.h"
+
+bool Load_From_MetaImage_Files( Drover &DICOM_data,
+                                std::map<std::string,std::string> &InvocationMetadata,
+                                const std::string &FilenameLex,
+                                std::list<std::filesystem::path> &Filenames );
+
+// Writes images forming a regular volume to a single MetaImage ('.mha') file. Voxel data are optionally
+// zlib-compressed.
+bool Write_Images_To_MetaImage( const planar_image_collection<float,double> &imagecoll,
+                                const std::filesystem::path &filename,
+                                bool compress );
@@ -0,0 +1,501 @@
+//NIfTI_File_Loader.cc - A part of DICOMautomaton 2026.
+//
+// This program loads NIfTI-1 and NIfTI-2 files, either as single files ('.nii') or header/image pairs ('.hdr' and
+// '.img'), any of which can be gzip-compressed. It also writes NIfTI-1 files.
+//
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <filesystem>
+
+#include "YgorImages.h"
+#include "YgorMath.h"         //Needed for vec3 class.
+#include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
+#include "YgorLog.h"
+#include "YgorString.h"       //Needed for the _s literal.
+
+#include "Metadata.h"
+#include "Structs.h"
+#include "Raw_Volume_IO.h"
+#include "NIfTI_File_Loader.h"
+
+
+// Field offsets that differ between NIfTI-1 and NIfTI-2 headers.
+struct nifti_header_layout {
+    int64_t header_size;
+    size_t dim;         // int16 (v1) or int64 (v2) [8].
+    size_t intent_code; // int16 (v1) or int32 (v2).
+    size_t datatype;    // int16.
+    size_t pixdim;      // float (v1) or double (v2) [8].
+    size_t vox_offset;  // float (v1) or int64 (v2).
+    size_t scl_slope;   // float (v1) or double (v2).
+    size_t scl_inter;
+    size_t descrip;     // char [80].
+    size_t qform_code;  // int16 (v1) or int32 (v2).
+    size_t sform_code;
+    size_t quatern_b;   // float (v1) or double (v2), followed by quatern_c, quatern_d, and qoffset_x/y/z.
+    size_t srow_x;      // float (v1) or double (v2) [4], followed by srow_y and srow_z.
+    size_t xyzt_units;  // char (v1) or int32 (v2).
+    size_t magic;
+};
+
+static const nifti_header_layout nifti1_layout = { 348,  40,  68,  70,  76, 108, 112, 116, 148, 252, 254, 256, 280, 123, 344 };
+static const nifti_header_layout nifti2_layout = { 540,  16, 504,  12, 104, 168, 176, 184, 240, 344, 348, 352, 400, 500,   4 };
+
+template <class T>
+static T nifti_read(const unsigned char *p, bool swap){
+    T v;
+    if(swap){
+        unsigned char b[sizeof(T)];
+        for(size_t j = 0; j < sizeof(T); ++j) b[j] = p[sizeof(T) - 1 - j];
+        std::memcpy(&v, b, sizeof(T));
+    }else{
+        std::memcpy(&v, p, sizeof(T));
+    }
+    return v;
+}
+
+template <class T>
+static void nifti_write(std::vector<unsigned char> &buf, size_t offset, T v){
+    unsigned char b[sizeof(T)];
+    std::memcpy(b, &v, sizeof(T));
+    for(size_t j = 0; j < sizeof(T); ++j){
+        buf.at(offset + j) = host_is_little_endian() ? b[j] : b[sizeof(T) - 1 - j];
+    }
+    return;
+}
+
+std::optional<std::pair<int, bool>> Identify_NIfTI_Header(const unsigned char *d, size_t size){
+    if(size < 348) return {};
+    for(const bool swap : { false, true }){
+        const auto sizeof_hdr = nifti_read<int32_t>(d, swap);
+        if( (sizeof_hdr == 348)
+        &&  ( (std::memcmp(d + 344, "n+1\0", 4) == 0)
+           || (std::memcmp(d + 344, "ni1\0", 4) == 0) ) ){
+            return std::make_pair(1, swap);
+        }
+        if( (sizeof_hdr == 540)
+        &&  (540 <= size)
+        &&  ( (std::memcmp(d + 4, "n+2\0\r\n\032\n", 8) == 0)
+           || (std::memcmp(d + 4, "ni2\0\r\n\032\n", 8) == 0) ) ){
+            return std::make_pair(2, swap);
+        }
+    }
+    return {};
+}
+
+static bool is_gzip(const unsigned char *d, size_t size){
+    return (2 <= size) && (d[0] == 0x1F) && (d[1] == 0x8B);
+}
+
+// Decompresses a whole gzip file, using the (modular) uncompressed size in the trailer as a size hint.
+static std::vector<unsigned char> nifti_inflate(const unsigned char *d, size_t size){
+    const size_t hint = (size < 4) ? 0 : static_cast<size_t>( nifti_read<uint32_t>(d + size - 4, !host_is_little_endian()) );
+    return Inflate_Buffer(d, size, hint);
+}
+
+static planar_image_collection<float,double>
+Read_NIfTI( const std::filesystem::path &Filename,
+            const unsigned char *d,
+            size_t size ){
+
+    const auto id = Identify_NIfTI_Header(d, size);
+    if(!id){
+        throw std::runtime_error("Header not recognized");
+    }
+    const bool is_v1 = (id.value().first == 1);
+    const bool swap = id.value().second;
+    const auto &H = (is_v1) ? nifti1_layout : nifti2_layout;
+
+    // Read fields that are stored with different widths in each version.
+    const auto rd_int = [&](size_t offset, size_t v1_width) -> int64_t {
+        if(is_v1){
+            return (v1_width == 2) ? nifti_read<int16_t>(d + offset, swap)
+                                   : nifti_read<int32_t>(d + offset, swap);
+        }
+        return nifti_read<int64_t>(d + offset, swap);
+    };
+    const auto rd_flt = [&](size_t offset) -> double {
+        return (is_v1) ? static_cast<double>(nifti_read<float>(d + offset, swap))
+                       : nifti_read<double>(d + offset, swap);
+    };
+    const size_t int_width = (is_v1) ? 2 : 8;
+    const size_t flt_width = (is_v1) ? 4 : 8;
+
+    std::array<int64_t, 8> dim;
+    std::array<double, 8> pixdim;
+    for(size_t i = 0; i < 8; ++i){
+        dim[i] = rd_int(H.dim + i * int_width, 2);
+        pixdim[i] = rd_flt(H.pixdim + i * flt_width);
+    }
+    const auto datatype = nifti_read<int16_t>(d + H.datatype, swap);
+    const auto qform_code = (is_v1) ? nifti_read<int16_t>(d + H.qform_code, swap) : nifti_read<int32_t>(d + H.qform_code, swap);
+    const auto sform_code = (is_v1) ? nifti_read<int16_t>(d + H.sform_code, swap) : nifti_read<int32_t>(d + H.sform_code, swap);
+    const auto vox_offset = (is_v1) ? static_cast<int64_t>(nifti_read<float>(d + H.vox_offset, swap))
+                                    : nifti_read<int64_t>(d + H.vox_offset, swap);
+
+    if( (dim[0] < 2)
+    ||  (7 < dim[0]) ){
+        throw std::runtime_error("Dimensionality is not supported");
+    }
+    for(int64_t i = 1; i <= 7; ++i){
+        if(dim[0] < i) dim[i] = 1;
+        if(dim[i] < 1) throw std::runtime_error("Dimensions are invalid");
+    }
+    if( (1 < dim[6])
+    ||  (1 < dim[7]) ){
+        throw std::runtime_error("Dimensions beyond the fifth are not supported");
+    }
+
+    raw_volume_layout layout;
+    layout.big_endian = (host_is_little_endian() == swap);
+    layout.N_cols   = dim[1];
+    layout.N_rows   = dim[2];
+    layout.N_slices = dim[3];
+    layout.N_times  = dim[4];
+
+    bool interleaved = false;
+    switch(datatype){
+        case 2:    layout.type = raw_voxel_type::uint8;   break;
+        case 4:    layout.type = raw_voxel_type::int16;   break;
+        case 8:    layout.type = raw_voxel_type::int32;   break;
+        case 16:   layout.type = raw_voxel_type::float32; break;
+        case 64:   layout.type = raw_voxel_type::float64; break;
+        case 256:  layout.type = raw_voxel_type::int8;    break;
+        case 512:  layout.type = raw_voxel_type::uint16;  break;
+        case 768:  layout.type = raw_voxel_type::uint32;  break;
+        case 1024: layout.type = raw_voxel_type::int64;   break;
+        case 1280: layout.type = raw_voxel_type::uint64;  break;
+        case 128:  layout.type = raw_voxel_type::uint8;   interleaved = true; layout.N_chnls = 3; break; // RGB.
+        case 2304: layout.type = raw_voxel_type::uint8;   interleaved = true; layout.N_chnls = 4; break; // RGBA.
+        default:
+            throw std::runtime_error("Datatype "_s + std::to_string(datatype) + " is not supported");
+    }
+    if(interleaved){
+        if(1 < dim[5]) throw std::runtime_error("Vector-valued colour images are not supported");
+        layout.set_interleaved_strides();
+    }else{
+        // Vector components are stored as separate volumes.
+        layout.N_chnls = dim[5];
+        layout.set_planar_strides();
+    }
+
+    const auto scl_slope = rd_flt(H.scl_slope);
+    const auto scl_inter = rd_flt(H.scl_inter);
+    if( std::isfinite(scl_slope)
+    &&  (scl_slope != 0.0) ){
+        layout.slope = scl_slope;
+        layout.intercept = std::isfinite(scl_inter) ? scl_inter : 0.0;
+    }
+
+    // Determine the voxel-to-world mapping. NIfTI uses the RAS+ coordinate system.
+    for(size_t i = 1; i <= 3; ++i){
+        if( !std::isfinite(pixdim[i])
+        ||  (pixdim[i] <= 0.0) ){
+            pixdim[i] = 1.0;
+        }
+    }
+    vec3<double> col_dir(pixdim[1], 0.0, 0.0);
+    vec3<double> row_dir(0.0, pixdim[2], 0.0);
+    vec3<double> slice_dir(0.0, 0.0, pixdim[3]);
+    vec3<double> origin(0.0, 0.0, 0.0);
+    if(0 < sform_code){
+        std::array<std::array<double, 4>, 3> M;
+        for(size_t r = 0; r < 3; ++r){
+            for(size_t c = 0; c < 4; ++c){
+                M[r][c] = rd_flt(H.srow_x + (r * 4 + c) * flt_width);
+            }
+        }
+        col_dir   = vec3<double>(M[0][0], M[1][0], M[2][0]);
+        row_dir   = vec3<double>(M[0][1], M[1][1], M[2][1]);
+        slice_dir = vec3<double>(M[0][2], M[1][2], M[2][2]);
+        origin    = vec3<double>(M[0][3], M[1][3], M[2][3]);
+
+    }else if(0 < qform_code){
+        const auto b = rd_flt(H.quatern_b);
+        const auto c = rd_flt(H.quatern_b + 1 * flt_width);
+        const auto dd = rd_flt(H.quatern_b + 2 * flt_width);
+        const auto a = std::sqrt(std::max(0.0, 1.0 - (b*b + c*c + dd*dd)));
+        const auto qfac = (pixdim[0] < 0.0) ? -1.0 : 1.0;
+        col_dir   = vec3<double>( a*a + b*b - c*c - dd*dd, 2.0*(b*c + a*dd), 2.0*(b*dd - a*c) ) * pixdim[1];
+        row_dir   = vec3<double>( 2.0*(b*c - a*dd), a*a + c*c - b*b - dd*dd, 2.0*(c*dd + a*b) ) * pixdim[2];
+        slice_dir = vec3<double>( 2.0*(b*dd + a*c), 2.0*(c*dd - a*b), a*a + dd*dd - c*c - b*b ) * (pixdim[3] * qfac);
+        origin    = vec3<double>( rd_flt(H.quatern_b + 3 * flt_width),
+                                  rd_flt(H.quatern_b + 4 * flt_width),
+                                  rd_flt(H.quatern_b + 5 * flt_width) );
+    }
+
+    // Convert to the DICOM patient coordinate system (i.e., LPS).
+    const auto ras_to_lps = [](const vec3<double> &v){
+        return vec3<double>(-v.x, -v.y, v.z);
+    };
+    layout.col_dir   = ras_to_lps(col_dir);
+    layout.row_dir   = ras_to_lps(row_dir);
+    layout.slice_dir = ras_to_lps(slice_dir);
+    layout.origin    = ras_to_lps(origin);
+
+    metadata_map_t file_metadata;
+    {
+        std::string descrip(reinterpret_cast<const char *>(d + H.descrip), 80);
+        descrip = descrip.substr(0, descrip.find('\0'));
+        if(!descrip.empty()) file_metadata["SeriesDescription"] = descrip;
+    }
+
+    // Locate the voxel data. Single files hold the data after the header, and pairs hold the data in a separate file.
+    const bool is_pair = (d[H.magic + 1] == 'i'); // 'ni1' or 'ni2' rather than 'n+1' or 'n+2'.
+    std::unique_ptr<mapped_file> img_file;
+    std::vector<unsigned char> inflated;
+    const unsigned char *src = d;
+    size_t src_size = size;
+    if(is_pair){
+        auto img_path = Filename;
+        bool img_compressed = false;
+        if(img_path.extension() == ".gz"){
+            img_path.replace_extension("");
+            img_compressed = true;
+        }
+        img_path.replace_extension(".img");
+        if(img_compressed) img_path += ".gz";
+        img_file = std::make_unique<mapped_file>(img_path);
+        src = img_file->data();
+        src_size = img_file->size();
+        if(is_gzip(src, src_size)){
+            inflated = nifti_inflate(src, src_size);
+            src = inflated.data();
+            src_size = inflated.size();
+        }
+    }else if(vox_offset < H.header_size){
+        throw std::runtime_error("Voxel offset is invalid");
+    }
+    if( (vox_offset < 0)
+    ||  (src_size < static_cast<size_t>(vox_offset)) ){
+        throw std::runtime_error("Voxel data are missing");
+    }
+    src += vox_offset;
+    src_size -= static_cast<size_t>(vox_offset);
+
+    auto imagecoll = Raw_Volume_To_Images(layout, src, src_size);
+    Attach_Volume_Metadata(imagecoll, file_metadata, Filename, layout.N_slices);
+
+    YLOGINFO("Loaded NIfTI-" << (is_v1 ? 1 : 2) << " file with dimensions "
+             << layout.N_cols << " x " << layout.N_rows << " x " << layout.N_slices
+             << ", " << layout.N_times << " time points, and " << layout.N_chnls << " channels");
+    return imagecoll;
+}
+
+
+bool Load_From_NIfTI_Files( Drover &DICOM_data,
+                            std::map<std::string,std::string> & /* InvocationMetadata */,
+                            const std::string &,
+                            std::list<std::filesystem::path> &Filenames ){
+
+    //This routine will attempt to load NIfTI files. Each file is loaded as a separate image array. Files that are not
+    // NIfTI files are not consumed so that they can be passed on to the next loading stage as needed.
+    //
+    // Note: This routine returns false only iff a file is suspected of being suited for this loader, but could not be
+    //       loaded (e.g., the file seems appropriate, but a parsing failure was encountered).
+    //
+    if(Filenames.empty()) return true;
+
+    size_t i = 0;
+    const size_t N = Filenames.size();
+
+    auto bfit = Filenames.begin();
+    while(bfit != Filenames.end()){
+        YLOGINFO("Parsing file #" << i+1 << "/" << N << " = " << 100*(i+1)/N << "%");
+        ++i;
+        const auto Filename = *bfit;
+
+        std::unique_ptr<mapped_file> mf;
+        std::vector<unsigned char> inflated;
+        const unsigned char *d = nullptr;
+        size_t size = 0;
+        try{
+            mf = std::make_unique<mapped_file>(Filename);
+            d = mf->data();
+            size = mf->size();
+        }catch(const std::exception &e){
+            YLOGINFO("Unable to load as NIfTI file: '" << e.what() << "'");
+            ++bfit;
+            continue;
+        }
+        // Compressed files are identified by decompressing only the header.
+        const bool compressed = is_gzip(d, size);
+        const auto prefix = (compressed) ? Inflate_Prefix(d, size, 540) : std::vector<unsigned char>();
+        if( (compressed && !Identify_NIfTI_Header(prefix.data(), prefix.size()))
+        ||  (!compressed && !Identify_NIfTI_Header(d, size)) ){
+            //Skip the file. It might be destined for some other loader.
+            ++bfit;
+            continue;
+        }
+
+        try{
+            if(compressed){
+                inflated = nifti_inflate(d, size);
+                d = inflated.data();
+                size = inflated.size();
+            }
+            auto imagecoll = Read_NIfTI(Filename, d, size);
+            DICOM_data.image_data.emplace_back( std::make_shared<Image_Array>() );
+            DICOM_data.image_data.back()->imagecoll = std::move(imagecoll);
+        }catch(const std::exception &e){
+            YLOGWARN("Unable to load NIfTI file '" << Filename.string() << "': " << e.what());
+            return false;
+        }
+        bfit = Filenames.erase( bfit );
+    }
+
+    return true;
+}
+
+
+bool Write_Images_To_NIfTI( const planar_image_collection<float,double> &imagecoll,
+                            const std::filesystem::path &filename,
+                            bool compress ){
+
+    const auto vol = Images_To_Volume(imagecoll);
+    const auto H = nifti1_layout;
+    const int64_t vox_offset = H.header_size + 4; // Includes the (empty) extension flag.
+
+    // NIfTI-1 dimensions are limited to 16 bits.
+    for(const auto &n : { vol.N_cols, vol.N_rows, vol.N_slices, vol.N_times, vol.N_chnls }){
+        if(std::numeric_limits<int16_t>::max() < n){
+            throw std::invalid_argument("Volume is too large to represent with NIfTI-1");
+        }
+    }
+
+    std::vector<unsigned char> buf(static_cast<size_t>(vox_offset), 0);
+    const auto lps_to_ras = [](const vec3<double> &v){
+        return vec3<double>(-v.x, -v.y, v.z);
+    };
+    const auto col_dir   = lps_to_ras(vol.col_dir);
+    const auto row_dir   = lps_to_ras(vol.row_dir);
+    const auto slice_dir = lps_to_ras(vol.slice_dir);
+    const auto origin    = lps_to_ras(vol.origin);
+
+    const bool has_chnls = (1 < vol.N_chnls);
+    const bool has_times = (1 < vol.N_times);
+    const int16_t N_dims = (has_chnls) ? 5 : ((has_times) ? 4 : 3);
+    const std::array<int16_t, 8> dim = {{ N_dims,
+                                          static_cast<int16_t>(vol.N_cols),
+                                          static_cast<int16_t>(vol.N_rows),
+                                          static_cast<int16_t>(vol.N_slices),
+                                          static_cast<int16_t>(vol.N_times),
+                                          static_cast<int16_t>(vol.N_chnls), 1, 1 }};
+
+    nifti_write<int32_t>(buf, 0, static_cast<int32_t>(H.header_size));
+    for(size_t i = 0; i < 8; ++i) nifti_write<int16_t>(buf, H.dim + 2 * i, dim[i]);
+    nifti_write<int16_t>(buf, H.intent_code, (has_chnls) ? 1007 : 0); // NIFTI_INTENT_VECTOR.
+    nifti_write<int16_t>(buf, H.datatype, 16);                         // 32-bit float.
+    nifti_write<int16_t>(buf, H.datatype + 2, 32);                     // Bits per voxel.
+    nifti_write<float>(buf, H.vox_offset, static_cast<float>(vox_offset));
+    nifti_write<float>(buf, H.scl_slope, 1.0f);
+    nifti_write<float>(buf, H.scl_inter, 0.0f);
+    buf.at(H.xyzt_units) = 2; // Millimetres.
+
+    // Quaternion form, which is only possible for orthogonal axes. Improper rotations are handled by flipping the
+    // slice axis.
+    double qfac = 1.0;
+    const auto c_u = col_dir.unit();
+    const auto r_u = row_dir.unit();
+    auto s_u = slice_dir.unit();
+    const bool orthogonal = (std::abs(c_u.Dot(r_u)) < 1.0E-4)
+                         && (std::abs(c_u.Dot(s_u)) < 1.0E-4)
+                         && (std::abs(r_u.Dot(s_u)) < 1.0E-4);
+    if(c_u.Cross(r_u).Dot(s_u) < 0.0){
+        qfac = -1.0;
+        s_u = s_u * -1.0;
+    }
+    if(orthogonal){
+        const double r11 = c_u.x, r12 = r_u.x, r13 = s_u.x;
+        const double r21 = c_u.y, r22 = r_u.y, r23 = s_u.y;
+        const double r31 = c_u.z, r32 = r_u.z, r33 = s_u.z;
+        double a = r11 + r22 + r33 + 1.0;
+        double b, c, dd;
+        if(0.5 < a){
+            a  = 0.5 * std::sqrt(a);
+            b  = 0.25 * (r32 - r23) / a;
+            c  = 0.25 * (r13 - r31) / a;
+            dd = 0.25 * (r21 - r12) / a;
+        }else{
+            const double xd = 1.0 + r11 - (r22 + r33);
+            const double yd = 1.0 + r22 - (r11 + r33);
+            const double zd = 1.0 + r33 - (r11 + r22);
+            if(1.0 < xd){
+                b  = 0.5 * std::sqrt(xd);
+                c  = 0.25 * (r12 + r21) / b;
+                dd = 0.25 * (r13 + r31) / b;
+                a  = 0.25 * (r32 - r23) / b;
+            }else if(1.0 < yd){
+                c  = 0.5 * std::sqrt(yd);
+                b  = 0.25 * (r12 + r21) / c;
+                dd = 0.25 * (r23 + r32) / c;
+                a  = 0.25 * (r13 - r31) / c;
+            }else{
+                dd = 0.5 * std::sqrt(zd);
+                b  = 0.25 * (r13 + r31) / dd;
+                c  = 0.25 * (r23 + r32) / dd;
+                a  = 0.25 * (r21 - r12) / dd;
+            }
+            if(a < 0.0){
+                b  = -b;
+                c  = -c;
+                dd = -dd;
+            }
+        }
+        nifti_write<int16_t>(buf, H.qform_code, 1); // NIFTI_XFORM_SCANNER_ANAT.
+        const std::array<double, 6> q = {{ b, c, dd, origin.x, origin.y, origin.z }};
+        for(size_t i = 0; i < q.size(); ++i) nifti_write<float>(buf, H.quatern_b + 4 * i, static_cast<float>(q[i]));
+    }
+
+    const std::array<float, 8> pixdim = {{ static_cast<float>(qfac),
+                                           static_cast<float>(col_dir.length()),
+                                           static_cast<float>(row_dir.length()),
+                                           static_cast<float>(slice_dir.length()),
+                                           1.0f, 1.0f, 1.0f, 1.0f }};
+    for(size_t i = 0; i < 8; ++i) nifti_write<float>(buf, H.pixdim + 4 * i, pixdim[i]);
+
+    // Affine form, which is exact.
+    nifti_write<int16_t>(buf, H.sform_code, 1); // NIFTI_XFORM_SCANNER_ANAT.
+    const std::array<vec3<double>, 4> cols = {{ col_dir, row_dir, slice_dir, origin }};
+    for(size_t c = 0; c < 4; ++c){
+        nifti_write<float>(buf, H.srow_x + 4 * c,      static_cast<float>(cols[c].x));
+        nifti_write<float>(buf, H.srow_x + 16 + 4 * c, static_cast<float>(cols[c].y));
+        nifti_write<float>(buf, H.srow_x + 32 + 4 * c, static_cast<float>(cols[c].z));
+    }
+
+    const auto common = Common_Volume_Metadata(vol);
+    if(const auto it = common.find("SeriesDescription"); it != std::end(common)){
+        const auto descrip = it->second.substr(0, 79);
+        std::copy(std::begin(descrip), std::end(descrip), std::begin(buf) + H.descrip);
+    }
+    std::memcpy(buf.data() + H.magic, "n+1\0", 4);
+
+    const auto raw = Volume_To_Raw_Float32(vol, true);
+    buf.insert(std::end(buf), std::begin(raw), std::end(raw));
+
+    std::ofstream FO(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(compress){
+        const auto c = Deflate_Buffer(buf.data(), buf.size(), deflate_format::gzip);
+        FO.write(reinterpret_cast<const char *>(c.data()), static_cast<std::streamsize>(c.size()));
+    }else{
+        FO.write(reinterpret_cast<const char *>(buf.data()), static_cast<std::streamsize>(buf.size()));
+    }
+    FO.flush();
+    return (!FO.fail());
+}
+
@@ -0,0 +1,30 @@
+//NIfTI_File_Loader.h.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <map>
+#include <list>
+#include <optional>
+#include <utility>
+
+#include <filesystem>
+
+#include "YgorImages.h"
+
+#include "Structs.h"
+
+// Identifies a NIfTI header, returning the version (1 or 2) and whether the header is byte-swapped.
+std::optional<std::pair<int, bool>> Identify_NIfTI_Header(const unsigned char *d, size_t size);
+
+bool Load_From_NIfTI_Files( Drover &DICOM_data,
+                            std::map<std::string,std::string> &InvocationMetadata,
+                            const std::string &FilenameLex,
+                            std::list<std::filesystem::path> &Filenames );
+
+// Writes images forming a regular volume to a single NIfTI-1 file. The whole file is optionally gzip-compressed, which
+// is conventionally denoted with a '.nii.gz' extension.
+bool Write_Images_To_NIfTI( const planar_image_collection<float,double> &imagecoll,
+                            const std::filesystem::path &filename,
+                            bool compress );
@@ -0,0 +1,513 @@
+//NRRD_File_Loader.cc - A part of DICOMautomaton 2026.
+//
+// This program loads and writes NRRD files. Attached and detached headers are supported, as are raw and gzip
+// encodings. Key/value pairs are treated as image metadata.
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <filesystem>
+
+#include "YgorImages.h"
+#include "YgorMath.h"         //Needed for vec3 class.
+#include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
+#include "YgorLog.h"
+#include "YgorString.h"       //Needed for Canonicalize_String2().
+
+#include "Metadata.h"
+#include "Structs.h"
+#include "Raw_Volume_IO.h"
+#include "NRRD_File_Loader.h"
+
+
+static std::string nrrd_lowercase(std::string s){
+    std::transform(std::begin(s), std::end(s), std::begin(s), [](unsigned char c){ return std::tolower(c); });
+    return s;
+}
+
+static std::vector<std::string> nrrd_tokens(const std::string &s){
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string token;
+    while(ss >> token) out.push_back(token);
+    return out;
+}
+
+// Key/value pairs escape newlines and backslashes.
+static std::string nrrd_escape(const std::string &s){
+    std::string out;
+    for(const auto &c : s){
+        if(c == '\\'){
+            out += "\\\\";
+        }else if(c == '\n'){
+            out += "\\n";
+        }else{
+            out += c;
+        }
+    }
+    return out;
+}
+
+static std::string nrrd_unescape(const std::string &s){
+    std::string out;
+    for(size_t i = 0; i < s.size(); ++i){
+        if( (s[i] == '\\')
+        &&  ((i + 1) < s.size()) ){
+            ++i;
+            out += (s[i] == 'n') ? '\n' : s[i];
+        }else{
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+static std::optional<raw_voxel_type> nrrd_parse_type(const std::string &s){
+    // Normalize whitespace, since types like 'unsigned short int' contain spaces.
+    std::string n;
+    for(const auto &t : nrrd_tokens(nrrd_lowercase(s))){
+        n += (n.empty() ? "" : " ") + t;
+    }
+
+    static const std::map<std::string, raw_voxel_type> types = {
+        { "signed char", raw_voxel_type::int8 }, { "int8", raw_voxel_type::int8 }, { "int8_t", raw_voxel_type::int8 },
+
+        { "uchar", raw_voxel_type::uint8 }, { "unsigned char", raw_voxel_type::uint8 },
+        { "uint8", raw_voxel_type::uint8 }, { "uint8_t", raw_voxel_type::uint8 },
+
+        { "short", raw_voxel_type::int16 }, { "short int", raw_voxel_type::int16 },
+        { "signed short", raw_voxel_type::int16 }, { "signed short int", raw_voxel_type::int16 },
+        { "int16", raw_voxel_type::int16 }, { "int16_t", raw_voxel_type::int16 },
+
+        { "ushort", raw_voxel_type::uint16 }, { "unsigned short", raw_voxel_type::uint16 },
+        { "unsigned short int", raw_voxel_type::uint16 },
+        { "uint16", raw_voxel_type::uint16 }, { "uint16_t", raw_voxel_type::uint16 },
+
+        { "int", raw_voxel_type::int32 }, { "signed int", raw_voxel_type::int32 },
+        { "int32", raw_voxel_type::int32 }, { "int32_t", raw_voxel_type::int32 },
+
+        { "uint", raw_voxel_type::uint32 }, { "unsigned int", raw_voxel_type::uint32 },
+        { "uint32", raw_voxel_type::uint32 }, { "uint32_t", raw_voxel_type::uint32 },
+
+        { "longlong", raw_voxel_type::int64 }, { "long long", raw_voxel_type::int64 },
+        { "long long int", raw_voxel_type::int64 }, { "signed long long", raw_voxel_type::int64 },
+        { "signed long long int", raw_voxel_type::int64 },
+        { "int64", raw_voxel_type::int64 }, { "int64_t", raw_voxel_type::int64 },
+
+        { "ulonglong", raw_voxel_type::uint64 }, { "unsigned long long", raw_voxel_type::uint64 },
+        { "unsigned long long int", raw_voxel_type::uint64 },
+        { "uint64", raw_voxel_type::uint64 }, { "uint64_t", raw_voxel_type::uint64 },
+
+        { "float", raw_voxel_type::float32 },
+        { "double", raw_voxel_type::float64 },
+    };
+    const auto it = types.find(n);
+    if(it == std::end(types)) return {};
+    return it->second;
+}
+
+// Parses a list of vectors like '(1,0,0) (0,1,0) none'.
+static std::vector<std::optional<vec3<double>>> nrrd_parse_vectors(const std::string &s){
+    std::vector<std::optional<vec3<double>>> out;
+    size_t i = 0;
+    while(i < s.size()){
+        if(std::isspace(static_cast<unsigned char>(s[i]))){
+            ++i;
+        }else if(s.compare(i, 4, "none") == 0){
+            out.emplace_back();
+            i += 4;
+        }else if(s[i] == '('){
+            const auto end = s.find(')', i);
+            if(end == std::string::npos){
+                throw std::runtime_error("Unterminated vector");
+            }
+            std::vector<double> c;
+            std::stringstream ss(s.substr(i + 1, end - i - 1));
+            std::string x;
+            while(std::getline(ss, x, ',')){
+                c.push_back(std::stod(x));
+            }
+            if( c.empty()
+            ||  (3 < c.size()) ){
+                throw std::runtime_error("Only vectors with 1-3 components are supported");
+            }
+            c.resize(3, 0.0);
+            out.emplace_back( vec3<double>(c[0], c[1], c[2]) );
+            i = end + 1;
+        }else{
+            throw std::runtime_error("Unable to parse vector list '"_s + s + "'");
+        }
+    }
+    return out;
+}
+
+static planar_image_collection<float,double>
+Read_NRRD( const std::filesystem::path &Filename,
+           const unsigned char *d,
+           size_t size ){
+
+    // Parse the header. Field names are case-insensitive and, for compatibility, spaces within them are ignored.
+    std::map<std::string, std::string> fields;
+    metadata_map_t kvs;
+    size_t pos = 0;
+    bool header_ended = false;
+    bool is_magic = true;
+    while(pos < size){
+        const auto *nl = static_cast<const unsigned char *>(std::memchr(d + pos, '\n', size - pos));
+        const size_t end = (nl == nullptr) ? size : static_cast<size_t>(nl - d);
+        std::string line(reinterpret_cast<const char *>(d + pos), end - pos);
+        pos = (nl == nullptr) ? size : (end + 1);
+        if(!line.empty() && (line.back() == '\r')) line.pop_back();
+
+        if(is_magic){
+            is_magic = false;
+            continue;
+        }
+        if(line.empty()){
+            header_ended = true;
+            break;
+        }
+        if(line.front() == '#') continue;
+
+        const auto kv = line.find(":=");
+        const auto f = line.find(": ");
+        if( (kv != std::string::npos)
+        &&  ((f == std::string::npos) || (kv < f)) ){
+            kvs[nrrd_unescape(line.substr(0, kv))] = nrrd_unescape(line.substr(kv + 2));
+            continue;
+        }
+        if(f == std::string::npos){
+            throw std::runtime_error("Unable to parse header line '"_s + line + "'");
+        }
+        auto field = nrrd_lowercase(line.substr(0, f));
+        field.erase( std::remove(std::begin(field), std::end(field), ' '), std::end(field) );
+        fields[field] = Canonicalize_String2(line.substr(f + 2), CANONICALIZE::TRIM);
+    }
+
+    const auto get = [&](const std::string &k) -> std::optional<std::string> {
+        const auto it = fields.find(k);
+        if(it == std::end(fields)) return {};
+        return it->second;
+    };
+    const auto require = [&](const std::string &k) -> std::string {
+        const auto v = get(k);
+        if(!v) throw std::runtime_error("Required field '"_s + k + "' is missing");
+        return v.value();
+    };
+
+    const auto dim = static_cast<size_t>(std::stoll(require("dimension")));
+    std::vector<int64_t> sizes;
+    for(const auto &t : nrrd_tokens(require("sizes"))) sizes.push_back(std::stoll(t));
+    if( (dim < 2)
+    ||  (sizes.size() != dim)
+    ||  std::any_of(std::begin(sizes), std::end(sizes), [](int64_t s){ return (s < 1); }) ){
+        throw std::runtime_error("Sizes are invalid");
+    }
+
+    raw_volume_layout layout;
+    const auto type = nrrd_parse_type(require("type"));
+    if(!type){
+        throw std::runtime_error("Type is not supported");
+    }
+    layout.type = type.value();
+    layout.big_endian = (nrrd_lowercase(get("endian").value_or("little")) == "big");
+
+    std::vector<std::string> kinds;
+    if(const auto k = get("kinds")) kinds = nrrd_tokens(nrrd_lowercase(k.value()));
+    std::vector<std::optional<vec3<double>>> dirs;
+    if(const auto s = get("spacedirections")) dirs = nrrd_parse_vectors(s.value());
+    std::vector<double> spacings;
+    if(const auto s = get("spacings")){
+        for(const auto &t : nrrd_tokens(s.value())) spacings.push_back(std::stod(t));
+    }
+    if( (!kinds.empty() && (kinds.size() != dim))
+    ||  (!dirs.empty() && (dirs.size() != dim)) ){
+        throw std::runtime_error("Per-axis fields are inconsistent with the dimension");
+    }
+
+    // Identify the spatial axes. A leading non-spatial axis is treated as channels, and any trailing non-spatial axes
+    // are flattened into time points.
+    std::vector<bool> is_spatial(dim, false);
+    for(size_t a = 0; a < dim; ++a){
+        if(!dirs.empty()){
+            is_spatial[a] = dirs[a].has_value();
+        }else if(!kinds.empty()){
+            is_spatial[a] = (kinds[a] == "domain") || (kinds[a] == "space");
+        }else{
+            is_spatial[a] = (a < 3);
+        }
+    }
+    size_t a = 0;
+    bool has_chnls = false;
+    if(!is_spatial[0]){
+        has_chnls = true;
+        a = 1;
+    }
+    std::vector<size_t> spatial_axes;
+    while( (a < dim) && is_spatial[a] && (spatial_axes.size() < 3) ){
+        spatial_axes.push_back(a++);
+    }
+    const size_t first_time_axis = a;
+    for(; a < dim; ++a){
+        if(is_spatial[a] && !dirs.empty()){
+            throw std::runtime_error("Non-contiguous spatial axes are not supported");
+        }
+    }
+    if(spatial_axes.size() < 2){
+        throw std::runtime_error("Only 2D and 3D volumes are supported");
+    }
+
+    std::vector<int64_t> strides(dim, 1);
+    for(size_t i = 1; i < dim; ++i) strides[i] = strides[i-1] * sizes[i-1];
+
+    layout.N_chnls  = (has_chnls) ? sizes[0] : 1;
+    layout.s_chnl   = 1;
+    layout.N_cols   = sizes[spatial_axes[0]];
+    layout.s_col    = strides[spatial_axes[0]];
+    layout.N_rows   = sizes[spatial_axes[1]];
+    layout.s_row    = strides[spatial_axes[1]];
+    layout.N_slices = (spatial_axes.size() == 3) ? sizes[spatial_axes[2]] : 1;
+    layout.s_slice  = (spatial_axes.size() == 3) ? strides[spatial_axes[2]] : 0;
+    layout.N_times  = 1;
+    layout.s_time   = (first_time_axis < dim) ? strides[first_time_axis] : 0;
+    for(size_t i = first_time_axis; i < dim; ++i) layout.N_times *= sizes[i];
+
+    const auto axis_dir = [&](size_t n) -> vec3<double> {
+        const auto ax = spatial_axes[n];
+        if(!dirs.empty()) return dirs[ax].value();
+
+        double sp = 1.0;
+        if( (ax < spacings.size())
+        &&  std::isfinite(spacings[ax])
+        &&  (0.0 < spacings[ax]) ){
+            sp = spacings[ax];
+        }
+        const auto e = (n == 0) ? vec3<double>(1.0, 0.0, 0.0)
+                     : (n == 1) ? vec3<double>(0.0, 1.0, 0.0)
+                                : vec3<double>(0.0, 0.0, 1.0);
+        return e * sp;
+    };
+    layout.col_dir = axis_dir(0);
+    layout.row_dir = axis_dir(1);
+    layout.slice_dir = (spatial_axes.size() == 3) ? axis_dir(2) : layout.row_dir.Cross(layout.col_dir).unit();
+    if(const auto o = get("spaceorigin")){
+        const auto v = nrrd_parse_vectors(o.value());
+        if(v.empty() || !v.front()) throw std::runtime_error("Space origin is invalid");
+        layout.origin = v.front().value();
+    }
+
+    // Convert to the DICOM patient coordinate system (i.e., LPS).
+    const auto space = nrrd_lowercase(get("space").value_or(""));
+    auto flip = vec3<double>(1.0, 1.0, 1.0);
+    if( (space == "right-anterior-superior") || (space == "ras")
+    ||  (space == "right-anterior-superior-time") || (space == "rast") ){
+        flip = vec3<double>(-1.0, -1.0, 1.0);
+    }else if( (space == "left-anterior-superior") || (space == "las")
+          ||  (space == "left-anterior-superior-time") || (space == "last") ){
+        flip = vec3<double>(-1.0, 1.0, 1.0);
+    }
+    for(auto *v : { &layout.origin, &layout.col_dir, &layout.row_dir, &layout.slice_dir }){
+        *v = vec3<double>(v->x * flip.x, v->y * flip.y, v->z * flip.z);
+    }
+
+    // Locate the voxel data, which follow the header or are stored in a separate file.
+    std::unique_ptr<mapped_file> detached;
+    const unsigned char *src = d + pos;
+    size_t src_size = size - pos;
+    if(const auto df = get("datafile")){
+        if( (df.value().rfind("LIST", 0) == 0)
+        ||  (nrrd_tokens(df.value()).size() != 1) ){
+            throw std::runtime_error("Multiple detached data files are not supported");
+        }
+        auto dp = std::filesystem::path(df.value());
+        if(dp.is_relative()) dp = Filename.parent_path() / dp;
+        detached = std::make_unique<mapped_file>(dp);
+        src = detached->data();
+        src_size = detached->size();
+    }else if(!header_ended){
+        throw std::runtime_error("Header is not terminated");
+    }
+
+    const auto line_skip = std::stoll(get("lineskip").value_or("0"));
+    for(int64_t n = 0; n < line_skip; ++n){
+        const auto *nl = static_cast<const unsigned char *>(std::memchr(src, '\n', src_size));
+        if(nl == nullptr) throw std::runtime_error("Unable to skip lines");
+        src_size -= static_cast<size_t>(nl + 1 - src);
+        src = nl + 1;
+    }
+
+    const auto encoding = nrrd_lowercase(require("encoding"));
+    std::vector<unsigned char> inflated;
+    if( (encoding == "gzip")
+    ||  (encoding == "gz") ){
+        inflated = Inflate_Buffer(src, src_size, static_cast<size_t>(layout.N_bytes()));
+        src = inflated.data();
+        src_size = inflated.size();
+    }else if(encoding != "raw"){
+        throw std::runtime_error("Encoding '"_s + encoding + "' is not supported");
+    }
+
+    const auto byte_skip = std::stoll(get("byteskip").value_or("0"));
+    const auto N_bytes = static_cast<size_t>(layout.N_bytes());
+    if(byte_skip == -1){
+        // The data are located at the end of the file.
+        if( (encoding != "raw")
+        ||  (src_size < N_bytes) ){
+            throw std::runtime_error("Unable to locate voxel data");
+        }
+        src += src_size - N_bytes;
+        src_size = N_bytes;
+    }else if( (byte_skip < 0)
+          ||  (src_size < static_cast<size_t>(byte_skip)) ){
+        throw std::runtime_error("Byte skip is invalid");
+    }else{
+        src += byte_skip;
+        src_size -= static_cast<size_t>(byte_skip);
+    }
+
+    auto imagecoll = Raw_Volume_To_Images(layout, src, src_size);
+    Attach_Volume_Metadata(imagecoll, kvs, Filename, layout.N_slices);
+
+    YLOGINFO("Loaded NRRD file with dimensions "
+             << layout.N_cols << " x " << layout.N_rows << " x " << layout.N_slices
+             << ", " << layout.N_times << " time points, and " << layout.N_chnls << " channels");
+    return imagecoll;
+}
+
+
+bool Load_From_NRRD_Files( Drover &DICOM_data,
+                           std::map<std::string,std::string> & /* InvocationMetadata */,
+                           const std::string &,
+                           std::list<std::filesystem::path> &Filenames ){
+
+    //This routine will attempt to load NRRD files. Each file is loaded as a separate image array. Files that are not
+    // NRRD files are not consumed so that they can be passed on to the next loading stage as needed.
+    //
+    // Note: This routine returns false only iff a file is suspected of being suited for this loader, but could not be
+    //       loaded (e.g., the file seems appropriate, but a parsing failure was encountered).
+    //
+    if(Filenames.empty()) return true;
+
+    size_t i = 0;
+    const size_t N = Filenames.size();
+
+    auto bfit = Filenames.begin();
+    while(bfit != Filenames.end()){
+        YLOGINFO("Parsing file #" << i+1 << "/" << N << " = " << 100*(i+1)/N << "%");
+        ++i;
+        const auto Filename = *bfit;
+
+        std::unique_ptr<mapped_file> mf;
+        try{
+            mf = std::make_unique<mapped_file>(Filename);
+        }catch(const std::exception &e){
+            YLOGINFO("Unable to load as NRRD file: '" << e.what() << "'");
+            ++bfit;
+            continue;
+        }
+        if( (mf->size() < 8)
+        ||  (std::memcmp(mf->data(), "NRRD000", 7) != 0) ){
+            //Skip the file. It might be destined for some other loader.
+            ++bfit;
+            continue;
+        }
+
+        try{
+            auto imagecoll = Read_NRRD(Filename, mf->data(), mf->size());
+            DICOM_data.image_data.emplace_back( std::make_shared<Image_Array>() );
+            DICOM_data.image_data.back()->imagecoll = std::move(imagecoll);
+        }catch(const std::exception &e){
+            YLOGWARN("Unable to load NRRD file '" << Filename.string() << "': " << e.what());
+            return false;
+        }
+        bfit = Filenames.erase( bfit );
+    }
+
+    return true;
+}
+
+
+bool Write_Images_To_NRRD( const planar_image_collection<float,double> &imagecoll,
+                           const std::filesystem::path &filename,
+                           bool compress ){
+
+    const auto vol = Images_To_Volume(imagecoll);
+    const auto raw = Volume_To_Raw_Float32(vol, false);
+
+    const bool has_chnls = (1 < vol.N_chnls);
+    const bool has_times = (1 < vol.N_times);
+
+    std::stringstream ss;
+    ss.precision( std::numeric_limits<double>::max_digits10 );
+    const auto emit_vec = [&](const vec3<double> &v){
+        // Adding zero avoids emitting negative zeros.
+        ss << "(" << (v.x + 0.0) << "," << (v.y + 0.0) << "," << (v.z + 0.0) << ")";
+    };
+
+    ss << "NRRD0004" << '\n';
+    ss << "# Complete NRRD file format specification at:" << '\n';
+    ss << "# http://teem.sourceforge.net/nrrd/format.html" << '\n';
+    ss << "type: float" << '\n';
+    ss << "dimension: " << (3 + (has_chnls ? 1 : 0) + (has_times ? 1 : 0)) << '\n';
+    ss << "space: left-posterior-superior" << '\n';
+
+    ss << "sizes:";
+    if(has_chnls) ss << " " << vol.N_chnls;
+    ss << " " << vol.N_cols << " " << vol.N_rows << " " << vol.N_slices;
+    if(has_times) ss << " " << vol.N_times;
+    ss << '\n';
+
+    ss << "space directions:";
+    if(has_chnls) ss << " none";
+    for(const auto &v : { vol.col_dir, vol.row_dir, vol.slice_dir }){
+        ss << " ";
+        emit_vec(v);
+    }
+    if(has_times) ss << " none";
+    ss << '\n';
+
+    ss << "kinds:";
+    if(has_chnls) ss << " list";
+    ss << " domain domain domain";
+    if(has_times) ss << " time";
+    ss << '\n';
+
+    ss << "endian: little" << '\n';
+    ss << "encoding: " << (compress ? "gzip" : "raw") << '\n';
+    ss << "space origin: ";
+    emit_vec(vol.origin);
+    ss << '\n';
+
+    for(const auto &kv : Common_Volume_Metadata(vol)){
+        if(kv.first.find(":=") != std::string::npos) continue;
+        ss << nrrd_escape(kv.first) << ":=" << nrrd_escape(kv.second) << '\n';
+    }
+    ss << '\n';
+
+    std::ofstream FO(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    FO << ss.str();
+    if(compress){
+        const auto c = Deflate_Buffer(raw.data(), raw.size(), deflate_format::gzip);
+        FO.write(reinterpret_cast<const char *>(c.data()), static_cast<std::streamsize>(c.size()));
+    }else{
+        FO.write(reinterpret_cast<const char *>(raw.data()), static_cast<std::streamsize>(raw.size()));
+    }
+    FO.flush();
+    return (!FO.fail());
+}
+
@@ -0,0 +1,23 @@
+//NRRD_File_Loader.h.
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <list>
+
+#include <filesystem>
+
+#include "YgorImages.h"
+
+#include "Structs.h"
+
+bool Load_From_NRRD_Files( Drover &DICOM_data,
+                           std::map<std::string,std::string> &InvocationMetadata,
+                           const std::string &FilenameLex,
+                           std::list<std::filesystem::path> &Filenames );
+
+// Writes images forming a regular volume to a single NRRD file. Voxel data are optionally gzip-compressed.
+bool Write_Images_To_NRRD( const planar_image_collection<float,double> &imagecoll,
+                           const std::filesystem::path &filename,
+                           bool compress );
@@ -111,6 +111,9 @@
 #include "Operations/ExportFITSImages.h"
 #include "Operations/ExportContours.h"
 #include "Operations/ExportLineSamples.h"
+#include "Operations/ExportMetaImages.h"
+#include "Operations/ExportNIfTIImages.h"
+#include "Operations/ExportNRRDImages.h"
 #include "Operations/ExportSNCImages.h"
 #include "Operations/ExportSurfaceMeshes.h"
 #include "Operations/ExportSurfaceMeshesOBJ.h"
@@ -124,6 +127,7 @@
 #include "Operations/ExtractImageHistograms.h"
 #include "Operations/ExtractPointsWarp.h"
 #include "Operations/False.h"
+#include "Operations/FlushExports.h"
 #include "Operations/ForEachDistinct.h"
 #include "Operations/ForEachRTPlan.h"
 #include "Operations/Fork.h"
@@ -192,6 +196,7 @@
 #include "Operations/SelectSlicesIntersectingROI.h"
 #include "Operations/SimplifyContours.h"
 #include "Operations/SimplifySurfaceMeshes.h"
+#include "Operations/SimulateFluenceMaps.h"
 #include "Operations/SimulateRadiograph.h"
 #include "Operations/Sleep.h"
 #include "Operations/SpatialBlur.h"
@@ -362,6 +367,9 @@ std::map<std::string, op_packet_t> Known_Operations(){
     out["ExportFITSImages"] = std::make_pair(OpArgDocExportFITSImages, ExportFITSImages);
     out["ExportContours"] = std::make_pair(OpArgDocExportContours, ExportContours);
     out["ExportLineSamples"] = std::make_pair(OpArgDocExportLineSamples, ExportLineSamples);
+    out["ExportMetaImages"] = std::make_pair(OpArgDocExportMetaImages, ExportMetaImages);
+    out["ExportNIfTIImages"] = std::make_pair(OpArgDocExportNIfTIImages, ExportNIfTIImages);
+    out["ExportNRRDImages"] = std::make_pair(OpArgDocExportNRRDImages, ExportNRRDImages);
     out["ExportPointClouds"] = std::make_pair(OpArgDocExportPointClouds, ExportPointClouds);
     out["ExportSNCImages"] = std::make_pair(OpArgDocExportSNCImages, ExportSNCImages);
     out["ExportSurfaceMeshesOBJ"] = std::make_pair(OpArgDocExportSurfaceMeshesOBJ, ExportSurfaceMeshesOBJ);
@@ -375,6 +383,7 @@ std::map<std::string, op_packet_t> Known_Operations(){
     out["ExtractImageHistograms"] = std::make_pair(OpArgDocExtractImageHistograms, ExtractImageHistograms);
     out["ExtractPointsWarp"] = std::make_pair(OpArgDocExtractPointsWarp, ExtractPointsWarp);
     out["False"] = std::make_pair(OpArgDocFalse, False);
+    out["FlushExports"] = std::make_pair(OpArgDocFlushExports, FlushExports);
     out["ForEachDistinct"] = std::make_pair(OpArgDocForEachDistinct, ForEachDistinct);
     out["ForEachRTPlan"] = std::make_pair(OpArgDocForEachRTPlan, ForEachRTPlan);
     out["Fork"] = std::make_pair(OpArgDocFork, Fork);
@@ -443,6 +452,7 @@ std::map<std::string, op_packet_t> Known_Operations(){
     out["SelectSlicesIntersectingROI"] = std::make_pair(OpArgDocSelectSlicesIntersectingROI, SelectSlicesIntersectingROI);
     out["SimplifyContours"] = std::make_pair(OpArgDocSimplifyContours, SimplifyContours);
     out["SimplifySurfaceMeshes"] = std::make_pair(OpArgDocSimplifySurfaceMeshes, SimplifySurfaceMeshes);
+    out["SimulateFluenceMaps"] = std::make_pair(OpArgDocSimulateFluenceMaps, SimulateFluenceMaps);
     out["SimulateRadiograph"] = std::make_pair(OpArgDocSimulateRadiograph, SimulateRadiograph);
     out["Sleep"] = std::make_pair(OpArgDocSleep, Sleep);
     out["SpatialBlur"] = std::make_pair(OpArgDocSpatialBlur, SpatialBlur);
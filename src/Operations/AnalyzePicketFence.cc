@@ -35,7 +35,7 @@
 #include "YgorStats.h"        //Needed for Stats:: namespace.
 #include "YgorFilesDirs.h"
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "AnalyzePicketFence.h"
 
@@ -180,7 +180,7 @@ bool AnalyzePicketFence(Drover &DICOM_data,
                           std::map<std::string, std::string>& /*InvocationMetadata*/,
                           const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto ImageSelectionStr = OptArgs.getValueStr("ImageSelection").value();
@@ -223,10 +223,10 @@ bool BEDConvert(Drover &DICOM_data,
     auto IAs_all = All_IAs( DICOM_data );
     auto IAs = Whitelist( IAs_all, ImageSelectionStr );
     IAs = Whitelist(IAs, "Modality", "RTDOSE");
+    // Note: the voxel classification is cached in the user data, so dose arrays sharing a grid are only classified once.
     for(auto & iap_it : IAs){
-        if(!(*iap_it)->imagecoll.Process_Images_Parallel( GroupIndividualImages,
-                                                          BEDConversion,
-                                                          {}, cc_ROIs, &ud )){
+        if(!(*iap_it)->imagecoll.Compute_Images( BEDConversion,
+                                                 {}, cc_ROIs, &ud )){
             throw std::runtime_error("Unable to convert image_array voxels to BED or EQDx using the specified ROI(s).");
         }
     }
@@ -12,6 +12,7 @@
 #include "../Common_Boost_Serialization.h"
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
+#include "../Write_File.h"
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 #include "YgorLog.h"
 
@@ -82,7 +83,7 @@ bool Boost_Serialize_Drover(Drover &DICOM_data,
     // Figure out what needs to be serialized.
     //
     // Note: The Drover class holds everything as shared_ptrs or containers of shared_ptrs, so these copies are
-    // superficial.
+    // superficial. A deep copy is taken below since serialization is performed in the background.
     Drover d;
     if(include_images){
         d.image_data = DICOM_data.image_data;
@@ -99,13 +100,28 @@ bool Boost_Serialize_Drover(Drover &DICOM_data,
     if(include_rtplans){
         d.rtplan_data = DICOM_data.rtplan_data;
     }
+    auto snapshot = std::make_shared<const Drover>(d.Deep_Copy());
 
-    const auto res = Common_Boost_Serialize_Drover(d, apath);
-    if(res){
-        YLOGINFO("Dumped serialization to file " << apath);
-    }else{
-        throw std::runtime_error("Unable dump serialization to file " + apath.string());
+    // Estimate the memory held by the snapshot. Only the bulk data are considered.
+    size_t bytes = 0;
+    for(const auto &ia : snapshot->image_data){
+        for(const auto &img : ia->imagecoll.images) bytes += img.data.size() * sizeof(float);
     }
+    if(snapshot->contour_data != nullptr){
+        for(const auto &cc : snapshot->contour_data->ccs){
+            for(const auto &c : cc.contours) bytes += c.points.size() * sizeof(vec3<double>);
+        }
+    }
+    for(const auto &pc : snapshot->point_data) bytes += pc->pset.points.size() * sizeof(vec3<double>);
+    for(const auto &sm : snapshot->smesh_data){
+        bytes += sm->meshes.vertices.size() * sizeof(vec3<double>);
+        for(const auto &f : sm->meshes.faces) bytes += f.size() * sizeof(uint64_t);
+    }
+
+    Write_Behind(apath, bytes, [snapshot, apath](){
+        return Common_Boost_Serialize_Drover(*snapshot, apath);
+    });
+    YLOGINFO("Queued serialization for writing to file " << apath);
 
     return true;
 }
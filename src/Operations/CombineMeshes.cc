@@ -14,7 +14,7 @@
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 #include "YgorLog.h"
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
@@ -54,7 +54,7 @@ bool CombineMeshes(Drover &DICOM_data,
                   std::map<std::string, std::string>& /*InvocationMetadata*/,
                   const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto MeshSelectionStr = OptArgs.getValueStr("MeshSelection").value();
@@ -16,7 +16,7 @@
 #include <vector>
 #include <cstdint>
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "YgorImages.h"
 #include "YgorImagesIO.h"
@@ -130,7 +130,7 @@ bool ContourBasedRayCastDoseAccumulate(Drover &DICOM_data,
     const auto Rows = std::stol(RowsStr);
     const auto Columns = std::stol(ColumnsStr);
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //Ensure the Ray dL is sufficiently small. We enforce that ray cannot step over the cylinder in a single iteration
     // for 95% of the width of the cylinder. So if the rays are oncoming and directed at the cylinder perpendicularly,
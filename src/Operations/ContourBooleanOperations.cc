@@ -17,7 +17,7 @@
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
 #include "ContourBooleanOperations.h"
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "YgorMath.h"         //Needed for vec3 class.
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 #include "YgorLog.h"
@@ -139,7 +139,7 @@ bool ContourBooleanOperations(Drover &DICOM_data,
         throw std::logic_error("Unanticipated Boolean operation request.");
     }
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //Stuff references to all contours into a list. Remember that you can still address specific contours through
     // the original holding containers (which are not modified here).
@@ -1,14 +1,20 @@
 //ContourSimilarity.cc - A part of DICOMautomaton 2015, 2016. Written by hal clark.
 
+#include <algorithm>
 #include <any>
+#include <exception>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
 #include <stdexcept>
 #include <string>    
+#include <utility>
 #include <vector>
 
 #include <boost/interprocess/creation_tags.hpp>
@@ -22,10 +28,11 @@
 #include "YgorString.h"       //Needed for GetFirstRegex(...)
 #include "YgorFilesDirs.h"
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
+#include "../Thread_Pool.h"
 #include "../YgorImages_Functors/Compute/Contour_Similarity.h"
 
 #include "ContourSimilarity.h"
@@ -38,6 +45,13 @@ OperationDoc OpArgDocContourSimilarity(){
         " The comparison is based on point samples. It is useful for comparing contouring styles."
         " This operation currently reports Dice and Jaccard similarity metrics.";
 
+    out.notes.emplace_back(
+        "Each ROI selected by the 'A' selectors is compared with each ROI selected by the 'B' selectors, and"
+        " one row is reported for each pair. Every ROI is rasterized only once, so comparing many candidate"
+        " ROIs against one or more references in a single invocation is much faster than invoking this"
+        " operation for each pair. Contour collections that share an ROIName are treated as a single ROI."
+    );
+
     out.notes.emplace_back(
         "This routine requires an image grid, which is used to control where the contours are sampled."
         " Images are not modified."
@@ -104,7 +118,7 @@ bool ContourSimilarity(Drover &DICOM_data,
     auto FileName = OptArgs.getValueStr("FileName").value();
     const auto UserComment = OptArgs.getValueStr("UserComment");
     //-----------------------------------------------------------------------------------------------------------------
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     auto cc_all = All_CCs( DICOM_data );
 
@@ -113,18 +127,12 @@ bool ContourSimilarity(Drover &DICOM_data,
     if(cc_A.empty()){
         throw std::invalid_argument("No contours selected (A). Cannot continue.");
     }
-    if(cc_A.size() != 1){
-        throw std::invalid_argument("Multiple contour collections selected (A). Refusing to continue.");
-    }
 
     auto cc_B = Whitelist( cc_all, { { "ROIName", ROILabelRegexB },
                                      { "NormalizedROIName", NormalizedROILabelRegexB } } );
     if(cc_B.empty()){
         throw std::invalid_argument("No contours selected (B). Cannot continue.");
     }
-    if(cc_B.size() != 1){
-        throw std::invalid_argument("Multiple contour collections selected (B). Refusing to continue.");
-    }
 
     auto IAs_all = All_IAs( DICOM_data );
     auto IAs = Whitelist( IAs_all, ImageSelectionStr );
@@ -135,41 +143,89 @@ bool ContourSimilarity(Drover &DICOM_data,
         throw std::invalid_argument("Multiple image arrays selected. Cannot continue.");
     }
     auto iap_it = IAs.front();
-    ComputeContourSimilarityUserData ud;
-    ud.Clear();
-    if(!(*iap_it)->imagecoll.Compute_Images( ComputeContourSimilarity, { },
-                                           { cc_A.front(), cc_B.front() }, &ud )){
-        throw std::runtime_error("Unable to compute contour similarity metrics. Cannot continue.");
-    }
-    YLOGINFO("Dice coefficient(A,B) = " << ud.Dice_Coefficient());
-    YLOGINFO("Jaccard coefficient(A,B) = " << ud.Jaccard_Coefficient());
-
-    // Attempt to identify the patient for reporting purposes.
-    std::string patient_ID;
-    if( auto o = cc_A.front().get().contours.front().GetMetadataValueAs<std::string>("PatientID") ){
-        patient_ID = o.value();
-    }else if( auto o = cc_B.front().get().contours.front().GetMetadataValueAs<std::string>("PatientID") ){
-        patient_ID = o.value();
-    }else if( auto o = cc_A.front().get().contours.front().GetMetadataValueAs<std::string>("StudyInstanceUID") ){
-        patient_ID = o.value();
-    }else if( auto o = cc_B.front().get().contours.front().GetMetadataValueAs<std::string>("StudyInstanceUID") ){
-        patient_ID = o.value();
-    }else{
-        patient_ID = "unknown_patient";
-    }
 
-    std::string ROINameA;
-    if( auto o = cc_A.front().get().contours.front().GetMetadataValueAs<std::string>("ROIName") ){
-        ROINameA = o.value();
-    }else{
-        ROINameA = "unknown_roi";
+    // Group the contour collections into ROIs by name and rasterize every distinct ROI once.
+    std::vector<contour_roi_group> rois;
+    const auto index_of = [&](const contour_roi_group &roi) -> size_t {
+        const auto same_collections = [](const contour_roi_group &L, const contour_roi_group &R) -> bool {
+            return std::equal(std::begin(L), std::end(L), std::begin(R), std::end(R),
+                              [](const auto &l, const auto &r){ return &(l.get()) == &(r.get()); });
+        };
+        for(size_t i = 0; i < rois.size(); ++i){
+            if(same_collections(rois[i], roi)) return i;
+        }
+        rois.push_back(roi);
+        return rois.size() - 1;
+    };
+    std::vector<std::pair<size_t, size_t>> pairs;
+    const auto rois_B = Group_Contour_Collections_By_ROIName(cc_B);
+    for(const auto &roi_A : Group_Contour_Collections_By_ROIName(cc_A)){
+        const auto i_A = index_of(roi_A);
+        for(const auto &roi_B : rois_B){
+            pairs.emplace_back( i_A, index_of(roi_B) );
+        }
     }
 
-    std::string ROINameB;
-    if( auto o = cc_B.front().get().contours.front().GetMetadataValueAs<std::string>("ROIName") ){
-        ROINameB = o.value();
-    }else{
-        ROINameB = "unknown_roi";
+    // Overlapping images would count voxels more than once, so they are rejected.
+    const auto imgs = Gather_Non_Overlapping_Images((*iap_it)->imagecoll);
+    YLOGINFO("Rasterizing " << rois.size() << " ROIs onto " << imgs.size() << " images");
+    const auto masks = Rasterize_Contour_Bitmasks(imgs, rois);
+
+    // Evaluate the overlap of all pairs.
+    std::vector<contour_overlap_counts> counts(pairs.size());
+    std::mutex saver_printer;
+    std::exception_ptr failure;
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(size_t n = 0; n < pairs.size(); ++n){
+            wq.submit_task([&,n]() -> void {
+                try{
+                    counts[n] = Count_Bitmask_Overlap( masks[pairs[n].first], masks[pairs[n].second] );
+                }catch(const std::exception &){
+                    std::lock_guard<std::mutex> lock(saver_printer);
+                    if(!failure) failure = std::current_exception();
+                }
+            });
+        }
+    } // Wait for all tasks to complete.
+    if(failure) std::rethrow_exception(failure);
+
+    const auto get_metadata = [](const contour_roi_group &roi,
+                                 const std::string &key) -> std::optional<std::string> {
+        for(const auto &cc_refw : roi){
+            for(const auto &c : cc_refw.get().contours){
+                if(auto o = c.GetMetadataValueAs<std::string>(key)) return o;
+            }
+        }
+        return {};
+    };
+
+    std::stringstream ss;
+    for(size_t n = 0; n < pairs.size(); ++n){
+        const auto &cc_a = rois[pairs[n].first];
+        const auto &cc_b = rois[pairs[n].second];
+
+        // Attempt to identify the patient for reporting purposes.
+        const auto patient_ID = get_metadata(cc_a, "PatientID")
+                       .value_or( get_metadata(cc_b, "PatientID")
+                       .value_or( get_metadata(cc_a, "StudyInstanceUID")
+                       .value_or( get_metadata(cc_b, "StudyInstanceUID")
+                       .value_or( "unknown_patient" ) ) ) );
+        const auto ROINameA = get_metadata(cc_a, "ROIName").value_or("unknown_roi");
+        const auto ROINameB = get_metadata(cc_b, "ROIName").value_or("unknown_roi");
+
+        YLOGINFO("Dice coefficient(" << ROINameA << "," << ROINameB << ") = " << counts[n].Dice_Coefficient());
+        YLOGINFO("Jaccard coefficient(" << ROINameA << "," << ROINameB << ") = " << counts[n].Jaccard_Coefficient());
+
+        ss << UserComment.value_or("") << ","
+           << patient_ID        << ","
+           << ROINameA          << ","
+           << X(ROINameA)       << ","
+           << ROINameB          << ","
+           << X(ROINameB)       << ","
+           << counts[n].Dice_Coefficient() << ","
+           << counts[n].Jaccard_Coefficient()
+           << std::endl;
     }
 
     //Report the findings. 
@@ -202,15 +258,7 @@ bool ContourSimilarity(Drover &DICOM_data,
                << "JaccardSimilarity"
                << std::endl;
         }
-        FO << UserComment.value_or("") << ","
-           << patient_ID        << ","
-           << ROINameA          << ","
-           << X(ROINameA)       << ","
-           << ROINameB          << ","
-           << X(ROINameB)       << ","
-           << ud.Dice_Coefficient() << ","
-           << ud.Jaccard_Coefficient()
-           << std::endl;
+        FO << ss.str();
         FO.flush();
         FO.close();
 
@@ -23,7 +23,7 @@
 #include "YgorStats.h"        //Needed for Stats:: namespace.
 #include "YgorString.h"       //Needed for GetFirstRegex(...)
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
@@ -96,7 +96,7 @@ bool ContourViaGeometry(Drover &DICOM_data,
                           const OperationArgPkg& OptArgs,
                           std::map<std::string, std::string>& /*InvocationMetadata*/,
                           const std::string& FilenameLex){
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto ROILabel = OptArgs.getValueStr("ROILabel").value();
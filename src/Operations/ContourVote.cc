@@ -1,5 +1,6 @@
 //ContourVote.cc - A part of DICOMautomaton 2018. Written by hal clark.
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>            //Needed for exit() calls.
 #include <cstdint>
@@ -11,11 +12,14 @@
 #include <regex>
 #include <stdexcept>
 #include <string>    
+#include <utility>
+#include <vector>
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
+#include "../Contour_Index.h"
 #include "ContourVote.h"
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "YgorMath.h"         //Needed for vec3 class.
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 #include "YgorLog.h"
@@ -133,7 +137,7 @@ bool ContourVote(Drover &DICOM_data,
                    std::map<std::string, std::string>& /*InvocationMetadata*/,
                    const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto WinnerROILabel = OptArgs.getValueStr("WinnerROILabel").value();
@@ -182,48 +186,50 @@ bool ContourVote(Drover &DICOM_data,
         YLOGWARN("No contours participated, so no contours won");
     }
         
+    //Select the criterion and the single contour property it needs.
+    std::function<double(const contour_properties &)> f_distance;
+    uint32_t needed = 0;
     if(!std::isnan( Area )){
-        cop_ROIs.sort( [&](const std::reference_wrapper<contour_of_points<double>> A,
-                           const std::reference_wrapper<contour_of_points<double>> B ){
-                               const auto AA = std::abs(A.get().Get_Signed_Area());
-                               const auto BA = std::abs(B.get().Get_Signed_Area());
-                               return std::abs(Area - AA) < std::abs(Area - BA);
-                      });
+        f_distance = [&](const contour_properties &p){ return std::abs(Area - p.area); };
+        needed = contour_index::property::area;
     }else if(!std::isnan( Perimeter )){
-        cop_ROIs.sort( [&](const std::reference_wrapper<contour_of_points<double>> A,
-                           const std::reference_wrapper<contour_of_points<double>> B ){
-                               const auto AP = A.get().Perimeter();
-                               const auto BP = B.get().Perimeter();
-                               return std::abs(Perimeter - AP) < std::abs(Perimeter - BP);
-                      });
+        f_distance = [&](const contour_properties &p){ return std::abs(Perimeter - p.perimeter); };
+        needed = contour_index::property::perimeter;
     }else if(!std::isnan( CentroidX )){
-        cop_ROIs.sort( [&](const std::reference_wrapper<contour_of_points<double>> A,
-                           const std::reference_wrapper<contour_of_points<double>> B ){
-                               const auto AX = A.get().Centroid().x;
-                               const auto BX = B.get().Centroid().x;
-                               return std::abs(CentroidX - AX) < std::abs(CentroidX - BX);
-                      });
+        f_distance = [&](const contour_properties &p){ return std::abs(CentroidX - p.centroid.x); };
+        needed = contour_index::property::geometry;
     }else if(!std::isnan( CentroidY )){
-        cop_ROIs.sort( [&](const std::reference_wrapper<contour_of_points<double>> A,
-                           const std::reference_wrapper<contour_of_points<double>> B ){
-                               const auto AY = A.get().Centroid().y;
-                               const auto BY = B.get().Centroid().y;
-                               return std::abs(CentroidY - AY) < std::abs(CentroidY - BY);
-                      });
+        f_distance = [&](const contour_properties &p){ return std::abs(CentroidY - p.centroid.y); };
+        needed = contour_index::property::geometry;
     }else if(!std::isnan( CentroidZ )){
-        cop_ROIs.sort( [&](const std::reference_wrapper<contour_of_points<double>> A,
-                           const std::reference_wrapper<contour_of_points<double>> B ){
-                               const auto AZ = A.get().Centroid().z;
-                               const auto BZ = B.get().Centroid().z;
-                               return std::abs(CentroidZ - AZ) < std::abs(CentroidZ - BZ);
-                      });
+        f_distance = [&](const contour_properties &p){ return std::abs(CentroidZ - p.centroid.z); };
+        needed = contour_index::property::geometry;
+    }
+
+    //Compute the needed property once, in parallel, rather than repeatedly within the sort comparator.
+    //
+    // Only the cached properties are needed here, so the index normal is arbitrary.
+    const contour_index cindex(cop_ROIs, vec3<double>(0.0, 0.0, 1.0), 1E-3, -1.0, needed);
+    const auto &props = cindex.properties();
+
+    //Order the contours by their cached score. The sort is stable so ties retain their original order.
+    std::vector<std::pair<double, size_t>> ranked;
+    ranked.reserve(props.size());
+    for(size_t i = 0; i < props.size(); ++i){
+        ranked.emplace_back( (f_distance) ? f_distance(props[i]) : 0.0, i );
+    }
+    if(f_distance){
+        std::stable_sort( std::begin(ranked), std::end(ranked),
+                          [](const std::pair<double, size_t> &A, const std::pair<double, size_t> &B){
+                              return A.first < B.first;
+                          });
     }
 
     //Create a new contour collection from the winning contours.
     contour_collection<double> cc_new;
-    for(auto & cop : cop_ROIs){
+    for(const auto &r : ranked){
         if(static_cast<int64_t>(cc_new.contours.size()) >= WinnerCount) break;
-        cc_new.contours.emplace_back(cop.get());
+        cc_new.contours.emplace_back(props[r.second].contour.get());
     }
 
     //Attach the requested metadata.
@@ -12,7 +12,7 @@
 #include <string>    
 #include <cstdint>
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -76,7 +76,7 @@ bool ContourWholeImages(Drover &DICOM_data,
 
     //-----------------------------------------------------------------------------------------------------------------
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
     const auto NormalizedROILabel = X(ROILabel);
     const int64_t ROINumber = 10001; // TODO: find highest existing and ++ it.
     DICOM_data.Ensure_Contour_Data_Allocated();
@@ -20,7 +20,7 @@
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 #include "YgorLog.h"
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "../Contour_Boolean_Operations.h"
 #include "../Structs.h"
@@ -156,7 +156,7 @@ bool ConvertContoursToMeshes(Drover &DICOM_data,
                                std::map<std::string, std::string>& /*InvocationMetadata*/,
                                const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto NormalizedROILabelRegex = OptArgs.getValueStr("NormalizedROILabelRegex").value();
@@ -24,7 +24,7 @@
 #include "YgorString.h"       //Needed for GetFirstRegex(...)
 #include "YgorMathIOOFF.h"
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
@@ -138,7 +138,7 @@ bool ConvertImageToMeshes(Drover &DICOM_data,
                             std::map<std::string, std::string>& /*InvocationMetadata*/,
                             const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto ImageSelectionStr = OptArgs.getValueStr("ImageSelection").value();
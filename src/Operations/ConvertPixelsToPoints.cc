@@ -16,7 +16,7 @@
 #include <vector>
 #include <cstdint>
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
@@ -101,7 +101,7 @@ bool ConvertPixelsToPoints(Drover &DICOM_data,
                              std::map<std::string, std::string>& /*InvocationMetadata*/,
                              const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto LabelStr = OptArgs.getValueStr("Label").value();
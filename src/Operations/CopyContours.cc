@@ -10,7 +10,7 @@
 #include <stdexcept>
 #include <string>    
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
@@ -56,7 +56,7 @@ bool CopyContours(Drover &DICOM_data,
     const auto ROILabel = OptArgs.getValueStr("ROILabel").value();
 
     //-----------------------------------------------------------------------------------------------------------------
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
     const auto NormalizedROILabel = X(ROILabel);
 
     //Stuff references to all contours into a list. Remember that you can still address specific contours through
@@ -1,15 +1,23 @@
 //DeDuplicateImages.cc - A part of DICOMautomaton 2019. Written by hal clark.
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
 #include <deque>
+#include <exception>
+#include <functional>
 #include <optional>
 #include <iterator>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <regex>
 #include <stdexcept>
 #include <string>    
 #include <cstdint>
+#include <vector>
 
 #include "YgorMisc.h"
 #include "YgorLog.h"
@@ -17,9 +25,88 @@
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
+#include "../Thread_Pool.h"
 
 #include "DeDuplicateImages.h"
 
+namespace {
+
+// Mixes a 64-bit word into a running hash. This is not cryptographically secure, but is fast and sensitive to both
+// the value and order of the words.
+uint64_t mix_hash(uint64_t h, uint64_t w){
+    w *= 0x87C37B91114253D5ULL;
+    w  = (w << 31) | (w >> 33);
+    w *= 0x4CF5AD432745937FULL;
+    h ^= w;
+    h  = (h << 27) | (h >> 37);
+    return h * 5 + 0x52DCE729ULL;
+}
+
+uint64_t hash_bytes(uint64_t h, const void *data, size_t size){
+    const auto *p = static_cast<const unsigned char *>(data);
+    size_t i = 0;
+    for( ; (i + sizeof(uint64_t)) <= size; i += sizeof(uint64_t)){
+        uint64_t w;
+        std::memcpy(&w, p + i, sizeof(w));
+        h = mix_hash(h, w);
+    }
+    uint64_t w = 0;
+    std::memcpy(&w, p + i, size - i);
+    return mix_hash(h, w ^ static_cast<uint64_t>(size));
+}
+
+uint64_t hash_vec3(uint64_t h, const vec3<double> &v){
+    const std::array<double, 3> a = {{ v.x, v.y, v.z }};
+    return hash_bytes(h, a.data(), sizeof(a));
+}
+
+// Fingerprints the geometry and voxel values of a single image.
+uint64_t hash_image(const planar_image<float,double> &img){
+    uint64_t h = 0;
+    const std::array<int64_t, 3> dims = {{ img.rows, img.columns, img.channels }};
+    const std::array<double, 3> spacing = {{ img.pxl_dx, img.pxl_dy, img.pxl_dz }};
+    h = hash_bytes(h, dims.data(), sizeof(dims));
+    h = hash_bytes(h, spacing.data(), sizeof(spacing));
+    h = hash_vec3(h, img.anchor);
+    h = hash_vec3(h, img.offset);
+    h = hash_vec3(h, img.row_unit);
+    h = hash_vec3(h, img.col_unit);
+    return hash_bytes(h, img.data.data(), img.data.size() * sizeof(float));
+}
+
+// Confirms that two image arrays have identical geometry and voxel values. Fingerprints can collide, so they are only
+// used to find candidates.
+bool are_exact_duplicates(const planar_image_collection<float,double> &A, const planar_image_collection<float,double> &B){
+    if(A.images.size() != B.images.size()) return false;
+    const auto same_vec3 = [](const vec3<double> &a, const vec3<double> &b){
+        return (a.x == b.x) && (a.y == b.y) && (a.z == b.z);
+    };
+    return std::equal(std::begin(A.images), std::end(A.images), std::begin(B.images),
+                      [&](const planar_image<float,double> &a, const planar_image<float,double> &b){
+        return (a.rows == b.rows)
+            && (a.columns == b.columns)
+            && (a.channels == b.channels)
+            && (a.pxl_dx == b.pxl_dx)
+            && (a.pxl_dy == b.pxl_dy)
+            && (a.pxl_dz == b.pxl_dz)
+            && same_vec3(a.anchor, b.anchor)
+            && same_vec3(a.offset, b.offset)
+            && same_vec3(a.row_unit, b.row_unit)
+            && same_vec3(a.col_unit, b.col_unit)
+            && std::equal(std::begin(a.data), std::end(a.data), std::begin(b.data), std::end(b.data));
+    });
+}
+
+// Per-image-array quantities needed to identify duplicates. These are computed once for each image array.
+struct image_array_summary {
+    vec3<double> center;
+    double volume = 0.0;
+    Stats::Running_MinMax<float> rmm;
+    uint64_t fingerprint = 0;
+};
+
+} // namespace
+
 OperationDoc OpArgDocDeDuplicateImages(){
     OperationDoc out;
     out.name = "DeDuplicateImages";
@@ -31,6 +118,14 @@ OperationDoc OpArgDocDeDuplicateImages(){
     out.notes.emplace_back(
         "This routine is experimental."
     );
+    out.notes.emplace_back(
+        "Image arrays with identical geometry and voxel values are always considered duplicates."
+        " Otherwise, image arrays are considered duplicates when their centres and volumes are nearly identical and"
+        " their voxel intensity ranges overlap almost entirely."
+    );
+    out.notes.emplace_back(
+        "When duplicates are found, the first image array (in order of selection) is retained."
+    );
 
     out.args.emplace_back();
     out.args.back() = IAWhitelistOpArgDoc();
@@ -53,68 +148,149 @@ bool DeDuplicateImages(Drover &DICOM_data,
     const auto vox_range_overlap_dice_threshold = 0.99; // the minimum acceptable dice similarity of the voxel intensity range.
     //-----------------------------------------------------------------------------------------------------------------
 
-    const auto voxel_intensity_min_max = [](std::shared_ptr<Image_Array> ia){
-        Stats::Running_MinMax<float> rmm;
-        const auto tally_mm = [&rmm](int64_t, int64_t, int64_t, float val) -> void {
-            rmm.Digest(val);
-            return;
-        };
-        ia->imagecoll.apply_to_pixels(tally_mm);
-        return rmm;
-    };
-
     // Gather a list of images to work on.
     auto IAs_all = All_IAs( DICOM_data );
     auto IAs = Whitelist( IAs_all, ImageSelectionStr ); // std::list<std::list<std::shared_ptr<Image_Array>>::iterator>
+    const std::vector< std::list<std::shared_ptr<Image_Array>>::iterator > IA_its(std::begin(IAs), std::end(IAs));
+    const auto N_IAs = IA_its.size();
+
+    // Summarize each image array. Images are fingerprinted individually, in parallel, and then combined in order.
+    std::vector<image_array_summary> summaries(N_IAs);
+    {
+        std::vector<std::vector<uint64_t>> img_hashes(N_IAs);
+        std::vector<std::vector<Stats::Running_MinMax<float>>> img_rmms(N_IAs);
+
+        std::mutex saver_printer;
+        std::exception_ptr failure;
+        {
+            work_queue<std::function<void(void)>> wq;
+            for(size_t i = 0; i < N_IAs; ++i){
+                const auto &imgs = (*IA_its[i])->imagecoll.images;
+                img_hashes[i].resize(imgs.size());
+                img_rmms[i].resize(imgs.size());
+
+                size_t j = 0;
+                for(const auto &img : imgs){
+                    wq.submit_task([&, i, j, img_ptr = &img]() -> void {
+                        try{
+                            img_hashes[i][j] = hash_image(*img_ptr);
+                            for(const auto &val : img_ptr->data) img_rmms[i][j].Digest(val);
+                        }catch(const std::exception &){
+                            std::lock_guard<std::mutex> lock(saver_printer);
+                            if(!failure) failure = std::current_exception();
+                        }
+                    });
+                    ++j;
+                }
+            }
+        } // Wait for all tasks to complete.
+        if(failure) std::rethrow_exception(failure);
+
+        for(size_t i = 0; i < N_IAs; ++i){
+            auto &s = summaries[i];
+            s.center = (*IA_its[i])->imagecoll.center();
+            s.volume = (*IA_its[i])->imagecoll.volume();
+
+            s.fingerprint = mix_hash(0, static_cast<uint64_t>(img_hashes[i].size()));
+            const auto &imgs = (*IA_its[i])->imagecoll.images;
+            auto img_it = std::begin(imgs);
+            for(size_t j = 0; j < img_hashes[i].size(); ++j, ++img_it){
+                s.fingerprint = mix_hash(s.fingerprint, img_hashes[i][j]);
+                if(!img_it->data.empty()){
+                    s.rmm.Digest(img_rmms[i][j].Current_Min());
+                    s.rmm.Digest(img_rmms[i][j].Current_Max());
+                }
+            }
+        }
+    }
+
+    // Compares two image arrays using position, spatial extent, and voxel distribution.
+    const auto are_near_duplicates = [&](const image_array_summary &A, const image_array_summary &B) -> bool {
+        const auto d_center = (A.center - B.center).length();
+        const auto d_volume = std::abs(A.volume - B.volume);
+
+        const auto vox_highest_min = std::max<float>(A.rmm.Current_Min(), B.rmm.Current_Min());
+        const auto vox_lowest_max  = std::min<float>(A.rmm.Current_Max(), B.rmm.Current_Max());
+        const auto vox_range_dice_numer = 2.0 * std::max<double>(0.0, vox_lowest_max - vox_highest_min);
+        const auto vox_range_dice_denom = std::abs(A.rmm.Current_Max() - A.rmm.Current_Min()) 
+                                        + std::abs(B.rmm.Current_Max() - B.rmm.Current_Min());
+        // Constant-valued arrays only overlap if they share the same value.
+        const auto vox_range_dice = (0.0 < vox_range_dice_denom) ? vox_range_dice_numer / vox_range_dice_denom
+                                  : ( (vox_highest_min == vox_lowest_max) ? 1.0 : 0.0 );
+
+        YLOGINFO("About to compare image arrays: "
+              << " d_center = " << d_center
+              << " d_volume = " << d_volume
+              << " vox_range_dice = " << vox_range_dice );
+
+        return (d_center <= d_center_threshold)
+            && (d_volume <= d_volume_threshold)
+            && (vox_range_overlap_dice_threshold <= vox_range_dice);
+    };
+
+    // Retained image arrays are bucketed by fingerprint (for exact duplicates) and by a coarse spatial grid over their
+    // centres (for near-duplicates). Only image arrays in neighbouring grid cells can satisfy the centre criterion, so
+    // each image array is only compared with a handful of candidates.
+    using cell_t = std::array<int64_t, 3>;
+    const auto to_cell = [&](const vec3<double> &c) -> cell_t {
+        return {{ static_cast<int64_t>(std::floor(c.x / d_center_threshold)),
+                  static_cast<int64_t>(std::floor(c.y / d_center_threshold)),
+                  static_cast<int64_t>(std::floor(c.z / d_center_threshold)) }};
+    };
+    std::map<uint64_t, std::vector<size_t>> fingerprints;
+    std::map<cell_t, std::vector<size_t>> spatial_buckets;
 
-    //std::list<std::shared_ptr<Image_Array>> IA_duplicates;
     std::list< std::list<std::shared_ptr<Image_Array>>::iterator > IA_duplicates;
+    for(size_t i = 0; i < N_IAs; ++i){
+        const auto &s = summaries[i];
+
+        bool is_exact_duplicate = false;
+        const auto f_it = fingerprints.find(s.fingerprint);
+        if(f_it != std::end(fingerprints)){
+            for(const auto &k : f_it->second){
+                if(are_exact_duplicates((*IA_its[k])->imagecoll, (*IA_its[i])->imagecoll)){
+                    is_exact_duplicate = true;
+                    break;
+                }
+            }
+        }
+        if(is_exact_duplicate){
+            YLOGINFO("Exact duplicate image array identified");
+            IA_duplicates.push_back( IA_its[i] );
+            continue;
+        }
 
-    // Score each relevant metric for each image array.
-    for(auto iapA_it_it = std::begin(IAs); iapA_it_it != std::end(IAs); ++iapA_it_it){
-        const auto center_A = (*(*iapA_it_it))->imagecoll.center();
-        const auto volume_A = (*(*iapA_it_it))->imagecoll.volume();
-        const auto rmm_A = voxel_intensity_min_max( (*(*iapA_it_it)) );
-
-        for(auto iapB_it_it = std::next(iapA_it_it); iapB_it_it != std::end(IAs);  ){
-            const auto center_B = (*(*iapB_it_it))->imagecoll.center();
-            const auto volume_B = (*(*iapB_it_it))->imagecoll.volume();
-            const auto rmm_B = voxel_intensity_min_max( (*(*iapB_it_it)) );
-
-            // Score the similarity by considering position, spatial extent, and voxel distribution.
-            const auto d_center = (center_A - center_B).length();
-            const auto d_volume = std::abs(volume_A - volume_B);
-
-            //const auto vox_lowest_min  = std::min<double>(rmm_A.Current_Min(), rmm_B.Current_Min());
-            const auto vox_highest_min = std::max<float>(rmm_A.Current_Min(), rmm_B.Current_Min());
-            const auto vox_lowest_max  = std::min<float>(rmm_A.Current_Max(), rmm_B.Current_Max());
-            //const auto vox_highest_max = std::max<double>(rmm_A.Current_Max(), rmm_B.Current_Max());
-            const auto vox_range_dice_numer = 2.0 * std::abs(vox_lowest_max - vox_highest_min);
-            const auto vox_range_dice_denom = std::abs(rmm_A.Current_Max() - rmm_A.Current_Min()) 
-                                            + std::abs(rmm_B.Current_Max() - rmm_B.Current_Min());
-            const auto vox_range_dice = vox_range_dice_numer + vox_range_dice_denom;
-
-YLOGINFO("About to compare image arrays: "
-      << " d_center = " << d_center
-      << " d_volume = " << d_volume
-      << " vox_range_dice = " << vox_range_dice );
-
-            // Check if the pair are duplicates. If so, erase the latter.
-            if( (d_center <= d_center_threshold)
-            &&  (d_volume <= d_volume_threshold)
-            &&  (vox_range_overlap_dice_threshold <= vox_range_dice) ){
-                YLOGINFO("Duplicate image array identified");
-                IA_duplicates.push_back( *iapB_it_it );
-                iapB_it_it = IAs.erase( iapB_it_it );
-            }else{
-                ++iapB_it_it;
+        bool is_duplicate = false;
+        const bool center_is_finite = std::isfinite(s.center.x) && std::isfinite(s.center.y) && std::isfinite(s.center.z);
+        const auto cell = center_is_finite ? to_cell(s.center) : cell_t{{ 0, 0, 0 }};
+        if(center_is_finite){
+            for(int64_t dx = -1; (dx <= 1) && !is_duplicate; ++dx){
+                for(int64_t dy = -1; (dy <= 1) && !is_duplicate; ++dy){
+                    for(int64_t dz = -1; (dz <= 1) && !is_duplicate; ++dz){
+                        const auto it = spatial_buckets.find({{ cell[0] + dx, cell[1] + dy, cell[2] + dz }});
+                        if(it == std::end(spatial_buckets)) continue;
+                        for(const auto &k : it->second){
+                            if(are_near_duplicates(summaries[k], s)){
+                                is_duplicate = true;
+                                break;
+                            }
+                        }
+                    }
+                }
             }
         }
+
+        if(is_duplicate){
+            YLOGINFO("Duplicate image array identified");
+            IA_duplicates.push_back( IA_its[i] );
+        }else{
+            fingerprints[s.fingerprint].push_back(i);
+            if(center_is_finite) spatial_buckets[cell].push_back(i);
+        }
     }
 
     // Delete the duplicate image arrays, leaving only one of the copies.
     for(auto & img_dup_it : IA_duplicates){
-        //DICOM_data.image_data.emplace_back( std::make_shared<Image_Array>( *img_arr ) );
         DICOM_data.image_data.erase( img_dup_it );
     }
 
@@ -14,7 +14,7 @@
 #include "../YgorImages_Functors/Grouping/Misc_Functors.h"
 #include "../YgorImages_Functors/Processing/DecayDoseOverTime.h"
 #include "DecayDoseOverTimeHalve.h"
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "YgorImages.h"
 
 
@@ -67,7 +67,7 @@ bool DecayDoseOverTimeHalve(Drover &DICOM_data,
 
     DecayDoseOverTimeUserData ud;
     ud.model = DecayDoseOverTimeMethod::Halve;
-    ud.channel = 0; // A second channel (added on-the-fly) will be used to store a modification mask.
+    ud.channel = 0;
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto ROILabelRegex = OptArgs.getValueStr("ROILabelRegex").value();
@@ -75,7 +75,7 @@ bool DecayDoseOverTimeHalve(Drover &DICOM_data,
 
     //-----------------------------------------------------------------------------------------------------------------
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //Merge the image arrays if necessary.
     if(DICOM_data.image_data.empty()){
@@ -100,9 +100,8 @@ bool DecayDoseOverTimeHalve(Drover &DICOM_data,
     }
 
     // Perform the dose modification.
-    if(!img_arr_ptr->imagecoll.Process_Images_Parallel( GroupIndividualImages,
-                                                        DecayDoseOverTime,
-                                                        {}, cc_ROIs, &ud )){
+    if(!img_arr_ptr->imagecoll.Compute_Images( DecayDoseOverTime,
+                                               {}, cc_ROIs, &ud )){
         throw std::runtime_error("Unable to decay dose (via halving).");
     }
 
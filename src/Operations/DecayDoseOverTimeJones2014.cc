@@ -16,7 +16,7 @@
 #include "../YgorImages_Functors/Grouping/Misc_Functors.h"
 #include "../YgorImages_Functors/Processing/DecayDoseOverTime.h"
 #include "DecayDoseOverTimeJones2014.h"
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
@@ -145,7 +145,7 @@ bool DecayDoseOverTimeJones2014(Drover &DICOM_data,
 
     DecayDoseOverTimeUserData ud;
     ud.model = DecayDoseOverTimeMethod::Jones_and_Grant_2014; 
-    ud.channel = 0; // A second channel (added on-the-fly) will be used to store a modification mask.
+    ud.channel = 0;
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto ROILabelRegex = OptArgs.getValueStr("ROILabelRegex").value();
@@ -171,7 +171,7 @@ bool DecayDoseOverTimeJones2014(Drover &DICOM_data,
 
     ud.UseMoreConservativeRecovery = std::regex_match(UseMoreConservativeRecovery_str, TrueRegex);
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //Merge the image arrays if necessary.
     if(DICOM_data.image_data.empty()){
@@ -219,9 +219,8 @@ bool DecayDoseOverTimeJones2014(Drover &DICOM_data,
     if(ud.TemporalGapMonths > 36) ud.TemporalGapMonths = 36.0; 
 
     // Perform the dose modification.
-    if(!img_arr_ptr->imagecoll.Process_Images_Parallel( GroupIndividualImages,
-                                                        DecayDoseOverTime,
-                                                        {}, cc_ROIs, &ud )){
+    if(!img_arr_ptr->imagecoll.Compute_Images( DecayDoseOverTime,
+                                               {}, cc_ROIs, &ud )){
         throw std::runtime_error("Unable to decay dose (Jones and Grant 2014 model).");
     }
 
@@ -11,7 +11,7 @@
 #include <stdexcept>
 #include <string>    
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "YgorMisc.h"
 #include "YgorLog.h"
@@ -127,7 +127,7 @@ bool EQDXTable(Drover &DICOM_data,
                std::map<std::string, std::string>& /*InvocationMetadata*/,
                const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto TargetDosePerFraction = std::stod(OptArgs.getValueStr("TargetDosePerFraction").value());
@@ -22,7 +22,7 @@
 #include <boost/interprocess/sync/named_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "YgorFilesDirs.h"    //Needed for Does_File_Exist_And_Can_Be_Read(...), etc..
 #include "YgorImages.h"
@@ -98,6 +98,29 @@ OperationDoc OpArgDocEvaluateDoseVolumeStats(){
     out.args.back().name = "BodyNormalizedROILabelRegex";
     out.args.back().default_val = ".*";
 
+    out.args.emplace_back();
+    out.args.back().name = "DoseBinWidth";
+    out.args.back().desc = "The default bin width of zero retains every voxel dose and computes all quantities exactly."
+                           " If positive, voxel doses are instead accumulated into volume-weighted histograms with this"
+                           " bin width (in the same units as the image voxels, usually Gy), which reduces memory for"
+                           " large ROIs. Means and standard deviations are always exact. Dose percentiles and volume"
+                           " fractions then have an error no larger than the bin width, and model integrands are"
+                           " evaluated at each bin's mean dose.";
+    out.args.back().default_val = "0";
+    out.args.back().expected = true;
+    out.args.back().examples = { "0", "0.001", "0.01", "0.1" };
+
+    out.args.emplace_back();
+    out.args.back().name = "FractionalOccupancy";
+    out.args.back().desc = "Controls whether voxels are weighted by the fraction of their in-plane footprint that is"
+                           " covered by the ROI. If false, voxels are considered wholly within the ROI if their centre"
+                           " is interior. If true, voxels straddling the ROI boundary contribute a partial volume,"
+                           " which improves accuracy for small ROIs on coarse dose grids without needing to supersample.";
+    out.args.back().default_val = "false";
+    out.args.back().expected = true;
+    out.args.back().examples = { "true", "false" };
+    out.args.back().samples = OpArgSamples::Exhaustive;
+
     out.args.emplace_back();
     out.args.back().name = "UserComment";
     out.args.back().desc = "A string that will be inserted into the output file which will simplify merging output"
@@ -129,6 +152,9 @@ bool EvaluateDoseVolumeStats(Drover &DICOM_data,
 
     const auto UserComment = OptArgs.getValueStr("UserComment");
 
+    const auto DoseBinWidth = std::stod( OptArgs.getValueStr("DoseBinWidth").value() );
+    const auto FractionalOccupancyStr = OptArgs.getValueStr("FractionalOccupancy").value();
+
     //-----------------------------------------------------------------------------------------------------------------
     const auto theregex_PTV = Compile_Regex(PTVROILabelRegex);
     const auto thenormalizedregex_PTV = Compile_Regex(PTVNormalizedROILabelRegex);
@@ -136,7 +162,13 @@ bool EvaluateDoseVolumeStats(Drover &DICOM_data,
     const auto theregex_Body = Compile_Regex(BodyROILabelRegex);
     const auto thenormalizedregex_Body = Compile_Regex(BodyNormalizedROILabelRegex);
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
+
+    if(!std::isfinite(DoseBinWidth) || (DoseBinWidth < 0.0)){
+        throw std::invalid_argument("Dose bin width must be non-negative. Cannot continue.");
+    }
+    const auto regex_true = Compile_Regex("^tr?u?e?$");
+    const auto FractionalOccupancy = std::regex_match(FractionalOccupancyStr, regex_true);
 
 
     //Merge the image arrays if necessary.
@@ -204,11 +236,17 @@ bool EvaluateDoseVolumeStats(Drover &DICOM_data,
 
     //Accumulate the voxel intensity distributions.
     AccumulatePixelDistributionsUserData ud_PTV;
+    ud_PTV.retain_voxels = false;
+    ud_PTV.histogram_bin_width = DoseBinWidth;
+    ud_PTV.fractional_occupancy = FractionalOccupancy;
     if(!img_arr_ptr->imagecoll.Compute_Images( AccumulatePixelDistributions, { },
                                                cc_PTV_ROIs, &ud_PTV )){
         throw std::runtime_error("Unable to accumulate PTV pixel distributions.");
     }
     AccumulatePixelDistributionsUserData ud_Body;
+    ud_Body.retain_voxels = false;
+    ud_Body.histogram_bin_width = DoseBinWidth;
+    ud_Body.fractional_occupancy = FractionalOccupancy;
     if(!img_arr_ptr->imagecoll.Compute_Images( AccumulatePixelDistributions, { },
                                                cc_Body_ROIs, &ud_Body )){
         throw std::runtime_error("Unable to accumulate Body pixel distributions.");
@@ -216,46 +254,37 @@ bool EvaluateDoseVolumeStats(Drover &DICOM_data,
 
 
     const auto Dpres95 = 0.95 * PTVPrescriptionDose;
-    int64_t N_Body_over_Dpres95 = 0; //We assume all body ROIs are part of a single object.
+    double N_Body_over_Dpres95 = 0.0; //We assume all body ROIs are part of a single object.
 
     //Evalute the models.
     {
-        for(auto &av : ud_Body.accumulated_voxels){
-            for(const auto &D_voxel : av.second){
-                if(D_voxel > Dpres95) ++N_Body_over_Dpres95;
-            }
-            av.second.clear(); // Reduce memory pressure.
+        for(const auto &h : ud_Body.histograms){
+            N_Body_over_Dpres95 += h.second.Fraction_Above(Dpres95) * h.second.Total_Weight();
         }
     }
 
     std::map<std::string, double> HI; // Heterogeneity index.
     std::map<std::string, double> CN; // Conformity number.
 
-    std::map<std::string, int64_t> N_PTV_over_Dpres95; //We assume all PTV ROIs are distinct.
+    std::map<std::string, double> N_PTV_over_Dpres95; //We assume all PTV ROIs are distinct.
     {
-        for(const auto &av : ud_PTV.accumulated_voxels){
-            const auto lROIname = av.first;
+        for(const auto &h : ud_PTV.histograms){
+            const auto lROIname = h.first;
 
-            const auto D_02 = Stats::Percentile(av.second, 0.98); // D_02 == 98% dose percentile.
-            const auto D_50 = Stats::Percentile(av.second, 0.50);
-            const auto D_98 = Stats::Percentile(av.second, 0.02); // D_98 == 2% dose percentile.
+            const auto D_02 = h.second.Percentile(0.98); // D_02 == 98% dose percentile.
+            const auto D_50 = h.second.Percentile(0.50);
+            const auto D_98 = h.second.Percentile(0.02); // D_98 == 2% dose percentile.
 
             HI[lROIname] = (D_02 - D_98)/D_50;
 
-            int64_t N_over_Dpres95 = 0;
-            for(const auto &D_voxel : av.second){
-                if(D_voxel > Dpres95) ++N_over_Dpres95;
-            }
-            N_PTV_over_Dpres95[lROIname] += N_over_Dpres95;
+            N_PTV_over_Dpres95[lROIname] += h.second.Fraction_Above(Dpres95) * h.second.Total_Weight();
         }
-        for(const auto &av : ud_PTV.accumulated_voxels){
-            const auto lROIname = av.first;
-            const auto N = av.second.size();
-            //const long double V_frac = static_cast<long double>(1) / N; // Fractional volume of a single voxel compared to whole ROI.
+        for(const auto &h : ud_PTV.histograms){
+            const auto lROIname = h.first;
 
-            const auto N_T = static_cast<double>(N);
-            const auto N_T_pres = static_cast<double>(N_PTV_over_Dpres95[lROIname]);
-            const auto N_pres = static_cast<double>(N_Body_over_Dpres95);
+            const auto N_T = h.second.Total_Weight();
+            const auto N_T_pres = N_PTV_over_Dpres95[lROIname];
+            const auto N_pres = N_Body_over_Dpres95;
 
             CN[lROIname] = (N_T_pres * N_T_pres) / (N_T * N_pres);
         }
@@ -296,13 +325,13 @@ bool EvaluateDoseVolumeStats(Drover &DICOM_data,
                    << "VoxelCount"
                    << std::endl;
         }
-        for(const auto &av : ud_PTV.accumulated_voxels){
-            const auto lROIname = av.first;
-            const auto DoseMin = Stats::Min( av.second );
-            const auto DoseMean = Stats::Mean( av.second );
-            const auto DoseMedian = Stats::Median( av.second );
-            const auto DoseMax = Stats::Max( av.second );
-            const auto DoseStdDev = std::sqrt(Stats::Unbiased_Var_Est( av.second ));
+        for(const auto &h : ud_PTV.histograms){
+            const auto lROIname = h.first;
+            const auto DoseMin = h.second.Min();
+            const auto DoseMean = h.second.Mean();
+            const auto DoseMedian = h.second.Median();
+            const auto DoseMax = h.second.Max();
+            const auto DoseStdDev = std::sqrt(h.second.Unbiased_Var_Est());
             const auto HeterogeneityIndex = HI[lROIname];
             const auto ConformityNumber = CN[lROIname];
 
@@ -317,7 +346,7 @@ bool EvaluateDoseVolumeStats(Drover &DICOM_data,
                     << DoseMedian         << ","
                     << DoseMax            << ","
                     << DoseStdDev         << ","
-                    << av.second.size()
+                    << h.second.Voxel_Count()
                     << std::endl;
         }
         FO_tcp.flush();
@@ -22,9 +22,11 @@
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
+#include "../String_Parsing.h"
+#include "../Parameter_Sampling.h"
 #include "../YgorImages_Functors/Compute/AccumulatePixelDistributions.h"
 #include "EvaluateNTCPModels.h"
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "YgorFilesDirs.h"    //Needed for Does_File_Exist_And_Can_Be_Read(...), etc..
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -182,6 +184,74 @@ OperationDoc OpArgDocEvaluateNTCPModels(){
     out.args.back().examples = { "1", "3", "4", "20", "31" };
 
 
+    out.args.emplace_back();
+    out.args.back().name = "DoseBinWidth";
+    out.args.back().desc = "The default bin width of zero retains every voxel dose and computes all quantities exactly."
+                           " If positive, voxel doses are instead accumulated into volume-weighted histograms with this"
+                           " bin width (in the same units as the image voxels, usually Gy), which reduces memory for"
+                           " large ROIs. Means and standard deviations are always exact. Dose percentiles and volume"
+                           " fractions then have an error no larger than the bin width, and model integrands are"
+                           " evaluated at each bin's mean dose.";
+    out.args.back().default_val = "0";
+    out.args.back().expected = true;
+    out.args.back().examples = { "0", "0.001", "0.01", "0.1" };
+
+    out.args.emplace_back();
+    out.args.back().name = "FractionalOccupancy";
+    out.args.back().desc = "Controls whether voxels are weighted by the fraction of their in-plane footprint that is"
+                           " covered by the ROI. If false, voxels are considered wholly within the ROI if their centre"
+                           " is interior. If true, voxels straddling the ROI boundary contribute a partial volume,"
+                           " which improves accuracy for small ROIs on coarse dose grids without needing to supersample.";
+    out.args.back().default_val = "false";
+    out.args.back().expected = true;
+    out.args.back().examples = { "true", "false" };
+    out.args.back().samples = OpArgSamples::Exhaustive;
+
+    out.args.emplace_back();
+    out.args.back().name = "ParameterSamples";
+    out.args.back().desc = "The number of model parameter sets to draw from the distributions given by the"
+                           " ParameterDistributions argument. Each set is evaluated against the same accumulated"
+                           " voxel doses, so uncertainty can be propagated without re-accumulating the dose"
+                           " distributions. Sets are evaluated in parallel and the requested percentiles of each"
+                           " model are appended to the output as additional columns."
+                           " If zero, only the nominal parameters are evaluated and no columns are added."
+                           " Note that the columns are fixed when the output file is first written, so output from"
+                           " invocations with and without sampling (or with differing percentiles) should not be"
+                           " appended to the same file.";
+    out.args.back().default_val = "0";
+    out.args.back().expected = true;
+    out.args.back().examples = { "0", "100", "1000", "10000" };
+
+    out.args.emplace_back();
+    out.args.back().name = "ParameterDistributions";
+    out.args.back().desc = "Distributions from which model parameters are drawn when ParameterSamples is positive."
+                           " Each distribution names a parameter as its first argument. Supported distributions are"
+                           " 'normal(name, mean, sd)', 'lognormal(name, median, geometric_sd)',"
+                           " 'uniform(name, lower, upper)', and 'triangular(name, lower, mode, upper)'."
+                           " Numbers suffixed with 'x' or '%' are relative to the parameter's nominal value,"
+                           " e.g., 'normal(LKB_TD50, 1.0x, 0.1x)' describes a 10% standard deviation about the"
+                           " nominal value. Parameters without a distribution retain their nominal values."
+                           " The parameters that can be sampled are LKB_TD50, LKB_M, and LKB_Alpha.";
+    out.args.back().default_val = "";
+    out.args.back().expected = false;
+    out.args.back().examples = { "normal(LKB_TD50, 26.8, 2.0)",
+                                 "normal(LKB_TD50, 1.0x, 0.1x); uniform(LKB_M, 0.40, 0.50)",
+                                 "lognormal(LKB_Alpha, 1.0, 1.2); triangular(LKB_M, 90%, 100%, 120%)" };
+
+    out.args.emplace_back();
+    out.args.back().name = "SamplePercentiles";
+    out.args.back().desc = "The percentiles of the sampled model outputs to report when ParameterSamples is positive.";
+    out.args.back().default_val = "2.5, 50, 97.5";
+    out.args.back().expected = true;
+    out.args.back().examples = { "50", "2.5, 50, 97.5", "5, 25, 50, 75, 95" };
+
+    out.args.emplace_back();
+    out.args.back().name = "Seed";
+    out.args.back().desc = "The seed value to use for random number generation when sampling model parameters.";
+    out.args.back().default_val = "1337";
+    out.args.back().expected = true;
+    out.args.back().examples = { "1", "1337", "1500450271" };
+
     out.args.emplace_back();
     out.args.back().name = "UserComment";
     out.args.back().desc = "A string that will be inserted into the output file which will simplify merging output"
@@ -211,6 +281,13 @@ bool EvaluateNTCPModels(Drover &DICOM_data,
     const auto LKB_Alpha = std::stod( OptArgs.getValueStr("LKB_Alpha").value() );
 
     const auto UserComment = OptArgs.getValueStr("UserComment");
+    const auto DoseBinWidth = std::stod( OptArgs.getValueStr("DoseBinWidth").value() );
+    const auto FractionalOccupancyStr = OptArgs.getValueStr("FractionalOccupancy").value();
+
+    const auto ParameterSamples = std::stol( OptArgs.getValueStr("ParameterSamples").value() );
+    const auto ParameterDistributionsStr = OptArgs.getValueStr("ParameterDistributions").value();
+    const auto SamplePercentilesStr = OptArgs.getValueStr("SamplePercentiles").value();
+    const auto Seed = std::stol( OptArgs.getValueStr("Seed").value() );
 
 /*
     const auto Gamma50 = std::stod( OptArgs.getValueStr("Gamma50").value() );
@@ -223,7 +300,32 @@ bool EvaluateNTCPModels(Drover &DICOM_data,
 
     //-----------------------------------------------------------------------------------------------------------------
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
+
+    if(!std::isfinite(DoseBinWidth) || (DoseBinWidth < 0.0)){
+        throw std::invalid_argument("Dose bin width must be non-negative. Cannot continue.");
+    }
+    const auto regex_true = Compile_Regex("^tr?u?e?$");
+    const auto FractionalOccupancy = std::regex_match(FractionalOccupancyStr, regex_true);
+
+    if(ParameterSamples < 0){
+        throw std::invalid_argument("The number of parameter samples must be non-negative. Cannot continue.");
+    }
+    const std::map<std::string, double> nominal_params = { { "LKB_TD50", LKB_TD50 },
+                                                           { "LKB_M", LKB_M },
+                                                           { "LKB_Alpha", LKB_Alpha } };
+    const auto param_dists = parse_parameter_distributions(ParameterDistributionsStr, nominal_params);
+    const auto SamplePercentiles = parse_numbers(", ", SamplePercentilesStr);
+    if(0 < ParameterSamples){
+        if(SamplePercentiles.empty()){
+            throw std::invalid_argument("No sample percentiles provided. Cannot continue.");
+        }
+        for(const auto &p : SamplePercentiles){
+            if(!(0.0 <= p) || !(p <= 100.0)){
+                throw std::invalid_argument("Sample percentiles must be within [0:100]. Cannot continue.");
+            }
+        }
+    }
 
     //Merge the image arrays if necessary.
     if(DICOM_data.image_data.empty()){
@@ -258,86 +360,94 @@ bool EvaluateNTCPModels(Drover &DICOM_data,
 
     //Accumulate the voxel intensity distributions.
     AccumulatePixelDistributionsUserData ud;
+    ud.retain_voxels = false;
+    ud.histogram_bin_width = DoseBinWidth;
+    ud.fractional_occupancy = FractionalOccupancy;
     if(!img_arr_ptr->imagecoll.Compute_Images( AccumulatePixelDistributions, { },
                                                cc_ROIs, &ud )){
         throw std::runtime_error("Unable to accumulate pixel distributions.");
     }
 
     //Evalute the models.
-    std::map<std::string, double> LKBModel;
-    std::map<std::string, double> FenwickModel;
-//    std::map<std::string, double> mEUDModel;
-    {
-        for(const auto &av : ud.accumulated_voxels){
-            const auto lROIname = av.first;
-
-            const auto N = av.second.size();
-            const long double V_frac = static_cast<long double>(1) / N; // Fractional volume of a single voxel compared to whole ROI.
-
-            std::vector<double> LKB_gEUD_elements;
-//            std::vector<double> mEUD_elements;
-            LKB_gEUD_elements.reserve(N);
-//            mEUD_elements.reserve(N);
-            for(const auto &D_voxel : av.second){
-                // LKB model.
-                //
-                // Note: Assumes voxel doses are EQD2. Pre-convert if the RT plan is not already in 2Gy/fraction!
-                {
-                    const auto scaled = std::pow(D_voxel, LKB_Alpha); //Problematic for (non-physical) 0.0.
-                    if(std::isfinite(scaled)){
-                        LKB_gEUD_elements.push_back(V_frac * std::pow(D_voxel, LKB_Alpha));
-                    }else{
-                        LKB_gEUD_elements.push_back(0.0); //No real need to include this except acknowledging what we are doing.
-                    }
-                }
-                
-                // mEUD model.
-                //
-                // Note: Assumes voxel doses are EQD2. Pre-convert if the RT plan is not already in 2Gy/fraction!
-                {
+    //
+    // Note: the models assume voxel doses are EQD2. Pre-convert if the RT plan is not already in 2Gy/fraction!
+    //
+    // The integrands are evaluated per histogram bin rather than per voxel. Each voxel contributes in
+    // proportion to its fractional volume of the whole ROI.
+    const auto evaluate_models = [](const std::map<std::string, double> &params,
+                                    const dose_histogram &h) -> std::vector<double> {
+        const auto l_LKB_TD50 = params.at("LKB_TD50");
+        const auto l_LKB_M = params.at("LKB_M");
+        const auto l_LKB_Alpha = params.at("LKB_Alpha");
+
+        // mEUD model.
+        //
 //NOTE: this model only uses the 100c with the highest dose. So sort and filter the voxels before computing mEUD!
 // Also, the model presented by Huang et al. is underspecified in their paper. Check the original for more comprehensive
 // explanation.
-//                    gEUD_elements.push_back(V_frac * std::pow(D_voxel, gEUD_Alpha));
-                }
 
-                // ... other models ...
-                // ...
-
-            }
-
-            //Post-processing.
-            {
-                const auto OAR_mean_dose = Stats::Mean(av.second);
-                const auto numer = OAR_mean_dose - 29.2;
-                const auto denom = 13.1 * std::sqrt(2);
-                const auto t = numer/denom;
-                const auto NTCP_Fenwick = 0.5*(1.0 + std::erf(t));
-                FenwickModel[lROIname] = NTCP_Fenwick;
-            }
-            {
-                const auto LKB_gEUD = std::pow( Stats::Sum(LKB_gEUD_elements), 1.0 / LKB_Alpha );
-
-                const auto numer = LKB_gEUD - LKB_TD50;
-                const auto denom = LKB_M * LKB_TD50 * std::sqrt(2.0);
-                const auto t = numer/denom;
-                const auto NTCP_LKB = 0.5*(1.0 + std::erf(t));
-                LKBModel[lROIname] = NTCP_LKB;
-            }
-            {
+        // ... other models ...
+        // ...
+
+        //Post-processing.
+        double NTCP_Fenwick = 0.0;
+        {
+            const auto OAR_mean_dose = h.Mean();
+            const auto numer = OAR_mean_dose - 29.2;
+            const auto denom = 13.1 * std::sqrt(2);
+            const auto t = numer/denom;
+            NTCP_Fenwick = 0.5*(1.0 + std::erf(t));
+        }
+        double NTCP_LKB = 0.0;
+        {
+            // LKB model.
+            const auto LKB_gEUD_mean = h.Mean_Of([&](double D_voxel) -> double {
+                const auto scaled = std::pow(D_voxel, l_LKB_Alpha); //Problematic for (non-physical) 0.0.
+                return std::isfinite(scaled) ? scaled : 0.0;
+            });
+            const auto LKB_gEUD = std::pow( LKB_gEUD_mean, 1.0 / l_LKB_Alpha );
+
+            const auto numer = LKB_gEUD - l_LKB_TD50;
+            const auto denom = l_LKB_M * l_LKB_TD50 * std::sqrt(2.0);
+            const auto t = numer/denom;
+            NTCP_LKB = 0.5*(1.0 + std::erf(t));
+        }
+        {
 /*
-                const double mEUD = std::pow( Stats::Sum(mEUD_elements), 1.0 / EUD_Alpha );
+            const double mEUD = std::pow( Stats::Sum(mEUD_elements), 1.0 / EUD_Alpha );
 
-                const double numer = std::pow(mEUD, EUD_Gamma50*4);
-                const double denom = numer + std::pow(EUD_TCD50, EUD_Gamma50*4);
-                double NTCP_mEUD = numer/denom; // This is a sigmoid curve.
+            const double numer = std::pow(mEUD, EUD_Gamma50*4);
+            const double denom = numer + std::pow(EUD_TCD50, EUD_Gamma50*4);
+            double NTCP_mEUD = numer/denom; // This is a sigmoid curve.
 
-                mEUDModel[lROIname] = NTCP_mEUD; 
+            mEUDModel[lROIname] = NTCP_mEUD; 
 */
-            }
         }
+        return { NTCP_LKB, NTCP_Fenwick };
+    };
+
+    std::map<std::string, double> LKBModel;
+    std::map<std::string, double> FenwickModel;
+//    std::map<std::string, double> mEUDModel;
+    for(const auto &h : ud.histograms){
+        const auto lROIname = h.first;
+        const auto models = evaluate_models(nominal_params, h.second);
+        LKBModel[lROIname] = models[0];
+        FenwickModel[lROIname] = models[1];
     }
 
+    // Propagate parameter uncertainty by evaluating every sampled parameter set against the same dose distributions.
+    std::map<std::string, std::vector<std::vector<double>>> SampledPercentiles; // key: ROIname.
+    if(0 < ParameterSamples){
+        const auto samples = sample_parameters(nominal_params, param_dists, ParameterSamples, static_cast<uint64_t>(Seed));
+        for(const auto &h : ud.histograms){
+            YLOGINFO("Evaluating " << samples.size() << " parameter samples for ROI '" << h.first << "'");
+            SampledPercentiles[h.first] = summarize_sampled_model(samples,
+                [&](const std::map<std::string, double> &params) -> std::vector<double> {
+                    return evaluate_models(params, h.second);
+                }, SamplePercentiles);
+        }
+    }
 
     //Report the findings. 
     YLOGINFO("Attempting to claim a mutex");
@@ -371,16 +481,23 @@ bool EvaluateNTCPModels(Drover &DICOM_data,
                    << "DoseMedian,"
                    << "DoseMax,"
                    << "DoseStdDev,"
-                   << "VoxelCount"
-                   << std::endl;
+                   << "VoxelCount";
+            if(0 < ParameterSamples){
+                for(const auto &model : { "NTCPLKBModel", "NTCPFenwickModel" }){
+                    for(const auto &p : SamplePercentiles){
+                        FO_tcp << "," << model << "P" << p;
+                    }
+                }
+            }
+            FO_tcp << std::endl;
         }
-        for(const auto &av : ud.accumulated_voxels){
-            const auto lROIname = av.first;
-            const auto DoseMin = Stats::Min( av.second );
-            const auto DoseMean = Stats::Mean( av.second );
-            const auto DoseMedian = Stats::Median( av.second );
-            const auto DoseMax = Stats::Max( av.second );
-            const auto DoseStdDev = std::sqrt(Stats::Unbiased_Var_Est( av.second ));
+        for(const auto &h : ud.histograms){
+            const auto lROIname = h.first;
+            const auto DoseMin = h.second.Min();
+            const auto DoseMean = h.second.Mean();
+            const auto DoseMedian = h.second.Median();
+            const auto DoseMax = h.second.Max();
+            const auto DoseStdDev = std::sqrt(h.second.Unbiased_Var_Est());
             const auto NTCPLKB = LKBModel[lROIname];
 //            const auto NTCPmEUD = mEUDModel[lROIname];
             const auto NTCPFenwick = FenwickModel[lROIname];
@@ -397,8 +514,15 @@ bool EvaluateNTCPModels(Drover &DICOM_data,
                     << DoseMedian        << ","
                     << DoseMax           << ","
                     << DoseStdDev        << ","
-                    << av.second.size()
-                    << std::endl;
+                    << h.second.Voxel_Count();
+            if(0 < ParameterSamples){
+                for(const auto &model_percentiles : SampledPercentiles[lROIname]){
+                    for(const auto &v : model_percentiles){
+                        FO_tcp << "," << v*100.0;
+                    }
+                }
+            }
+            FO_tcp << std::endl;
         }
         FO_tcp.flush();
         FO_tcp.close();
@@ -23,9 +23,11 @@
 #include "../Contour_Collection_Estimates.h"
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
+#include "../String_Parsing.h"
+#include "../Parameter_Sampling.h"
 #include "../YgorImages_Functors/Compute/AccumulatePixelDistributions.h"
 #include "EvaluateTCPModels.h"
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "YgorFilesDirs.h"    //Needed for Does_File_Exist_And_Can_Be_Read(...), etc..
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -218,6 +220,76 @@ OperationDoc OpArgDocEvaluateTCPModels(){
     out.args.back().expected = true;
     out.args.back().examples = { "148410.0" };
 
+    out.args.emplace_back();
+    out.args.back().name = "DoseBinWidth";
+    out.args.back().desc = "The default bin width of zero retains every voxel dose and computes all quantities exactly."
+                           " If positive, voxel doses are instead accumulated into volume-weighted histograms with this"
+                           " bin width (in the same units as the image voxels, usually Gy), which reduces memory for"
+                           " large ROIs. Means and standard deviations are always exact. Dose percentiles and volume"
+                           " fractions then have an error no larger than the bin width, and model integrands are"
+                           " evaluated at each bin's mean dose.";
+    out.args.back().default_val = "0";
+    out.args.back().expected = true;
+    out.args.back().examples = { "0", "0.001", "0.01", "0.1" };
+
+    out.args.emplace_back();
+    out.args.back().name = "FractionalOccupancy";
+    out.args.back().desc = "Controls whether voxels are weighted by the fraction of their in-plane footprint that is"
+                           " covered by the ROI. If false, voxels are considered wholly within the ROI if their centre"
+                           " is interior. If true, voxels straddling the ROI boundary contribute a partial volume,"
+                           " which improves accuracy for small ROIs on coarse dose grids without needing to supersample.";
+    out.args.back().default_val = "false";
+    out.args.back().expected = true;
+    out.args.back().examples = { "true", "false" };
+    out.args.back().samples = OpArgSamples::Exhaustive;
+
+    out.args.emplace_back();
+    out.args.back().name = "ParameterSamples";
+    out.args.back().desc = "The number of model parameter sets to draw from the distributions given by the"
+                           " ParameterDistributions argument. Each set is evaluated against the same accumulated"
+                           " voxel doses, so uncertainty can be propagated without re-accumulating the dose"
+                           " distributions. Sets are evaluated in parallel and the requested percentiles of each"
+                           " model are appended to the output as additional columns."
+                           " If zero, only the nominal parameters are evaluated and no columns are added."
+                           " Note that the columns are fixed when the output file is first written, so output from"
+                           " invocations with and without sampling (or with differing percentiles) should not be"
+                           " appended to the same file.";
+    out.args.back().default_val = "0";
+    out.args.back().expected = true;
+    out.args.back().examples = { "0", "100", "1000", "10000" };
+
+    out.args.emplace_back();
+    out.args.back().name = "ParameterDistributions";
+    out.args.back().desc = "Distributions from which model parameters are drawn when ParameterSamples is positive."
+                           " Each distribution names a parameter as its first argument. Supported distributions are"
+                           " 'normal(name, mean, sd)', 'lognormal(name, median, geometric_sd)',"
+                           " 'uniform(name, lower, upper)', and 'triangular(name, lower, mode, upper)'."
+                           " Numbers suffixed with 'x' or '%' are relative to the parameter's nominal value,"
+                           " e.g., 'normal(Dose50, 1.0x, 0.1x)' describes a 10% standard deviation about the"
+                           " nominal value. Parameters without a distribution retain their nominal values."
+                           " The parameters that can be sampled are Gamma50, Dose50, EUD_Gamma50, EUD_TCD50,"
+                           " EUD_Alpha, Fenwick_C, Fenwick_M, and Fenwick_Vref. Note that Dose50 is shared by the"
+                           " Martel and Fenwick models.";
+    out.args.back().default_val = "";
+    out.args.back().expected = false;
+    out.args.back().examples = { "normal(Dose50, 65.0, 5.0)",
+                                 "normal(Dose50, 1.0x, 0.1x); uniform(Gamma50, 1.5, 2.5)",
+                                 "lognormal(EUD_TCD50, 51.9, 1.1); triangular(EUD_Alpha, -20, -13, -7.2)" };
+
+    out.args.emplace_back();
+    out.args.back().name = "SamplePercentiles";
+    out.args.back().desc = "The percentiles of the sampled model outputs to report when ParameterSamples is positive.";
+    out.args.back().default_val = "2.5, 50, 97.5";
+    out.args.back().expected = true;
+    out.args.back().examples = { "50", "2.5, 50, 97.5", "5, 25, 50, 75, 95" };
+
+    out.args.emplace_back();
+    out.args.back().name = "Seed";
+    out.args.back().desc = "The seed value to use for random number generation when sampling model parameters.";
+    out.args.back().default_val = "1337";
+    out.args.back().expected = true;
+    out.args.back().examples = { "1", "1337", "1500450271" };
+
     out.args.emplace_back();
     out.args.back().name = "UserComment";
     out.args.back().desc = "A string that will be inserted into the output file which will simplify merging output"
@@ -243,6 +315,13 @@ bool EvaluateTCPModels(Drover &DICOM_data,
     const auto NormalizedROILabelRegex = OptArgs.getValueStr("NormalizedROILabelRegex").value();
 
     const auto UserComment = OptArgs.getValueStr("UserComment");
+    const auto DoseBinWidth = std::stod( OptArgs.getValueStr("DoseBinWidth").value() );
+    const auto FractionalOccupancyStr = OptArgs.getValueStr("FractionalOccupancy").value();
+
+    const auto ParameterSamples = std::stol( OptArgs.getValueStr("ParameterSamples").value() );
+    const auto ParameterDistributionsStr = OptArgs.getValueStr("ParameterDistributions").value();
+    const auto SamplePercentilesStr = OptArgs.getValueStr("SamplePercentiles").value();
+    const auto Seed = std::stol( OptArgs.getValueStr("Seed").value() );
 
     const auto Gamma50 = std::stod( OptArgs.getValueStr("Gamma50").value() );
     const auto Dose50 = std::stod( OptArgs.getValueStr("Dose50").value() );
@@ -251,14 +330,43 @@ bool EvaluateTCPModels(Drover &DICOM_data,
     const auto EUD_TCD50 = std::stod( OptArgs.getValueStr("EUD_TCD50").value() );
     const auto EUD_Alpha = std::stod( OptArgs.getValueStr("EUD_Alpha").value() );
 
-    const auto Fenwick_D50 = Dose50; // Shared with Martel model. There may be a slight difference though.
     const auto Fenwick_C = std::stod( OptArgs.getValueStr("Fenwick_C").value() );
     const auto Fenwick_M = std::stod( OptArgs.getValueStr("Fenwick_M").value() );
     const auto Fenwick_Vref = std::stod( OptArgs.getValueStr("Fenwick_Vref").value() );
 
     //-----------------------------------------------------------------------------------------------------------------
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
+
+    if(!std::isfinite(DoseBinWidth) || (DoseBinWidth < 0.0)){
+        throw std::invalid_argument("Dose bin width must be non-negative. Cannot continue.");
+    }
+    const auto regex_true = Compile_Regex("^tr?u?e?$");
+    const auto FractionalOccupancy = std::regex_match(FractionalOccupancyStr, regex_true);
+
+    if(ParameterSamples < 0){
+        throw std::invalid_argument("The number of parameter samples must be non-negative. Cannot continue.");
+    }
+    const std::map<std::string, double> nominal_params = { { "Gamma50", Gamma50 },
+                                                           { "Dose50", Dose50 },
+                                                           { "EUD_Gamma50", EUD_Gamma50 },
+                                                           { "EUD_TCD50", EUD_TCD50 },
+                                                           { "EUD_Alpha", EUD_Alpha },
+                                                           { "Fenwick_C", Fenwick_C },
+                                                           { "Fenwick_M", Fenwick_M },
+                                                           { "Fenwick_Vref", Fenwick_Vref } };
+    const auto param_dists = parse_parameter_distributions(ParameterDistributionsStr, nominal_params);
+    const auto SamplePercentiles = parse_numbers(", ", SamplePercentilesStr);
+    if(0 < ParameterSamples){
+        if(SamplePercentiles.empty()){
+            throw std::invalid_argument("No sample percentiles provided. Cannot continue.");
+        }
+        for(const auto &p : SamplePercentiles){
+            if(!(0.0 <= p) || !(p <= 100.0)){
+                throw std::invalid_argument("Sample percentiles must be within [0:100]. Cannot continue.");
+            }
+        }
+    }
 
     //Merge the image arrays if necessary.
     if(DICOM_data.image_data.empty()){
@@ -300,73 +408,89 @@ bool EvaluateTCPModels(Drover &DICOM_data,
 
     //Accumulate the voxel intensity distributions.
     AccumulatePixelDistributionsUserData ud;
+    ud.retain_voxels = false;
+    ud.histogram_bin_width = DoseBinWidth;
+    ud.fractional_occupancy = FractionalOccupancy;
     if(!img_arr_ptr->imagecoll.Compute_Images( AccumulatePixelDistributions, { },
                                                cc_ROIs, &ud )){
         throw std::runtime_error("Unable to accumulate pixel distributions.");
     }
 
     //Evalute the models.
+    //
+    // The integrands are evaluated per histogram bin rather than per voxel. Each voxel contributes in
+    // proportion to its fractional volume of the whole ROI, so the product of per-voxel TCPs raised to the
+    // fractional volume is the exponential of the volume-weighted mean of the log TCP.
+    const auto evaluate_models = [ROI_V](const std::map<std::string, double> &params,
+                                         const dose_histogram &h) -> std::vector<double> {
+        const auto l_Gamma50 = params.at("Gamma50");
+        const auto l_Dose50 = params.at("Dose50");
+        const auto l_EUD_Gamma50 = params.at("EUD_Gamma50");
+        const auto l_EUD_TCD50 = params.at("EUD_TCD50");
+        const auto l_EUD_Alpha = params.at("EUD_Alpha");
+        const auto l_Fenwick_D50 = l_Dose50; // Shared with Martel model. There may be a slight difference though.
+        const auto l_Fenwick_C = params.at("Fenwick_C");
+        const auto l_Fenwick_M = params.at("Fenwick_M");
+        const auto l_Fenwick_Vref = params.at("Fenwick_Vref");
+
+        // Martel model.
+        const auto TCP_Martel = std::exp( h.Mean_Of([&](double D_voxel) -> double {
+            const auto numer = std::pow(D_voxel, l_Gamma50*4);
+            const auto denom = std::pow(l_Dose50, l_Gamma50*4) + numer;
+            const auto TCP_voxel = numer/denom; // This is a sigmoid curve.
+            return std::log(TCP_voxel);
+        }) );
+
+        // Fenwick model.
+        const auto TCP_Fenwick = std::exp( h.Mean_Of([&](double D_voxel) -> double {
+            const auto numer = (D_voxel - l_Fenwick_D50 - l_Fenwick_C * std::log(ROI_V/l_Fenwick_Vref));
+            const auto denom = l_Fenwick_M * D_voxel * std::sqrt(2.0);
+            //Note: the 'normal distribution function Phi(z)' referred to in Fenwick's paper is
+            // (1/sqrt(2pi))*integral(exp(-x*x/2)dx, -inf, z) == 0.5*(1+erf(z/sqrt(2))).
+            const auto TCP_voxel = 0.5*(1.0 + std::erf(numer/denom)); // This is a sigmoid curve.
+            return std::log(TCP_voxel);
+        }) );
+
+        // ... other models ...
+        // ...
+
+        // gEUD model.
+        double TCP_gEUD = 0.0;
+        {
+            const auto gEUD = h.gEUD(l_EUD_Alpha);
+
+            const auto numer = std::pow(gEUD, l_EUD_Gamma50*4);
+            const auto denom = numer + std::pow(l_EUD_TCD50, l_EUD_Gamma50*4);
+            TCP_gEUD = numer/denom; // This is a sigmoid curve.
+        }
+
+        return { TCP_Martel, TCP_gEUD, TCP_Fenwick };
+    };
+
     std::map<std::string, double> MartelModel;
     std::map<std::string, double> gEUDModel;
     std::map<std::string, double> FenwickModel;
-    {
-        for(const auto &av : ud.accumulated_voxels){
-            const auto lROIname = av.first;
-
-            const auto N = av.second.size();
-            const double V_frac = 1.0 / N; // Fractional volume of a single voxel compared to whole ROI.
-
-            double TCP_Martel = 1.0;
-            double TCP_Fenwick = 1.0;
-
-            std::vector<double> gEUD_elements;
-            gEUD_elements.reserve(N);
-            for(const auto &D_voxel : av.second){
-                // Martel model.
-                {
-                    const auto numer = std::pow(D_voxel, Gamma50*4);
-                    const auto denom = std::pow(Dose50, Gamma50*4) + numer;
-                    const auto TCP_voxel = numer/denom; // This is a sigmoid curve.
-                    TCP_Martel *= std::pow(TCP_voxel, V_frac);
-                }
-                
-                // gEUD model.
-                {
-                    gEUD_elements.push_back(V_frac * std::pow(D_voxel, EUD_Alpha));
-                }
-
-                // Fenwick model.
-                {
-                    const auto numer = (D_voxel - Fenwick_D50 - Fenwick_C * std::log(ROI_V/Fenwick_Vref));
-                    const auto denom = Fenwick_M * D_voxel * std::sqrt(2.0);
-                    //Note: the 'normal distribution function Phi(z)' referred to in Fenwick's paper is
-                    // (1/sqrt(2pi))*integral(exp(-x*x/2)dx, -inf, z) == 0.5*(1+erf(z/sqrt(2))).
-                    const auto TCP_voxel = 0.5*(1.0 + std::erf(numer/denom)); // This is a sigmoid curve.
-                    TCP_Fenwick *= std::pow(TCP_voxel, V_frac);
-                }
-
-                // ... other models ...
-                // ...
-
-            }
-
-            //Post-processing.
-            MartelModel[lROIname] = TCP_Martel;
-            FenwickModel[lROIname] = TCP_Fenwick;
-
-            {
-                const auto gEUD = std::pow( Stats::Sum(gEUD_elements), 1.0 / EUD_Alpha );
-
-                const auto numer = std::pow(gEUD, EUD_Gamma50*4);
-                const auto denom = numer + std::pow(EUD_TCD50, EUD_Gamma50*4);
-                double TCP_gEUD = numer/denom; // This is a sigmoid curve.
+    for(const auto &h : ud.histograms){
+        const auto lROIname = h.first;
+        const auto models = evaluate_models(nominal_params, h.second);
+        MartelModel[lROIname] = models[0];
+        gEUDModel[lROIname] = models[1];
+        FenwickModel[lROIname] = models[2];
+    }
 
-                gEUDModel[lROIname] = TCP_gEUD; 
-            }
+    // Propagate parameter uncertainty by evaluating every sampled parameter set against the same dose distributions.
+    std::map<std::string, std::vector<std::vector<double>>> SampledPercentiles; // key: ROIname.
+    if(0 < ParameterSamples){
+        const auto samples = sample_parameters(nominal_params, param_dists, ParameterSamples, static_cast<uint64_t>(Seed));
+        for(const auto &h : ud.histograms){
+            YLOGINFO("Evaluating " << samples.size() << " parameter samples for ROI '" << h.first << "'");
+            SampledPercentiles[h.first] = summarize_sampled_model(samples,
+                [&](const std::map<std::string, double> &params) -> std::vector<double> {
+                    return evaluate_models(params, h.second);
+                }, SamplePercentiles);
         }
     }
 
-
     //Report the findings. 
     YLOGINFO("Attempting to claim a mutex");
     {
@@ -397,14 +521,21 @@ bool EvaluateTCPModels(Drover &DICOM_data,
                    << "DoseMean,"
                    << "DoseMedian,"
                    << "DoseStdDev,"
-                   << "VoxelCount"
-                   << std::endl;
+                   << "VoxelCount";
+            if(0 < ParameterSamples){
+                for(const auto &model : { "TCPMartelModel", "TCPgEUDModel", "TCPFenwickModel" }){
+                    for(const auto &p : SamplePercentiles){
+                        FO_tcp << "," << model << "P" << p;
+                    }
+                }
+            }
+            FO_tcp << std::endl;
         }
-        for(const auto &av : ud.accumulated_voxels){
-            const auto lROIname = av.first;
-            const auto DoseMean = Stats::Mean( av.second );
-            const auto DoseMedian = Stats::Median( av.second );
-            const auto DoseStdDev = std::sqrt(Stats::Unbiased_Var_Est( av.second ));
+        for(const auto &h : ud.histograms){
+            const auto lROIname = h.first;
+            const auto DoseMean = h.second.Mean();
+            const auto DoseMedian = h.second.Median();
+            const auto DoseStdDev = std::sqrt(h.second.Unbiased_Var_Est());
             const auto TCPMartel = MartelModel[lROIname];
             const auto TCPgEUD = gEUDModel[lROIname];
             const auto TCPFenwick = FenwickModel[lROIname];
@@ -419,7 +550,15 @@ bool EvaluateTCPModels(Drover &DICOM_data,
                     << DoseMean          << ","
                     << DoseMedian        << ","
                     << DoseStdDev        << ","
-                    << av.second.size()  << std::endl;
+                    << h.second.Voxel_Count();
+            if(0 < ParameterSamples){
+                for(const auto &model_percentiles : SampledPercentiles[lROIname]){
+                    for(const auto &v : model_percentiles){
+                        FO_tcp << "," << v*100.0;
+                    }
+                }
+            }
+            FO_tcp << std::endl;
         }
         FO_tcp.flush();
         FO_tcp.close();
@@ -14,6 +14,7 @@
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
+#include "../Write_File.h"
 #include "ExecuteShell.h"
 
 OperationDoc OpArgDocExecuteShell(){
@@ -75,6 +76,9 @@ bool ExecuteShell(Drover &DICOM_data,
 
     //-----------------------------------------------------------------------------------------------------------------
 
+    // The command may access files exported earlier in this script, so ensure they are complete.
+    Flush_Write_Behind();
+
     std::string out;
     auto pipe = popen(CommandStr.c_str(), "r");
     if(pipe == nullptr){
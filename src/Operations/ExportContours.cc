@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <optional>
 #include <fstream>
+#include <functional>
 #include <iterator>
 #include <list>
 #include <map>
@@ -29,6 +30,7 @@
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
 #include "../Thread_Pool.h"
+#include "../Write_File.h"
 #include "../Contour_Collection_File_Loader.h"
 
 #include "ExportContours.h"
@@ -101,18 +103,29 @@ bool ExportContours(Drover &DICOM_data,
 
     // Determine which filename to use.
     const auto FN = Get_Unique_Sequential_Filename(FilenameBaseStr + "_", 6, ".dat");
-    std::fstream FO(FN, std::fstream::out | std::ios::binary);
 
-    if(!Write_Contour_Collections(cc_ROIs, FO)){
-        throw std::runtime_error("Unable to write contours; emitter routine failed. Cannot continue.");
+    auto snapshot = std::make_shared<std::list<contour_collection<double>>>();
+    size_t bytes = 0;
+    for(const auto &cc_refw : cc_ROIs){
+        snapshot->emplace_back( cc_refw.get() );
+        for(const auto &c : snapshot->back().contours) bytes += c.points.size() * sizeof(vec3<double>);
     }
-    FO.flush();
-    if(!FO){
-        throw std::runtime_error("Unable to write contours; stream left in invalid state. Cannot continue.");
-    }
-    FO.close();
 
-    YLOGINFO("Contours written to '" << FN << "'");
+    Write_Behind(FN, bytes, [snapshot, FN](){
+        std::list<std::reference_wrapper<contour_collection<double>>> ccs;
+        for(auto &cc : *snapshot) ccs.emplace_back( std::ref(cc) );
+
+        std::fstream FO(FN, std::fstream::out | std::ios::binary);
+        if(!Write_Contour_Collections(ccs, FO)){
+            throw std::runtime_error("Unable to write contours; emitter routine failed");
+        }
+        FO.flush();
+        if(!FO){
+            throw std::runtime_error("Unable to write contours; stream left in invalid state");
+        }
+        return true;
+    });
+    YLOGINFO("Queued contours for writing to '" << FN << "'");
 
     return true;
 }
@@ -21,7 +21,6 @@
 #include "YgorLog.h"
 #include "YgorStats.h"        //Needed for Stats:: namespace.
 #include "YgorString.h"       //Needed for GetFirstRegex(...)
-#include "YgorImagesIO.h"
 #include "YgorFilesDirs.h"
 
 #include "Explicator.h"       //Needed for Explicator class.
@@ -29,6 +28,8 @@
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
 #include "../Thread_Pool.h"
+#include "../Write_File.h"
+#include "../FITS_File_Loader.h"
 
 #include "ExportFITSImages.h"
 
@@ -38,7 +39,8 @@ OperationDoc OpArgDocExportFITSImages(){
     out.name = "ExportFITSImages";
 
     out.desc = 
-        "This operation writes image arrays to FITS-formatted image files.";
+        "This operation writes image arrays to FITS-formatted image files."
+        " Each image array is written to a single multi-extension FITS file containing one image extension per image.";
 
     out.notes.emplace_back(
         "FITS images support lossless metadata export, but the metadata is embedded in a non-standard (but compliant)"
@@ -46,6 +48,10 @@ OperationDoc OpArgDocExportFITSImages(){
         " metadata."
     );
 
+    out.notes.emplace_back(
+        "Voxels are written as 32-bit floats. Multi-channel images are written with channels along the third axis."
+    );
+
     out.args.emplace_back();
     out.args.back() = IAWhitelistOpArgDoc();
     out.args.back().name = "ImageSelection";
@@ -83,12 +89,14 @@ bool ExportFITSImages(Drover &DICOM_data,
     for(const auto& iap_it : IAs){
         const auto fname = Get_Unique_Sequential_Filename(FilenameBaseStr + "_", 6, ".fits");
 
-        YLOGINFO("Exporting " << (*iap_it)->imagecoll.images.size() << " images to file '" << fname << "' now..");
-        if(WriteToFITS((*iap_it)->imagecoll, fname)){
-            YLOGINFO("Exported image array to file '" << fname << "'");
-        }else{
-            YLOGWARN("Unable to export image array to file '" << fname << "'");
-        }
+        auto snapshot = std::make_shared<const planar_image_collection<float,double>>((*iap_it)->imagecoll);
+        size_t bytes = 0;
+        for(const auto &img : snapshot->images) bytes += img.data.size() * sizeof(float);
+
+        YLOGINFO("Queueing export of " << snapshot->images.size() << " images to file '" << fname << "'");
+        Write_Behind(fname, bytes, [snapshot, fname](){
+            return Write_Images_To_FITS(*snapshot, fname);
+        });
     }
 
     return true;
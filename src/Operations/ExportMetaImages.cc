@@ -0,0 +1,100 @@
+//ExportMetaImages.cc - A part of DICOMautomaton 2026.
+
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <regex>
+#include <stdexcept>
+#include <string>
+
+#include "YgorImages.h"
+#include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
+#include "YgorLog.h"
+#include "YgorString.h"       //Needed for GetFirstRegex(...)
+
+#include "../Structs.h"
+#include "../Regex_Selectors.h"
+#include "../Raw_Volume_IO.h"
+#include "../MetaImage_File_Loader.h"
+
+#include "ExportMetaImages.h"
+
+
+OperationDoc OpArgDocExportMetaImages(){
+    OperationDoc out;
+    out.name = "ExportMetaImages";
+
+    out.desc = 
+        "This operation writes image arrays to MetaImage-formatted image files. Each image array is written to a"
+        " single file containing a regular volume, with the header and voxel data combined.";
+
+    out.notes.emplace_back(
+        "Images must form a regular volume: all images must share the same dimensions, orientation, and voxel spacing,"
+        " and images must be evenly spaced along the slice direction. Images sharing a position are treated as"
+        " separate time points."
+    );
+
+    out.notes.emplace_back(
+        "Voxel data are stored as 32-bit floats. Metadata are not exported."
+    );
+
+    out.args.emplace_back();
+    out.args.back() = IAWhitelistOpArgDoc();
+    out.args.back().name = "ImageSelection";
+    out.args.back().default_val = "last";
+
+    out.args.emplace_back();
+    out.args.back().name = "FilenameBase";
+    out.args.back().desc = "The base filename that images will be written to."
+                           " A sequentially-increasing number and file suffix are appended after the base filename."
+                           " Note that the file type is MetaImage.";
+    out.args.back().default_val = "/tmp/dcma_exportmetaimages";
+    out.args.back().expected = true;
+    out.args.back().examples = { "../somedir/out", 
+                                 "/path/to/some/dir/file_prefix" };
+    out.args.back().mimetype = "application/octet-stream";
+
+    out.args.emplace_back();
+    out.args.back().name = "Compression";
+    out.args.back().desc = "Controls whether voxel data are compressed."
+                           " Compression is lossless, and is performed using multiple threads.";
+    out.args.back().default_val = "none";
+    out.args.back().expected = true;
+    out.args.back().examples = { "none", "zlib" };
+    out.args.back().samples = OpArgSamples::Exhaustive;
+
+    return out;
+}
+
+
+bool ExportMetaImages(Drover &DICOM_data,
+                      const OperationArgPkg& OptArgs,
+                      std::map<std::string, std::string>& /*InvocationMetadata*/,
+                      const std::string& /*FilenameLex*/){
+
+    //---------------------------------------------- User Parameters --------------------------------------------------
+    const auto ImageSelectionStr = OptArgs.getValueStr("ImageSelection").value();
+    const auto FilenameBaseStr = OptArgs.getValueStr("FilenameBase").value();
+    const auto CompressionStr = OptArgs.getValueStr("Compression").value();
+
+    //-----------------------------------------------------------------------------------------------------------------
+    const auto regex_zlib = Compile_Regex("^zl?i?b?$");
+    const auto regex_none = Compile_Regex("^no?n?e?$");
+
+    bool compress = false;
+    if(std::regex_match(CompressionStr, regex_zlib)){
+        compress = true;
+    }else if(std::regex_match(CompressionStr, regex_none)){
+        compress = false;
+    }else{
+        throw std::invalid_argument("Compression argument not understood. Cannot continue.");
+    }
+
+    Export_Image_Arrays_As_Volumes( DICOM_data, ImageSelectionStr, FilenameBaseStr, ".mha",
+        [compress](const planar_image_collection<float,double> &imagecoll, const std::filesystem::path &fname){
+            return Write_Images_To_MetaImage(imagecoll, fname, compress);
+        });
+
+    return true;
+}
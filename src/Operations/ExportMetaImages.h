@@ -0,0 +1,16 @@
+// ExportMetaImages.h.
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "../Structs.h"
+
+
+OperationDoc OpArgDocExportMetaImages();
+
+bool ExportMetaImages(Drover &DICOM_data,
+                      const OperationArgPkg& /*OptArgs*/,
+                      std::map<std::string, std::string>& /*InvocationMetadata*/,
+                      const std::string& /*FilenameLex*/);
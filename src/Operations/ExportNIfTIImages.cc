@@ -0,0 +1,102 @@
+//ExportNIfTIImages.cc - A part of DICOMautomaton 2026.
+
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <regex>
+#include <stdexcept>
+#include <string>
+
+#include "YgorImages.h"
+#include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
+#include "YgorLog.h"
+#include "YgorString.h"       //Needed for GetFirstRegex(...)
+
+#include "../Structs.h"
+#include "../Regex_Selectors.h"
+#include "../Raw_Volume_IO.h"
+#include "../NIfTI_File_Loader.h"
+
+#include "ExportNIfTIImages.h"
+
+
+OperationDoc OpArgDocExportNIfTIImages(){
+    OperationDoc out;
+    out.name = "ExportNIfTIImages";
+
+    out.desc = 
+        "This operation writes image arrays to NIfTI-1-formatted image files. Each image array is written to a single"
+        " file containing a regular volume.";
+
+    out.notes.emplace_back(
+        "Images must form a regular volume: all images must share the same dimensions, orientation, and voxel spacing,"
+        " and images must be evenly spaced along the slice direction. Images sharing a position are treated as"
+        " separate time points."
+    );
+
+    out.notes.emplace_back(
+        "Coordinates are converted from the DICOM patient coordinate system to the NIfTI (i.e., RAS) coordinate system."
+        " Voxel data are stored as 32-bit floats. Multi-channel images are stored as vectors. Metadata are not"
+        " exported, aside from the series description."
+    );
+
+    out.args.emplace_back();
+    out.args.back() = IAWhitelistOpArgDoc();
+    out.args.back().name = "ImageSelection";
+    out.args.back().default_val = "last";
+
+    out.args.emplace_back();
+    out.args.back().name = "FilenameBase";
+    out.args.back().desc = "The base filename that images will be written to."
+                           " A sequentially-increasing number and file suffix are appended after the base filename."
+                           " Note that the file type is NIfTI-1. The suffix is '.nii.gz' when compressed.";
+    out.args.back().default_val = "/tmp/dcma_exportniftiimages";
+    out.args.back().expected = true;
+    out.args.back().examples = { "../somedir/out", 
+                                 "/path/to/some/dir/file_prefix" };
+    out.args.back().mimetype = "application/octet-stream";
+
+    out.args.emplace_back();
+    out.args.back().name = "Compression";
+    out.args.back().desc = "Controls whether voxel data are compressed."
+                           " Compression is lossless, and is performed using multiple threads.";
+    out.args.back().default_val = "none";
+    out.args.back().expected = true;
+    out.args.back().examples = { "none", "gzip" };
+    out.args.back().samples = OpArgSamples::Exhaustive;
+
+    return out;
+}
+
+
+bool ExportNIfTIImages(Drover &DICOM_data,
+                       const OperationArgPkg& OptArgs,
+                       std::map<std::string, std::string>& /*InvocationMetadata*/,
+                       const std::string& /*FilenameLex*/){
+
+    //---------------------------------------------- User Parameters --------------------------------------------------
+    const auto ImageSelectionStr = OptArgs.getValueStr("ImageSelection").value();
+    const auto FilenameBaseStr = OptArgs.getValueStr("FilenameBase").value();
+    const auto CompressionStr = OptArgs.getValueStr("Compression").value();
+
+    //-----------------------------------------------------------------------------------------------------------------
+    const auto regex_gzip = Compile_Regex("^gz?i?p?$");
+    const auto regex_none = Compile_Regex("^no?n?e?$");
+
+    bool compress = false;
+    if(std::regex_match(CompressionStr, regex_gzip)){
+        compress = true;
+    }else if(std::regex_match(CompressionStr, regex_none)){
+        compress = false;
+    }else{
+        throw std::invalid_argument("Compression argument not understood. Cannot continue.");
+    }
+
+    Export_Image_Arrays_As_Volumes( DICOM_data, ImageSelectionStr, FilenameBaseStr, (compress) ? ".nii.gz" : ".nii",
+        [compress](const planar_image_collection<float,double> &imagecoll, const std::filesystem::path &fname){
+            return Write_Images_To_NIfTI(imagecoll, fname, compress);
+        });
+
+    return true;
+}
@@ -0,0 +1,16 @@
+// ExportNIfTIImages.h.
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "../Structs.h"
+
+
+OperationDoc OpArgDocExportNIfTIImages();
+
+bool ExportNIfTIImages(Drover &DICOM_data,
+                       const OperationArgPkg& /*OptArgs*/,
+                       std::map<std::string, std::string>& /*InvocationMetadata*/,
+                       const std::string& /*FilenameLex*/);
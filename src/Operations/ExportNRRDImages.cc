@@ -0,0 +1,100 @@
+//ExportNRRDImages.cc - A part of DICOMautomaton 2026.
+
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <regex>
+#include <stdexcept>
+#include <string>
+
+#include "YgorImages.h"
+#include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
+#include "YgorLog.h"
+#include "YgorString.h"       //Needed for GetFirstRegex(...)
+
+#include "../Structs.h"
+#include "../Regex_Selectors.h"
+#include "../Raw_Volume_IO.h"
+#include "../NRRD_File_Loader.h"
+
+#include "ExportNRRDImages.h"
+
+
+OperationDoc OpArgDocExportNRRDImages(){
+    OperationDoc out;
+    out.name = "ExportNRRDImages";
+
+    out.desc = 
+        "This operation writes image arrays to NRRD-formatted image files. Each image array is written to a single"
+        " file containing a regular volume.";
+
+    out.notes.emplace_back(
+        "Images must form a regular volume: all images must share the same dimensions, orientation, and voxel spacing,"
+        " and images must be evenly spaced along the slice direction. Images sharing a position are treated as"
+        " separate time points."
+    );
+
+    out.notes.emplace_back(
+        "Metadata common to all images are stored as NRRD key/value pairs. Voxel data are stored as 32-bit floats."
+    );
+
+    out.args.emplace_back();
+    out.args.back() = IAWhitelistOpArgDoc();
+    out.args.back().name = "ImageSelection";
+    out.args.back().default_val = "last";
+
+    out.args.emplace_back();
+    out.args.back().name = "FilenameBase";
+    out.args.back().desc = "The base filename that images will be written to."
+                           " A sequentially-increasing number and file suffix are appended after the base filename."
+                           " Note that the file type is NRRD.";
+    out.args.back().default_val = "/tmp/dcma_exportnrrdimages";
+    out.args.back().expected = true;
+    out.args.back().examples = { "../somedir/out", 
+                                 "/path/to/some/dir/file_prefix" };
+    out.args.back().mimetype = "application/octet-stream";
+
+    out.args.emplace_back();
+    out.args.back().name = "Compression";
+    out.args.back().desc = "Controls whether voxel data are compressed."
+                           " Compression is lossless, and is performed using multiple threads.";
+    out.args.back().default_val = "none";
+    out.args.back().expected = true;
+    out.args.back().examples = { "none", "gzip" };
+    out.args.back().samples = OpArgSamples::Exhaustive;
+
+    return out;
+}
+
+
+bool ExportNRRDImages(Drover &DICOM_data,
+                      const OperationArgPkg& OptArgs,
+                      std::map<std::string, std::string>& /*InvocationMetadata*/,
+                      const std::string& /*FilenameLex*/){
+
+    //---------------------------------------------- User Parameters --------------------------------------------------
+    const auto ImageSelectionStr = OptArgs.getValueStr("ImageSelection").value();
+    const auto FilenameBaseStr = OptArgs.getValueStr("FilenameBase").value();
+    const auto CompressionStr = OptArgs.getValueStr("Compression").value();
+
+    //-----------------------------------------------------------------------------------------------------------------
+    const auto regex_gzip = Compile_Regex("^gz?i?p?$");
+    const auto regex_none = Compile_Regex("^no?n?e?$");
+
+    bool compress = false;
+    if(std::regex_match(CompressionStr, regex_gzip)){
+        compress = true;
+    }else if(std::regex_match(CompressionStr, regex_none)){
+        compress = false;
+    }else{
+        throw std::invalid_argument("Compression argument not understood. Cannot continue.");
+    }
+
+    Export_Image_Arrays_As_Volumes( DICOM_data, ImageSelectionStr, FilenameBaseStr, ".nrrd",
+        [compress](const planar_image_collection<float,double> &imagecoll, const std::filesystem::path &fname){
+            return Write_Images_To_NRRD(imagecoll, fname, compress);
+        });
+
+    return true;
+}
@@ -0,0 +1,16 @@
+// ExportNRRDImages.h.
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "../Structs.h"
+
+
+OperationDoc OpArgDocExportNRRDImages();
+
+bool ExportNRRDImages(Drover &DICOM_data,
+                      const OperationArgPkg& /*OptArgs*/,
+                      std::map<std::string, std::string>& /*InvocationMetadata*/,
+                      const std::string& /*FilenameLex*/);
@@ -31,6 +31,7 @@
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
 #include "../Thread_Pool.h"
+#include "../Write_File.h"
 
 #include "ExportPointClouds.h"
 
@@ -87,12 +88,19 @@ bool ExportPointClouds(Drover &DICOM_data,
         // Determine which filename to use.
         const auto FN = Get_Unique_Sequential_Filename(FilenameBaseStr + "_", 6, ".xyz");
 
-        std::fstream FO(FN, std::fstream::out);
-        if(!WritePointSetToXYZ((*pcp_it)->pset, FO) || !FO){
-            throw std::runtime_error("Unable to write point cloud. Cannot continue.");
-        }
-
-        YLOGINFO("Point cloud written to '" << FN << "'");
+        auto snapshot = std::make_shared<const point_set<double>>((*pcp_it)->pset);
+        const auto bytes = snapshot->points.size() * sizeof(decltype(snapshot->points)::value_type)
+                         + snapshot->normals.size() * sizeof(decltype(snapshot->normals)::value_type)
+                         + snapshot->colours.size() * sizeof(decltype(snapshot->colours)::value_type);
+
+        Write_Behind(FN, bytes, [snapshot, FN](){
+            std::fstream FO(FN, std::fstream::out);
+            if(!WritePointSetToXYZ(*snapshot, FO) || !FO){
+                throw std::runtime_error("Unable to write point cloud");
+            }
+            return true;
+        });
+        YLOGINFO("Queued point cloud for writing to '" << FN << "'");
     }
 
     return true;
@@ -31,6 +31,7 @@
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
 #include "../Thread_Pool.h"
+#include "../Write_File.h"
 
 #include "ExportSurfaceMeshesOBJ.h"
 
@@ -109,11 +110,19 @@ bool ExportSurfaceMeshesOBJ(Drover &DICOM_data,
             FN = Get_Unique_Sequential_Filename(suffixless_fullpath + "_", n_of_digit_pads, required_file_extension);
         }
 
-        std::fstream FO(FN, std::fstream::out | std::ios::binary);
-        if(!WriteFVSMeshToOBJ( (*smp_it)->meshes, FO )){
-            throw std::runtime_error("Unable to write surface mesh in OBJ format. Cannot continue.");
-        }
-        YLOGINFO("Surface mesh written to '" << FN << "'");
+        auto snapshot = std::make_shared<const fv_surface_mesh<double, uint64_t>>((*smp_it)->meshes);
+        size_t bytes = snapshot->vertices.size() * sizeof(decltype(snapshot->vertices)::value_type)
+                     + snapshot->vertex_normals.size() * sizeof(decltype(snapshot->vertex_normals)::value_type);
+        for(const auto &f : snapshot->faces) bytes += f.size() * sizeof(uint64_t);
+
+        Write_Behind(FN, bytes, [snapshot, FN](){
+            std::fstream FO(FN, std::fstream::out | std::ios::binary);
+            if(!WriteFVSMeshToOBJ( *snapshot, FO )){
+                throw std::runtime_error("Unable to write surface mesh in OBJ format.");
+            }
+            return true;
+        });
+        YLOGINFO("Queued surface mesh for writing to '" << FN << "'");
     }
 
     return true;
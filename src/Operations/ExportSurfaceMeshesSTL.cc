@@ -31,6 +31,7 @@
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
 #include "../Thread_Pool.h"
+#include "../Write_File.h"
 
 #include "ExportSurfaceMeshesSTL.h"
 
@@ -139,17 +140,25 @@ bool ExportSurfaceMeshesSTL(Drover &DICOM_data,
             FN = Get_Unique_Sequential_Filename(suffixless_fullpath + "_", n_of_digit_pads, required_file_extension);
         }
 
-        std::fstream FO(FN, std::fstream::out | std::ios::binary);
-        if(as_binary){
-            if(!WriteFVSMeshToBinarySTL( (*smp_it)->meshes, FO )){
-                throw std::runtime_error("Unable to write surface mesh in STL format. Cannot continue.");
+        auto snapshot = std::make_shared<const fv_surface_mesh<double, uint64_t>>((*smp_it)->meshes);
+        size_t bytes = snapshot->vertices.size() * sizeof(decltype(snapshot->vertices)::value_type)
+                     + snapshot->vertex_normals.size() * sizeof(decltype(snapshot->vertex_normals)::value_type);
+        for(const auto &f : snapshot->faces) bytes += f.size() * sizeof(uint64_t);
+
+        Write_Behind(FN, bytes, [snapshot, FN, as_binary](){
+            std::fstream FO(FN, std::fstream::out | std::ios::binary);
+            if(as_binary){
+                if(!WriteFVSMeshToBinarySTL( *snapshot, FO )){
+                    throw std::runtime_error("Unable to write surface mesh in STL format.");
+                }
+            }else{
+                if(!WriteFVSMeshToASCIISTL( *snapshot, FO )){
+                    throw std::runtime_error("Unable to write surface mesh in STL format.");
+                }
             }
-        }else{
-            if(!WriteFVSMeshToASCIISTL( (*smp_it)->meshes, FO )){
-                throw std::runtime_error("Unable to write surface mesh in STL format. Cannot continue.");
-            }
-        }
-        YLOGINFO("Surface mesh written to '" << FN << "'");
+            return true;
+        });
+        YLOGINFO("Queued surface mesh for writing to '" << FN << "'");
     }
 
     return true;
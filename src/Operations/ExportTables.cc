@@ -1,6 +1,7 @@
 //ExportTables.cc - A part of DICOMautomaton 2021. Written by hal clark.
 
 #include <deque>
+#include <fstream>
 #include <optional>
 #include <iterator>
 #include <list>
@@ -57,19 +58,38 @@ bool ExportTables(Drover &DICOM_data,
     auto Filename = OptArgs.getValueStr("Filename").value();
 
     //-----------------------------------------------------------------------------------------------------------------
-    auto file_lock = Make_File_Lock("dcma_op_exporttables");
-
-    if(Filename.empty()){
-        Filename = Generate_Unique_tmp_Filename("dcma_exporttables_", ".csv").string();
+    {
+        // Claim the filename while holding the lock, but release it before queueing the write. Appends are
+        // performed later in the background, under the same lock, so concurrent processes do not interleave.
+        auto file_lock = Make_File_Lock("dcma_op_exporttables");
+        if(Filename.empty()){
+            Filename = Generate_Unique_tmp_Filename("dcma_exporttables_", ".csv").string();
+        }
+        std::fstream of(Filename, std::ios::out | std::ios::app | std::ios::binary);
+        if(!of){
+            throw std::runtime_error("Unable to open file '" + Filename + "' for writing. Cannot continue.");
+        }
     }
-    std::fstream of(Filename, std::ios::out | std::ios::app | std::ios::binary);
 
     auto STs_all = All_STs( DICOM_data );
     auto STs = Whitelist( STs_all, TableSelectionStr );
+
+    auto snapshot = std::make_shared<std::list<tables::table2>>();
+    size_t bytes = 0;
     for(auto & stp_it : STs){
-        (*stp_it)->table.write_csv(of);
+        snapshot->emplace_back( (*stp_it)->table );
+        for(const auto &c : snapshot->back().data) bytes += sizeof(c) + c.val.size();
     }
-    of.flush();
+
+    Write_Behind(Filename, bytes, [snapshot, Filename](){
+        auto file_lock = Make_File_Lock("dcma_op_exporttables");
+        std::fstream of(Filename, std::ios::out | std::ios::app | std::ios::binary);
+        for(const auto &t : *snapshot){
+            t.write_csv(of);
+        }
+        of.flush();
+        return static_cast<bool>(of);
+    });
 
     return true;
 }
@@ -67,6 +67,30 @@ OperationDoc OpArgDocExportWarps(){
                                  "/path/to/some/mapping.trans" };
     out.args.back().mimetype = "text/plain";
 
+
+    out.args.emplace_back();
+    out.args.back().name = "FieldPrecision";
+    out.args.back().desc = "Controls the precision used to store vector deformation fields."
+                           " 'Double' retains full precision."
+                           " 'Single' halves the storage requirements, but is lossy; vectors retain roughly 7"
+                           " significant digits, which is normally well below the voxel dimensions."
+                           " This parameter is ignored for other transformations.";
+    out.args.back().default_val = "double";
+    out.args.back().expected = true;
+    out.args.back().examples = { "double", "single" };
+    out.args.back().samples = OpArgSamples::Exhaustive;
+
+
+    out.args.emplace_back();
+    out.args.back().name = "Compression";
+    out.args.back().desc = "Controls whether vector deformation field voxel data are compressed."
+                           " Compression is lossless."
+                           " This parameter is ignored for other transformations.";
+    out.args.back().default_val = "zlib";
+    out.args.back().expected = true;
+    out.args.back().examples = { "zlib", "none" };
+    out.args.back().samples = OpArgSamples::Exhaustive;
+
     return out;
 }
 
@@ -81,8 +105,31 @@ bool ExportWarps(Drover &DICOM_data,
     const auto TFormSelectionStr = OptArgs.getValueStr("TransformSelection").value();
 
     const auto FilenameStr = OptArgs.getValueStr("Filename").value();
+    const auto FieldPrecisionStr = OptArgs.getValueStr("FieldPrecision").value();
+    const auto CompressionStr = OptArgs.getValueStr("Compression").value();
     //-----------------------------------------------------------------------------------------------------------------
 
+    const auto regex_double = Compile_Regex("^do?u?b?l?e?$");
+    const auto regex_single = Compile_Regex("^si?n?g?l?e?$");
+    const auto regex_zlib = Compile_Regex("^zl?i?b?$");
+    const auto regex_none = Compile_Regex("^no?n?e?$");
+
+    deformation_field_write_opts dfwo;
+    if(std::regex_match(FieldPrecisionStr, regex_double)){
+        dfwo.single_precision = false;
+    }else if(std::regex_match(FieldPrecisionStr, regex_single)){
+        dfwo.single_precision = true;
+    }else{
+        throw std::invalid_argument("Field precision argument not understood. Cannot continue.");
+    }
+    if(std::regex_match(CompressionStr, regex_zlib)){
+        dfwo.compress = true;
+    }else if(std::regex_match(CompressionStr, regex_none)){
+        dfwo.compress = false;
+    }else{
+        throw std::invalid_argument("Compression argument not understood. Cannot continue.");
+    }
+
     auto T3s_all = All_T3s( DICOM_data );
     auto T3s = Whitelist( T3s_all, TFormSelectionStr );
     YLOGINFO(T3s.size() << " transformations selected");
@@ -100,9 +147,9 @@ bool ExportWarps(Drover &DICOM_data,
         }
 
         const auto FN_path = std::filesystem::path(FN).replace_extension(".trans");
-        std::fstream FO(FN_path, std::fstream::out);
-        if(!WriteTransform3(*(*t3p_it), FO)){
-             std::runtime_error("Unable to write to file. Cannot continue.");
+        std::fstream FO(FN_path, std::fstream::out | std::fstream::binary);
+        if(!WriteTransform3(*(*t3p_it), FO, dfwo)){
+             throw std::runtime_error("Unable to write to file. Cannot continue.");
         }
     }
  
@@ -24,7 +24,7 @@
 #include "../Regex_Selectors.h"
 #include "../YgorImages_Functors/Compute/Extract_Histograms.h"
 #include "ExtractImageHistograms.h"
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "YgorFilesDirs.h"    //Needed for Does_File_Exist_And_Can_Be_Read(...), etc..
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -113,12 +113,17 @@ OperationDoc OpArgDocExtractImageHistograms(){
                            " The default 'center' considers only the central-most point of each voxel."
                            " There are two corner options that correspond to a 2D projection of the voxel onto the image plane."
                            " The first, 'planar_corner_inclusive', considers a voxel interior if ANY corner is interior."
-                           " The second, 'planar_corner_exclusive', considers a voxel interior if ALL (four) corners are interior.";
+                           " The second, 'planar_corner_exclusive', considers a voxel interior if ALL (four) corners are interior."
+                           " The 'fractional' option weights each voxel by the fraction of its 2D projection onto the"
+                           " image plane that is covered by the ROI(s), so voxels straddling the ROI boundary contribute a"
+                           " partial volume. This is most useful for small ROIs on coarse grids, where it can avoid the"
+                           " need to supersample the image.";
     out.args.back().default_val = "center";
     out.args.back().expected = true;
     out.args.back().examples = { "center", "centre", 
                                  "planar_corner_inclusive", "planar_inc",
-                                 "planar_corner_exclusive", "planar_exc" };
+                                 "planar_corner_exclusive", "planar_exc",
+                                 "fractional" };
     out.args.back().samples = OpArgSamples::Exhaustive;
 
 
@@ -232,6 +237,7 @@ bool ExtractImageHistograms(Drover &DICOM_data,
     const auto regex_centre = Compile_Regex("^cent.*");
     const auto regex_pci = Compile_Regex("^planar_?c?o?r?n?e?r?s?_?inc?l?u?s?i?v?e?$");
     const auto regex_pce = Compile_Regex("^planar_?c?o?r?n?e?r?s?_?exc?l?u?s?i?v?e?$");
+    const auto regex_frac = Compile_Regex("^fr?a?c?t?i?o?n?a?l?$");
 
     const auto regex_ignore = Compile_Regex("^ig?n?o?r?e?$");
     const auto regex_honopps = Compile_Regex("^ho?n?o?u?r?_?o?p?p?o?s?i?t?e?_?o?r?i?e?n?t?a?t?i?o?n?s?$");
@@ -240,7 +246,7 @@ bool ExtractImageHistograms(Drover &DICOM_data,
     const auto regex_separate = Compile_Regex("^se?p?[ea]?r?a?t?e?$");
     const auto regex_combined = Compile_Regex("^co?m?b?i?n?e?d?$");
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     if( std::regex_match(GroupingStr, regex_combined) && !GroupLabelOpt ){
         throw std::invalid_argument("A valid 'GroupLabel' must be provided when 'Grouping'='combined'.");
@@ -306,6 +312,8 @@ bool ExtractImageHistograms(Drover &DICOM_data,
             ud.mutation_opts.inclusivity = Mutate_Voxels_Opts::Inclusivity::Inclusive;
         }else if( std::regex_match(InclusivityStr, regex_pce) ){
             ud.mutation_opts.inclusivity = Mutate_Voxels_Opts::Inclusivity::Exclusive;
+        }else if( std::regex_match(InclusivityStr, regex_frac) ){
+            ud.fractional_occupancy = true;
         }else{
             throw std::invalid_argument("Inclusivity argument '"_s + InclusivityStr + "' is not valid");
         }
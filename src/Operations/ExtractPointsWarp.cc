@@ -16,7 +16,7 @@
 #include <vector>
 #include <cstdint>
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -485,7 +485,7 @@ bool ExtractPointsWarp(Drover &DICOM_data,
                          std::map<std::string, std::string>& /*InvocationMetadata*/,
                          const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto MovingPointSelectionStr = OptArgs.getValueStr("MovingPointSelection").value();
@@ -21,6 +21,9 @@
 #include <filesystem>
 #include <numeric>
 #include <cstdint>
+#include <exception>
+#include <mutex>
+#include <sstream>
 
 #ifdef DCMA_USE_CGAL
 #else
@@ -35,7 +38,7 @@
 #include "YgorStats.h"        //Needed for Stats:: namespace.
 #include "YgorFilesDirs.h"
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "../Insert_Contours.h"
 #include "../Structs.h"
@@ -43,6 +46,7 @@
 #include "../Write_File.h"
 #include "../Thread_Pool.h"
 #include "../Surface_Meshes.h"
+#include "../Texture_Features.h"
 #include "../YgorImages_Functors/Grouping/Misc_Functors.h"
 #include "../YgorImages_Functors/Processing/Partitioned_Image_Voxel_Visitor_Mutator.h"
 
@@ -65,6 +69,11 @@ OperationDoc OpArgDocExtractRadiomicFeatures(){
         " Often removing the highest-frequency components of the contour will help, such as edges that conform"
         " tightly to individual voxels."
     );
+    out.notes.emplace_back(
+        "The maximum diameter (i.e., longest vertex-vertex distance) is evaluated using only the vertices of the"
+        " convex hull of all selected contour vertices. Convex hull volume, area, and solidity are derived from the"
+        " same hull. Solidity is the ratio of the surface mesh volume to the convex hull volume."
+    );
 
 
     out.args.emplace_back();
@@ -87,6 +96,20 @@ OperationDoc OpArgDocExtractRadiomicFeatures(){
     out.args.back().mimetype = "text/csv";
 
 
+    out.args.emplace_back();
+    out.args.back().name = "TextureGreyLevels";
+    out.args.back().desc = "The number of grey levels used to quantise voxel intensities for texture features"
+                           " (i.e., grey level co-occurrence, run-length, and size-zone matrices)."
+                           " Intensities within the ROI are quantised into this many equal-width bins spanning the"
+                           " ROI intensity range."
+                           " Co-occurrence and run-length features are computed for each of the 13 unique 3D"
+                           " directions and then averaged. Size zones use 26-connectivity."
+                           " Set to zero to disable texture features.";
+    out.args.back().default_val = "0";
+    out.args.back().expected = true;
+    out.args.back().examples = { "0", "8", "16", "32", "64" };
+
+
     out.args.emplace_back();
     out.args.back() = IAWhitelistOpArgDoc();
     out.args.back().name = "ImageSelection";
@@ -113,7 +136,7 @@ bool ExtractRadiomicFeatures(Drover &DICOM_data,
                                std::map<std::string, std::string>& /*InvocationMetadata*/,
                                const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     auto FeaturesFileName = OptArgs.getValueStr("FeaturesFileName").value();
@@ -125,6 +148,8 @@ bool ExtractRadiomicFeatures(Drover &DICOM_data,
 
     const auto ImageSelectionStr = OptArgs.getValueStr("ImageSelection").value();
 
+    const auto TextureGreyLevels = std::stol( OptArgs.getValueStr("TextureGreyLevels").value_or("0") );
+
     //-----------------------------------------------------------------------------------------------------------------
 
     //Stuff references to all contours into a list. Remember that you can still address specific contours through
@@ -144,92 +169,248 @@ bool ExtractRadiomicFeatures(Drover &DICOM_data,
     const auto& ROIName = ROINameOpt.value();
 
 
-    // Contour-based features.
+    // Contour-based, convex-hull-based, and surface-mesh-based features are independent of one another and of the
+    // images, so they are computed concurrently. Each feature group writes only to its own streams.
     std::stringstream contours_header;
     std::stringstream contours_report;
+    std::stringstream hull_header;
+    std::stringstream hull_report;
+    std::stringstream smesh_header;
+    std::stringstream smesh_report;
+    double MeshVolume = std::numeric_limits<double>::quiet_NaN();
+    double HullVolume = std::numeric_limits<double>::quiet_NaN();
+
+    std::mutex err_lock;
+    std::exception_ptr err_ptr;
+    const auto capture_errors = [&](const std::function<void(void)> &f){
+        try{
+            f();
+        }catch(const std::exception &){
+            std::lock_guard<std::mutex> lock(err_lock);
+            if(!err_ptr) err_ptr = std::current_exception();
+        }
+        return;
+    };
+
     {
-        double TotalPerimeter = std::numeric_limits<double>::quiet_NaN();
-        double LongestPerimeter = std::numeric_limits<double>::quiet_NaN();
-
-        for(const auto &cc_refw : cc_ROIs){
-            const auto p = cc_refw.get().Perimeter();
-            if(!std::isfinite(TotalPerimeter)){
-                TotalPerimeter = p;
-            }else{
-                TotalPerimeter += p;
-            }
+        work_queue<std::function<void(void)>> wq;
+
+        // Contour-based features.
+        wq.submit_task([&]() -> void {
+            capture_errors([&](){
+                double TotalPerimeter = std::numeric_limits<double>::quiet_NaN();
+                double LongestPerimeter = std::numeric_limits<double>::quiet_NaN();
+
+                for(const auto &cc_refw : cc_ROIs){
+                    const auto p = cc_refw.get().Perimeter();
+                    if(!std::isfinite(TotalPerimeter)){
+                        TotalPerimeter = p;
+                    }else{
+                        TotalPerimeter += p;
+                    }
 
-            const auto pl = cc_refw.get().Longest_Perimeter();
-            if(!std::isfinite(LongestPerimeter)){
-                LongestPerimeter = pl;
-            }else{
-                LongestPerimeter = std::max<double>(LongestPerimeter, pl);
-            }
-        }
-        contours_header << ",TotalPerimeter";
-        contours_report << "," << TotalPerimeter;
-
-        contours_header << ",LongestPerimeter";
-        contours_report << "," << LongestPerimeter;
-
-        double LongestVertVertDistance = -1.0;
-        for(const auto &cc_refw : cc_ROIs){
-            for(const auto &cA : cc_refw.get().contours){
-                for(const auto &vA : cA.points){
-                    for(const auto &cB : cc_refw.get().contours){
-                        for(const auto &vB : cB.points){
-                            const auto dist = vB.distance( vA );
-                            if(dist > LongestVertVertDistance) LongestVertVertDistance = dist;
+                    const auto pl = cc_refw.get().Longest_Perimeter();
+                    if(!std::isfinite(LongestPerimeter)){
+                        LongestPerimeter = pl;
+                    }else{
+                        LongestPerimeter = std::max<double>(LongestPerimeter, pl);
+                    }
+                }
+                contours_header << ",TotalPerimeter";
+                contours_report << "," << TotalPerimeter;
+
+                contours_header << ",LongestPerimeter";
+                contours_report << "," << LongestPerimeter;
+            });
+        });
+
+        // Convex-hull-based features.
+        //
+        // The maximum vertex-vertex distance is always realized by a pair of convex hull vertices, so the hull is
+        // extracted once and only its (typically few) vertices are compared. This avoids comparing every pair of
+        // contour vertices, which is prohibitive for large ROIs.
+        wq.submit_task([&]() -> void {
+            capture_errors([&](){
+                fv_surface_mesh<double, uint64_t> hull;
+                for(const auto &cc_refw : cc_ROIs){
+                    for(const auto &c : cc_refw.get().contours){
+                        for(const auto &p : c.points){
+                            hull.vertices.emplace_back(p);
                         }
                     }
                 }
-            }
-        }
-        contours_header << ",LongestVertexVertexDistance";
-        contours_report << "," << LongestVertVertDistance;
 
-    }
+                // A 3D hull cannot be built from coplanar or collinear vertices (e.g., single-slice ROIs), so these
+                // are detected up front and the hull-based features are reported as NaN.
+                const auto is_degenerate = [](const std::vector<vec3<double>> &verts) -> bool {
+                    if(verts.size() < 4) return true;
+                    const auto &P0 = verts.front();
+                    double max_sq_dist = 0.0;
+                    vec3<double> P1 = P0;
+                    for(const auto &v : verts){
+                        const auto d_sq = v.sq_dist(P0);
+                        if(max_sq_dist < d_sq){
+                            max_sq_dist = d_sq;
+                            P1 = v;
+                        }
+                    }
+                    const auto extent = std::sqrt(max_sq_dist);
+                    const auto eps = 1.0E-9 * extent;
+                    if(extent <= 0.0) return true;
+
+                    const auto L = (P1 - P0).unit();
+                    double max_perp = 0.0;
+                    vec3<double> P2 = P0;
+                    for(const auto &v : verts){
+                        const auto perp = (v - P0).Cross(L).length();
+                        if(max_perp < perp){
+                            max_perp = perp;
+                            P2 = v;
+                        }
+                    }
+                    if(max_perp <= eps) return true; // Collinear.
 
-    // Surface-mesh-based features.
-    std::stringstream smesh_header;
-    std::stringstream smesh_report;
+                    const auto N = (P1 - P0).Cross(P2 - P0).unit();
+                    for(const auto &v : verts){
+                        if(eps < std::abs((v - P0).Dot(N))) return false;
+                    }
+                    return true; // Coplanar.
+                };
+
+                bool hull_is_valid = false;
+                if(!is_degenerate(hull.vertices)){
+                    try{
+                        using vert_vec_t = decltype(std::begin(hull.vertices));
+                        hull.faces = Convex_Hull_3<vert_vec_t,uint64_t>( std::begin(hull.vertices),
+                                                                         std::end(hull.vertices) );
+                        hull_is_valid = !hull.faces.empty();
+                    }catch(const std::exception &e){
+                        YLOGWARN("Unable to compute convex hull: " << e.what());
+                    }
+                }
+                if(hull_is_valid){
+                    hull.remove_disconnected_vertices();
+                    YLOGINFO("Convex hull of " << cc_ROIs.size() << " contour collection(s) has "
+                             << hull.vertices.size() << " vertices and " << hull.faces.size() << " faces");
+                }else{
+                    // Fall back to comparing all vertices directly.
+                    hull.faces.clear();
+                }
+
+                // Antipodal search over the hull vertices, partitioned over threads by the first vertex.
+                double LongestVertVertDistance = -1.0;
+                {
+                    std::mutex dist_lock;
+                    const auto N_verts = static_cast<int64_t>(hull.vertices.size());
+                    const auto N_tasks = std::max<int64_t>(1, std::min<int64_t>(N_verts, 64));
+                    {
+                        work_queue<std::function<void(void)>> wq_diam;
+                        for(int64_t t = 0; t < N_tasks; ++t){
+                            wq_diam.submit_task([&,t]() -> void {
+                                double l_max_sq = -1.0;
+                                for(int64_t i = t; i < N_verts; i += N_tasks){
+                                    const auto &vA = hull.vertices[i];
+                                    for(int64_t j = i + 1; j < N_verts; ++j){
+                                        const auto d_sq = vA.sq_dist(hull.vertices[j]);
+                                        if(l_max_sq < d_sq) l_max_sq = d_sq;
+                                    }
+                                }
+                                if(0.0 <= l_max_sq){
+                                    std::lock_guard<std::mutex> lock(dist_lock);
+                                    LongestVertVertDistance = std::max(LongestVertVertDistance, std::sqrt(l_max_sq));
+                                }
+                            });
+                        }
+                    } // Wait for all tasks to complete.
+                    if(LongestVertVertDistance < 0.0) LongestVertVertDistance = (N_verts == 0) ? -1.0 : 0.0;
+                }
+                hull_header << ",LongestVertexVertexDistance";
+                hull_report << "," << LongestVertVertDistance;
+
+                // Hull volume and area via a fan triangulation of each face, using the vertex centroid as the apex of
+                // each tetrahedron. Orientation is not assumed since the centroid is interior to the hull.
+                double V = std::numeric_limits<double>::quiet_NaN();
+                double A = std::numeric_limits<double>::quiet_NaN();
+                if(hull_is_valid){
+                    V = 0.0;
+                    A = 0.0;
+                    vec3<double> centroid(0.0, 0.0, 0.0);
+                    for(const auto &v : hull.vertices) centroid += v;
+                    centroid /= static_cast<double>(hull.vertices.size());
+
+                    for(const auto &f : hull.faces){
+                        if(f.size() < 3) continue;
+                        const auto &P0 = hull.vertices.at(f[0]);
+                        for(size_t k = 1; (k + 1) < f.size(); ++k){
+                            const auto &P1 = hull.vertices.at(f[k]);
+                            const auto &P2 = hull.vertices.at(f[k + 1]);
+                            const auto n = (P1 - P0).Cross(P2 - P0);
+                            A += 0.5 * n.length();
+                            V += std::abs( (P0 - centroid).Dot(n) ) / 6.0;
+                        }
+                    }
+                }
+                HullVolume = V;
+
+                hull_header << ",ConvexHullVolume";
+                hull_report << "," << V;
+
+                hull_header << ",ConvexHullSurfaceArea";
+                hull_report << "," << A;
+            });
+        });
+
+        // Surface-mesh-based features.
+        wq.submit_task([&]() -> void {
+            capture_errors([&](){
+                auto meshing_params = dcma_surface_meshes::Parameters();
+                auto fv_mesh = dcma_surface_meshes::Estimate_Surface_Mesh_Marching_Cubes( 
+                                                                cc_ROIs, meshing_params );
+                auto smesh = dcma_surface_meshes::FVSMeshToPolyhedron(fv_mesh);
+
+                //if(!polyhedron_processing::SaveAsOFF(smesh, "/tmp/test.off")){
+                //    YLOGERR("Unable to write mesh as OFF file");
+                //}
+
+                //polyhedron_processing::Subdivide(smesh, MeshSubdivisions);
+                //polyhedron_processing::Simplify(smesh, MeshSimplificationEdgeCountLimit);
+                //polyhedron_processing::SaveAsOFF(smesh, base_dir + "_polyhedron.off");
+
+                const auto V = polyhedron_processing::Volume(smesh);
+                smesh_header << ",MeshVolume";
+                smesh_report << "," << V;
+                MeshVolume = V;
+
+                const auto A = polyhedron_processing::SurfaceArea(smesh);
+                smesh_header << ",MeshSurfaceArea";
+                smesh_report << "," << A;
+
+                const auto SA_V = A/V;
+                smesh_header << ",MeshSurfaceAreaVolumeRatio";
+                smesh_report << "," << SA_V;
+
+                const auto pi = std::acos(-1.0);
+                const auto Sph = std::pow(36.0 * pi * V * V, 1.0/3.0)/A;
+                smesh_header << ",MeshSphericity";
+                smesh_report << "," << Sph;
+
+                const auto C = V/std::sqrt( pi * std::pow(A, 3.0) );
+                smesh_header << ",MeshCompactness";
+                smesh_report << "," << C;
+            });
+        });
+    } // Wait for all feature groups to complete.
+
+    if(err_ptr) std::rethrow_exception(err_ptr);
+
+    // Features that combine the hull and the mesh.
     {
-        auto meshing_params = dcma_surface_meshes::Parameters();
-        auto fv_mesh = dcma_surface_meshes::Estimate_Surface_Mesh_Marching_Cubes( 
-                                                        cc_ROIs, meshing_params );
-        auto smesh = dcma_surface_meshes::FVSMeshToPolyhedron(fv_mesh);
-
-        //if(!polyhedron_processing::SaveAsOFF(smesh, "/tmp/test.off")){
-        //    YLOGERR("Unable to write mesh as OFF file");
-        //}
-
-        //polyhedron_processing::Subdivide(smesh, MeshSubdivisions);
-        //polyhedron_processing::Simplify(smesh, MeshSimplificationEdgeCountLimit);
-        //polyhedron_processing::SaveAsOFF(smesh, base_dir + "_polyhedron.off");
-
-        const auto V = polyhedron_processing::Volume(smesh);
-        smesh_header << ",MeshVolume";
-        smesh_report << "," << V;
-
-        const auto A = polyhedron_processing::SurfaceArea(smesh);
-        smesh_header << ",MeshSurfaceArea";
-        smesh_report << "," << A;
-
-        const auto SA_V = A/V;
-        smesh_header << ",MeshSurfaceAreaVolumeRatio";
-        smesh_report << "," << SA_V;
-
-        const auto pi = std::acos(-1.0);
-        const auto Sph = std::pow(36.0 * pi * V * V, 1.0/3.0)/A;
-        smesh_header << ",MeshSphericity";
-        smesh_report << "," << Sph;
-
-        const auto C = V/std::sqrt( pi * std::pow(A, 3.0) );
-        smesh_header << ",MeshCompactness";
-        smesh_report << "," << C;
+        // Solidity is the fraction of the convex hull occupied by the ROI.
+        const auto Solidity = MeshVolume / HullVolume;
+        smesh_header << ",MeshSolidity";
+        smesh_report << "," << Solidity;
     }
 
-
     std::mutex common_access;
     std::stringstream header;
     std::stringstream report;
@@ -516,10 +697,36 @@ bool ExtractRadiomicFeatures(Drover &DICOM_data,
         }
 
 
+        // Texture features.
+        if(0 < TextureGreyLevels){
+            std::list<std::reference_wrapper<planar_image<float,double>>> imgs;
+            for(auto &img : (*iap_it)->imagecoll.images) imgs.emplace_back( std::ref(img) );
+
+            // Texture features are optional, so failures are reported but do not abort the other features. The
+            // texture columns are still emitted (as NaN) so the CSV schema does not depend on whether extraction
+            // succeeded.
+            std::vector<std::pair<std::string, double>> features;
+            try{
+                const auto vol = Quantise_Texture_Volume( imgs, cc_ROIs, TextureGreyLevels );
+                const auto tm = Compute_Texture_Matrices( vol );
+                features = Compute_Texture_Features( tm, vol.count_roi_voxels() );
+            }catch(const std::exception &e){
+                YLOGWARN("Unable to extract texture features, reporting them as NaN: " << e.what());
+                features = Compute_Texture_Features( texture_matrices(), 0 );
+            }
+            for(const auto &f : features){
+                header << "," << f.first;
+                report << "," << f.second;
+            }
+        }
+
         // Add the contour- and surface-mesh-based features.
         header << contours_header.str();
         report << contours_report.str();
 
+        header << hull_header.str();
+        report << hull_report.str();
+
         header << smesh_header.str();
         report << smesh_report.str();
 
@@ -0,0 +1,41 @@
+//FlushExports.cc - A part of DICOMautomaton 2026.
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>    
+
+#include "../Structs.h"
+#include "../Write_File.h"
+
+#include "FlushExports.h"
+
+
+OperationDoc OpArgDocFlushExports(){
+    OperationDoc out;
+    out.name = "FlushExports";
+
+    out.desc = 
+        "This operation waits until all pending file exports have been written to disk."
+        " Several export operations (e.g., ExportFITSImages, ExportSurfaceMeshes, ExportPointClouds, ExportTables,"
+        " ExportContours, and BoostSerializeDrover) write files in the background from a snapshot of the selected"
+        " data, so they return before the files are complete. This operation acts as a barrier, and reports any"
+        " errors encountered while writing.";
+
+    out.notes.emplace_back(
+        "Pending exports are also flushed automatically at the end of a script, before external programs are"
+        " invoked, and before files are loaded. This operation is only needed when exported files must be complete"
+        " at a specific point, e.g., before they are accessed by another process."
+    );
+
+    return out;
+}
+
+bool FlushExports(Drover&,
+                  const OperationArgPkg&,
+                  std::map<std::string, std::string>&,
+                  const std::string& ){
+
+    Flush_Write_Behind();
+    return true;
+}
@@ -30,6 +30,7 @@
 #include "../Regex_Selectors.h"
 #include "../Thread_Pool.h"
 #include "../Operation_Dispatcher.h"
+#include "../Write_File.h"
 
 #include "Fork.h"
 
@@ -79,6 +80,10 @@ bool Fork(Drover &DICOM_data,
     auto children = OptArgs.getChildren();
 
 #if !defined(_WIN32) && !defined(_WIN64)
+    // Complete any pending background writes so the child does not inherit a partially-written queue, which would
+    // have no worker thread in the child.
+    Flush_Write_Behind();
+
     auto pid = fork();
     if(pid == -1){ // Parent process.
         throw std::runtime_error("Unable to fork");
@@ -90,6 +95,12 @@ bool Fork(Drover &DICOM_data,
         if(!Operation_Dispatcher(DICOM_data, InvocationMetadata, FilenameLex, children)){
             YLOGERR("Forked child operations failed");
         }
+        // Static destructors may not run, so pending writes must be completed explicitly.
+        try{
+            Flush_Write_Behind();
+        }catch(const std::exception &e){
+            YLOGWARN(e.what());
+        }
 #if defined(DCMA_CPPSTDLIB_HAS_QUICK_EXIT)
         std::quick_exit(EXIT_SUCCESS);
 #else
@@ -108,6 +119,8 @@ bool Fork(Drover &DICOM_data,
             // Issue a warning, but carry on since terminating here will also terminate the parent process.
             YLOGWARN("Forked child operations failed");
         }
+        // The write-behind queue is shared with the parent, so it is not flushed here; flushing would consume (and
+        // merely warn about) failures belonging to the parent. The parent's next flush reports all failures instead.
         return;
     };
     std::thread t(task, DICOM_data.Deep_Copy(), 
@@ -15,7 +15,7 @@
 #include <utility>            //Needed for std::pair.
 #include <vector>
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -75,7 +75,7 @@ bool GenerateMeshes(Drover &DICOM_data,
                     std::map<std::string, std::string>& /*InvocationMetadata*/,
                     const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto ObjectsStr = OptArgs.getValueStr("Objects").value();
@@ -9,7 +9,7 @@
 #include <string>    
 #include <cstdint>
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -36,7 +36,7 @@ bool GenerateVirtualDataImageSphereV1(Drover &DICOM_data,
                                         std::map<std::string, std::string>& /*InvocationMetadata*/,
                                         const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     using loaded_imgs_storage_t = decltype(DICOM_data.image_data);
     std::list<loaded_imgs_storage_t> loaded_imgs_storage;
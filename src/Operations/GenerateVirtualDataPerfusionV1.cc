@@ -17,7 +17,7 @@
 #include "YgorLog.h"
 #include "YgorString.h"       //Needed for GetFirstRegex(...)
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "../Imebra_Shim.h"
 #include "../Structs.h"
@@ -41,7 +41,7 @@ bool GenerateVirtualDataPerfusionV1(Drover &DICOM_data,
                                       std::map<std::string, std::string>& /*InvocationMetadata*/,
                                       const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     using loaded_imgs_storage_t = decltype(DICOM_data.image_data);
     std::list<loaded_imgs_storage_t> loaded_imgs_storage;
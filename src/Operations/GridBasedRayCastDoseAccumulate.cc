@@ -1,6 +1,7 @@
 //GridBasedRayCastDoseAccumulate.cc - A part of DICOMautomaton 2015, 2016. Written by hal clark.
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstdlib>            //Needed for exit() calls.
 #include <any>
@@ -15,9 +16,11 @@
 #include <regex>
 #include <stdexcept>
 #include <string>    
+#include <utility>
+#include <vector>
 #include <cstdint>
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "YgorFilesDirs.h"    //Needed for Does_File_Exist_And_Can_Be_Read(...), etc..
 #include "YgorImages.h"
@@ -36,6 +39,150 @@
 #include "GridBasedRayCastDoseAccumulate.h"
 
 
+// A dense, rectilinear voxel mask used for exact ray traversal.
+//
+// Voxel (k, r, c) spans [k, k+1) x [r, r+1) x [c, c+1) in grid coordinates, where voxel centres are the image voxel
+// positions.
+struct rectilinear_mask {
+    vec3<double> origin;             // Corner of voxel (0, 0, 0).
+    std::array<vec3<double>, 3> axes; // Unit vectors along increasing (image, row, column).
+    std::array<double, 3> spacing = {{ 0.0, 0.0, 0.0 }};
+    std::array<int64_t, 3> dims = {{ 0, 0, 0 }};
+    std::vector<uint8_t> voxels;
+
+    uint8_t value(const std::array<int64_t, 3> &idx) const {
+        return this->voxels[ static_cast<size_t>((idx[0] * this->dims[1] + idx[1]) * this->dims[2] + idx[2]) ];
+    }
+};
+
+static rectilinear_mask
+make_rectilinear_mask(const planar_image_collection<float,double> &imagecoll,
+                      float mask_val){
+    if(imagecoll.images.empty()){
+        throw std::invalid_argument("No mask images provided");
+    }
+
+    std::vector<const planar_image<float,double>*> imgs;
+    for(const auto &img : imagecoll.images) imgs.push_back(&img);
+
+    const auto &first = *(imgs.front());
+    const auto normal = first.row_unit.Cross(first.col_unit).unit();
+    std::sort(std::begin(imgs), std::end(imgs), [&](const planar_image<float,double> *A,
+                                                    const planar_image<float,double> *B){
+        return (A->position(0,0).Dot(normal) < B->position(0,0).Dot(normal));
+    });
+
+    rectilinear_mask out;
+    const auto &base = *(imgs.front());
+    out.axes = {{ normal, base.row_unit.unit(), base.col_unit.unit() }};
+    out.dims = {{ static_cast<int64_t>(imgs.size()), base.rows, base.columns }};
+    out.spacing[1] = base.pxl_dx;
+    out.spacing[2] = base.pxl_dy;
+    out.spacing[0] = base.pxl_dz;
+    if(1 < imgs.size()){
+        const auto span = (imgs.back()->position(0,0) - base.position(0,0)).Dot(normal);
+        out.spacing[0] = span / static_cast<double>(imgs.size() - 1);
+    }
+    if( !(0.0 < out.spacing[0]) || !(0.0 < out.spacing[1]) || !(0.0 < out.spacing[2]) ){
+        throw std::runtime_error("Mask grid has invalid voxel dimensions");
+    }
+    out.origin = base.position(0,0) - out.axes[0] * (0.5 * out.spacing[0])
+                                    - out.axes[1] * (0.5 * out.spacing[1])
+                                    - out.axes[2] * (0.5 * out.spacing[2]);
+
+    out.voxels.resize(static_cast<size_t>(out.dims[0] * out.dims[1] * out.dims[2]), 0);
+    for(int64_t k = 0; k < out.dims[0]; ++k){
+        const auto &img = *(imgs[k]);
+        if( (img.rows != base.rows) || (img.columns != base.columns)
+        ||  (std::abs(img.row_unit.Dot(base.row_unit) - 1.0) > 1.0E-6)
+        ||  (std::abs(img.col_unit.Dot(base.col_unit) - 1.0) > 1.0E-6) ){
+            throw std::runtime_error("Mask grid images are not rectilinear");
+        }
+        for(int64_t r = 0; r < img.rows; ++r){
+            for(int64_t c = 0; c < img.columns; ++c){
+                if(img.value(r, c, 0) == mask_val){
+                    out.voxels[ static_cast<size_t>((k * out.dims[1] + r) * out.dims[2] + c) ] = 1;
+                }
+            }
+        }
+    }
+    return out;
+}
+
+// Visits every voxel crossed by the ray segment from A to B using the Amanatides-Woo 3D-DDA, passing the voxel index
+// and the entry and exit distances (measured from A) to the functor. Each voxel is visited exactly once, in order,
+// and the path lengths sum to the length of the segment within the grid.
+static void
+traverse_voxels(const rectilinear_mask &grid,
+                const vec3<double> &A,
+                const vec3<double> &B,
+                const std::function<void(const std::array<int64_t,3> &, double, double)> &f){
+    const auto length = A.distance(B);
+    if(!(0.0 < length)) return;
+    const auto dir = (B - A) / length;
+
+    // Ray in continuous grid coordinates: q(t) = q0 + v*t.
+    std::array<double, 3> q0;
+    std::array<double, 3> v;
+    double t_enter = 0.0;
+    double t_exit = length;
+    const double inf = std::numeric_limits<double>::infinity();
+    for(size_t i = 0; i < 3; ++i){
+        q0[i] = (A - grid.origin).Dot(grid.axes[i]) / grid.spacing[i];
+        v[i]  = dir.Dot(grid.axes[i]) / grid.spacing[i];
+        const auto n = static_cast<double>(grid.dims[i]);
+        if(std::abs(v[i]) < 1.0E-12){
+            v[i] = 0.0;
+            if( (q0[i] < 0.0) || (n <= q0[i]) ) return; // Parallel and outside of the grid.
+            continue;
+        }
+        const auto t_a = (0.0 - q0[i]) / v[i];
+        const auto t_b = (n - q0[i]) / v[i];
+        t_enter = std::max(t_enter, std::min(t_a, t_b));
+        t_exit  = std::min(t_exit,  std::max(t_a, t_b));
+    }
+    if(t_exit <= t_enter) return;
+
+    std::array<int64_t, 3> idx;
+    std::array<int64_t, 3> step;
+    std::array<double, 3> t_max;
+    std::array<double, 3> t_delta;
+    const auto t_mid = 0.5 * (t_enter + std::min(t_exit, t_enter + 1.0E-9));
+    for(size_t i = 0; i < 3; ++i){
+        const auto q = q0[i] + v[i] * t_mid;
+        idx[i] = std::clamp<int64_t>(static_cast<int64_t>(std::floor(q)), 0, grid.dims[i] - 1);
+        if(0.0 < v[i]){
+            step[i] = 1;
+            t_max[i] = (static_cast<double>(idx[i] + 1) - q0[i]) / v[i];
+            t_delta[i] = 1.0 / v[i];
+        }else if(v[i] < 0.0){
+            step[i] = -1;
+            t_max[i] = (static_cast<double>(idx[i]) - q0[i]) / v[i];
+            t_delta[i] = -1.0 / v[i];
+        }else{
+            step[i] = 0;
+            t_max[i] = inf;
+            t_delta[i] = inf;
+        }
+    }
+
+    double t = t_enter;
+    while(true){
+        const size_t axis = (t_max[0] < t_max[1]) ? ((t_max[0] < t_max[2]) ? 0 : 2)
+                                                  : ((t_max[1] < t_max[2]) ? 1 : 2);
+        const auto t_next = std::min(t_max[axis], t_exit);
+        if(t < t_next) f(idx, t, t_next);
+        if(t_exit <= t_next) break;
+
+        idx[axis] += step[axis];
+        if( (idx[axis] < 0) || (grid.dims[axis] <= idx[axis]) ) break;
+        t = t_next;
+        t_max[axis] += t_delta[axis];
+    }
+    return;
+}
+
+
 
 OperationDoc OpArgDocGridBasedRayCastDoseAccumulate(){
     OperationDoc out;
@@ -43,6 +190,11 @@ OperationDoc OpArgDocGridBasedRayCastDoseAccumulate(){
     out.desc = 
         "This operation performs a ray casting to estimate the surface dose of an ROI.";
 
+    out.notes.emplace_back(
+        "Rays are traversed exactly through the surface mask grid, visiting only the voxels each ray crosses and"
+        " accumulating the exact path length within each. Results therefore do not depend on a ray step size."
+    );
+
 
     out.args.emplace_back();
     out.args.back().name = "DoseMapFileName";
@@ -109,7 +261,9 @@ OperationDoc OpArgDocGridBasedRayCastDoseAccumulate(){
     out.args.emplace_back();
     out.args.back().name = "SmallestFeature";
     out.args.back().desc = "A length giving an estimate of the smallest feature you want to resolve."
-                      " Quantity is in the DICOM coordinate system.";
+                      " Quantity is in the DICOM coordinate system."
+                      " This parameter is no longer needed since rays are traversed exactly; it is retained for"
+                      " compatibility and ignored.";
     out.args.back().default_val = "0.5";
     out.args.back().expected = true;
     out.args.back().examples = { "1.0", "2.0", "0.5", "5.0" };
@@ -119,7 +273,9 @@ OperationDoc OpArgDocGridBasedRayCastDoseAccumulate(){
     out.args.back().desc = "The distance to move a ray each iteration. Should be << img_thickness and << cylinder_radius."
                       " Making too large will invalidate results, causing rays to pass through the surface without"
                       " registering any dose accumulation. Making too small will cause the run-time to grow and may"
-                      " eventually lead to truncation or round-off errors. Quantity is in the DICOM coordinate system.";
+                      " eventually lead to truncation or round-off errors. Quantity is in the DICOM coordinate system."
+                      " This parameter is no longer needed since rays are traversed exactly; it is retained for"
+                      " compatibility and ignored.";
     out.args.back().default_val = "0.1";
     out.args.back().expected = true;
     out.args.back().examples = { "0.1", "0.05", "0.01", "0.005" };
@@ -157,6 +313,16 @@ OperationDoc OpArgDocGridBasedRayCastDoseAccumulate(){
     out.args.back().examples = { "10", "50", "128", "1024" };
 
     
+    out.args.emplace_back();
+    out.args.back().name = "RayPacketSize";
+    out.args.back().desc = "Controls how detector rays are grouped when they are distributed to threads."
+                      " If zero, each detector row is traced independently."
+                      " Otherwise, square tiles of this many rows and columns are traced together so that"
+                      " neighbouring rays, which cross many of the same voxels, share cached mask and dose data.";
+    out.args.back().default_val = "0";
+    out.args.back().expected = true;
+    out.args.back().examples = { "0", "4", "8", "16" };
+
     out.args.emplace_back();
     out.args.back().name = "NumberOfImages";
     out.args.back().desc = "The number of images used for grid-based surface detection. Leave negative for computation"
@@ -184,12 +350,11 @@ bool GridBasedRayCastDoseAccumulate(Drover &DICOM_data,
     const auto NormalizedROILabelRegex = OptArgs.getValueStr("NormalizedROILabelRegex").value();
     const auto ReferenceROILabelRegex = OptArgs.getValueStr("ReferenceROILabelRegex").value();
     const auto NormalizedReferenceROILabelRegex = OptArgs.getValueStr("NormalizedReferenceROILabelRegex").value();
-    const auto SmallestFeature = std::stod(OptArgs.getValueStr("SmallestFeature").value());
-    const auto RaydL = std::stod(OptArgs.getValueStr("RaydL").value());
     const auto GridRows = std::stol(OptArgs.getValueStr("GridRows").value());
     const auto GridColumns = std::stol(OptArgs.getValueStr("GridColumns").value());
     const auto SourceDetectorRows = std::stol(OptArgs.getValueStr("SourceDetectorRows").value());
     const auto SourceDetectorColumns = std::stol(OptArgs.getValueStr("SourceDetectorColumns").value());
+    const auto RayPacketSize = std::stol(OptArgs.getValueStr("RayPacketSize").value());
     auto NumberOfImages = std::stol(OptArgs.getValueStr("NumberOfImages").value());
 
     //-----------------------------------------------------------------------------------------------------------------
@@ -198,7 +363,11 @@ bool GridBasedRayCastDoseAccumulate(Drover &DICOM_data,
     const auto refregex = Compile_Regex(ReferenceROILabelRegex);
     const auto refnormalizedregex = Compile_Regex(NormalizedReferenceROILabelRegex);
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
+
+    if(RayPacketSize < 0){
+        throw std::invalid_argument("Ray packet size must be non-negative. Cannot continue.");
+    }
 
     //Merge the dose arrays if multiple are available.
     DICOM_data = Meld_Only_Dose_Data(DICOM_data);
@@ -454,65 +623,79 @@ bool GridBasedRayCastDoseAccumulate(Drover &DICOM_data,
 
     //Now ready to ray cast. Loop over integer pixel coordinates. Start and finish are image pixels.
     // The top image can be the length image.
+    const auto mask = make_rectilinear_mask(grid_arr_ptr->imagecoll, surface_mask_val);
     {
         std::mutex printer; // Who gets to print to the console and iterate the counter.
         int64_t completed = 0;
+        int64_t last_percent = -1;
 
         const double cleaved_gap_dist = std::abs(ROICleaving.Get_Signed_Distance_To_Point(ROI_centroid));
 
+        const auto trace_ray = [&](int64_t row, int64_t col) -> void {
+            double accumulated_length = 0.0;      //Length of ray travel within the 'surface'.
+            double accumulated_doselength = 0.0;
+            const vec3<double> source = SourceImg->position(row, col);
+            const vec3<double> terminus = DetectImg->position(row, col);
+            const vec3<double> ray_dir = (terminus - source).unit();
+            const vec3<double> ray_start = source + ray_dir * cleaved_gap_dist; // Skip the gap which has been cleaved out.
+
+            traverse_voxels(mask, ray_start, terminus,
+                            [&](const std::array<int64_t,3> &idx, double t_in, double t_out) -> void {
+                if(mask.value(idx) == 0) return;
+
+                const auto dL = t_out - t_in;
+                accumulated_length += dL;
+
+                //Find the dose at the half-way point of the segment within this voxel.
+                const auto midpoint = ray_start + ray_dir * (0.5 * (t_in + t_out));
+                auto encompass_imgs = img_arr_ptr->imagecoll.get_images_which_encompass_point( midpoint );
+                for(const auto &enc_img : encompass_imgs){
+                    const auto pix_val = enc_img->value(midpoint, 0);
+                    accumulated_doselength += dL * pix_val;
+                }
+            });
+
+            //Deposit the dose in the images.
+            SourceImg->reference(row, col, 0) = static_cast<float>(accumulated_length);
+            DetectImg->reference(row, col, 0) = static_cast<float>(accumulated_doselength);
+            DoseImg->reference(row, col, 0) = 0.0f;
+            if(accumulated_length != 0.0){
+                DoseImg->reference(row, col, 0) = static_cast<float>(accumulated_doselength)
+                                                  / static_cast<float>(accumulated_length);
+            }
+        };
+
+        //Partition the detector into tasks. Either whole rows, or square tiles (packets) of adjacent rays.
+        const int64_t tile_rows = (RayPacketSize == 0) ? 1 : RayPacketSize;
+        const int64_t tile_cols = (RayPacketSize == 0) ? SourceDetectorColumns : RayPacketSize;
+        const int64_t task_count = ((SourceDetectorRows + tile_rows - 1) / tile_rows)
+                                 * ((SourceDetectorColumns + tile_cols - 1) / tile_cols);
+
         work_queue<std::function<void(void)>> wq;
-        for(int64_t row = 0; row < SourceDetectorRows; ++row){
-            wq.submit_task([&,row]() -> void {
-                for(int64_t col = 0; col < SourceDetectorColumns; ++col){
-                    double accumulated_length = 0.0;      //Length of ray travel within the 'surface'.
-                    double accumulated_doselength = 0.0;
-                    vec3<double> ray_pos = SourceImg->position(row, col);
-                    const vec3<double> terminus = DetectImg->position(row, col);
-                    const vec3<double> ray_dir = (terminus - ray_pos).unit();
-
-                    ray_pos += ray_dir * cleaved_gap_dist; // Skip the gap which has been cleaved out.
-
-                    //Go until we get within certain distance or overshoot and the ray wants to backtrack.
-                    while(    (ray_dir.Dot( (terminus - ray_pos).unit() ) > 0.8 ) // Ray orientation is still downward-facing.
-                           && (ray_pos.distance(terminus) > std::max<double>(RaydL, SmallestFeature)) ){ // Still far away from detector.
-
-                        ray_pos += ray_dir * RaydL;
-                        const auto midpoint = ray_pos - (ray_dir * RaydL * 0.5);
-
-                        //Check if it was in the surface at the midpoint.
-                        auto rel_img = grid_arr_ptr->imagecoll.get_images_which_encompass_point(midpoint);
-                        if(rel_img.empty()) continue;
-                        const auto mask_val = rel_img.front()->value(midpoint, 0);
-                        const auto is_in_surface = (mask_val == surface_mask_val);
-                        if(is_in_surface){
-                            accumulated_length += RaydL;
-
-                            //Find the dose at the half-way point.
-                            auto encompass_imgs = img_arr_ptr->imagecoll.get_images_which_encompass_point( midpoint );
-                            for(const auto &enc_img : encompass_imgs){
-                                const auto pix_val = enc_img->value(midpoint, 0);
-                                accumulated_doselength += RaydL * pix_val;
-                            }
+        for(int64_t row_0 = 0; row_0 < SourceDetectorRows; row_0 += tile_rows){
+            for(int64_t col_0 = 0; col_0 < SourceDetectorColumns; col_0 += tile_cols){
+                wq.submit_task([&,row_0,col_0]() -> void {
+                    const auto row_1 = std::min(SourceDetectorRows, row_0 + tile_rows);
+                    const auto col_1 = std::min(SourceDetectorColumns, col_0 + tile_cols);
+                    for(int64_t row = row_0; row < row_1; ++row){
+                        for(int64_t col = col_0; col < col_1; ++col){
+                            trace_ray(row, col);
                         }
                     }
 
-                    //Deposit the dose in the images.
-                    SourceImg->reference(row, col, 0) = static_cast<float>(accumulated_length);
-                    DetectImg->reference(row, col, 0) = static_cast<float>(accumulated_doselength);
-                    DoseImg->reference(row, col, 0) = 0.0f;
-                    if(accumulated_length != 0.0){
-                        DoseImg->reference(row, col, 0) = static_cast<float>(accumulated_doselength)
-                                                          / static_cast<float>(accumulated_length);
+                    {
+                        // Report progress, but only when the whole-number percentage changes.
+                        std::lock_guard<std::mutex> lock(printer);
+                        ++completed;
+                        const auto percent = (100 * completed) / task_count;
+                        if(last_percent < percent){
+                            last_percent = percent;
+                            YLOGINFO("Completed " << completed << " of " << task_count
+                                  << " --> " << static_cast<int>(1000.0*(completed)/task_count)/10.0 << "% done");
+                        }
                     }
-                }
-
-                {
-                    std::lock_guard<std::mutex> lock(printer);
-                    ++completed;
-                    YLOGINFO("Completed " << completed << " of " << SourceDetectorRows 
-                          << " --> " << static_cast<int>(1000.0*(completed)/SourceDetectorRows)/10.0 << "% done");
-                }
-            });
+                });
+            }
         }
     } // Complete tasks and terminate thread pool.
 
@@ -92,6 +92,9 @@ bool LoadFiles(Drover &DICOM_data,
         }
     }
     
+    // Files may have been exported earlier in this script, so ensure they are complete.
+    Flush_Write_Behind();
+
     // Load the files to a placeholder Drover class.
     Drover DD_work;
     std::map<std::string, std::string> dummy;
@@ -18,14 +18,14 @@
 #include <string>    
 #include <utility>
 #include <vector>
-#include <utility>
 #include <random>
+#include <condition_variable>
+#include <mutex>
+#include <numeric>
+#include <thread>
 #include <filesystem>
 #include <cstdint>
-
-#ifdef DCMA_USE_NLOPT
-#include <nlopt.hpp>
-#endif // DCMA_USE_NLOPT
+#include <exception>
 
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -35,7 +35,7 @@
 #include "YgorStats.h"        //Needed for Stats:: namespace.
 #include "YgorFilesDirs.h"
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "../Insert_Contours.h"
 #include "../Structs.h"
@@ -64,34 +64,28 @@ struct dose_dist_stats {
 
 };
 
-// Global objects so lambdas can be non-capturing and thus passed as function pointers.
-std::function< dose_dist_stats (std::vector<double> &, std::vector<double> &)> global_evaluate_weights;
-std::vector<double> global_working;
-bool generate_dose_dist_stats = false;
-
-
-// This routine determines the normalization factor required to satisfy the given DVH criteria: $V_{D} \geq V_{min}$.
-// Every element in the input should be multiplied with the return value to satisfy the DVH criteria.
-//
-// Note: it may not be possible to satisfy the criteria. Check the result for non-finite values.
-//
-// Note: Vmin is assumed to be a fraction (of the number of elements, but if each element represents the same fractional
-//       volume of the whole then Vmin is also a fraction of the whole volume).
-//
-// Note: D is in whatever units the input data is; most likely absolute dose. If the normalization condition is a
-//       fraction of the prescribed dose, it will need to be converted into absolute dose if the input data is in
-//       absolute dose.
+// The dose each beam deposits (at unit weight) in each sampled voxel, stored in compressed sparse row (CSR) form.
 //
-double DVH_Normalize(std::vector<double> in, 
-                     double D, 
-                     double Vmin){
-
-    // Compute the current dose that corresponds to Vmin.
-    const auto D_current = Stats::Percentile(std::move(in), (1.0 - Vmin));
+// Each row is a voxel and holds only the beams which deposit non-zero dose there, so the total dose for a given
+// weighting is a sparse matrix-vector product and the cost gradient is a sparse transposed product.
+struct beam_influence_matrix {
+    int64_t N_beams = 0;
+    std::vector<uint64_t> row_offsets;  // Voxel v's entries are [row_offsets[v], row_offsets[v+1]).
+    std::vector<uint32_t> beam_index;
+    std::vector<double> dose;
+
+    size_t N_voxels() const {
+        return (this->row_offsets.empty()) ? 0 : (this->row_offsets.size() - 1);
+    }
 
-    // Scale needed to make it coincide with desired dose.
-    return D / D_current;
-}
+    // Dose deposited in voxel v by a single beam.
+    double element(size_t v, int64_t beam) const {
+        for(auto i = this->row_offsets[v]; i < this->row_offsets[v+1]; ++i){
+            if(static_cast<int64_t>(this->beam_index[i]) == beam) return this->dose[i];
+        }
+        return 0.0;
+    }
+};
 
 
 OperationDoc OpArgDocOptimizeStaticBeams(){
@@ -120,6 +114,13 @@ OperationDoc OpArgDocOptimizeStaticBeams(){
         " For example, bolus D_{max} can be high, but is ultimately irrelevant."
     );
 
+    out.notes.emplace_back(
+        "Beam weights are optimized using a bounded projected gradient method with analytic gradients."
+        " The dose from each beam within the selected ROI(s) is extracted once into a sparse influence matrix,"
+        " so each iteration only touches voxels and beams that contribute dose."
+        " The optimizer finds a local optimum, starting from uniform weights."
+    );
+
     out.notes.emplace_back(
         "By default, this routine uses all available images. This may be fixed in a future release."
         " Patches are welcome."
@@ -172,6 +173,16 @@ OperationDoc OpArgDocOptimizeStaticBeams(){
     out.args.back().default_val = "1000";
     out.args.back().expected = true;
     out.args.back().examples = { "200", "500", "1000", "2000", "5000" };
+    out.args.back().desc += " If zero or negative, all voxels are used.";
+
+
+    out.args.emplace_back();
+    out.args.back().name = "MaxIterations";
+    out.args.back().desc = "The maximum number of projected gradient iterations to perform."
+                           " Optimization usually converges well before this limit is reached.";
+    out.args.back().default_val = "1000";
+    out.args.back().expected = true;
+    out.args.back().examples = { "100", "1000", "10000" };
 
 
     out.args.emplace_back();
@@ -216,7 +227,7 @@ bool OptimizeStaticBeams(Drover &DICOM_data,
                            std::map<std::string, std::string>& /*InvocationMetadata*/,
                            const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto ImageSelectionStr = OptArgs.getValueStr("ImageSelection").value();
@@ -229,6 +240,7 @@ bool OptimizeStaticBeams(Drover &DICOM_data,
     const auto ROILabelRegex = OptArgs.getValueStr("ROILabelRegex").value();
 
     const auto MaxVoxelSamples = std::stol( OptArgs.getValueStr("MaxVoxelSamples").value() );
+    const auto MaxIterations = std::stol( OptArgs.getValueStr("MaxIterations").value() );
 
     const auto dvh_D_frac = std::stod(  OptArgs.getValueStr("NormalizationD").value() );
     const auto dvh_Vmin_frac = std::stod(  OptArgs.getValueStr("NormalizationV").value() );
@@ -345,7 +357,7 @@ bool OptimizeStaticBeams(Drover &DICOM_data,
             auto re = re_orig;
             std::shuffle(vec.begin(), vec.end(), re);
         }
-        if(static_cast<int64_t>(voxels.front().size()) > N_voxels_max){
+        if( (0 < N_voxels_max) && (static_cast<int64_t>(voxels.front().size()) > N_voxels_max) ){
             for(auto &vec : voxels){
                 vec.resize( N_voxels_max );
             }
@@ -355,119 +367,251 @@ bool OptimizeStaticBeams(Drover &DICOM_data,
     const auto N_beams = static_cast<int64_t>(voxels.size());
     const auto N_voxels = voxels.front().size();
 
-    std::stringstream ss;
+    // Transpose the per-beam voxel samples into a sparse influence matrix, discarding zero-dose entries.
+    beam_influence_matrix A;
+    A.N_beams = N_beams;
+    A.row_offsets.reserve(N_voxels + 1);
+    A.row_offsets.push_back(0);
+    for(size_t v = 0; v < N_voxels; ++v){
+        for(int64_t beam = 0; beam < N_beams; ++beam){
+            const auto D = voxels[beam][v];
+            if(D != 0.0){
+                A.beam_index.push_back(static_cast<uint32_t>(beam));
+                A.dose.push_back(D);
+            }
+        }
+        A.row_offsets.push_back(A.dose.size());
+    }
+    voxels.clear();
+    voxels.shrink_to_fit();
+    YLOGINFO("Influence matrix has " << A.dose.size() << " non-zero elements"
+             " (" << (100.0 * static_cast<double>(A.dose.size()) / static_cast<double>(N_voxels * N_beams)) << "% dense)");
+
+    // Voxels are partitioned into contiguous chunks which are processed in parallel. Each chunk accumulates into its
+    // own slot, and slots are reduced in order so results do not depend on scheduling.
+    const size_t N_chunks = std::max<size_t>(1, std::min<size_t>( (N_voxels + 4095) / 4096,
+                                                                   4 * std::max(1U, std::thread::hardware_concurrency()) ));
+    const size_t chunk_size = (N_voxels + N_chunks - 1) / N_chunks;
+    work_queue<std::function<void(void)>> wq;
+    const auto for_each_chunk = [&](const std::function<void(size_t, size_t, size_t)> &f){
+        std::mutex m;
+        std::condition_variable cv;
+        size_t remaining = N_chunks;
+        std::exception_ptr failure;
+
+        // Signals completion even if the task throws, since the queue does not propagate exceptions.
+        struct completion_guard {
+            std::mutex &m;
+            std::condition_variable &cv;
+            size_t &remaining;
+            ~completion_guard(){
+                std::lock_guard<std::mutex> lock(m);
+                --remaining;
+                cv.notify_all();
+            }
+        };
 
-    // This routine evaluates weighting schemes to produce cost and quality metrics.
-    auto evaluate_weights = [&,N_beams](std::vector<double> &weights, 
-                                        std::vector<double> &working) -> dose_dist_stats {
+        for(size_t c = 0; c < N_chunks; ++c){
+            wq.submit_task([&,c]() -> void {
+                completion_guard guard{m, cv, remaining};
+                try{
+                    const auto begin = std::min(N_voxels, c * chunk_size);
+                    const auto end = std::min(N_voxels, begin + chunk_size);
+                    f(c, begin, end);
+                }catch(...){
+                    std::lock_guard<std::mutex> lock(m);
+                    if(!failure) failure = std::current_exception();
+                }
+            });
+        }
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [&](){ return (remaining == 0); });
+        if(failure) std::rethrow_exception(failure);
+    };
+
+    const auto DVH_norm_D = dvh_D_frac * D_Rx;
+    const auto DVH_norm_Vmin = dvh_Vmin_frac;
+
+    // This routine evaluates weighting schemes to produce cost and quality metrics, and optionally the gradient of the
+    // cost with respect to the weights.
+    //
+    // The weighted dose distribution is scaled so the DVH normalization criteria is satisfied, i.e., so the dose at the
+    // (1 - Vmin) percentile is D. The cost is the sum of squared differences from the prescription dose. Since the
+    // scaling is invariant to the overall magnitude of the weights, so is the cost.
+    std::vector<double> working(N_voxels, 0.0);
+    std::vector<size_t> order(N_voxels, 0);
+    std::vector<double> chunk_cost(N_chunks);
+    std::vector<double> chunk_rd(N_chunks);
+    std::vector<std::vector<double>> chunk_grad(N_chunks, std::vector<double>(N_beams));
+    auto evaluate_weights = [&](const std::vector<double> &weights,
+                                bool generate_dose_dist_stats,
+                                std::vector<double> *gradient) -> dose_dist_stats {
 
         dose_dist_stats out;
+        if(gradient != nullptr) gradient->assign(N_beams, 0.0);
 
         // Compute the total dose using the current weighting scheme.
-        //
-        // Note: This requires consistent voxel ordering!
-        std::fill(working.begin(), working.end(), 0.0);
-        for(int64_t beam = 0; beam < N_beams; ++beam){
-            const auto weight = weights[beam];
-            std::transform( working.begin(), working.end(),
-                            voxels[beam].begin(), 
-                            working.begin(),
-                            [=](const double &L, const double &R){ return L + weight * R; });
-        }
+        for_each_chunk([&](size_t, size_t begin, size_t end){
+            for(size_t v = begin; v < end; ++v){
+                double D = 0.0;
+                for(auto i = A.row_offsets[v]; i < A.row_offsets[v+1]; ++i){
+                    D += weights[A.beam_index[i]] * A.dose[i];
+                }
+                working[v] = D;
+            }
+        });
 
         // Sanity check.
-        const auto D_max = Stats::Max(working);
+        const auto D_max = *std::max_element(std::begin(working), std::end(working));
         if(!std::isfinite(D_max) || (D_max < 1E-3)){
             out.cost = std::numeric_limits<double>::max();
+            return out;
+        }
+
+        // Locate the voxels which bracket the normalization percentile. The percentile is linearly interpolated
+        // between them, so it is differentiable as long as the voxel ordering does not change.
+        const auto pos = std::clamp(1.0 - DVH_norm_Vmin, 0.0, 1.0) * static_cast<double>(N_voxels - 1);
+        const auto pos_lo = static_cast<size_t>(std::floor(pos));
+        const auto pos_hi = std::min(pos_lo + 1, N_voxels - 1);
+        const auto frac = pos - static_cast<double>(pos_lo);
+        std::iota(std::begin(order), std::end(order), static_cast<size_t>(0));
+        const auto by_dose = [&](size_t L, size_t R){ return working[L] < working[R]; };
+        std::nth_element(std::begin(order), std::next(std::begin(order), pos_lo), std::end(order), by_dose);
+        const auto v_lo = order[pos_lo];
+        const auto v_hi = (pos_hi == pos_lo) ? v_lo
+                        : *std::min_element(std::next(std::begin(order), pos_lo + 1), std::end(order), by_dose);
+        const auto D_current = (1.0 - frac) * working[v_lo] + frac * working[v_hi];
+        if(!std::isfinite(D_current) || (D_current <= 0.0)){
+            out.cost = std::numeric_limits<double>::max();
+            return out;
         }
 
         // Scale the weighted dose distribution to achieve the specified normalization.
-        const auto DVH_norm_D = dvh_D_frac * D_Rx;
-        const auto DVH_norm_Vmin = dvh_Vmin_frac;
-        const auto dose_scaler = DVH_Normalize(working, DVH_norm_D, DVH_norm_Vmin);
+        const auto dose_scaler = DVH_norm_D / D_current;
 
-        std::transform(working.begin(), working.end(), 
-                       working.begin(), [=](double D) -> double { return D*dose_scaler; });
-        
         // Generate descriptive stats for the dose distribution.
         if(generate_dose_dist_stats){
-            out.D_min  = 100.0 * Stats::Min(working) / D_Rx;
-            out.D_max  = 100.0 * Stats::Max(working) / D_Rx;
-            out.D_mean = 100.0 * Stats::Mean(working) / D_Rx;
-            out.D_02   = Stats::Percentile(working, 0.02);
-            out.D_05   = Stats::Percentile(working, 0.05);
-            out.D_50   = Stats::Percentile(working, 0.50);
-            out.D_95   = Stats::Percentile(working, 0.95);
-            out.D_98   = Stats::Percentile(working, 0.98);
+            std::vector<double> scaled(working);
+            for(auto &D : scaled) D *= dose_scaler;
+            out.D_min  = 100.0 * Stats::Min(scaled) / D_Rx;
+            out.D_max  = 100.0 * Stats::Max(scaled) / D_Rx;
+            out.D_mean = 100.0 * Stats::Mean(scaled) / D_Rx;
+            out.D_02   = Stats::Percentile(scaled, 0.02);
+            out.D_05   = Stats::Percentile(scaled, 0.05);
+            out.D_50   = Stats::Percentile(scaled, 0.50);
+            out.D_95   = Stats::Percentile(scaled, 0.95);
+            out.D_98   = Stats::Percentile(scaled, 0.98);
         }
 
-        //Compute the cost function for each dose element.
-        std::transform(working.begin(), working.end(), 
-                       working.begin(), [=](double D) -> double { return std::pow(D - D_Rx, 2.0); });
-        out.cost = Stats::Sum(working);
-
-/*
-            std::cout << "Evaluation # " << eval_count << " yields " << total_cost << " with weights ";
-            for(auto &w : weights) std::cout << w << " ";
-            std::cout << "Dmin= " << Dmin << "\% Dmean= " << Dmean << "\% Dmax= " << Dmax << "\%";
-            std::cout << std::endl;
-*/
+        // Compute the cost function for each dose element, along with the terms needed for the gradient:
+        //   cost = sum_v r_v^2, where r_v = s*d_v - D_Rx and s = D/q,
+        //   d(cost)/dw_b = 2s * sum_v r_v A_vb - (2s/q) * (sum_v r_v d_v) * dq/dw_b.
+        for_each_chunk([&](size_t c, size_t begin, size_t end){
+            double cost = 0.0;
+            double rd = 0.0;
+            auto &g = chunk_grad[c];
+            if(gradient != nullptr) std::fill(std::begin(g), std::end(g), 0.0);
+            for(size_t v = begin; v < end; ++v){
+                const auto r = dose_scaler * working[v] - D_Rx;
+                cost += r * r;
+                if(gradient != nullptr){
+                    rd += r * working[v];
+                    for(auto i = A.row_offsets[v]; i < A.row_offsets[v+1]; ++i){
+                        g[A.beam_index[i]] += r * A.dose[i];
+                    }
+                }
+            }
+            chunk_cost[c] = cost;
+            chunk_rd[c] = rd;
+        });
+
+        out.cost = std::accumulate(std::begin(chunk_cost), std::end(chunk_cost), 0.0);
+        if(gradient != nullptr){
+            const auto rd = std::accumulate(std::begin(chunk_rd), std::end(chunk_rd), 0.0);
+            for(int64_t beam = 0; beam < N_beams; ++beam){
+                double g = 0.0;
+                for(const auto &cg : chunk_grad) g += cg[beam];
+                const auto dq = (1.0 - frac) * A.element(v_lo, beam) + frac * A.element(v_hi, beam);
+                (*gradient)[beam] = 2.0 * dose_scaler * g - (2.0 * dose_scaler / D_current) * rd * dq;
+            }
+        }
         return out;
     };
-    global_evaluate_weights = evaluate_weights;
 
-    //Constrained surface optimization.
-    auto f_to_optimize = [](const std::vector<double> &open_weights, 
-                            std::vector<double> &grad, 
-                            void * ) -> double {
-        if(!grad.empty()) throw std::logic_error("This implementation cannot handle derivatives.");
+    // Bounded optimization using projected gradient descent with Barzilai-Borwein step sizes and an Armijo
+    // backtracking line search. Weights are confined to [0:1].
+    std::vector<double> open_weights(N_beams, 0.5);
+    {
+        const auto project = [](double w){ return std::clamp(w, 0.0, 1.0); };
 
-        std::vector<double> weights(open_weights);
-        const auto sum = std::accumulate(weights.begin(), weights.end(), 0.0);
-        std::transform(weights.begin(), weights.end(), weights.begin(), [=](double ow) -> double { return ow / sum; });
+        std::vector<double> grad;
+        auto cost = evaluate_weights(open_weights, false, &grad).cost;
+        if(!std::isfinite(cost) || (cost == std::numeric_limits<double>::max())){
+            throw std::runtime_error("Initial beam weights produce an invalid dose distribution. Cannot continue.");
+        }
 
-        auto res = global_evaluate_weights(weights, global_working);
-        return res.cost;
-    };
+        double step = 0.0;
+        {
+            double g_max = 0.0;
+            for(const auto &g : grad) g_max = std::max(g_max, std::abs(g));
+            step = (0.0 < g_max) ? (0.1 / g_max) : 1.0;
+        }
 
-    std::vector<double> open_weights(N_beams, 0.5);
-    std::vector<double> working(N_voxels, 0.0);
-    global_working = working;
-
-#ifdef DCMA_USE_NLOPT
-    //nlopt::opt optimizer(nlopt::LN_NELDERMEAD, N_beams);
-    nlopt::opt optimizer(nlopt::GN_DIRECT_L, N_beams);
-    //nlopt::opt optimizer(nlopt::GN_ISRES, N_beams);
-    //nlopt::opt optimizer(nlopt::GN_ESCH, N_beams);
-
-    std::vector<double> lower_bounds(N_beams, 0.0);
-    std::vector<double> upper_bounds(N_beams, 1.0);
-
-    optimizer.set_lower_bounds(lower_bounds);
-    optimizer.set_upper_bounds(upper_bounds);
-    optimizer.set_min_objective(f_to_optimize, nullptr);
-    optimizer.set_ftol_abs(-HUGE_VAL);
-    optimizer.set_ftol_rel(1.0E-8);
-    optimizer.set_xtol_abs(-HUGE_VAL);
-    optimizer.set_xtol_rel(-HUGE_VAL);
-    optimizer.set_maxeval(500'000);
-    double minf;
-
-    generate_dose_dist_stats = false;
-    YLOGINFO("Beginning optimization now..")
-    nlopt::result nlopt_result = optimizer.optimize(open_weights, minf); // open_weights will contain the current-best weights on success.
-    YLOGINFO("Optimizer result: " << nlopt_result);
-#else // DCMA_USE_NLOPT
-    throw std::runtime_error("Unable to optimize -- nlopt was not used");
-#endif // DCMA_USE_NLOPT
+        YLOGINFO("Beginning optimization now..");
+        std::vector<double> trial(N_beams);
+        std::vector<double> trial_grad;
+        int64_t iter = 0;
+        for( ; iter < MaxIterations; ++iter){
+            bool accepted = false;
+            double trial_cost = cost;
+            for(int64_t attempt = 0; attempt < 50; ++attempt){
+                for(int64_t beam = 0; beam < N_beams; ++beam){
+                    trial[beam] = project(open_weights[beam] - step * grad[beam]);
+                }
+                double descent = 0.0; // Directional derivative along the projected step.
+                for(int64_t beam = 0; beam < N_beams; ++beam){
+                    descent += grad[beam] * (trial[beam] - open_weights[beam]);
+                }
+                if(0.0 <= descent) break; // Projected gradient vanishes; stationary point.
+
+                trial_cost = evaluate_weights(trial, false, &trial_grad).cost;
+                if(trial_cost <= (cost + 1.0E-4 * descent)){
+                    accepted = true;
+                    break;
+                }
+                step *= 0.5;
+            }
+            if(!accepted) break;
+
+            // Barzilai-Borwein step size for the next iteration.
+            double sy = 0.0;
+            double ss = 0.0;
+            for(int64_t beam = 0; beam < N_beams; ++beam){
+                const auto s_b = trial[beam] - open_weights[beam];
+                const auto y_b = trial_grad[beam] - grad[beam];
+                sy += s_b * y_b;
+                ss += s_b * s_b;
+            }
+            step = (0.0 < sy) ? std::clamp(ss / sy, 1.0E-12, 1.0E12) : (step * 2.0);
+
+            const auto rel_change = std::abs(cost - trial_cost) / std::max(1.0, std::abs(cost));
+            open_weights.swap(trial);
+            grad.swap(trial_grad);
+            cost = trial_cost;
+            if(rel_change < 1.0E-10) break;
+        }
+        YLOGINFO("Optimization completed after " << iter << " iterations with cost " << cost);
+    }
 
     std::vector<double> weights(open_weights);
     const auto sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+    if(!(0.0 < sum)){
+        throw std::runtime_error("Optimized beam weights are all zero. Cannot continue.");
+    }
     std::transform(weights.begin(), weights.end(), 
                    weights.begin(), [=](double ow) -> double { return ow / sum; });
 
-    generate_dose_dist_stats = true;
-    const auto res = global_evaluate_weights(weights, global_working);
+    const auto res = evaluate_weights(weights, true, nullptr);
 
     // Construct a summary.
     std::stringstream summary;
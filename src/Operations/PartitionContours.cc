@@ -19,7 +19,7 @@
 #include <numeric>
 #include <cstdint>
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "YgorMath.h"         //Needed for vec3 class.
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
@@ -264,7 +264,7 @@ bool PartitionContours(Drover &DICOM_data,
         throw std::invalid_argument("Requested number of partitions along 'Z' axis is not valid. Refusing to continue.");
     }
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     // Stuff references to all contours into a list. Remember that you can still address specific contours through
     // the original holding containers (which are not modified here).
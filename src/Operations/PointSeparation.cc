@@ -22,7 +22,7 @@
 #include "YgorString.h"       //Needed for GetFirstRegex(...)
 #include "YgorFilesDirs.h"
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
@@ -94,7 +94,7 @@ bool PointSeparation(Drover &DICOM_data,
     auto FileName = OptArgs.getValueStr("FileName").value();
     const auto UserComment = OptArgs.getValueStr("UserComment");
     //-----------------------------------------------------------------------------------------------------------------
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     auto PCs_all = All_PCs( DICOM_data );
     const auto PCs_A = Whitelist( PCs_all, PointSelectionAStr );
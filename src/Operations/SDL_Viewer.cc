@@ -58,7 +58,7 @@
 #include "YgorStats.h"        //Needed for Stats:: namespace.
 #include "YgorString.h"       //Needed for GetFirstRegex(...)
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "../Operation_Dispatcher.h"
 
@@ -77,6 +77,7 @@
 #include "../Script_Loader.h"
 #include "../Standard_Scripts.h"
 #include "../Thread_Pool.h"
+#include "../Write_File.h"
 #include "../String_Parsing.h"
 #include "../Dialogs.h"
 #include "../Alignment_Rigid.h"
@@ -877,7 +878,7 @@ bool SDL_Viewer(Drover &DICOM_data,
 
     const std::chrono::time_point<std::chrono::system_clock> t_start = std::chrono::system_clock::now();
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     struct View_Toggles {
         bool set_about_popup = false;
@@ -2630,6 +2631,12 @@ bool SDL_Viewer(Drover &DICOM_data,
                     }catch(const std::exception &){}
                     if(!success) break;
                 }
+                try{
+                    Flush_Write_Behind();
+                }catch(const std::exception &e){
+                    YLOGWARN(e.what());
+                    success = false;
+                }
                 if(!success){
                     // Report the failure to the user.
                     //
@@ -41,7 +41,7 @@
 #include "YgorStats.h"        //Needed for Stats:: namespace.
 #include "YgorString.h"       //Needed for GetFirstRegex(...)
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "../Colour_Maps.h"
 #include "../Common_Boost_Serialization.h"
@@ -118,7 +118,7 @@ bool SFML_Viewer(Drover &DICOM_data,
     const auto SingleScreenshot = std::regex_match(SingleScreenshotStr, TrueRegex);
     int64_t SingleScreenshotCounter = 3; // Used to count down frames before taking the snapshot.
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //Trim any empty image sets.
     for(auto it = DICOM_data.image_data.begin(); it != DICOM_data.image_data.end();  ){
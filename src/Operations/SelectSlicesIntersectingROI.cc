@@ -1,14 +1,17 @@
 //SelectSlicesIntersectingROI.cc - A part of DICOMautomaton 2016. Written by hal clark.
 
+#include <cmath>
 #include <optional>
 #include <functional>
 #include <list>
 #include <map>
 #include <memory>
 #include <string>    
+#include <vector>
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
+#include "../Contour_Index.h"
 #include "SelectSlicesIntersectingROI.h"
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -58,13 +61,42 @@ bool SelectSlicesIntersectingROI(Drover &DICOM_data,
                                         { "NormalizedROIName", NormalizedROILabelRegex } } );
 
 
+    //Index all selected contours by their position along the common contour normal so that each image only needs to
+    // consider contours near its own plane.
+    std::list<contour_index::cop_refw_t> cop_ROIs;
+    for(auto &cc_ref : cc_ROIs){
+        for(auto &acontour : cc_ref.get().contours){
+            cop_ROIs.push_back( std::ref(acontour) );
+        }
+    }
+    auto index_normal = vec3<double>(0.0, 0.0, 1.0);
+    if(!cop_ROIs.empty()){
+        const auto N = Average_Contour_Normals(cc_ROIs);
+        if(N.isfinite() && (0.0 < N.length())) index_normal = N.unit();
+    }
+    const contour_index cindex(cop_ROIs, index_normal, 1E-3, -1.0, contour_index::property::geometry);
+    const auto &props = cindex.properties();
+
     //Generate a closure that discards images not encompassing any ROI contours.
-    const auto retain_encompassing_imgs = [&cc_ROIs](const planar_image<float, double> &animg) -> bool {
-                //Retain the image IFF it intersects one of the contours.
-                for(const auto &cc_ref : cc_ROIs){
-                    for(const auto &acontour : cc_ref.get().contours){
-                        if(animg.encompasses_contour_of_points(acontour)) return true;
+    const auto retain_encompassing_imgs = [&](const planar_image<float, double> &animg) -> bool {
+                //Images that are not aligned with the index or have no thickness cannot use it, so fall back to an
+                // exhaustive search.
+                const auto img_normal = animg.image_plane().N_0.unit();
+                if( (std::abs(img_normal.Dot(index_normal)) < (1.0 - 1E-6))
+                ||  !std::isfinite(animg.pxl_dz)
+                ||  (animg.pxl_dz <= 0.0) ){
+                    for(const auto &p : props){
+                        if(animg.encompasses_contour_of_points(p.contour.get())) return true;
                     }
+                    return false;
+                }
+
+                //Retain the image IFF it intersects one of the contours. Only contours overlapping the image's slab
+                // are candidates.
+                const auto offset = cindex.offset_of(animg.center());
+                const auto half_thickness = 0.5 * animg.pxl_dz;
+                for(const auto i : cindex.within_planes(offset - half_thickness, offset + half_thickness)){
+                    if(animg.encompasses_contour_of_points(props[i].contour.get())) return true;
                 }
                 return false;
     };
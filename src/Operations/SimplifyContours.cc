@@ -1,14 +1,19 @@
 //SimplifyContours.cc - A part of DICOMautomaton 2018. Written by hal clark.
 
 #include <cstdlib>            //Needed for exit() calls.
+#include <cmath>
+#include <cstdint>
 #include <optional>
 #include <functional>
+#include <limits>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <regex>
 #include <stdexcept>
 #include <string>    
+#include <utility>
 #include <vector>
 
 #include "../Insert_Contours.h"
@@ -18,10 +23,197 @@
 
 #include "YgorMath.h"         //Needed for vec3 class.
 
-#include "Explicator.h"
+#include "../Lexicon_Loader.h"
 
 #include "SimplifyContours.h"
 
+
+// Binary min-heap over a fixed set of item indices, which supports updating or removing arbitrary items via a reverse
+// index. This permits local cost updates after each simplification step without rescanning the whole contour.
+class indexed_min_heap {
+  private:
+    std::vector<double> keys;      // Indexed by item.
+    std::vector<int64_t> heap;     // Heap-ordered items.
+    std::vector<int64_t> position; // Position of each item in the heap, or -1 if absent.
+
+    bool less(int64_t a, int64_t b) const {
+        return (this->keys[this->heap[a]] < this->keys[this->heap[b]]);
+    }
+    void swap_nodes(int64_t a, int64_t b){
+        std::swap(this->heap[a], this->heap[b]);
+        this->position[this->heap[a]] = a;
+        this->position[this->heap[b]] = b;
+    }
+    void sift_up(int64_t n){
+        while(0 < n){
+            const auto parent = (n - 1) / 2;
+            if(!this->less(n, parent)) break;
+            this->swap_nodes(n, parent);
+            n = parent;
+        }
+    }
+    void sift_down(int64_t n){
+        const auto N = static_cast<int64_t>(this->heap.size());
+        while(true){
+            const auto l = 2 * n + 1;
+            const auto r = l + 1;
+            auto m = n;
+            if((l < N) && this->less(l, m)) m = l;
+            if((r < N) && this->less(r, m)) m = r;
+            if(m == n) break;
+            this->swap_nodes(n, m);
+            n = m;
+        }
+    }
+
+  public:
+    // Items are [0, keys.size()). Infinite keys are never inserted.
+    explicit indexed_min_heap(std::vector<double> k) : keys(std::move(k)), position(keys.size(), -1) {
+        this->heap.reserve(this->keys.size());
+        for(int64_t i = 0; i < static_cast<int64_t>(this->keys.size()); ++i){
+            if(!std::isfinite(this->keys[i])) continue;
+            this->position[i] = static_cast<int64_t>(this->heap.size());
+            this->heap.push_back(i);
+        }
+        for(int64_t n = static_cast<int64_t>(this->heap.size()) / 2; 0 <= n; --n) this->sift_down(n);
+    }
+
+    bool empty() const {
+        return this->heap.empty();
+    }
+    int64_t top() const {
+        return this->heap.front();
+    }
+    double top_key() const {
+        return this->keys[this->heap.front()];
+    }
+
+    void remove(int64_t item){
+        const auto n = this->position[item];
+        if(n < 0) return;
+        const auto last = static_cast<int64_t>(this->heap.size()) - 1;
+        if(n != last) this->swap_nodes(n, last);
+        this->heap.pop_back();
+        this->position[item] = -1;
+        if(n < last){
+            const auto moved = this->heap[n];
+            this->sift_up(n);
+            this->sift_down(this->position[moved]);
+        }
+    }
+
+    void update(int64_t item, double key){
+        this->remove(item);
+        this->keys[item] = key;
+        if(!std::isfinite(key)) return;
+        this->position[item] = static_cast<int64_t>(this->heap.size());
+        this->heap.push_back(item);
+        this->sift_up(this->position[item]);
+    }
+};
+
+
+// Simplify a planar contour by repeatedly removing the least significant vertex (or collapsing the least significant
+// pair of adjacent vertices to their midpoint), as measured by the magnitude of the area change, until the cumulative
+// area change would exceed the tolerance.
+//
+// Vertices are kept in an implicit doubly-linked list and the costs in an indexed min-heap, so each step only needs to
+// re-evaluate the costs of its immediate neighbours. The overall cost is O(N log N) per contour.
+static
+void simplify_contour(contour_of_points<double> &c,
+                      double A_tol,
+                      bool collapse){
+    std::vector<vec3<double>> P( std::begin(c.points), std::end(c.points) );
+    const auto N = static_cast<int64_t>(P.size());
+    const int64_t N_min = (c.closed) ? 3 : 2;
+    if(N <= N_min) return;
+
+    // Newell's method for the plane normal, which is robust to non-convex polygons.
+    vec3<double> normal(0.0, 0.0, 0.0);
+    for(int64_t i = 0; i < N; ++i){
+        const auto &A = P[i];
+        const auto &B = P[(i + 1) % N];
+        normal += A.Cross(B);
+    }
+    normal = (0.0 < normal.length()) ? normal.unit() : vec3<double>(0.0, 0.0, 1.0);
+
+    std::vector<int64_t> prev(N);
+    std::vector<int64_t> next(N);
+    std::vector<bool> alive(N, true);
+    for(int64_t i = 0; i < N; ++i){
+        prev[i] = (i + N - 1) % N;
+        next[i] = (i + 1) % N;
+    }
+    // Open contour endpoints are never removed or moved.
+    const auto is_fixed = [&](int64_t i) -> bool {
+        return !c.closed && ((i == 0) || (i == (N - 1)));
+    };
+    const auto signed_area = [&](const vec3<double> &A, const vec3<double> &B, const vec3<double> &C) -> double {
+        return 0.5 * (B - A).Cross(C - A).Dot(normal);
+    };
+    const auto inf = std::numeric_limits<double>::infinity();
+
+    // For removal, item i is vertex i. For collapse, item i is the edge from vertex i to next[i].
+    const auto cost = [&](int64_t i) -> double {
+        if(!alive[i]) return inf;
+        if(!collapse){
+            if(is_fixed(i)) return inf;
+            return std::abs( signed_area(P[prev[i]], P[i], P[next[i]]) );
+        }
+        const auto j = next[i];
+        if(is_fixed(i) || is_fixed(j)) return inf;
+        const auto h = prev[i];
+        const auto k = next[j];
+        const auto M = (P[i] + P[j]) * 0.5;
+        // Area change from replacing the chain h-i-j-k with h-M-k.
+        const auto A_old = signed_area(P[h], P[i], P[j]) + signed_area(P[h], P[j], P[k]);
+        const auto A_new = signed_area(P[h], M, P[k]);
+        return std::abs(A_new - A_old);
+    };
+
+    std::vector<double> keys(N);
+    for(int64_t i = 0; i < N; ++i) keys[i] = cost(i);
+    indexed_min_heap heap(keys);
+
+    int64_t N_alive = N;
+    double A_used = 0.0;
+    while( (N_min < N_alive) && !heap.empty() ){
+        const auto i = heap.top();
+        const auto dA = heap.top_key();
+        if(A_tol < (A_used + dA)) break;
+        A_used += dA;
+
+        // The vertex to unlink: i for removal, next[i] for collapse.
+        const auto r = (collapse) ? next[i] : i;
+        if(collapse) P[i] = (P[i] + P[r]) * 0.5;
+
+        const auto h = prev[r];
+        const auto k = next[r];
+        next[h] = k;
+        prev[k] = h;
+        alive[r] = false;
+        heap.remove(r);
+        --N_alive;
+
+        // Re-evaluate the costs of items that depend on the modified neighbourhood.
+        if(collapse){
+            for(const auto j : { prev[h], h, k, prev[prev[h]] }){
+                heap.update(j, cost(j));
+            }
+        }else{
+            heap.update(h, cost(h));
+            heap.update(k, cost(k));
+        }
+    }
+
+    c.points.clear();
+    for(int64_t i = 0; i < N; ++i){
+        if(alive[i]) c.points.push_back(P[i]);
+    }
+    return;
+}
+
+
 OperationDoc OpArgDocSimplifyContours(){
     OperationDoc out;
     out.name = "SimplifyContours";
@@ -32,6 +224,7 @@ OperationDoc OpArgDocSimplifyContours(){
 
     out.notes.emplace_back(
         "Contours are currently processed individually, not as a volume."
+        " Contours are simplified in parallel."
     );
     out.notes.emplace_back(
         "Simplification is generally performed most eagerly on regions with relatively low curvature."
@@ -54,7 +247,9 @@ OperationDoc OpArgDocSimplifyContours(){
     out.args.emplace_back();
     out.args.back().name = "FractionalAreaTolerance";
     out.args.back().desc = "The fraction of area each contour will tolerate during simplified."
-                           " This is a measure of how much the contour area can change due to simplification.";
+                           " This is a measure of how much the contour area can change due to simplification."
+                           " The magnitude of each simplification step's area change is accumulated, and"
+                           " simplification stops when the next step would exceed the tolerance.";
     out.args.back().default_val = "0.01";
     out.args.back().expected = true;
     out.args.back().examples = { "0.001", "0.01", "0.02", "0.05", "0.10" };
@@ -96,7 +291,7 @@ bool SimplifyContours(Drover &DICOM_data,
                         std::map<std::string, std::string>& /*InvocationMetadata*/,
                         const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto NormalizedROILabelRegex = OptArgs.getValueStr("NormalizedROILabelRegex").value();
@@ -121,25 +316,24 @@ bool SimplifyContours(Drover &DICOM_data,
                                         { "NormalizedROIName", NormalizedROILabelRegex } } );
 
     const bool AssumePlanar = true;
-    for(auto &cc_refw : cc_ROIs){
-        for(auto &c : cc_refw.get().contours){
-            const auto A_orig = std::abs( c.Get_Signed_Area(AssumePlanar) );
-            const auto A_tol = FractionalAreaTolerance * A_orig;
-
-            if( std::regex_match(SimplificationMethod, regex_vert_col) ){
-                // Vertex collapse. Adjacent vertices are merged together.
-                c = c.Collapse_Vertices(A_tol);
-
-            }else if( std::regex_match(SimplificationMethod, regex_vert_rem) ){
-                // Vertex removal. No vertices are added.
-                c = c.Remove_Vertices(A_tol);
+    const bool Collapse = std::regex_match(SimplificationMethod, regex_vert_col);
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(auto &cc_refw : cc_ROIs){
+            for(auto &c : cc_refw.get().contours){
+                std::reference_wrapper<contour_of_points<double>> c_refw( std::ref(c) );
+                wq.submit_task([&,c_refw]() -> void {
+                    auto &l_c = c_refw.get();
+                    const auto A_orig = std::abs( l_c.Get_Signed_Area(AssumePlanar) );
+                    const auto A_tol = FractionalAreaTolerance * A_orig;
 
-            }else{
-                throw std::logic_error("SimplificationMethod options have been updated incompletely. Cannot continue.");
+                    // Vertex collapse merges adjacent vertices together. Vertex removal adds no vertices.
+                    simplify_contour(l_c, A_tol, Collapse);
+                    return;
+                });
             }
-
         }
-    }
+    } // Wait for all tasks to complete.
 
     return true;
 }
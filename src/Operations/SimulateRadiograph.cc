@@ -52,16 +52,195 @@
 #include "SimulateRadiograph.h"
 
 
+// A dense attenuation coefficient volume sampled on a rectilinear grid.
+struct attenuation_volume {
+    vec3<double> origin;              // Corner of voxel (0, 0, 0).
+    std::array<vec3<double>, 3> axes; // Unit vectors along increasing (image, row, column).
+    std::array<double, 3> spacing = {{ 0.0, 0.0, 0.0 }};
+    std::array<int64_t, 3> dims = {{ 0, 0, 0 }};
+    std::vector<float> mu;
+};
+
+// Converts CT numbers (in HU) to relative attenuation coefficients, i.e., a ficticious mass density encountered by rays.
+static attenuation_volume
+make_attenuation_volume(const planar_image_collection<float,double> &imagecoll,
+                        int64_t channel){
+    if(imagecoll.images.empty()){
+        throw std::invalid_argument("No images provided");
+    }
+
+    std::vector<const planar_image<float,double>*> imgs;
+    for(const auto &img : imagecoll.images) imgs.push_back(&img);
+
+    const auto &first = *(imgs.front());
+    const auto normal = first.col_unit.Cross(first.row_unit).unit();
+    std::sort(std::begin(imgs), std::end(imgs), [&](const planar_image<float,double> *A,
+                                                    const planar_image<float,double> *B){
+        return (A->position(0,0).Dot(normal) < B->position(0,0).Dot(normal));
+    });
+
+    attenuation_volume out;
+    const auto &base = *(imgs.front());
+    out.axes = {{ normal, base.row_unit.unit(), base.col_unit.unit() }};
+    out.dims = {{ static_cast<int64_t>(imgs.size()), base.rows, base.columns }};
+    out.spacing[1] = base.pxl_dx;
+    out.spacing[2] = base.pxl_dy;
+    out.spacing[0] = base.pxl_dz;
+    if(1 < imgs.size()){
+        const auto span = (imgs.back()->position(0,0) - base.position(0,0)).Dot(normal);
+        out.spacing[0] = span / static_cast<double>(imgs.size() - 1);
+    }
+    if( !(0.0 < out.spacing[0]) || !(0.0 < out.spacing[1]) || !(0.0 < out.spacing[2]) ){
+        throw std::runtime_error("Image grid has invalid voxel dimensions");
+    }
+    out.origin = base.position(0,0) - out.axes[0] * (0.5 * out.spacing[0])
+                                    - out.axes[1] * (0.5 * out.spacing[1])
+                                    - out.axes[2] * (0.5 * out.spacing[2]);
+
+    out.mu.resize(static_cast<size_t>(out.dims[0] * out.dims[1] * out.dims[2]), 0.0f);
+    for(int64_t k = 0; k < out.dims[0]; ++k){
+        const auto &img = *(imgs[k]);
+        if( (img.rows != base.rows) || (img.columns != base.columns) ){
+            throw std::runtime_error("Image grid is not rectilinear");
+        }
+        for(int64_t r = 0; r < img.rows; ++r){
+            for(int64_t c = 0; c < img.columns; ++c){
+                const auto voxel_val = img.value(r, c, channel);
+                const auto intensity = (voxel_val < -1000.0f) ? -1000.0f : voxel_val; // Enforce physicality.
+                out.mu[ static_cast<size_t>((k * out.dims[1] + r) * out.dims[2] + c) ] = 1.0f + (intensity / 1000.0f);
+            }
+        }
+    }
+    return out;
+}
+
+// Rotates a vector about a unit axis using Rodrigues' formula.
+static vec3<double>
+rotate_about_axis(const vec3<double> &v, const vec3<double> &axis, double angle){
+    const auto c = std::cos(angle);
+    const auto s = std::sin(angle);
+    return v * c + axis.Cross(v) * s + axis * (axis.Dot(v) * (1.0 - c));
+}
+
+// Traces the rays from a point source to a row of N equally-spaced detector pixels, where pixel i is located at
+// first_pixel + col_step * i, using the incremental Siddon (Jacobs) algorithm. Each ray visits exactly the voxels it
+// crosses and the sum of mu*dL is reported for each pixel.
+//
+// Rays are parameterized as source + (pixel - source) * alpha for alpha in [0:1]. Since all rays share the source and
+// the pixels are equally spaced, the per-axis parametric setup for the entire row is performed in flat loops over the
+// columns before any voxels are visited.
+static void
+trace_detector_row(const attenuation_volume &vol,
+                   const vec3<double> &source,
+                   const vec3<double> &first_pixel,
+                   const vec3<double> &col_step,
+                   int64_t N,
+                   std::vector<double> &out){
+    out.assign(static_cast<size_t>(N), 0.0);
+    if(N <= 0) return;
+
+    const double inf = std::numeric_limits<double>::infinity();
+    const std::array<int64_t, 3> stride = {{ vol.dims[1] * vol.dims[2], vol.dims[2], 1 }};
+
+    // The source position in continuous grid coordinates is common to all rays.
+    std::array<double, 3> q0;
+    for(size_t i = 0; i < 3; ++i){
+        q0[i] = (source - vol.origin).Dot(vol.axes[i]) / vol.spacing[i];
+    }
+
+    // Per-axis ray directions in continuous grid coordinates, and the parametric entry and exit points.
+    std::array<std::vector<double>, 3> v;
+    std::vector<double> a_enter(static_cast<size_t>(N), 0.0);
+    std::vector<double> a_exit(static_cast<size_t>(N), 1.0);
+    for(size_t i = 0; i < 3; ++i){
+        const auto v0 = (first_pixel - source).Dot(vol.axes[i]) / vol.spacing[i];
+        const auto dv = col_step.Dot(vol.axes[i]) / vol.spacing[i];
+        const auto n = static_cast<double>(vol.dims[i]);
+        const bool q0_inside = (0.0 <= q0[i]) && (q0[i] < n);
+
+        auto &vi = v[i];
+        vi.resize(static_cast<size_t>(N));
+        for(int64_t c = 0; c < N; ++c){
+            vi[c] = v0 + dv * static_cast<double>(c);
+        }
+        for(int64_t c = 0; c < N; ++c){
+            if(std::abs(vi[c]) < 1.0E-12){
+                vi[c] = 0.0;
+                if(!q0_inside) a_exit[c] = -1.0; // Parallel and outside of the grid.
+                continue;
+            }
+            const auto a_a = (0.0 - q0[i]) / vi[c];
+            const auto a_b = (n - q0[i]) / vi[c];
+            a_enter[c] = std::max(a_enter[c], std::min(a_a, a_b));
+            a_exit[c]  = std::min(a_exit[c],  std::max(a_a, a_b));
+        }
+    }
+
+    for(int64_t c = 0; c < N; ++c){
+        if(a_exit[c] <= a_enter[c]) continue;
+
+        std::array<int64_t, 3> idx;
+        std::array<int64_t, 3> step;
+        std::array<double, 3> a_next;
+        std::array<double, 3> a_delta;
+        const auto a_mid = 0.5 * (a_enter[c] + std::min(a_exit[c], a_enter[c] + 1.0E-9));
+        int64_t offset = 0;
+        for(size_t i = 0; i < 3; ++i){
+            const auto vc = v[i][c];
+            const auto q = q0[i] + vc * a_mid;
+            idx[i] = std::clamp<int64_t>(static_cast<int64_t>(std::floor(q)), 0, vol.dims[i] - 1);
+            offset += idx[i] * stride[i];
+            if(0.0 < vc){
+                step[i] = 1;
+                a_next[i] = (static_cast<double>(idx[i] + 1) - q0[i]) / vc;
+                a_delta[i] = 1.0 / vc;
+            }else if(vc < 0.0){
+                step[i] = -1;
+                a_next[i] = (static_cast<double>(idx[i]) - q0[i]) / vc;
+                a_delta[i] = -1.0 / vc;
+            }else{
+                step[i] = 0;
+                a_next[i] = inf;
+                a_delta[i] = inf;
+            }
+        }
+
+        double acc = 0.0;
+        double a = a_enter[c];
+        while(true){
+            const size_t axis = (a_next[0] < a_next[1]) ? ((a_next[0] < a_next[2]) ? 0 : 2)
+                                                        : ((a_next[1] < a_next[2]) ? 1 : 2);
+            const auto a_n = std::min(a_next[axis], a_exit[c]);
+            acc += static_cast<double>(vol.mu[static_cast<size_t>(offset)]) * (a_n - a);
+            if(a_exit[c] <= a_n) break;
+
+            idx[axis] += step[axis];
+            if( (idx[axis] < 0) || (vol.dims[axis] <= idx[axis]) ) break;
+            offset += step[axis] * stride[axis];
+            a = a_n;
+            a_next[axis] += a_delta[axis];
+        }
+
+        const auto ray_length = (first_pixel + col_step * static_cast<double>(c) - source).length();
+        out[c] = acc * ray_length;
+    }
+    return;
+}
+
+
+
 
 OperationDoc OpArgDocSimulateRadiograph(){
     OperationDoc out;
     out.name = "SimulateRadiograph";
 
     out.desc = 
-        "This routine uses ray marching and volumetric sampling to simulate radiographs using a CT image array."
+        "This routine uses ray tracing to simulate radiographs using a CT image array."
         " Voxels are assumed to have intensities in HU. A simplisitic conversion"
-        " from CT number (in HU) to relative electron density (see note below) is performed for marched"
-        " rays.";
+        " from CT number (in HU) to relative electron density (see note below) is performed once for all"
+        " voxels, and rays are then traced exactly through the voxels they cross (i.e., Siddon's method)."
+        " Radiographs for multiple source positions can be simulated in a single invocation, e.g., for an arc of"
+        " gantry angles.";
 
     out.notes.emplace_back(
         "Images must be regular."
@@ -78,6 +257,10 @@ OperationDoc OpArgDocSimulateRadiograph(){
         " are numerically equivalent. This assumption appears to be reasonable for bulk human tissue"
         " (arXiv:1508.00226v1)."
     );
+    out.notes.emplace_back(
+        "All simulated radiographs are emitted as a single image array, one image per projection. Projections are"
+        " ordered by transformation, and then by gantry angle."
+    );
 
     out.args.emplace_back();
     out.args.back() = IAWhitelistOpArgDoc();
@@ -111,6 +294,30 @@ OperationDoc OpArgDocSimulateRadiograph(){
                                  "absolute(-123.0, 123.0, 1.23)" };
 
 
+    out.args.emplace_back();
+    out.args.back().name = "GantryAngles";
+    out.args.back().desc = "A list of gantry angles (in degrees) for which radiographs will be simulated."
+                           " For each angle, the source position is rotated about the image centre around the image"
+                           " array's normal (i.e., the axis perpendicular to the images). The detector is re-oriented"
+                           " to face the source for each angle. An angle of zero corresponds to the SourcePosition"
+                           " parameter. Angles can be separated by commas or spaces."
+                           " Leaving empty will result in a single radiograph for the SourcePosition parameter.";
+    out.args.back().default_val = "";
+    out.args.back().expected = false;
+    out.args.back().examples = { "", "0", "0, 90, 180, 270", "0 45 90 135 180 225 270 315" };
+
+
+    out.args.emplace_back();
+    out.args.back() = T3WhitelistOpArgDoc();
+    out.args.back().name = "TransformSelection";
+    out.args.back().default_val = "none";
+    out.args.back().desc = "Affine transformations that will be applied to the source position. A radiograph will be"
+                           " simulated for each selected transformation (and each gantry angle, if provided)."
+                           " Transformations are applied after the gantry rotation."
+                           " Only affine transformations are supported. "_s
+                         + out.args.back().desc;
+
+
     out.args.emplace_back();
     out.args.back().name = "AttenuationScale";
     out.args.back().desc = "This parameter globally scales all attenuation factors derived via ray marching."
@@ -190,6 +397,10 @@ bool SimulateRadiograph(Drover &DICOM_data,
 
     const auto SourcePositionStr = OptArgs.getValueStr("SourcePosition").value();
 
+    const auto GantryAnglesStr = OptArgs.getValueStr("GantryAngles").value();
+
+    const auto TFormSelectionStr = OptArgs.getValueStr("TransformSelection").value();
+
     const auto AttenuationScale = std::stod( OptArgs.getValueStr("AttenuationScale").value() );
 
     const auto ImageModelStr = OptArgs.getValueStr("ImageModel").value();
@@ -241,6 +452,23 @@ bool SimulateRadiograph(Drover &DICOM_data,
         if(!source_position.isfinite()) throw std::invalid_argument("Source position invalid.");
     }
 
+    std::vector<double> GantryAngles;
+    {
+        auto split = SplitStringToVector(GantryAnglesStr, ',', 'd');
+        split = SplitVector(split, ' ', 'd');
+        for(const auto &w : split){
+            if(w.empty()) continue;
+            try{
+                GantryAngles.emplace_back( std::stod(w) );
+            }catch(const std::exception &){
+                throw std::invalid_argument("Unable to parse gantry angle '"_s + w + "'. Cannot continue.");
+            }
+            if(!std::isfinite(GantryAngles.back())){
+                throw std::invalid_argument("Gantry angles must be finite. Cannot continue.");
+            }
+        }
+    }
+
     auto IAs_all = All_IAs( DICOM_data );
     //auto IAs = Whitelist( IAs_all, "Modality@CT" );
     auto IAs = Whitelist( IAs_all, ImageSelectionStr );
@@ -274,75 +502,48 @@ bool SimulateRadiograph(Drover &DICOM_data,
     const auto col_unit = img_arr_ptr->imagecoll.images.front().col_unit.unit();
     const auto img_unit = col_unit.Cross(row_unit).unit();
 
-    planar_image_adjacency<float,double> img_adj( {}, { { std::ref(img_arr_ptr->imagecoll) } }, img_unit );
-    if(img_adj.int_to_img.empty()){
-        throw std::logic_error("Image array contained no images. Cannot continue.");
-    }
-
-    const auto pxl_dx = img_arr_ptr->imagecoll.images.front().pxl_dx;
-    const auto pxl_dy = img_arr_ptr->imagecoll.images.front().pxl_dy;
-    const auto pxl_dz = img_arr_ptr->imagecoll.images.front().pxl_dz;
-    const auto pxl_diagonal_sq_length = (pxl_dx*pxl_dx + pxl_dy*pxl_dy + pxl_dz*pxl_dz);
-
-    const auto grid_zero = img_adj.index_to_image(0).get().position(0,0); // Centre of the (0,0,0) voxel.
-    const auto img_bps = img_adj.bounding_volume_planes;
+    // Convert the CT numbers to attenuation coefficients once, up front, so rays only need a single lookup per voxel.
+    const auto vol = make_attenuation_volume(img_arr_ptr->imagecoll, Channel);
+    YLOGINFO("Prepared attenuation volume with " << vol.dims[0] << " images, " << vol.dims[1] << " rows, and "
+             << vol.dims[2] << " columns");
 
-    const auto N_rows = static_cast<int64_t>(img_arr_ptr->imagecoll.images.front().rows);
-    const auto N_cols = static_cast<int64_t>(img_arr_ptr->imagecoll.images.front().columns);
-    const auto N_imgs = static_cast<int64_t>(img_adj.int_to_img.size());
-
-    // Determine an appropriate radiograph orientation.
     const auto img_centre = img_arr_ptr->imagecoll.center(); // TODO: For TBI, should be at the t0 point (i.e., at the level of the lung).
-    auto ray_source = vec3_nan;
+    auto nominal_source = vec3_nan;
     if(spos_is_relative){
-        ray_source = img_centre + source_position;  // Should be relative to voxel at (0,0,0), not image centre.
+        nominal_source = img_centre + source_position;  // Should be relative to voxel at (0,0,0), not image centre.
     }else if(spos_is_absolute){
-        ray_source = source_position;
+        nominal_source = source_position;
     }else{
         throw std::logic_error("Unknown option. Cannot continue.");
     }
-    if(ray_source.distance(img_centre) < machine_eps){
-        throw std::invalid_argument("Ray source point cannot coincide with image centre. Refusing to continue.");
-    }
-    const line<double> source_centre_line(ray_source, img_centre); 
-
-    // Determine which way will be 'up' in the radiograph.
-    const auto ray_unit = (img_centre - ray_source).unit();
-    auto rg_up = img_unit;
-    auto rg_left = rg_up.Cross(ray_unit).unit();
-    if(!ray_unit.GramSchmidt_orthogonalize(rg_up, rg_left)){
-        throw std::invalid_argument("Cannot orthogonalize radiograph orientation unit vectors. Cannot continue.");
-    }
-    rg_up = rg_up.unit();
-    rg_left = rg_left.unit();
-
-    YLOGINFO("Proceeding with radiograph into-plane orientation unit vector: " << ray_unit);
-    YLOGINFO("Proceeding with radiograph leftward orientation unit vector: " << rg_left);
-    YLOGINFO("Proceeding with radiograph upward orientation unit vector: " << rg_up);
-    YLOGINFO("Proceeding with ray source at: " << ray_source);
-    YLOGINFO("Proceeding with image centre at: " << img_centre);
-    YLOGINFO("Proceeding with ray source - image centre line: " << source_centre_line);
-
-    // Confirm the bounding planes are all correctly oriented.
-    for(const auto & img_bp : img_bps){
-        if(!img_bp.Is_Point_Above_Plane(img_centre)){
-            throw std::logic_error("Bounding planes are not inward oriented. Refusing to continue.");
-            // Note: could just re-orient them here...
-        }
-    }
-    if(img_bps.size() != 6){
-        throw std::logic_error("Incorrect number of bounding planes provided. Cannot continue.");
-    }
 
-    // Pre-compute whether the ray source position is bounded within the image volume.
-    bool ray_source_is_within_image_volume = false;
+    // Enumerate the projections. Every transform (or the identity, if none are selected) is combined with every gantry
+    // angle (or the nominal source position, if no angles are provided).
+    std::vector<std::optional<double>> angles;
+    for(const auto &a : GantryAngles) angles.emplace_back(a);
+    if(angles.empty()) angles.emplace_back();
+
+    std::vector<std::optional<affine_transform<double>>> transforms;
     {
-        int64_t N_bounds = 0;
-        for(const auto & img_bp : img_bps){
-            N_bounds += (img_bp.Is_Point_Above_Plane(ray_source)) ? 1L : 0L;
+        auto T3s_all = All_T3s( DICOM_data );
+        auto T3s = Whitelist( T3s_all, TFormSelectionStr );
+        for(auto & t3p_it : T3s){
+            const auto *t = std::get_if<affine_transform<double>>( &((*t3p_it)->transform) );
+            if(t == nullptr){
+                throw std::invalid_argument("Only affine transformations can be used to position the source. Cannot continue.");
+            }
+            transforms.emplace_back(*t);
         }
-        ray_source_is_within_image_volume = (N_bounds == 6);
+        YLOGINFO("Selected " << transforms.size() << " transformation objects");
     }
+    if(transforms.empty()) transforms.emplace_back();
+
+    struct projection {
+        vec3<double> source;
+        std::optional<double> angle;
+        planar_image<float, double> *detector = nullptr;
+    };
+    std::vector<projection> projections;
 
     // Encode the image geometry as contours for volumetric bounds determination.
     contour_collection<double> cc;
@@ -358,230 +559,134 @@ bool SimulateRadiograph(Drover &DICOM_data,
     }
     std::list<std::reference_wrapper<contour_collection<double>>> cc_ROIs = { std::ref(cc) };
 
-    //------------------------
-    // Create a detector that will encompass the images.
-    //
-    // Note: We are generous here because the source is a single point. The image projection will therefore be
-    //       magnified. If the source is too close the projection will 
-    double grid_x_margin = 5.0;
-    double grid_y_margin = 5.0;
-    double grid_z_margin = 5.0;
-
-    //Generate a grid volume bounding the ROI(s). We ask for many images in order to compress the pxl_dz taken by each.
-    // Only two are actually allocated.
-    const auto NumberOfPanelImages = 1000L;
-    auto sd_image_collection = Symmetrically_Contiguously_Grid_Volume<float,double>(
-             cc_ROIs, 
-             grid_x_margin, grid_y_margin, grid_z_margin,
-             RadiographRows, RadiographColumns, /*number_of_channels=*/ 1, NumberOfPanelImages, 
-             source_centre_line, (rg_up * -1.0), rg_left,
-             /*pixel_fill=*/ 0.0, 
-             /*only_top_and_bottom=*/ true);
-
-    //Get handles for each image.
-    planar_image<float, double> *DetectImg = &(*std::next(sd_image_collection.images.begin(),0));
-    planar_image<float, double> *OrthoSrcImg = &(*std::next(sd_image_collection.images.begin(),1));
-
-    // Confirm the detector image is oriented correctly.
-    //
-    // Note: the detector will always be on the opposite side of the image centre compared with the source point
-    // (i.e., the source will always points towards the image centre).
-    {
-        const auto dICSP = img_centre - source_position;
-        const auto dDPIC = DetectImg->center() - img_centre;
-        if(dICSP.Dot(dDPIC) < 0.0){
-            std::swap(DetectImg, OrthoSrcImg);
-        }
-    }
+    planar_image_collection<float, double> radiographs;
+    for(const auto &t : transforms){
+        for(const auto &a : angles){
+            auto ray_source = nominal_source;
+            if(a){
+                ray_source = img_centre + rotate_about_axis(nominal_source - img_centre, img_unit, a.value() * pi / 180.0);
+            }
+            if(t){
+                t.value().apply_to(ray_source);
+            }
+            if(!ray_source.isfinite()){
+                throw std::invalid_argument("Ray source position is not finite. Cannot continue.");
+            }
+            if(ray_source.distance(img_centre) < machine_eps){
+                throw std::invalid_argument("Ray source point cannot coincide with image centre. Refusing to continue.");
+            }
+            const line<double> source_centre_line(ray_source, img_centre); 
+
+            // Determine which way will be 'up' in the radiograph. The image normal is preferred, but rays along the
+            // normal require another choice.
+            const auto ray_unit = (img_centre - ray_source).unit();
+            auto rg_up = img_unit;
+            auto rg_left = rg_up.Cross(ray_unit).unit();
+            if(!ray_unit.GramSchmidt_orthogonalize(rg_up, rg_left)){
+                rg_up = col_unit;
+                rg_left = rg_up.Cross(ray_unit).unit();
+                if(!ray_unit.GramSchmidt_orthogonalize(rg_up, rg_left)){
+                    throw std::invalid_argument("Cannot orthogonalize radiograph orientation unit vectors. Cannot continue.");
+                }
+            }
+            rg_up = rg_up.unit();
+            rg_left = rg_left.unit();
+
+            YLOGINFO("Proceeding with radiograph into-plane orientation unit vector: " << ray_unit);
+            YLOGINFO("Proceeding with radiograph leftward orientation unit vector: " << rg_left);
+            YLOGINFO("Proceeding with radiograph upward orientation unit vector: " << rg_up);
+            YLOGINFO("Proceeding with ray source at: " << ray_source);
+            YLOGINFO("Proceeding with image centre at: " << img_centre);
+
+            //------------------------
+            // Create a detector that will encompass the images.
+            //
+            // Note: We are generous here because the source is a single point. The image projection will therefore be
+            //       magnified. If the source is too close the projection will 
+            double grid_x_margin = 5.0;
+            double grid_y_margin = 5.0;
+            double grid_z_margin = 5.0;
+
+            //Generate a grid volume bounding the ROI(s). We ask for many images in order to compress the pxl_dz taken by each.
+            // Only two are actually allocated.
+            const auto NumberOfPanelImages = 1000L;
+            auto sd_image_collection = Symmetrically_Contiguously_Grid_Volume<float,double>(
+                     cc_ROIs, 
+                     grid_x_margin, grid_y_margin, grid_z_margin,
+                     RadiographRows, RadiographColumns, /*number_of_channels=*/ 1, NumberOfPanelImages, 
+                     source_centre_line, (rg_up * -1.0), rg_left,
+                     /*pixel_fill=*/ 0.0, 
+                     /*only_top_and_bottom=*/ true);
+
+            // Keep only the detector image.
+            //
+            // Note: the detector will always be on the opposite side of the image centre compared with the source point
+            // (i.e., the source will always points towards the image centre).
+            {
+                const auto dICSP = img_centre - ray_source;
+                const auto dDPIC = sd_image_collection.images.front().center() - img_centre;
+                if(dICSP.Dot(dDPIC) < 0.0){
+                    sd_image_collection.images.pop_front();
+                }else{
+                    sd_image_collection.images.pop_back();
+                }
+            }
+            radiographs.images.splice( std::end(radiographs.images), sd_image_collection.images );
 
-    DetectImg->metadata["Description"] = "Virtual radiograph detector";
-    OrthoSrcImg->metadata["Description"] = "(unused)";
+            auto &det = radiographs.images.back();
+            det.metadata["Description"] = "Virtual radiograph detector";
+            if(a){
+                det.metadata["GantryAngle"] = std::to_string(a.value());
+            }
 
-    const auto detector_plane = DetectImg->image_plane();
+            projections.emplace_back();
+            projections.back().source = ray_source;
+            projections.back().angle = a;
+            projections.back().detector = &det;
+        }
+    }
+    YLOGINFO("Simulating " << projections.size() << " radiograph(s)");
 
     //------------------------
-    // March rays through the image data.
+    // Trace rays through the attenuation volume. Each task handles a single detector row of a single projection.
     {
         std::mutex printer; // Who gets to print to the console and iterate the counter.
         int64_t completed = 0;
+        int64_t last_percent = -1;
+        const auto N_tasks = static_cast<int64_t>(projections.size()) * RadiographRows;
 
         work_queue<std::function<void(void)>> wq;
-        for(int64_t RadiographRow = 0; RadiographRow < RadiographRows; ++RadiographRow){
-            wq.submit_task([&,RadiographRow]() -> void {
-                for(int64_t RadiographCol = 0; RadiographCol < RadiographColumns; ++RadiographCol){
-
-                    // Construct a line segment between the source and detector. 
-                    const auto ray_terminus = DetectImg->position(RadiographRow, RadiographCol);
-                    const auto ray_line = line<double>(ray_source, ray_terminus);
-
-                    // Find the intersection of the ray with the detector bounding planes.
-                    vec3<double> detector_panel_bp_intersection;
-                    if(!detector_plane.Intersects_With_Line_Once(ray_line, detector_panel_bp_intersection)){
-                        throw std::logic_error("Ray line does not intersect far image array bounding plane. Cannot continue.");
-                    }
-                    const auto ray_ls = line_segment<double>(ray_source, detector_panel_bp_intersection);
-
-                    // Find the intersections of the ray and the bounding box containing the images.
-                    std::vector<vec3<double>> bp_intersections;
-                    for(const auto & img_bp : img_bps){
-                        vec3<double> P;
-                        //if(img_bp.Intersects_With_Line_Once(ray_line, P)){
-                        if(img_bp.Intersects_With_Line_Segment_Once(ray_ls, P)){
-
-                            // Determine if the intersection point is on a face of the cube.
-                            const auto bp_centre = img_bp.Project_Onto_Plane_Orthogonally(img_centre);
-                            const auto dP = (P - bp_centre);
-                            const auto dP_row = std::abs(dP.Dot(row_unit));
-                            const auto dP_col = std::abs(dP.Dot(col_unit));
-                            const auto dP_img = std::abs(dP.Dot(img_unit));
-
-                            const auto max_row = (static_cast<double>(N_rows) * pxl_dx * 0.5);
-                            const auto max_col = (static_cast<double>(N_cols) * pxl_dy * 0.5);
-                            const auto max_img = (static_cast<double>(N_imgs) * pxl_dz * 0.5);
-
-                            if( (dP_row <= max_row)
-                            &&  (dP_col <= max_col)
-                            &&  (dP_img <= max_img) ){
-                                bp_intersections.emplace_back(P);
-                            }
-                        }
-                    }
-
-                    // Explicitly add the ray source point if it is bounded within the image volume.
-                    if(ray_source_is_within_image_volume){
-                        bp_intersections.emplace_back(ray_source);
-                    }
+        for(const auto &p : projections){
+            for(int64_t RadiographRow = 0; RadiographRow < RadiographRows; ++RadiographRow){
+                wq.submit_task([&,RadiographRow]() -> void {
+                    auto *DetectImg = p.detector;
+                    const auto first_pixel = DetectImg->position(RadiographRow, 0);
+                    const auto col_step = (1 < RadiographColumns) ? (DetectImg->position(RadiographRow, 1) - first_pixel)
+                                                                  : vec3<double>(0.0, 0.0, 0.0);
+
+                    std::vector<double> accumulated_attenuation_length_product;
+                    trace_detector_row(vol, p.source, first_pixel, col_step, RadiographColumns,
+                                       accumulated_attenuation_length_product);
 
-                    // Skip rays that do not intersect the image volume twice.
-                    if(bp_intersections.size() != 2){
-                        continue;
+                    //Record the result in the image.
+                    for(int64_t RadiographCol = 0; RadiographCol < RadiographColumns; ++RadiographCol){
+                        DetectImg->reference(RadiographRow, RadiographCol, 0)
+                            = static_cast<float>(accumulated_attenuation_length_product[RadiographCol]);
                     }
 
-                    // Explicitly state the ray start and end positions using identified bounding-box intersection points.
-                    const vec3<double> ray_start = bp_intersections[0];
-                    const vec3<double> ray_end = bp_intersections[1];
-                    const auto ray_direction = (ray_end - ray_start).unit();
-                    const auto ray_total_sq_dist = ray_end.sq_dist(ray_start);
-
-                    // Determine whether moving from tail to head along the ray will increase or decrease the
-                    // row/col/img coordinates. Note that the direction will never change.
-                    const int64_t incr_row = (row_unit.Dot(ray_direction) < 0.0) ? -1L : 1L;
-                    const int64_t incr_col = (col_unit.Dot(ray_direction) < 0.0) ? -1L : 1L;
-                    const int64_t incr_img = (img_unit.Dot(ray_direction) < 0.0) ? -1L : 1L;
-
-                    // Determine the amount the ray will traverse due to incrementing i, j, or k individually.
-                    const auto true_ray_pos_dR_incr_row = ray_direction * (std::abs(row_unit.Dot(ray_direction)) * pxl_dx);
-                    const auto true_ray_pos_dR_incr_col = ray_direction * (std::abs(col_unit.Dot(ray_direction)) * pxl_dy);
-                    const auto true_ray_pos_dR_incr_img = ray_direction * (std::abs(img_unit.Dot(ray_direction)) * pxl_dz);
-
-                    const auto true_ray_pos_dR_incr_row_length = true_ray_pos_dR_incr_row.length();
-                    const auto true_ray_pos_dR_incr_col_length = true_ray_pos_dR_incr_col.length();
-                    const auto true_ray_pos_dR_incr_img_length = true_ray_pos_dR_incr_img.length();
-
-                    const auto blocky_ray_pos_dR_incr_row = row_unit * (pxl_dx * static_cast<double>(incr_row));
-                    const auto blocky_ray_pos_dR_incr_col = col_unit * (pxl_dy * static_cast<double>(incr_col));
-                    const auto blocky_ray_pos_dR_incr_img = img_unit * (pxl_dz * static_cast<double>(incr_img));
-
-                    // Determine the pseudo integer coordinates for the starting point.
-                    //
-                    // Note that these coordinates will not necessarily intersect any real voxels. They are defined only
-                    // by the (infinite) regular grid that coincides with the real voxels.
-                    const auto ray_start_grid_offset = ray_start - grid_zero;
-                    const auto ray_start_row_index = static_cast<int64_t>( std::round( ray_start_grid_offset.Dot(row_unit)/pxl_dx ) );
-                    const auto ray_start_col_index = static_cast<int64_t>( std::round( ray_start_grid_offset.Dot(col_unit)/pxl_dy ) );
-                    const auto ray_start_img_index = static_cast<int64_t>( std::round( ray_start_grid_offset.Dot(img_unit)/pxl_dz ) );
-
-                    int64_t ray_i = ray_start_row_index;
-                    int64_t ray_j = ray_start_col_index;
-                    int64_t ray_k = ray_start_img_index;
-
-                    vec3<double> true_ray_pos = ray_start;
-                    vec3<double> blocky_ray_pos = grid_zero + row_unit * (static_cast<double>(ray_i) * pxl_dx)
-                                                            + col_unit * (static_cast<double>(ray_j) * pxl_dy)
-                                                            + img_unit * (static_cast<double>(ray_k) * pxl_dz);
-
-                    // Each time the ray samples the CT number, the ray is simulated to have interacted with the medium
-                    // for the length of the ray advancement.
-                    //
-                    // For purposes of simulating a radiograph, the remaining fractional ray intensity could be
-                    // immediately reduced by multiplying by a factor of exp(-attenuation_coeff*dL). However, it is
-                    // easier to sum all the attenuation_coeff*dL contributions and apply the reduction factor once at
-                    // the end.
-                    double accumulated_attenuation_length_product = 0.0;
-                    double last_move_dist = 0.0;
-
-                    while(true){
-                        // Test which single increment (either i, j, or k) remaing the closest to the ray line.
-                        const auto cand_pos_i = blocky_ray_pos + blocky_ray_pos_dR_incr_row;
-                        const auto cand_pos_j = blocky_ray_pos + blocky_ray_pos_dR_incr_col;
-                        const auto cand_pos_k = blocky_ray_pos + blocky_ray_pos_dR_incr_img;
-
-                        const auto cand_sq_dist_i = ray_line.Sq_Distance_To_Point( cand_pos_i );
-                        const auto cand_sq_dist_j = ray_line.Sq_Distance_To_Point( cand_pos_j );
-                        const auto cand_sq_dist_k = ray_line.Sq_Distance_To_Point( cand_pos_k );
-
-                        if( (cand_sq_dist_i <= cand_sq_dist_j) && (cand_sq_dist_i <= cand_sq_dist_k) ){
-                            blocky_ray_pos = cand_pos_i;
-                            true_ray_pos += true_ray_pos_dR_incr_row;
-                            last_move_dist = true_ray_pos_dR_incr_row_length;
-                            ray_i += incr_row;
-                        }else if( cand_sq_dist_j <= cand_sq_dist_k ){
-                            blocky_ray_pos = cand_pos_j;
-                            true_ray_pos += true_ray_pos_dR_incr_col;
-                            last_move_dist = true_ray_pos_dR_incr_col_length;
-                            ray_j += incr_col;
-                        }else{
-                            blocky_ray_pos = cand_pos_k;
-                            true_ray_pos += true_ray_pos_dR_incr_img;
-                            last_move_dist = true_ray_pos_dR_incr_img_length;
-                            ray_k += incr_img;
-                        }
-
-                        // Terminate if the geometry is invalid.
-                        if( pxl_diagonal_sq_length < true_ray_pos.sq_dist(blocky_ray_pos) ){
-                            throw std::runtime_error("Real ray position and blocky ray position differ by more than a voxel diagonal");
-                        }
-
-                        // Process the voxel.
-                        if( ( 0 <= ray_i ) && (ray_i < N_rows)
-                        &&  ( 0 <= ray_j ) && (ray_j < N_cols)
-                        &&  ( 0 <= ray_k ) && (ray_k < N_imgs) ){
-                            const auto intersecting_img_refw = img_adj.index_to_image(ray_k);
-                            const auto voxel_val = intersecting_img_refw.get().value(ray_i, ray_j, Channel);
-
-                            // Ficticious mass density encountered by the ray.
-                            const auto intensity = (voxel_val < -1000.0f) ? -1000.0f : voxel_val; // Enforce physicality.
-                            const auto attenuation_coeff = 1.0f + (intensity / 1000.0f); 
-
-                            accumulated_attenuation_length_product += attenuation_coeff * last_move_dist;
-                            
-                            // Could alternately invoke a more generic user function using (i,j,k) and the various ray
-                            // positions/distances here.
-
-                            //  ... TODO ...
-
-                        }
-
-                        // Terminate if the ray has traveled far enough.
-                        const auto ray_traveled_sq_dist = ray_start.sq_dist(true_ray_pos);
-                        if(ray_total_sq_dist <= ray_traveled_sq_dist){
-                            break;
+                    {
+                        // Report progress, but only when the whole-number percentage changes.
+                        std::lock_guard<std::mutex> lock(printer);
+                        ++completed;
+                        const auto percent = (100 * completed) / N_tasks;
+                        if(last_percent < percent){
+                            last_percent = percent;
+                            YLOGINFO("Completed " << completed << " of " << N_tasks
+                                  << " --> " << static_cast<int>(1000.0*(completed)/N_tasks)/10.0 << "% done");
                         }
                     }
-
-                    //Record the result in the image.
-                    DetectImg->reference(RadiographRow, RadiographCol, 0) = static_cast<float>(accumulated_attenuation_length_product);
-                }
-
-                {
-                    // Report progress.
-                    std::lock_guard<std::mutex> lock(printer);
-                    ++completed;
-                    YLOGINFO("Completed " << completed << " of " << RadiographRows 
-                          << " --> " << static_cast<int>(1000.0*(completed)/RadiographRows)/10.0 << "% done");
-                }
-            });
-
+                });
+            }
         }
     } // Complete tasks and terminate thread pool.
 
@@ -593,11 +698,13 @@ bool SimulateRadiograph(Drover &DICOM_data,
 
     }else if(imgmodel_is_exp){
         // Implement a generic radiograph image with exponential attenuation.
-        for(int64_t row = 0; row < RadiographRows; ++row){
-            for(int64_t col = 0; col < RadiographColumns; ++col){
-                const auto alp = DetectImg->reference(row, col, 0);
-                const auto att = 1.0 - std::exp(-alp * AttenuationScale);
-                DetectImg->reference(row, col, 0) = att;
+        for(auto &DetectImg : radiographs.images){
+            for(int64_t row = 0; row < RadiographRows; ++row){
+                for(int64_t col = 0; col < RadiographColumns; ++col){
+                    const auto alp = DetectImg.reference(row, col, 0);
+                    const auto att = 1.0 - std::exp(-alp * AttenuationScale);
+                    DetectImg.reference(row, col, 0) = att;
+                }
             }
         }
 
@@ -610,17 +717,15 @@ bool SimulateRadiograph(Drover &DICOM_data,
         FilenameStr = Get_Unique_Sequential_Filename("/tmp/dicomautomaton_simulateradiograph_", 6, ".fits");
     }
 
-    if(!WriteToFITS(*DetectImg, FilenameStr)){
+    const bool wrote = (radiographs.images.size() == 1) ? WriteToFITS(radiographs.images.front(), FilenameStr)
+                                                        : WriteToFITS(radiographs, FilenameStr);
+    if(!wrote){
         throw std::runtime_error("Unable to write FITS file for simulated radiograph.");
     }
 
     // Insert the image maps as images for later processing and/or viewing, if desired.
-    *OrthoSrcImg = *DetectImg;
-    sd_image_collection.images.resize(1);
-
     DICOM_data.image_data.emplace_back( std::make_shared<Image_Array>() );
-    DICOM_data.image_data.back()->imagecoll = sd_image_collection;
+    DICOM_data.image_data.back()->imagecoll = radiographs;
 
     return true;
 }
-
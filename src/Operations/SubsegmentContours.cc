@@ -18,7 +18,7 @@
 #include <vector>
 #include <numeric>
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "YgorMath.h"         //Needed for vec3 class.
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
@@ -283,7 +283,7 @@ bool SubsegmentContours(Drover &DICOM_data,
                  << ZSelectionLower << " and " << ZSelectionUpper << " respectively");
     }
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     // Stuff references to all contours into a list. Remember that you can still address specific contours through
     // the original holding containers (which are not modified here).
@@ -25,7 +25,7 @@
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
 #include "../YgorImages_Functors/Compute/AccumulatePixelDistributions.h"
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "Subsegment_ComputeDose_VanLuijk.h"
 #include "YgorFilesDirs.h"    //Needed for Does_File_Exist_And_Can_Be_Read(...), etc..
 #include "YgorImages.h"
@@ -285,7 +285,7 @@ bool Subsegment_ComputeDose_VanLuijk(Drover &DICOM_data,
                  << ZSelectionLower << " and " << ZSelectionUpper << " respectively");
     }
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //Merge the dose arrays if multiple are available.
     DICOM_data = Meld_Only_Dose_Data(DICOM_data);
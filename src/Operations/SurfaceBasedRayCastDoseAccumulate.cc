@@ -49,11 +49,7 @@
 
 #include <CGAL/subdivision_method_3.h>
 
-#include <CGAL/AABB_tree.h>
-#include <CGAL/AABB_traits.h>
 #include <CGAL/boost/graph/graph_traits_Polyhedron_3.h>
-#include <CGAL/AABB_face_graph_triangle_primitive.h>
-#include <boost/optional.hpp>
 
 
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
@@ -73,12 +69,13 @@
 #include "YgorImagesIO.h"
 #include "YgorImagesPlotting.h"
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "../Structs.h"
 #include "../Regex_Selectors.h"
 #include "../Thread_Pool.h"
 #include "../Surface_Meshes.h"
+#include "../Surface_Mesh_BVH.h"
 #include "../Dose_Meld.h"
 
 #include "../YgorImages_Functors/Grouping/Misc_Functors.h"
@@ -135,8 +132,9 @@ OperationDoc OpArgDocSurfaceBasedRayCastDoseAccumulate(){
         " Though it is not required by the implementation, only the ray-surface intersection nearest to the detector is"
         " considered. All other intersections (i.e., on the far side of the surface mesh) are ignored."
         " This routine is fairly fast compared to the slow grid-based counterpart previously implemented. The speedup comes"
-        " from use of an AABB-tree to accelerate intersection queries and avoid having to 'walk' rays step-by-step through"
-        " over/through the geometry.";
+        " from use of a bounding volume hierarchy to accelerate intersection queries and avoid having to 'walk' rays"
+        " step-by-step through over/through the geometry. Adjacent rays are traced together in small packets that share"
+        " a single traversal of the hierarchy.";
 
 
     out.args.emplace_back();
@@ -454,7 +452,7 @@ bool SurfaceBasedRayCastDoseAccumulate(Drover &DICOM_data,
     const auto refnormalizedregex = Compile_Regex(NormalizedReferenceROILabelRegex);
     const auto TrueRegex = Compile_Regex("^tr?u?e?$");
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
 
     //Boolean options.
@@ -608,21 +606,9 @@ bool SurfaceBasedRayCastDoseAccumulate(Drover &DICOM_data,
     if(OnlyGenerateSurface) return true;
 
 
-    // ================================ Construct AABB Trees for Spatial Lookups ===================================
-    //typedef CGAL::Exact_predicates_inexact_constructions_kernel Kernel;
-    using Kernel                = dcma_surface_meshes::Kernel;
-    using Point                 = Kernel::Point_3;
-    using Segment               = Kernel::Segment_3;
-    using Line                  = Kernel::Line_3;
-    using Triangle_Primitive    = CGAL::AABB_face_graph_triangle_primitive<dcma_surface_meshes::Polyhedron>;
-    using Traits                = CGAL::AABB_traits<Kernel, Triangle_Primitive>;
-    using AABB_Tree             = CGAL::AABB_tree<Traits>;
-    using Segment_intersection  = boost::optional<AABB_Tree::Intersection_and_primitive_id<Segment>::Type>;
-    //using Line_intersection     = boost::optional<AABB_Tree::Intersection_and_primitive_id<Line>::Type>;
-
-    //Construct the tree.
-    AABB_Tree tree(faces(polyhedron).first, faces(polyhedron).second, polyhedron);
-    AABB_Tree ref_tree(faces(ref_polyhedron).first, faces(ref_polyhedron).second, ref_polyhedron);
+    // ================================ Construct BVHs for Spatial Lookups ===================================
+    const surface_mesh_bvh bvh( dcma_surface_meshes::PolyhedronToFVSMesh(polyhedron) );
+    const surface_mesh_bvh ref_bvh( dcma_surface_meshes::PolyhedronToFVSMesh(ref_polyhedron) );
 
     //Figure out what z-margin is needed so the extra two images do not interfere with the grid lining up with the
     // contours. (Want exactly one contour plane per image.) So the margin should be large enough so the empty
@@ -761,93 +747,90 @@ bool SurfaceBasedRayCastDoseAccumulate(Drover &DICOM_data,
         work_queue<std::function<void(void)>> wq;
         for(int64_t row = 0; row < SourceDetectorRows; ++row){
             wq.submit_task([&,row]() -> void {
-                for(int64_t col = 0; col < SourceDetectorColumns; ++col){
+                // Adjacent detector pixels are traced together as a packet since their rays are coherent.
+                const int64_t packet_size = static_cast<int64_t>(surface_mesh_bvh::max_packet_size);
+                std::vector<bvh_ray> segments;
+                std::vector<bvh_ray> lines;
+                std::vector<std::vector<double>> hits;
+                std::vector<bool> ref_hits;
+                std::vector<std::pair<double, vec3<double>>> points; // (distance to detector, intersection point).
+
+                for(int64_t col_0 = 0; col_0 < SourceDetectorColumns; col_0 += packet_size){
+                    const auto col_1 = std::min<int64_t>(SourceDetectorColumns, col_0 + packet_size);
+
+                    //Construct a line segment between the source and detector for each ray.
+                    segments.clear();
+                    for(int64_t col = col_0; col < col_1; ++col){
+                        const vec3<double> ray_start = SourceImg->position(row, col); // The naive starting position, without boosting.
+                        const vec3<double> ray_end = DetectImg->position(row, col);
+                        segments.emplace_back();
+                        segments.back().origin = ray_start;
+                        segments.back().dir = ray_end - ray_start;
+                        segments.back().t_min = 0.0;
+                        segments.back().t_max = 1.0;
+                    }
+                    const auto N_rays = segments.size();
+
+                    //Enumerate all intersections. Glancing intersections, where the segment lies in a facet's plane,
+                    // are not reported.
+                    for(auto &h : hits) h.clear();
+                    bvh.all_intersections(segments.data(), N_rays, hits);
+
+                    //Determine whether the reference ROI is orthogonally adjacent, i.e., whether the infinite line
+                    // containing each ray intersects it anywhere.
+                    lines = segments;
+                    for(auto &l : lines){
+                        l.t_min = -std::numeric_limits<double>::infinity();
+                        l.t_max =  std::numeric_limits<double>::infinity();
+                    }
+                    ref_bvh.any_intersections(lines.data(), N_rays, ref_hits);
+
+                    for(size_t i = 0; i < N_rays; ++i){
+                        const auto col = col_0 + static_cast<int64_t>(i);
+                        int64_t accumulated_counts = 0;      //The number of ray-surface intersections.
+                        int64_t ref_accumulated_counts = 0;  //Whether the ray intersects the reference ROI anywhere..
+                        double accumulated_totaldose = 0.0;   //The total accumulated dose from all intersections.
+
+                        //Sort by distance from the detector so the first intersection is closest to the detector.
+                        points.clear();
+                        for(const auto &t : hits[i]){
+                            const auto P = segments[i].origin + segments[i].dir * t;
+                            points.emplace_back( std::abs( detector_plane.Get_Signed_Distance_To_Point(P) ), P );
+                        }
+                        std::sort(std::begin(points), std::end(points),
+                                  [](const std::pair<double, vec3<double>> &A, const std::pair<double, vec3<double>> &B){
+                                      return (A.first < B.first);
+                                  });
 
-                    //Construct a line segment between the source and detector. 
-                    int64_t accumulated_counts = 0;      //The number of ray-surface intersections.
-                    int64_t ref_accumulated_counts = 0;  //Whether the ray intersects the reference ROI anywhere..
-                    double accumulated_totaldose = 0.0;   //The total accumulated dose from all intersections.
-                    const vec3<double> ray_start = SourceImg->position(row, col); // The naive starting position, without boosting.
-                    const vec3<double> ray_end = DetectImg->position(row, col);
+                        //Cycle through the intersections stopping after the point nearest the detector is located.
+                        for(const auto &p : points){
+                            const auto &P = p.second;
 
-                    Segment line_segment( Point(ray_start.x, ray_start.y, ray_start.z),
-                                          Point(ray_end.x,   ray_end.y,   ray_end.z)   );
+                            //Record the distance to the detector.
+                            DepthImg->reference(row, col, accumulated_counts) = static_cast<float>( p.first );
 
-                    //Fast check for intersections.
-                    if(tree.do_intersect(line_segment)){
+                            //Compute the distance to the COM-COM line (between target ROI and reference ROI).
+                            const auto P_rad_dist = COM_COM_line.Distance_To_Point(P);
+                            RadialDistImg->reference(row, col, accumulated_counts) = static_cast<float>( P_rad_dist );
 
-                        //Enumerate all intersections. Note that some may be line segment "glances."
-                        std::list<Segment_intersection> intersections;
-                        tree.all_intersections(line_segment, std::back_inserter(intersections));
+                            //Find the dose at the intersection point.
+                            const auto interp_val = img_arr_ptr->imagecoll.trilinearly_interpolate(P,0);
 
-                        //Sort by distance from the detector so the first intersection is closest to the detector.
-                        intersections.sort([&](const Segment_intersection &A, const Segment_intersection &B) -> bool {
-                            const Point *pA = boost::get<Point>(&(A->first));
-                            const Point *pB = boost::get<Point>(&(B->first));
-                            if( (pA) && (pB) ){ // Both valid points.
-                                const vec3<double> PA(static_cast<double>( CGAL::to_double( pA->x() )),
-                                                      static_cast<double>( CGAL::to_double( pA->y() )),
-                                                      static_cast<double>( CGAL::to_double( pA->z() )));
-                                const vec3<double> PB(static_cast<double>( CGAL::to_double( pB->x() )),
-                                                      static_cast<double>( CGAL::to_double( pB->y() )),
-                                                      static_cast<double>( CGAL::to_double( pB->z() )));
-                                return std::abs( detector_plane.Get_Signed_Distance_To_Point(PA) ) 
-                                          < std::abs( detector_plane.Get_Signed_Distance_To_Point(PB) );
-                            }else if((pA) && !(pB)){
-                                return true;
-                            }else if(!(pA) && (pB)){
-                                return false;
-                            }
-                            return false; //Both non-points.
-
-                        });
+                            accumulated_totaldose += interp_val;
+                            ++accumulated_counts;
+                            if(ref_hits[i]) ++ref_accumulated_counts;
 
-                        //Cycle through the intersections stopping after the point nearest the detector is located.
-                        for(const auto & intersection : intersections){
-                            if(intersection){
-                                const Point* p = boost::get<Point>(&(intersection->first));
-                                if(p){
-                                    //Convert from CGAL vector to Ygor vector.
-                                    const vec3<double> P(static_cast<double>( CGAL::to_double( p->x() )),
-                                                         static_cast<double>( CGAL::to_double( p->y() )),
-                                                         static_cast<double>( CGAL::to_double( p->z() )));
-
-                                    //Compute the distance to the detector.
-                                    const auto P_src_dist = std::abs( detector_plane.Get_Signed_Distance_To_Point(P) );
-                                    DepthImg->reference(row, col, accumulated_counts) = static_cast<float>( P_src_dist );
-
-                                    //Compute the distance to the COM-COM line (between target ROI and reference ROI).
-                                    const auto P_rad_dist = COM_COM_line.Distance_To_Point(P);
-                                    RadialDistImg->reference(row, col, accumulated_counts) = static_cast<float>( P_rad_dist );
-
-                                    //Find the dose at the intersection point.
-                                    const auto interp_val = img_arr_ptr->imagecoll.trilinearly_interpolate(P,0);
-
-                                    accumulated_totaldose += interp_val;
-                                    ++accumulated_counts;
-
-                                    //Determine whether the reference ROI is orthogonally adjacent to this intersection.
-                                    Line cgal_line( Point(ray_start.x, ray_start.y, ray_start.z),
-                                                    Point(ray_end.x,   ray_end.y,   ray_end.z)   );
-                                    
-                                    //Fast check for intersections with the reference ROI.
-                                    if(ref_tree.do_intersect(cgal_line)){
-                                        ++ref_accumulated_counts;
-                                    }
-
-                                    //Terminate the loop after desired number of intersections.
-                                    if(accumulated_counts >= MaxRaySurfaceIntersections) break;
-                                }
-                            }
+                            //Terminate the loop after desired number of intersections.
+                            if(accumulated_counts >= MaxRaySurfaceIntersections) break;
                         }
-                    }
 
-                    //Deposit the dose in the images.
-                    SourceImg->reference(row, col, 0)    = static_cast<float>(accumulated_counts);
-                    DetectImg->reference(row, col, 0)    = static_cast<float>(accumulated_totaldose);
-                    DetectRefImg->reference(row, col, 0) = static_cast<float>(ref_accumulated_counts);
-                    if(ref_accumulated_counts != 0){
-                        RefCroppedImg->reference(row, col, 0)    = static_cast<float>(accumulated_totaldose);
+                        //Deposit the dose in the images.
+                        SourceImg->reference(row, col, 0)    = static_cast<float>(accumulated_counts);
+                        DetectImg->reference(row, col, 0)    = static_cast<float>(accumulated_totaldose);
+                        DetectRefImg->reference(row, col, 0) = static_cast<float>(ref_accumulated_counts);
+                        if(ref_accumulated_counts != 0){
+                            RefCroppedImg->reference(row, col, 0)    = static_cast<float>(accumulated_totaldose);
+                        }
                     }
                 }
 
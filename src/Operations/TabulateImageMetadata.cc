@@ -20,7 +20,7 @@
 #include "YgorLog.h"
 #include "YgorString.h"       //Needed for GetFirstRegex(...)
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 
 #include "../Structs.h"
 #include "../Metadata.h"
@@ -116,7 +116,7 @@ bool TabulateImageMetadata(Drover &DICOM_data,
                                           std::map<std::string, std::string>& /*InvocationMetadata*/,
                                           const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto ImageSelectionStr = OptArgs.getValueStr("ImageSelection").value();
@@ -22,7 +22,7 @@
 #include "../YgorImages_Functors/ConvenienceRoutines.h"
 
 #include "ThresholdImages.h"
-#include "Explicator.h"       //Needed for Explicator class.
+#include "../Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
@@ -118,7 +118,7 @@ bool ThresholdImages(Drover &DICOM_data,
                        std::map<std::string, std::string>& /*InvocationMetadata*/,
                        const std::string& FilenameLex){
 
-    Explicator X(FilenameLex);
+    Shared_Lexicon X(FilenameLex);
 
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto LowerStr = OptArgs.getValueStr("Lower").value();
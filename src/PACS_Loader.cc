@@ -24,7 +24,7 @@
 
 #include <pqxx/pqxx>          //PostgreSQL C++ interface.
 
-#include "Explicator.h"       //Needed for Explicator class.
+#include "Lexicon_Loader.h"       //Needed for Shared_Lexicon class.
 #include "Imebra_Shim.h"      //Wrapper for Imebra library. Black-boxed to speed up compilation.
 #include "Structs.h"
 #include "YgorFilesDirs.h"    //Needed for Does_File_Exist_And_Can_Be_Read(...), etc..
@@ -279,7 +279,7 @@ bool Load_From_PACS_DB( Drover &DICOM_data,
 
     //Attempt contour name normalization using the selected lexicon.
     {
-        Explicator X(FilenameLex);
+        Shared_Lexicon X(FilenameLex);
         for(auto & cc : loaded_contour_data_storage->ccs){
              for(auto & c : cc.contours){
                  const auto NormalizedROIName = X(c.metadata["ROIName"]); //Could be cached, externally or internally.
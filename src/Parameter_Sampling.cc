@@ -0,0 +1,227 @@
+//Parameter_Sampling.cc - A part of DICOMautomaton 2026.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "YgorMisc.h"
+#include "YgorLog.h"
+#include "YgorString.h"
+
+#include "Regex_Selectors.h"
+#include "String_Parsing.h"
+#include "Thread_Pool.h"
+
+#include "Parameter_Sampling.h"
+
+
+double parameter_distribution::sample(std::mt19937 &re) const {
+    // Note: degenerate distributions (e.g., with zero width) are handled explicitly since the standard library
+    // distributions do not permit them.
+    if(this->type == kind::normal){
+        if(this->params.at(1) == 0.0) return this->params.at(0);
+        std::normal_distribution<double> rd(this->params.at(0), this->params.at(1));
+        return rd(re);
+
+    }else if(this->type == kind::lognormal){
+        const auto sigma = std::log(this->params.at(1));
+        if(sigma == 0.0) return this->params.at(0);
+        std::lognormal_distribution<double> rd(std::log(this->params.at(0)), sigma);
+        return rd(re);
+
+    }else if(this->type == kind::uniform){
+        std::uniform_real_distribution<double> rd(this->params.at(0), this->params.at(1));
+        return rd(re);
+
+    }else if(this->type == kind::triangular){
+        // Inverse transform sampling.
+        const auto a = this->params.at(0);
+        const auto c = this->params.at(1);
+        const auto b = this->params.at(2);
+        std::uniform_real_distribution<double> rd(0.0, 1.0);
+        const auto u = rd(re);
+        if(u < (c - a) / (b - a)){
+            return a + std::sqrt(u * (b - a) * (c - a));
+        }
+        return b - std::sqrt((1.0 - u) * (b - a) * (b - c));
+    }
+    throw std::logic_error("Distribution not understood");
+    return 0.0;
+}
+
+
+std::map<std::string, parameter_distribution>
+parse_parameter_distributions(const std::string &spec,
+                              const std::map<std::string, double> &nominal){
+    const auto regex_normal = Compile_Regex("^no?r?m?a?l?$|^ga?u?s?s?i?a?n?$");
+    const auto regex_lognormal = Compile_Regex("^lo?g?[-_]?no?r?m?a?l?$");
+    const auto regex_uniform = Compile_Regex("^un?i?f?o?r?m?$");
+    const auto regex_triangular = Compile_Regex("^tr?i?a?n?g?u?l?a?r?$");
+
+    std::map<std::string, parameter_distribution> out;
+    for(const auto &pf : parse_functions(spec)){
+        if(!pf.children.empty()){
+            throw std::invalid_argument("Children functions are not accepted");
+        }
+        if(pf.parameters.empty()){
+            throw std::invalid_argument("Distribution '"_s + pf.name + "' must name a parameter");
+        }
+        const auto name = pf.parameters.front().raw;
+        const auto n_it = nominal.find(name);
+        if(n_it == std::end(nominal)){
+            throw std::invalid_argument("Parameter '"_s + name + "' is not recognized");
+        }
+        if(out.count(name) != 0){
+            throw std::invalid_argument("Parameter '"_s + name + "' was given multiple distributions");
+        }
+
+        parameter_distribution d;
+        size_t N_expected = 2;
+        if(std::regex_match(pf.name, regex_lognormal)){
+            d.type = parameter_distribution::kind::lognormal;
+        }else if(std::regex_match(pf.name, regex_normal)){
+            d.type = parameter_distribution::kind::normal;
+        }else if(std::regex_match(pf.name, regex_uniform)){
+            d.type = parameter_distribution::kind::uniform;
+        }else if(std::regex_match(pf.name, regex_triangular)){
+            d.type = parameter_distribution::kind::triangular;
+            N_expected = 3;
+        }else{
+            throw std::invalid_argument("Distribution '"_s + pf.name + "' not understood");
+        }
+        if(pf.parameters.size() != (N_expected + 1)){
+            throw std::invalid_argument("Incorrect number of arguments were provided for distribution '"_s + pf.name + "'");
+        }
+
+        for(size_t i = 1; i < pf.parameters.size(); ++i){
+            const auto &fp = pf.parameters[i];
+            if(!fp.number){
+                throw std::invalid_argument("Unable to parse distribution argument '"_s + fp.raw + "'");
+            }
+            auto x = fp.number.value();
+            if(fp.is_fractional){
+                x *= n_it->second;
+            }else if(fp.is_percentage){
+                x *= n_it->second / 100.0;
+            }
+            if(!std::isfinite(x)){
+                throw std::invalid_argument("Distribution arguments must be finite");
+            }
+            d.params.push_back(x);
+        }
+
+        // Validate the arguments now rather than when sampling.
+        const auto &p = d.params;
+        if( (d.type == parameter_distribution::kind::normal) && !(0.0 <= p[1]) ){
+            throw std::invalid_argument("Normal distribution standard deviation must be non-negative");
+        }else if( (d.type == parameter_distribution::kind::lognormal) && (!(0.0 < p[0]) || !(1.0 <= p[1])) ){
+            throw std::invalid_argument("Log-normal distribution requires a positive median and a geometric standard deviation of at least 1");
+        }else if( (d.type == parameter_distribution::kind::uniform) && !(p[0] < p[1]) ){
+            throw std::invalid_argument("Uniform distribution bounds must be increasing");
+        }else if( (d.type == parameter_distribution::kind::triangular) && (!(p[0] <= p[1]) || !(p[1] <= p[2]) || !(p[0] < p[2])) ){
+            throw std::invalid_argument("Triangular distribution requires lower <= mode <= upper");
+        }
+
+        YLOGINFO("Parameter '" << name << "' will be sampled from a '" << pf.name << "' distribution");
+        out[name] = d;
+    }
+    return out;
+}
+
+
+std::vector<std::map<std::string, double>>
+sample_parameters(const std::map<std::string, double> &nominal,
+                  const std::map<std::string, parameter_distribution> &dists,
+                  int64_t N,
+                  uint64_t seed){
+    std::vector<std::map<std::string, double>> out;
+    if(N <= 0) return out;
+    out.reserve(static_cast<size_t>(N));
+
+    std::mt19937 re(seed);
+    for(int64_t i = 0; i < N; ++i){
+        out.emplace_back(nominal);
+        for(const auto &d : dists){
+            out.back()[d.first] = d.second.sample(re);
+        }
+    }
+    return out;
+}
+
+
+std::vector<std::vector<double>>
+summarize_sampled_model(const std::vector<std::map<std::string, double>> &samples,
+                        const std::function<std::vector<double>(const std::map<std::string, double> &)> &model,
+                        const std::vector<double> &percentiles){
+    std::vector<std::vector<double>> out;
+    const auto N = samples.size();
+    if(N == 0) return out;
+
+    // Evaluate the first set serially to determine the number of outputs.
+    const auto first = model(samples.front());
+    const auto N_outputs = first.size();
+    std::vector<std::vector<double>> vals(N_outputs, std::vector<double>(N, 0.0));
+    for(size_t j = 0; j < N_outputs; ++j) vals[j][0] = first[j];
+
+    std::mutex saver;
+    bool ok = true;
+    {
+        // Each task handles a contiguous block of samples to amortize the queueing overhead.
+        const size_t block = 64;
+        work_queue<std::function<void(void)>> wq;
+        for(size_t begin = 1; begin < N; begin += block){
+            const auto end = std::min(N, begin + block);
+            wq.submit_task([&,begin,end]() -> void {
+                try{
+                    for(size_t i = begin; i < end; ++i){
+                        const auto res = model(samples[i]);
+                        if(res.size() != N_outputs){
+                            throw std::logic_error("Inconsistent number of outputs");
+                        }
+                        for(size_t j = 0; j < N_outputs; ++j) vals[j][i] = res[j];
+                    }
+                }catch(const std::exception &e){
+                    std::lock_guard<std::mutex> lock(saver);
+                    YLOGWARN("Model evaluation failed: " << e.what());
+                    ok = false;
+                }
+            });
+        }
+    } // Complete tasks and terminate thread pool.
+    if(!ok){
+        throw std::runtime_error("Unable to evaluate model for all parameter samples");
+    }
+
+    // Non-finite outputs (e.g., from non-physical parameter sets) are excluded from the summaries.
+    out.reserve(N_outputs);
+    for(auto &v : vals){
+        v.erase( std::remove_if(std::begin(v), std::end(v), [](double x){ return !std::isfinite(x); }), std::end(v) );
+        std::sort(std::begin(v), std::end(v));
+        out.emplace_back();
+        const auto M = v.size();
+        if(M < N){
+            YLOGWARN("Excluded " << (N - M) << " non-finite model outputs from summary");
+        }
+        for(const auto &p : percentiles){
+            if(M == 0){
+                out.back().push_back( std::numeric_limits<double>::quiet_NaN() );
+                continue;
+            }
+            const auto x = std::clamp(p / 100.0, 0.0, 1.0) * static_cast<double>(M - 1);
+            const auto lo = static_cast<size_t>(std::floor(x));
+            const auto hi = std::min(lo + 1, M - 1);
+            const auto f = x - static_cast<double>(lo);
+            out.back().push_back( v[lo] * (1.0 - f) + v[hi] * f );
+        }
+    }
+    return out;
+}
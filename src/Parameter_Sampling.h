@@ -0,0 +1,56 @@
+//Parameter_Sampling.h.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+
+// A univariate distribution from which a model parameter can be drawn, e.g., to propagate parameter uncertainty
+// through a model.
+struct parameter_distribution {
+    enum class kind {
+        normal,     // Parameters are (mean, standard deviation).
+        lognormal,  // Parameters are (median, geometric standard deviation).
+        uniform,    // Parameters are (lower bound, upper bound).
+        triangular, // Parameters are (lower bound, mode, upper bound).
+    } type = kind::normal;
+
+    std::vector<double> params;
+
+    double sample(std::mt19937 &re) const;
+};
+
+
+// Parses distribution specifications like 'normal(TD50, 26.8, 2.0); uniform(m, 0.40, 0.50)' where the first argument
+// names the parameter. Numbers with a fractional ('1.1x') or percentage ('110%') suffix are taken relative to the
+// parameter's nominal value.
+//
+// Every named parameter must be present in the provided nominal values. Parameters can be specified at most once.
+std::map<std::string, parameter_distribution>
+parse_parameter_distributions(const std::string &spec,
+                              const std::map<std::string, double> &nominal);
+
+
+// Draws N sets of parameters. Parameters without a distribution retain their nominal values in every set.
+//
+// Samples are drawn sequentially from a single generator, so the result depends only on the seed and is independent
+// of how the samples are subsequently evaluated.
+std::vector<std::map<std::string, double>>
+sample_parameters(const std::map<std::string, double> &nominal,
+                  const std::map<std::string, parameter_distribution> &dists,
+                  int64_t N,
+                  uint64_t seed);
+
+
+// Evaluates a model for every parameter set, in parallel, and summarizes each of the model's outputs using the given
+// percentiles (in [0:100]). The model must be thread-safe and return the same number of outputs for every parameter
+// set. The result is indexed as [output][percentile]. Percentiles are linearly interpolated between samples.
+std::vector<std::vector<double>>
+summarize_sampled_model(const std::vector<std::map<std::string, double>> &samples,
+                        const std::function<std::vector<double>(const std::map<std::string, double> &)> &model,
+                        const std::vector<double> &percentiles);
@@ -0,0 +1,861 @@
+//Raw_Volume_IO.cc - A part of DICOMautomaton 2026.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include <zlib.h>
+
+#include "YgorImages.h"
+#include "YgorMath.h"         //Needed for vec3 class.
+#include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
+#include "YgorLog.h"
+#include "YgorString.h"       //Needed for the _s literal.
+#include "YgorFilesDirs.h"    //Needed for Get_Unique_Sequential_Filename().
+
+#include "Metadata.h"
+#include "Regex_Selectors.h"
+#include "Structs.h"
+#include "Thread_Pool.h"
+#include "Raw_Volume_IO.h"
+
+
+size_t raw_voxel_size(raw_voxel_type t){
+    switch(t){
+        case raw_voxel_type::int8:    return 1;
+        case raw_voxel_type::uint8:   return 1;
+        case raw_voxel_type::int16:   return 2;
+        case raw_voxel_type::uint16:  return 2;
+        case raw_voxel_type::int32:   return 4;
+        case raw_voxel_type::uint32:  return 4;
+        case raw_voxel_type::int64:   return 8;
+        case raw_voxel_type::uint64:  return 8;
+        case raw_voxel_type::float32: return 4;
+        case raw_voxel_type::float64: return 8;
+    }
+    throw std::logic_error("Voxel type not understood");
+}
+
+bool host_is_little_endian(){
+    const uint16_t test = 0x01;
+    return (*reinterpret_cast<const unsigned char *>(&test) == 0x01);
+}
+
+// Written as byte permutations over fixed-width words, which compilers can vectorize without a byte-shuffle
+// instruction (unlike scalar bswap).
+template <size_t W>
+static void byteswap_words(unsigned char *data, size_t N){
+    for(size_t i = 0; i < N; ++i){
+        unsigned char *p = data + i * W;
+        for(size_t j = 0; j < W / 2; ++j) std::swap(p[j], p[W - 1 - j]);
+    }
+    return;
+}
+
+void Byteswap_Buffer(unsigned char *data, size_t N_elements, size_t element_size){
+    switch(element_size){
+        case 1: break;
+        case 2: byteswap_words<2>(data, N_elements); break;
+        case 4: byteswap_words<4>(data, N_elements); break;
+        case 8: byteswap_words<8>(data, N_elements); break;
+        default: throw std::invalid_argument("Unsupported element size for byte swapping");
+    }
+    return;
+}
+
+
+void raw_volume_layout::set_interleaved_strides(){
+    this->s_chnl  = 1;
+    this->s_col   = this->N_chnls;
+    this->s_row   = this->s_col * this->N_cols;
+    this->s_slice = this->s_row * this->N_rows;
+    this->s_time  = this->s_slice * this->N_slices;
+    return;
+}
+
+void raw_volume_layout::set_planar_strides(){
+    this->s_col   = 1;
+    this->s_row   = this->N_cols;
+    this->s_slice = this->s_row * this->N_rows;
+    this->s_time  = this->s_slice * this->N_slices;
+    this->s_chnl  = this->s_time * this->N_times;
+    return;
+}
+
+int64_t raw_volume_layout::N_voxels() const {
+    return this->N_cols * this->N_rows * this->N_slices * this->N_times * this->N_chnls;
+}
+
+int64_t raw_volume_layout::N_bytes() const {
+    return this->N_voxels() * static_cast<int64_t>(raw_voxel_size(this->type));
+}
+
+
+mapped_file::mapped_file(const std::filesystem::path &p){
+#if !defined(_WIN32) && !defined(_WIN64)
+    const int fd = ::open(p.string().c_str(), O_RDONLY);
+    if(fd < 0){
+        throw std::runtime_error("Unable to open file '"_s + p.string() + "'");
+    }
+    struct stat st;
+    if(::fstat(fd, &st) != 0){
+        ::close(fd);
+        throw std::runtime_error("Unable to query file '"_s + p.string() + "'");
+    }
+    this->len = static_cast<size_t>(st.st_size);
+    if(0 < this->len){
+        void *m = ::mmap(nullptr, this->len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(m != MAP_FAILED){
+            ::madvise(m, this->len, MADV_SEQUENTIAL);
+            this->ptr = static_cast<const unsigned char *>(m);
+            this->is_mapped = true;
+        }
+    }
+    ::close(fd);
+    if(this->is_mapped || (this->len == 0)) return;
+#endif
+
+    // Fall back on reading the whole file.
+    std::ifstream FI(p, std::ios::in | std::ios::binary | std::ios::ate);
+    if(!FI){
+        throw std::runtime_error("Unable to open file '"_s + p.string() + "'");
+    }
+    const auto l_len = static_cast<int64_t>(FI.tellg());
+    if(l_len < 0){
+        throw std::runtime_error("Unable to query file '"_s + p.string() + "'");
+    }
+    this->buffer.resize(static_cast<size_t>(l_len));
+    FI.seekg(0, std::ios::beg);
+    FI.read(reinterpret_cast<char *>(this->buffer.data()), static_cast<std::streamsize>(l_len));
+    if(!FI){
+        throw std::runtime_error("Unable to read file '"_s + p.string() + "'");
+    }
+    this->ptr = this->buffer.data();
+    this->len = this->buffer.size();
+}
+
+mapped_file::~mapped_file(){
+#if !defined(_WIN32) && !defined(_WIN64)
+    if(this->is_mapped){
+        ::munmap(const_cast<unsigned char *>(this->ptr), this->len);
+    }
+#endif
+}
+
+const unsigned char* mapped_file::data() const {
+    return this->ptr;
+}
+
+size_t mapped_file::size() const {
+    return this->len;
+}
+
+
+static uint32_t read_le16(const unsigned char *p){
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8);
+}
+
+static uint32_t read_le32(const unsigned char *p){
+    return read_le16(p) | (read_le16(p + 2) << 16);
+}
+
+static void append_le16(std::vector<unsigned char> &v, uint32_t x){
+    v.push_back(static_cast<unsigned char>(x & 0xFF));
+    v.push_back(static_cast<unsigned char>((x >> 8) & 0xFF));
+}
+
+static void append_le32(std::vector<unsigned char> &v, uint32_t x){
+    append_le16(v, x & 0xFFFF);
+    append_le16(v, (x >> 16) & 0xFFFF);
+}
+
+// zlib uses 32-bit lengths, so large buffers are fed in pieces.
+constexpr size_t zlib_max_chunk = static_cast<size_t>(1) << 30;
+
+std::vector<unsigned char>
+Inflate_Buffer(const unsigned char *data, size_t size, size_t expected_size){
+    std::vector<unsigned char> out;
+
+    // Attempt to partition the stream into BGZF blocks. Each block is a complete gzip member that records its own
+    // compressed length in the 'BC' extra subfield, and its uncompressed length in the trailer, so blocks can be located
+    // without decompressing and then decompressed independently.
+    struct block_t {
+        size_t in_offset  = 0;
+        size_t in_length  = 0;
+        size_t out_offset = 0;
+        size_t out_length = 0;
+        uint32_t crc = 0;
+    };
+    std::vector<block_t> blocks;
+    bool is_bgzf = true;
+    {
+        size_t pos = 0;
+        size_t out_total = 0;
+        while(pos < size){
+            const auto *h = data + pos;
+            const size_t remaining = size - pos;
+            if( (remaining < 18)
+            ||  (h[0] != 0x1F)
+            ||  (h[1] != 0x8B)
+            ||  (h[2] != 8)     // Deflate.
+            ||  (h[3] != 4) ){  // Only the FEXTRA flag.
+                is_bgzf = false;
+                break;
+            }
+            const size_t xlen = read_le16(h + 10);
+            if(remaining < (12 + xlen)){
+                is_bgzf = false;
+                break;
+            }
+            size_t bsize = 0;
+            for(size_t x = 0; (x + 4) <= xlen; ){
+                const size_t slen = read_le16(h + 14 + x);
+                if( (h[12 + x] == 'B')
+                &&  (h[13 + x] == 'C')
+                &&  (slen == 2)
+                &&  ((x + 6) <= xlen) ){
+                    bsize = read_le16(h + 16 + x) + 1;
+                }
+                x += 4 + slen;
+            }
+            if( (bsize < (12 + xlen + 8))
+            ||  (remaining < bsize) ){
+                is_bgzf = false;
+                break;
+            }
+
+            block_t b;
+            b.in_offset = pos + 12 + xlen;
+            b.in_length = bsize - 12 - xlen - 8;
+            b.crc = read_le32(h + bsize - 8);
+            b.out_length = read_le32(h + bsize - 4);
+            b.out_offset = out_total;
+            out_total += b.out_length;
+            blocks.push_back(b);
+            pos += bsize;
+        }
+        if(is_bgzf && !blocks.empty()){
+            out.resize(out_total);
+        }
+    }
+
+    if(is_bgzf && !blocks.empty()){
+        std::mutex saver_printer;
+        bool ok = true;
+        {
+            work_queue<std::function<void(void)>> wq;
+            for(const auto &b : blocks){
+                if(b.out_length == 0) continue;
+                wq.submit_task([&,b]() -> void {
+                    z_stream zs;
+                    std::memset(&zs, 0, sizeof(zs));
+                    bool l_ok = (inflateInit2(&zs, -MAX_WBITS) == Z_OK);
+                    if(l_ok){
+                        zs.next_in = const_cast<Bytef *>(data + b.in_offset);
+                        zs.avail_in = static_cast<uInt>(b.in_length);
+                        zs.next_out = out.data() + b.out_offset;
+                        zs.avail_out = static_cast<uInt>(b.out_length);
+                        const auto res = inflate(&zs, Z_FINISH);
+                        l_ok = (res == Z_STREAM_END)
+                            && (zs.avail_out == 0)
+                            && (crc32(0L, out.data() + b.out_offset, static_cast<uInt>(b.out_length)) == b.crc);
+                        inflateEnd(&zs);
+                    }
+                    if(!l_ok){
+                        std::lock_guard<std::mutex> lock(saver_printer);
+                        ok = false;
+                    }
+                });
+            }
+        } // Wait for all tasks to complete.
+        if(!ok){
+            throw std::runtime_error("Unable to decompress: corrupt BGZF block");
+        }
+        return out;
+    }
+
+    // Otherwise, decompress the stream serially.
+    out.clear();
+    out.reserve( (0 < expected_size) ? expected_size : (size * 4) );
+
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if(inflateInit2(&zs, MAX_WBITS + 32) != Z_OK){ // Automatic gzip or zlib header detection.
+        throw std::runtime_error("Unable to initialize decompression");
+    }
+    size_t in_pos = 0;
+    while(true){
+        if( (zs.avail_in == 0)
+        &&  (in_pos < size) ){
+            const size_t n = std::min(size - in_pos, zlib_max_chunk);
+            zs.next_in = const_cast<Bytef *>(data + in_pos);
+            zs.avail_in = static_cast<uInt>(n);
+            in_pos += n;
+        }
+
+        const size_t old_size = out.size();
+        const size_t growth = std::clamp<size_t>( (expected_size > old_size) ? (expected_size - old_size) : 0,
+                                                  static_cast<size_t>(1) << 20, zlib_max_chunk );
+        out.resize(old_size + growth);
+        zs.next_out = out.data() + old_size;
+        zs.avail_out = static_cast<uInt>(growth);
+        const auto res = inflate(&zs, Z_NO_FLUSH);
+        out.resize(old_size + growth - zs.avail_out);
+
+        if(res == Z_STREAM_END){
+            // Another gzip member may follow.
+            const auto *next = (0 < zs.avail_in) ? zs.next_in : (data + in_pos);
+            const size_t remaining = zs.avail_in + (size - in_pos);
+            if( (2 <= remaining)
+            &&  (next[0] == 0x1F)
+            &&  (next[1] == 0x8B) ){
+                inflateReset(&zs);
+                continue;
+            }
+            break;
+        }
+        if( (res == Z_BUF_ERROR)
+        &&  (zs.avail_in == 0)
+        &&  (in_pos == size) ){
+            inflateEnd(&zs);
+            throw std::runtime_error("Unable to decompress: stream is truncated");
+        }
+        if( (res != Z_OK)
+        &&  (res != Z_BUF_ERROR) ){
+            inflateEnd(&zs);
+            throw std::runtime_error("Unable to decompress: corrupt stream");
+        }
+    }
+    inflateEnd(&zs);
+    return out;
+}
+
+std::vector<unsigned char>
+Inflate_Prefix(const unsigned char *data, size_t size, size_t max_size){
+    std::vector<unsigned char> out(max_size);
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if(inflateInit2(&zs, 32 + 15) != Z_OK) return {};
+
+    zs.next_in = const_cast<Bytef *>(data);
+    zs.avail_in = static_cast<uInt>(std::min(size, zlib_max_chunk));
+    zs.next_out = out.data();
+    zs.avail_out = static_cast<uInt>(max_size);
+    const auto res = inflate(&zs, Z_SYNC_FLUSH);
+    out.resize(max_size - zs.avail_out);
+    inflateEnd(&zs);
+    if( (res != Z_OK)
+    &&  (res != Z_STREAM_END)
+    &&  (res != Z_BUF_ERROR) ){
+        out.clear();
+    }
+    return out;
+}
+
+
+// Compresses a buffer as a raw deflate stream. If 'flush' is Z_SYNC_FLUSH the stream is left open and byte-aligned so
+// that it can be concatenated with another raw deflate stream.
+static std::vector<unsigned char>
+deflate_raw(const unsigned char *data, size_t size, int level, int flush){
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if(deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK){
+        throw std::runtime_error("Unable to initialize compression");
+    }
+    std::vector<unsigned char> out(deflateBound(&zs, static_cast<uLong>(size)) + 64);
+    zs.next_in = const_cast<Bytef *>(data);
+    zs.avail_in = static_cast<uInt>(size);
+    size_t produced = 0;
+    while(true){
+        zs.next_out = out.data() + produced;
+        zs.avail_out = static_cast<uInt>(out.size() - produced);
+        const auto res = deflate(&zs, flush);
+        produced = out.size() - zs.avail_out;
+        if( (res == Z_STREAM_END)
+        ||  ((flush != Z_FINISH) && (res == Z_OK) && (0 < zs.avail_out)) ){
+            break;
+        }
+        if( (res != Z_OK)
+        &&  (res != Z_BUF_ERROR) ){
+            deflateEnd(&zs);
+            throw std::runtime_error("Unable to compress buffer");
+        }
+        out.resize(out.size() * 2);
+    }
+    deflateEnd(&zs);
+    out.resize(produced);
+    return out;
+}
+
+std::vector<unsigned char>
+Deflate_Buffer(const unsigned char *data, size_t size, deflate_format f){
+    // BGZF blocks are limited to 64 KiB, including the gzip header and trailer. Blocks that do not compress are stored.
+    // zlib streams are compressed as independent chunks that are concatenated, so larger chunks are used.
+    const size_t chunk_size = (f == deflate_format::gzip) ? static_cast<size_t>(0xFF00)
+                                                          : (static_cast<size_t>(1) << 20);
+    const size_t N_chunks = std::max<size_t>(1, (size + chunk_size - 1) / chunk_size);
+
+    std::vector<std::vector<unsigned char>> chunks(N_chunks);
+    {
+        std::mutex saver_printer;
+        std::exception_ptr failure;
+        {
+            work_queue<std::function<void(void)>> wq;
+            for(size_t n = 0; n < N_chunks; ++n){
+                wq.submit_task([&,n]() -> void {
+                    try{
+                        const auto *in = data + n * chunk_size;
+                        const size_t in_len = (size <= n * chunk_size) ? 0 : std::min(chunk_size, size - n * chunk_size);
+                        if(f == deflate_format::gzip){
+                            chunks[n] = deflate_raw(in, in_len, Z_DEFAULT_COMPRESSION, Z_FINISH);
+                            if(0x10000 < (chunks[n].size() + 26)){
+                                chunks[n] = deflate_raw(in, in_len, Z_NO_COMPRESSION, Z_FINISH);
+                            }
+                        }else{
+                            const bool is_last = ((n + 1) == N_chunks);
+                            chunks[n] = deflate_raw(in, in_len, Z_DEFAULT_COMPRESSION, (is_last) ? Z_FINISH : Z_SYNC_FLUSH);
+                        }
+                    }catch(const std::exception &){
+                        std::lock_guard<std::mutex> lock(saver_printer);
+                        failure = std::current_exception();
+                    }
+                });
+            }
+        } // Wait for all tasks to complete.
+        if(failure) std::rethrow_exception(failure);
+    }
+
+    std::vector<unsigned char> out;
+    if(f == deflate_format::gzip){
+        size_t total = 28;
+        for(const auto &c : chunks) total += c.size() + 26;
+        out.reserve(total);
+        for(size_t n = 0; n < N_chunks; ++n){
+            const auto *in = data + n * chunk_size;
+            const size_t in_len = (size <= n * chunk_size) ? 0 : std::min(chunk_size, size - n * chunk_size);
+            if(in_len == 0) continue;
+
+            const unsigned char header[] = { 0x1F, 0x8B, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x06, 0x00, 'B', 'C', 0x02, 0x00 };
+            out.insert(std::end(out), std::begin(header), std::end(header));
+            append_le16(out, static_cast<uint32_t>(chunks[n].size() + 25)); // Block size, minus one.
+            out.insert(std::end(out), std::begin(chunks[n]), std::end(chunks[n]));
+            append_le32(out, static_cast<uint32_t>(crc32(0L, in, static_cast<uInt>(in_len))));
+            append_le32(out, static_cast<uint32_t>(in_len));
+        }
+
+        // The conventional BGZF end-of-file marker, which is an empty block.
+        const unsigned char eof[] = { 0x1F, 0x8B, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x06, 0x00, 'B', 'C',
+                                      0x02, 0x00, 0x1B, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+        out.insert(std::end(out), std::begin(eof), std::end(eof));
+
+    }else{
+        size_t total = 6;
+        for(const auto &c : chunks) total += c.size();
+        out.reserve(total);
+        out.push_back(0x78);
+        out.push_back(0x9C);
+        for(const auto &c : chunks) out.insert(std::end(out), std::begin(c), std::end(c));
+
+        uLong adler = adler32(0L, Z_NULL, 0);
+        for(size_t pos = 0; pos < size; pos += zlib_max_chunk){
+            adler = adler32(adler, data + pos, static_cast<uInt>(std::min(zlib_max_chunk, size - pos)));
+        }
+        for(int i = 3; 0 <= i; --i){
+            out.push_back(static_cast<unsigned char>((adler >> (8 * i)) & 0xFF));
+        }
+    }
+    return out;
+}
+
+
+template <class T>
+static inline T load_element(const unsigned char *p, bool swap){
+    T v;
+    if(swap){
+        unsigned char b[sizeof(T)];
+        for(size_t j = 0; j < sizeof(T); ++j) b[j] = p[sizeof(T) - 1 - j];
+        std::memcpy(&v, b, sizeof(T));
+    }else{
+        std::memcpy(&v, p, sizeof(T));
+    }
+    return v;
+}
+
+template <class T>
+static void convert_image(const raw_volume_layout &L,
+                          const unsigned char *data,
+                          int64_t base,
+                          bool swap,
+                          planar_image<float,double> &img){
+    const auto *p = data + base * static_cast<int64_t>(sizeof(T));
+
+    // Contiguous, native 32-bit floats can be copied directly.
+    if constexpr (std::is_same_v<T, float>){
+        if( !swap
+        &&  (L.slope == 1.0)
+        &&  (L.intercept == 0.0)
+        &&  (L.s_chnl == 1)
+        &&  (L.s_col == L.N_chnls)
+        &&  (L.s_row == (L.N_chnls * L.N_cols)) ){
+            std::memcpy(img.data.data(), p, img.data.size() * sizeof(float));
+            return;
+        }
+    }
+
+    // When each row is stored contiguously (with channels either interleaved or planar), runs are converted via a
+    // scratch buffer so that byte swapping and conversion operate on contiguous elements.
+    const bool interleaved_rows = (L.s_chnl == 1) && (L.s_col == L.N_chnls);
+    const bool planar_rows = (L.s_col == 1);
+    if(interleaved_rows || planar_rows){
+        const int64_t run = interleaved_rows ? (L.N_cols * L.N_chnls) : L.N_cols;
+        const int64_t N_runs = interleaved_rows ? 1 : L.N_chnls;
+        const int64_t out_stride = interleaved_rows ? 1 : L.N_chnls;
+        const bool is_identity = (L.slope == 1.0) && (L.intercept == 0.0);
+        std::vector<T> scratch(static_cast<size_t>(run));
+        for(int64_t row = 0; row < L.N_rows; ++row){
+            for(int64_t r = 0; r < N_runs; ++r){
+                const auto *q = p + (row * L.s_row + r * L.s_chnl) * static_cast<int64_t>(sizeof(T));
+                std::memcpy(scratch.data(), q, scratch.size() * sizeof(T));
+                if(swap){
+                    Byteswap_Buffer(reinterpret_cast<unsigned char *>(scratch.data()), scratch.size(), sizeof(T));
+                }
+                auto *out = img.data.data() + (row * L.N_cols * L.N_chnls + r);
+                if(is_identity){
+                    for(int64_t i = 0; i < run; ++i) out[i * out_stride] = static_cast<float>(scratch[i]);
+                }else{
+                    for(int64_t i = 0; i < run; ++i){
+                        out[i * out_stride] = static_cast<float>(L.slope * static_cast<double>(scratch[i]) + L.intercept);
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    auto *out = img.data.data();
+    for(int64_t row = 0; row < L.N_rows; ++row){
+        for(int64_t col = 0; col < L.N_cols; ++col){
+            const auto *q = p + (row * L.s_row + col * L.s_col) * static_cast<int64_t>(sizeof(T));
+            for(int64_t chnl = 0; chnl < L.N_chnls; ++chnl){
+                const auto v = load_element<T>(q + chnl * L.s_chnl * static_cast<int64_t>(sizeof(T)), swap);
+                *(out++) = static_cast<float>(L.slope * static_cast<double>(v) + L.intercept);
+            }
+        }
+    }
+    return;
+}
+
+planar_image_collection<float,double>
+Raw_Volume_To_Images(const raw_volume_layout &L,
+                     const unsigned char *data,
+                     size_t size,
+                     bool parallel){
+    if( (L.N_cols < 1)
+    ||  (L.N_rows < 1)
+    ||  (L.N_slices < 1)
+    ||  (L.N_times < 1)
+    ||  (L.N_chnls < 1) ){
+        throw std::invalid_argument("Volume dimensions are invalid");
+    }
+    if( (L.s_col < 0)
+    ||  (L.s_row < 0)
+    ||  (L.s_slice < 0)
+    ||  (L.s_time < 0)
+    ||  (L.s_chnl < 0) ){
+        throw std::invalid_argument("Volume strides are invalid");
+    }
+    const int64_t last = (L.N_cols - 1) * L.s_col
+                       + (L.N_rows - 1) * L.s_row
+                       + (L.N_slices - 1) * L.s_slice
+                       + (L.N_times - 1) * L.s_time
+                       + (L.N_chnls - 1) * L.s_chnl;
+    if(static_cast<int64_t>(size) < ((last + 1) * static_cast<int64_t>(raw_voxel_size(L.type)))){
+        throw std::runtime_error("Voxel data are truncated");
+    }
+
+    const auto pxl_dx = L.row_dir.length();
+    const auto pxl_dy = L.col_dir.length();
+    auto pxl_dz = L.slice_dir.length();
+    if( !std::isfinite(pxl_dx)
+    ||  !std::isfinite(pxl_dy)
+    ||  (pxl_dx <= 0.0)
+    ||  (pxl_dy <= 0.0) ){
+        throw std::invalid_argument("Voxel spacing is invalid");
+    }
+    if( !std::isfinite(pxl_dz)
+    ||  (pxl_dz <= 0.0) ){
+        pxl_dz = 1.0;
+    }
+    const auto row_unit = L.row_dir.unit();
+    const auto col_unit = L.col_dir.unit();
+    const auto zero = vec3<double>(0.0, 0.0, 0.0);
+    const bool swap = (L.big_endian == host_is_little_endian());
+
+    planar_image_collection<float,double> out;
+    std::vector<std::pair<planar_image<float,double>*, int64_t>> jobs; // (image, offset of the first voxel).
+    for(int64_t t = 0; t < L.N_times; ++t){
+        for(int64_t k = 0; k < L.N_slices; ++k){
+            out.images.emplace_back();
+            auto &img = out.images.back();
+            img.init_orientation(row_unit, col_unit);
+            img.init_buffer(L.N_rows, L.N_cols, L.N_chnls);
+            img.init_spatial(pxl_dx, pxl_dy, pxl_dz, zero, L.origin + L.slice_dir * static_cast<double>(k));
+            jobs.emplace_back( &img, t * L.s_time + k * L.s_slice );
+        }
+    }
+
+    const auto convert = [&L,data,swap](const std::pair<planar_image<float,double>*, int64_t> &job) -> void {
+        auto &img = *(job.first);
+        switch(L.type){
+            case raw_voxel_type::int8:    convert_image<int8_t  >(L, data, job.second, swap, img); break;
+            case raw_voxel_type::uint8:   convert_image<uint8_t >(L, data, job.second, swap, img); break;
+            case raw_voxel_type::int16:   convert_image<int16_t >(L, data, job.second, swap, img); break;
+            case raw_voxel_type::uint16:  convert_image<uint16_t>(L, data, job.second, swap, img); break;
+            case raw_voxel_type::int32:   convert_image<int32_t >(L, data, job.second, swap, img); break;
+            case raw_voxel_type::uint32:  convert_image<uint32_t>(L, data, job.second, swap, img); break;
+            case raw_voxel_type::int64:   convert_image<int64_t >(L, data, job.second, swap, img); break;
+            case raw_voxel_type::uint64:  convert_image<uint64_t>(L, data, job.second, swap, img); break;
+            case raw_voxel_type::float32: convert_image<float   >(L, data, job.second, swap, img); break;
+            case raw_voxel_type::float64: convert_image<double  >(L, data, job.second, swap, img); break;
+        }
+    };
+    if(!parallel || (jobs.size() < 2)){
+        for(const auto &job : jobs) convert(job);
+        return out;
+    }
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(const auto &job : jobs){
+            wq.submit_task([&convert,job]() -> void {
+                convert(job);
+            });
+        }
+    } // Wait for all tasks to complete.
+    return out;
+}
+
+
+void
+Attach_Volume_Metadata(planar_image_collection<float,double> &imagecoll,
+                       metadata_map_t file_metadata,
+                       const std::filesystem::path &filename,
+                       int64_t N_slices){
+    auto l_meta = coalesce_metadata_for_basic_image({});
+    inject_metadata( l_meta, std::move(file_metadata) ); // File metadata takes priority.
+
+    const bool is_temporal = (0 < N_slices) && (N_slices < static_cast<int64_t>(imagecoll.images.size()));
+    int64_t n = 0;
+    for(auto &img : imagecoll.images){
+        img.metadata = l_meta;
+        img.metadata["Filename"] = filename.string();
+        if(is_temporal){
+            img.metadata["TemporalPositionIndex"] = std::to_string(n / N_slices + 1);
+        }
+        l_meta = coalesce_metadata_for_basic_image(l_meta, meta_evolve::iterate); // Evolve for next image.
+        ++n;
+    }
+    return;
+}
+
+
+image_volume
+Images_To_Volume(const planar_image_collection<float,double> &imagecoll){
+    if(imagecoll.images.empty()){
+        throw std::invalid_argument("No images provided");
+    }
+    const auto &ref = imagecoll.images.front();
+    const auto row_unit = ref.row_unit.unit();
+    const auto col_unit = ref.col_unit.unit();
+    const auto ref_pos = ref.position(0, 0);
+
+    // Orient the slice direction so the ordering of the collection is preserved where possible.
+    auto normal = row_unit.Cross(col_unit).unit();
+    if((imagecoll.images.back().position(0, 0) - ref_pos).Dot(normal) < 0.0){
+        normal = normal * -1.0;
+    }
+    const double eps = 1.0E-3 * std::min(ref.pxl_dx, ref.pxl_dy);
+    if( !std::isfinite(eps)
+    ||  (eps <= 0.0)
+    ||  !std::isfinite(normal.length()) ){
+        throw std::invalid_argument("Image geometry is invalid");
+    }
+
+    std::vector<std::pair<double, const planar_image<float,double>*>> projs;
+    for(const auto &img : imagecoll.images){
+        if( (img.rows != ref.rows)
+        ||  (img.columns != ref.columns)
+        ||  (img.channels != ref.channels)
+        ||  (eps < std::abs(img.pxl_dx - ref.pxl_dx))
+        ||  (eps < std::abs(img.pxl_dy - ref.pxl_dy))
+        ||  (row_unit.Dot(img.row_unit.unit()) < (1.0 - 1.0E-6))
+        ||  (col_unit.Dot(img.col_unit.unit()) < (1.0 - 1.0E-6)) ){
+            throw std::invalid_argument("Images do not share a common in-plane geometry");
+        }
+        const auto d = img.position(0, 0) - ref_pos;
+        const auto s = d.Dot(normal);
+        if(eps < (d - normal * s).length()){
+            throw std::invalid_argument("Images are not aligned along the slice direction");
+        }
+        projs.emplace_back(s, &img);
+    }
+    std::stable_sort(std::begin(projs), std::end(projs),
+                     [](const auto &l, const auto &r){ return (l.first < r.first); });
+
+    // Images sharing a position are treated as distinct time points, in the order they appear.
+    std::vector<double> positions;
+    std::vector<std::vector<const planar_image<float,double>*>> groups;
+    for(const auto &p : projs){
+        if( groups.empty()
+        ||  (eps < (p.first - positions.back())) ){
+            positions.push_back(p.first);
+            groups.emplace_back();
+        }
+        groups.back().push_back(p.second);
+    }
+
+    image_volume out;
+    out.N_cols   = ref.columns;
+    out.N_rows   = ref.rows;
+    out.N_chnls  = ref.channels;
+    out.N_slices = static_cast<int64_t>(groups.size());
+    out.N_times  = static_cast<int64_t>(groups.front().size());
+    for(const auto &g : groups){
+        if(static_cast<int64_t>(g.size()) != out.N_times){
+            throw std::invalid_argument("Each slice position must have the same number of images");
+        }
+    }
+
+    double spacing = ref.pxl_dz;
+    if(1 < out.N_slices){
+        spacing = (positions.back() - positions.front()) / static_cast<double>(out.N_slices - 1);
+        for(size_t k = 1; k < positions.size(); ++k){
+            if((0.01 * spacing + eps) < std::abs((positions[k] - positions[k-1]) - spacing)){
+                throw std::invalid_argument("Images are not regularly spaced");
+            }
+        }
+    }
+    out.origin    = groups.front().front()->position(0, 0);
+    out.col_dir   = col_unit * ref.pxl_dy;
+    out.row_dir   = row_unit * ref.pxl_dx;
+    out.slice_dir = normal * spacing;
+
+    for(int64_t t = 0; t < out.N_times; ++t){
+        for(int64_t k = 0; k < out.N_slices; ++k){
+            out.images.emplace_back( std::cref(*(groups[k][t])) );
+        }
+    }
+    return out;
+}
+
+std::vector<unsigned char>
+Volume_To_Raw_Float32(const image_volume &vol, bool planar_channels){
+    const int64_t N_img_voxels = vol.N_rows * vol.N_cols;
+    const int64_t N_imgs = static_cast<int64_t>(vol.images.size());
+    std::vector<unsigned char> out(static_cast<size_t>(N_img_voxels * vol.N_chnls * N_imgs) * sizeof(float));
+    const bool le = host_is_little_endian();
+
+    const auto store = [le](float v, unsigned char *p) -> void {
+        if(le){
+            std::memcpy(p, &v, sizeof(float));
+        }else{
+            unsigned char b[sizeof(float)];
+            std::memcpy(b, &v, sizeof(float));
+            for(size_t j = 0; j < sizeof(float); ++j) p[j] = b[sizeof(float) - 1 - j];
+        }
+    };
+
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(int64_t n = 0; n < N_imgs; ++n){
+            wq.submit_task([&,n]() -> void {
+                const auto &img = vol.images[n].get();
+                if(!planar_channels || (vol.N_chnls == 1)){
+                    auto *p = out.data() + static_cast<size_t>(n * N_img_voxels * vol.N_chnls) * sizeof(float);
+                    if(le){
+                        std::memcpy(p, img.data.data(), img.data.size() * sizeof(float));
+                    }else{
+                        for(const auto &v : img.data){
+                            store(v, p);
+                            p += sizeof(float);
+                        }
+                    }
+                    return;
+                }
+
+                for(int64_t chnl = 0; chnl < vol.N_chnls; ++chnl){
+                    auto *p = out.data() + static_cast<size_t>((chnl * N_imgs + n) * N_img_voxels) * sizeof(float);
+                    for(int64_t i = 0; i < N_img_voxels; ++i){
+                        store(img.data[i * vol.N_chnls + chnl], p);
+                        p += sizeof(float);
+                    }
+                }
+            });
+        }
+    } // Wait for all tasks to complete.
+    return out;
+}
+
+metadata_map_t
+Common_Volume_Metadata(const image_volume &vol){
+    metadata_map_t out;
+    if(vol.images.empty()) return out;
+
+    out = vol.images.front().get().metadata;
+    for(const auto &img_refw : vol.images){
+        const auto &m = img_refw.get().metadata;
+        for(auto it = std::begin(out); it != std::end(out); ){
+            const auto f = m.find(it->first);
+            if( (f == std::end(m))
+            ||  (f->second != it->second) ){
+                it = out.erase(it);
+            }else{
+                ++it;
+            }
+        }
+    }
+
+    // Exclude metadata that describe the file or the image geometry, which are regenerated when loading.
+    for(const auto &k : { "Filename", "TemporalPositionIndex" }){
+        out.erase(k);
+    }
+    return out;
+}
+
+
+void
+Export_Image_Arrays_As_Volumes(Drover &DICOM_data,
+                               const std::string &ImageSelectionStr,
+                               const std::string &FilenameBase,
+                               const std::string &suffix,
+                               const volume_writer_t &writer){
+    const auto IAs_all = All_IAs( DICOM_data );
+    auto IAs = Whitelist( IAs_all, ImageSelectionStr );
+    for(const auto& iap_it : IAs){
+        const auto fname = Get_Unique_Sequential_Filename(FilenameBase + "_", 6, suffix);
+
+        YLOGINFO("Exporting " << (*iap_it)->imagecoll.images.size() << " images to file '" << fname << "' now..");
+        if(writer((*iap_it)->imagecoll, fname)){
+            YLOGINFO("Exported image array to file '" << fname << "'");
+        }else{
+            YLOGWARN("Unable to export image array to file '" << fname << "'");
+        }
+    }
+    return;
+}
@@ -0,0 +1,186 @@
+//Raw_Volume_IO.h.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"         //Needed for vec3 class.
+
+#include "Metadata.h"
+#include "Structs.h"
+
+
+// Routines shared by loaders and exporters for formats that store a volume as a single block of voxels (e.g., NRRD,
+// NIfTI, and MetaImage).
+
+// Element types that can appear in a raw voxel block.
+enum class raw_voxel_type {
+    int8,
+    uint8,
+    int16,
+    uint16,
+    int32,
+    uint32,
+    int64,
+    uint64,
+    float32,
+    float64,
+};
+
+size_t raw_voxel_size(raw_voxel_type t);
+
+bool host_is_little_endian();
+
+// Reverses the byte order of each element in place. Elements must be 1, 2, 4, or 8 bytes wide.
+void Byteswap_Buffer(unsigned char *data, size_t N_elements, size_t element_size);
+
+
+// Describes how a raw voxel block maps onto a collection of planar images.
+//
+// Strides are in elements, relative to the start of the block. Direction vectors include the voxel spacing, so the
+// centre of voxel (col, row, slice) is 'origin + col_dir * col + row_dir * row + slice_dir * slice'.
+struct raw_volume_layout {
+    raw_voxel_type type = raw_voxel_type::float32;
+    bool big_endian = false;
+
+    int64_t N_cols   = 0;
+    int64_t N_rows   = 0;
+    int64_t N_slices = 1;
+    int64_t N_times  = 1;
+    int64_t N_chnls  = 1;
+
+    int64_t s_col   = 0;
+    int64_t s_row   = 0;
+    int64_t s_slice = 0;
+    int64_t s_time  = 0;
+    int64_t s_chnl  = 0;
+
+    vec3<double> origin    = vec3<double>(0.0, 0.0, 0.0);
+    vec3<double> col_dir   = vec3<double>(1.0, 0.0, 0.0);
+    vec3<double> row_dir   = vec3<double>(0.0, 1.0, 0.0);
+    vec3<double> slice_dir = vec3<double>(0.0, 0.0, 1.0);
+
+    // Linear transformation applied to stored values.
+    double slope     = 1.0;
+    double intercept = 0.0;
+
+    // Channels vary fastest, followed by columns, rows, slices, and times.
+    void set_interleaved_strides();
+
+    // Columns vary fastest, followed by rows, slices, times, and channels.
+    void set_planar_strides();
+
+    int64_t N_voxels() const;
+    int64_t N_bytes() const;
+};
+
+
+// A read-only view of a file's contents. Files are memory-mapped where supported, and otherwise read into memory.
+class mapped_file {
+    private:
+        const unsigned char *ptr = nullptr;
+        size_t len = 0;
+        bool is_mapped = false;
+        std::vector<unsigned char> buffer;
+
+    public:
+        explicit mapped_file(const std::filesystem::path &p);
+        ~mapped_file();
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file& operator=(const mapped_file &) = delete;
+
+        const unsigned char* data() const;
+        size_t size() const;
+};
+
+
+// Decompresses a gzip or zlib stream. Concatenated gzip members are supported. Streams consisting of BGZF blocks
+// (i.e., gzip members that record their compressed length) are decompressed in parallel.
+//
+// The expected size is only used as a hint to reduce reallocations.
+std::vector<unsigned char>
+Inflate_Buffer(const unsigned char *data, size_t size, size_t expected_size = 0);
+
+// Decompresses at most the leading 'max_size' bytes of a gzip or zlib stream, e.g., to identify the contents. Errors and
+// truncation are not reported; fewer bytes are returned instead.
+std::vector<unsigned char>
+Inflate_Prefix(const unsigned char *data, size_t size, size_t max_size);
+
+enum class deflate_format {
+    gzip, // BGZF blocks, which any gzip reader can decompress.
+    zlib, // A single zlib stream.
+};
+
+// Compresses a buffer. Independent chunks are compressed in parallel.
+std::vector<unsigned char>
+Deflate_Buffer(const unsigned char *data, size_t size, deflate_format f);
+
+
+// Converts a raw voxel block into images. Images are ordered by time, then by slice. Each image is converted in
+// parallel unless 'parallel' is false, e.g., when the caller is already running concurrent tasks.
+planar_image_collection<float,double>
+Raw_Volume_To_Images(const raw_volume_layout &layout,
+                     const unsigned char *data,
+                     size_t size,
+                     bool parallel = true);
+
+
+// Assigns metadata to images loaded from a volume file. Metadata from the file take priority over generated metadata.
+// Images are assumed to be ordered by time, then by slice.
+void
+Attach_Volume_Metadata(planar_image_collection<float,double> &imagecoll,
+                       metadata_map_t file_metadata,
+                       const std::filesystem::path &filename,
+                       int64_t N_slices);
+
+
+// A regular volume formed from a collection of images.
+//
+// Images are partitioned into sets sharing a position (i.e., time points), and each set is sorted along the slice
+// direction. Images are ordered by time, then by slice.
+struct image_volume {
+    std::vector<std::reference_wrapper<const planar_image<float,double>>> images;
+
+    int64_t N_cols   = 0;
+    int64_t N_rows   = 0;
+    int64_t N_slices = 0;
+    int64_t N_times  = 0;
+    int64_t N_chnls  = 0;
+
+    vec3<double> origin;
+    vec3<double> col_dir;
+    vec3<double> row_dir;
+    vec3<double> slice_dir;
+};
+
+// Throws if the images do not form a regular grid.
+image_volume
+Images_To_Volume(const planar_image_collection<float,double> &imagecoll);
+
+// Serializes voxel values as little-endian 32-bit floats with columns varying fastest, followed by rows, slices, and
+// times. Channels are either interleaved (i.e., vary fastest) or planar (i.e., vary slowest).
+std::vector<unsigned char>
+Volume_To_Raw_Float32(const image_volume &vol, bool planar_channels);
+
+// Metadata shared by all images in a volume, which can be stored in a volume file header.
+metadata_map_t
+Common_Volume_Metadata(const image_volume &vol);
+
+// Writes each selected image array to its own file using a volume writer, as the volume export operations do.
+// Filenames are generated sequentially from the base and suffix. Failures are reported but do not prevent other image
+// arrays from being exported.
+using volume_writer_t = std::function<bool(const planar_image_collection<float,double> &,
+                                           const std::filesystem::path &)>;
+void
+Export_Image_Arrays_As_Volumes(Drover &DICOM_data,
+                               const std::string &ImageSelectionStr,
+                               const std::string &FilenameBase,
+                               const std::string &suffix,
+                               const volume_writer_t &writer);
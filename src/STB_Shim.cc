@@ -62,14 +62,13 @@ ReadImageUsingSTB(const std::string &fname){
         cc.images.back().init_spatial( pxl_dx, pxl_dy, pxl_dz, anchor, offset );
         cc.images.back().init_orientation( row_unit, col_unit );
 
-        unsigned char* l_pixels = pixels;
-        for(int64_t row = 0; row < rows; ++row){
-            for(int64_t col = 0; col < cols; ++col){
-                for(int64_t chn = 0; chn < chns; ++chn){
-                    cc.images.back().reference(row, col, chn) = static_cast<float>(*l_pixels);
-                    ++l_pixels;
-                }
-            }
+        // The decoded samples are interleaved by channel in row-major order, which matches the image buffer layout, so
+        // all channels are converted together in a single contiguous (and vectorizable) pass.
+        const auto N_samples = static_cast<size_t>(rows * cols * chns);
+        const unsigned char *in = pixels;
+        float *out = cc.images.back().data.data();
+        for(size_t n = 0; n < N_samples; ++n){
+            out[n] = static_cast<float>(in[n]);
         }
     }
 
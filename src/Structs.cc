@@ -726,11 +726,11 @@ Dynamic_Machine_State::normalize_states(){
         if( !A->JawPositionsX.empty()
         &&   B->JawPositionsX.empty()) B->JawPositionsX = A->JawPositionsX;
 
-        if( A->JawPositionsY.empty() 
-        && !B->JawPositionsY.empty()) B->JawPositionsY = A->JawPositionsY;
+        if( !A->JawPositionsY.empty()
+        &&   B->JawPositionsY.empty()) B->JawPositionsY = A->JawPositionsY;
 
-        if( A->MLCPositionsX.empty() 
-        && !B->MLCPositionsX.empty()) B->MLCPositionsX = A->MLCPositionsX;
+        if( !A->MLCPositionsX.empty()
+        &&   B->MLCPositionsX.empty()) B->MLCPositionsX = A->MLCPositionsX;
     }
 
     return;
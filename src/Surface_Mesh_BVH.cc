@@ -0,0 +1,236 @@
+//Surface_Mesh_BVH.cc - A part of DICOMautomaton 2026.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "YgorMath.h"
+#include "YgorMisc.h"
+#include "YgorLog.h"
+
+#include "Surface_Mesh_BVH.h"
+
+
+// Triangles are stored as (v0, e1 = v1 - v0, e2 = v2 - v0) since this is the form the intersection test needs.
+surface_mesh_bvh::surface_mesh_bvh(const fv_surface_mesh<double, uint64_t> &mesh, size_t leaf_size){
+    if(leaf_size == 0){
+        throw std::invalid_argument("BVH leaf size must be positive. Cannot continue.");
+    }
+
+    std::vector<std::array<vec3<double>, 3>> unordered;
+    const auto N_verts = mesh.vertices.size();
+    for(const auto &f : mesh.faces){
+        if(f.size() < 3) continue;
+        for(const auto &i : f){
+            if(N_verts <= i) throw std::invalid_argument("Face refers to a nonexistent vertex. Cannot continue.");
+        }
+        const auto &A = mesh.vertices[f[0]];
+        for(size_t j = 2; j < f.size(); ++j){
+            const auto &B = mesh.vertices[f[j-1]];
+            const auto &C = mesh.vertices[f[j]];
+            unordered.push_back( {{ A, B - A, C - A }} );
+        }
+    }
+    if(std::numeric_limits<uint32_t>::max() <= unordered.size()){
+        throw std::invalid_argument("Too many triangles for BVH. Cannot continue.");
+    }
+
+    const auto N = unordered.size();
+    std::vector<vec3<double>> centroids;
+    centroids.reserve(N);
+    for(const auto &t : unordered){
+        centroids.emplace_back( t[0] + (t[1] + t[2]) / 3.0 );
+    }
+    std::vector<uint32_t> order(N);
+    std::iota(std::begin(order), std::end(order), static_cast<uint32_t>(0));
+
+    const auto get = [](const vec3<double> &v, size_t a) -> double {
+        return (a == 0) ? v.x : ((a == 1) ? v.y : v.z);
+    };
+
+    // Recursively partition the triangles at the median centroid along the longest axis of the centroid bounds.
+    // Nodes are emitted depth-first so the left child is always adjacent to its parent.
+    const auto build = [&](const auto &self, size_t begin, size_t end) -> void {
+        const auto idx = this->nodes.size();
+        this->nodes.emplace_back();
+
+        const auto inf = std::numeric_limits<double>::infinity();
+        node n;
+        n.lo = {{ inf, inf, inf }};
+        n.hi = {{ -inf, -inf, -inf }};
+        std::array<double, 3> c_lo = n.lo;
+        std::array<double, 3> c_hi = n.hi;
+        for(size_t i = begin; i < end; ++i){
+            const auto &t = unordered[order[i]];
+            const std::array<vec3<double>, 3> verts = {{ t[0], t[0] + t[1], t[0] + t[2] }};
+            for(size_t a = 0; a < 3; ++a){
+                for(const auto &v : verts){
+                    n.lo[a] = std::min(n.lo[a], get(v, a));
+                    n.hi[a] = std::max(n.hi[a], get(v, a));
+                }
+                c_lo[a] = std::min(c_lo[a], get(centroids[order[i]], a));
+                c_hi[a] = std::max(c_hi[a], get(centroids[order[i]], a));
+            }
+        }
+
+        size_t axis = 0;
+        for(size_t a = 1; a < 3; ++a){
+            if((c_hi[axis] - c_lo[axis]) < (c_hi[a] - c_lo[a])) axis = a;
+        }
+
+        if( ((end - begin) <= leaf_size)
+        ||  !((c_hi[axis] - c_lo[axis]) > 0.0) ){
+            n.offset = static_cast<uint32_t>(begin);
+            n.count = static_cast<uint32_t>(end - begin);
+            this->nodes[idx] = n;
+            return;
+        }
+
+        const auto mid = begin + (end - begin) / 2;
+        std::nth_element( std::next(std::begin(order), begin),
+                          std::next(std::begin(order), mid),
+                          std::next(std::begin(order), end),
+                          [&](uint32_t A, uint32_t B){
+                              return get(centroids[A], axis) < get(centroids[B], axis);
+                          });
+
+        self(self, begin, mid);
+        n.offset = static_cast<uint32_t>(this->nodes.size());
+        n.count = 0;
+        self(self, mid, end);
+        this->nodes[idx] = n;
+        return;
+    };
+    if(0 < N){
+        this->nodes.reserve(2 * ((N + leaf_size - 1) / leaf_size));
+        build(build, 0, N);
+    }
+
+    this->tris.reserve(N);
+    for(const auto &i : order) this->tris.push_back( unordered[i] );
+}
+
+size_t surface_mesh_bvh::triangle_count() const {
+    return this->tris.size();
+}
+
+template <class F>
+void surface_mesh_bvh::traverse(const bvh_ray *rays, size_t N, F &&f) const {
+    if(this->nodes.empty() || (N == 0)) return;
+    if(max_packet_size < N){
+        throw std::invalid_argument("Ray packet is too large. Cannot continue.");
+    }
+
+    std::array<std::array<double, 3>, max_packet_size> origin;
+    std::array<std::array<double, 3>, max_packet_size> inv_dir;
+    std::array<double, max_packet_size> dir_length;
+    uint32_t active = 0;
+    for(size_t i = 0; i < N; ++i){
+        const auto &r = rays[i];
+        origin[i] = {{ r.origin.x, r.origin.y, r.origin.z }};
+        inv_dir[i] = {{ 1.0 / r.dir.x, 1.0 / r.dir.y, 1.0 / r.dir.z }};
+        dir_length[i] = r.dir.length();
+        if( r.origin.isfinite() && r.dir.isfinite() && (0.0 < dir_length[i]) && !(r.t_max < r.t_min) ){
+            active |= (1U << i);
+        }
+    }
+
+    // Slab test. Note that 0 * inf produces NaN when a ray lies on a slab boundary; the argument order of std::min and
+    // std::max is chosen so that NaNs are ignored.
+    const auto ray_hits_box = [&](size_t i, const node &n) -> bool {
+        double t_near = rays[i].t_min;
+        double t_far  = rays[i].t_max;
+        for(size_t a = 0; a < 3; ++a){
+            double t0 = (n.lo[a] - origin[i][a]) * inv_dir[i][a];
+            double t1 = (n.hi[a] - origin[i][a]) * inv_dir[i][a];
+            if(t1 < t0) std::swap(t0, t1);
+            t_near = std::max(t_near, t0);
+            t_far  = std::min(t_far, t1);
+        }
+        return (t_near <= t_far);
+    };
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while(!stack.empty() && (active != 0)){
+        const auto &n = this->nodes[stack.back()];
+        const auto n_idx = stack.back();
+        stack.pop_back();
+
+        uint32_t mask = 0;
+        for(size_t i = 0; i < N; ++i){
+            if( ((active >> i) & 1U) && ray_hits_box(i, n) ) mask |= (1U << i);
+        }
+        if(mask == 0) continue;
+
+        if(n.count == 0){
+            stack.push_back(n.offset);
+            stack.push_back(n_idx + 1);
+            continue;
+        }
+
+        for(uint32_t j = n.offset; j < (n.offset + n.count); ++j){
+            const auto &v0 = this->tris[j][0];
+            const auto &e1 = this->tris[j][1];
+            const auto &e2 = this->tris[j][2];
+            const auto scale = e1.Cross(e2).length();
+
+            for(size_t i = 0; i < N; ++i){
+                if( !((mask >> i) & 1U) || !((active >> i) & 1U) ) continue;
+                const auto &r = rays[i];
+
+                // Moller-Trumbore. Rays (nearly) parallel to the triangle's plane are rejected.
+                const auto p = r.dir.Cross(e2);
+                const auto det = e1.Dot(p);
+                if(std::abs(det) <= 1.0E-12 * dir_length[i] * scale) continue;
+                const auto inv_det = 1.0 / det;
+
+                const auto s = r.origin - v0;
+                const auto u = s.Dot(p) * inv_det;
+                if( (u < 0.0) || (1.0 < u) ) continue;
+
+                const auto q = s.Cross(e1);
+                const auto v = r.dir.Dot(q) * inv_det;
+                if( (v < 0.0) || (1.0 < (u + v)) ) continue;
+
+                const auto t = e2.Dot(q) * inv_det;
+                if( (t < r.t_min) || (r.t_max < t) ) continue;
+
+                if(!f(i, t)) active &= ~(1U << i);
+            }
+        }
+    }
+    return;
+}
+
+void surface_mesh_bvh::all_intersections(const bvh_ray *rays, size_t N, std::vector<std::vector<double>> &hits) const {
+    if(hits.size() < N) hits.resize(N);
+    for(size_t begin = 0; begin < N; begin += max_packet_size){
+        const auto count = std::min(max_packet_size, N - begin);
+        this->traverse(rays + begin, count, [&](size_t i, double t) -> bool {
+            hits[begin + i].push_back(t);
+            return true;
+        });
+    }
+    return;
+}
+
+void surface_mesh_bvh::any_intersections(const bvh_ray *rays, size_t N, std::vector<bool> &hit) const {
+    hit.assign(N, false);
+    for(size_t begin = 0; begin < N; begin += max_packet_size){
+        const auto count = std::min(max_packet_size, N - begin);
+        this->traverse(rays + begin, count, [&](size_t i, double) -> bool {
+            hit[begin + i] = true;
+            return false;
+        });
+    }
+    return;
+}
+
@@ -0,0 +1,65 @@
+//Surface_Mesh_BVH.h.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "YgorMath.h"
+
+
+// A ray, or a segment of a ray, parameterized as origin + dir * t for t in [t_min, t_max].
+//
+// The direction need not be normalized; intersection distances are reported in units of the direction's length.
+// Infinite bounds are permitted, e.g., to represent a line.
+struct bvh_ray {
+    vec3<double> origin;
+    vec3<double> dir;
+    double t_min = 0.0;
+    double t_max = 1.0;
+};
+
+
+// A flattened bounding volume hierarchy over the triangles of a surface mesh.
+//
+// Triangles are copied into a contiguous array in traversal order and nodes are stored depth-first, so the left child
+// of an interior node immediately follows it. Intersections use the Moller-Trumbore test in double precision.
+//
+// Rays can be traversed in packets. All rays in a packet share a single traversal of the hierarchy; a node is only
+// visited if at least one ray in the packet intersects its bounding box. Packets are most effective when the rays are
+// coherent, e.g., adjacent detector pixels.
+class surface_mesh_bvh {
+  public:
+    static constexpr size_t max_packet_size = 8;
+
+  private:
+    struct node {
+        std::array<double, 3> lo;
+        std::array<double, 3> hi;
+        uint32_t offset = 0; // Leaf: first triangle. Interior: index of the right child.
+        uint32_t count = 0;  // Leaf: number of triangles. Interior: zero.
+    };
+
+    std::vector<node> nodes;
+    std::vector<std::array<vec3<double>, 3>> tris;
+
+    // Visits every (ray, triangle) intersection for the active rays in the packet, passing the ray index and the
+    // intersection distance. The functor can return false to deactivate the ray.
+    template <class F>
+    void traverse(const bvh_ray *rays, size_t N, F &&f) const;
+
+  public:
+    // Faces with more than three vertices are fan-triangulated. Leaves hold at most leaf_size triangles.
+    explicit surface_mesh_bvh(const fv_surface_mesh<double, uint64_t> &mesh, size_t leaf_size = 4);
+
+    size_t triangle_count() const;
+
+    // Appends the distances of all intersections, unsorted, to hits[i] for each ray i. Rays that merely graze a
+    // triangle's plane are not reported. Packets larger than max_packet_size are split.
+    void all_intersections(const bvh_ray *rays, size_t N, std::vector<std::vector<double>> &hits) const;
+
+    // Sets hit[i] to whether ray i intersects any triangle. Traversal for a ray stops at the first intersection.
+    void any_intersections(const bvh_ray *rays, size_t N, std::vector<bool> &hit) const;
+};
+
@@ -7,6 +7,7 @@
 #include <string>    
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <list>
 #include <functional>
 #include <array>
@@ -1998,6 +1999,32 @@ FVSMeshToPolyhedron(
 
     return output_mesh;
 }
+
+fv_surface_mesh<double, uint64_t>
+PolyhedronToFVSMesh(
+        const Polyhedron &in ){
+
+    fv_surface_mesh<double, uint64_t> out;
+
+    // Vertex handles are mapped to indices by address.
+    std::unordered_map<const void*, uint64_t> vert_index;
+    for(auto v_it = in.vertices_begin(); v_it != in.vertices_end(); ++v_it){
+        const auto &p = v_it->point();
+        vert_index[ static_cast<const void*>(&*v_it) ] = out.vertices.size();
+        out.vertices.emplace_back( static_cast<double>( CGAL::to_double( p.x() ) ),
+                                   static_cast<double>( CGAL::to_double( p.y() ) ),
+                                   static_cast<double>( CGAL::to_double( p.z() ) ) );
+    }
+    for(auto f_it = in.facets_begin(); f_it != in.facets_end(); ++f_it){
+        std::vector<uint64_t> face;
+        auto h = f_it->facet_begin();
+        do{
+            face.push_back( vert_index.at( static_cast<const void*>(&*(h->vertex())) ) );
+        }while(++h != f_it->facet_begin());
+        out.faces.emplace_back(face);
+    }
+    return out;
+}
 #endif // DCMA_USE_CGAL
 
 
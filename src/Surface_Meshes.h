@@ -88,6 +88,10 @@ namespace dcma_surface_meshes {
     Polyhedron
     FVSMeshToPolyhedron(
             const fv_surface_mesh<double, uint64_t> &mesh );
+
+    fv_surface_mesh<double, uint64_t>
+    PolyhedronToFVSMesh(
+            const Polyhedron &mesh );
 #endif // DCMA_USE_CGAL
 
 } // namespace dcma_surface_meshes
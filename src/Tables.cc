@@ -8,11 +8,22 @@
 #include <ostream>
 #include <iomanip>
 #include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
 
 #include "YgorString.h"
 #include "YgorMisc.h"
 #include "YgorLog.h"
 
+#include "Thread_Pool.h"
 #include "Tables.h"
 
 //#ifndef DCMA_TABLE_DISABLE_ALL_SPECIALIZATIONS
@@ -269,116 +280,255 @@ table2::visit_standard_block( const visitor_func_t& f ){
     return;
 }
 
-void
-table2::read_csv( std::istream &is ){
-    this->data.clear();
-    this->metadata.clear();
-
-    const std::string quotes = "\"";  // Characters that open a quote at beginning of line only.
-    const std::string escs   = "\\";  // The escape character(s) inside quotes.
-    const std::string pseps  = "\t";  // 'Priority' separation characters. If detected, these take priority over others.
-    std::string seps   = ",";   // The characters that separate cells.
+// CSV parsing helpers.
+//
+// Quotes can open anywhere outside of a quote, and the escape character can be used to escape any character (including
+// newlines) inside of quotes. Newlines outside of quotes end a record.
+namespace {
+
+constexpr char csv_quote = '"';
+constexpr char csv_esc   = '\\';
+
+enum class csv_state : uint8_t {
+    outside = 0,
+    inside  = 1,
+};
+
+struct csv_chunk_summary {
+    csv_state end_state = csv_state::outside;
+    int64_t records = 0;   // The number of record-terminating newlines.
+    int64_t seps = 0;      // The number of unquoted separators, used to reserve space.
+};
+
+// Scans a chunk that begins immediately after a newline (or at the beginning of the buffer), assuming the given state.
+// Escaped characters never straddle chunks since an escaped newline does not end a chunk.
+csv_chunk_summary summarize_csv_chunk(const char *b, const char *e, csv_state s, char sep){
+    csv_chunk_summary out;
+    for(const char *c = b; c != e; ++c){
+        if(s == csv_state::outside){
+            if(*c == csv_quote){
+                s = csv_state::inside;
+            }else if(*c == '\n'){
+                ++out.records;
+            }else if(*c == sep){
+                ++out.seps;
+            }
+        }else{
+            if(*c == csv_quote){
+                s = csv_state::outside;
+            }else if(*c == csv_esc){
+                if(std::next(c) != e) ++c;
+            }
+        }
+    }
+    out.end_state = s;
+    return out;
+}
 
-    std::stringstream ss;
+// Returns a pointer one-past the newline that terminates the record containing the given position. The position must
+// be inside a quote.
+const char* skip_quoted_csv_record(const char *b, const char *e){
+    csv_state s = csv_state::inside;
+    for(const char *c = b; c != e; ++c){
+        if(s == csv_state::outside){
+            if(*c == csv_quote){
+                s = csv_state::inside;
+            }else if(*c == '\n'){
+                return std::next(c);
+            }
+        }else{
+            if(*c == csv_quote){
+                s = csv_state::outside;
+            }else if(*c == csv_esc){
+                if(std::next(c) != e) ++c;
+            }
+        }
+    }
+    return e;
+}
 
-    // --- Automatic separator detection ---
-    const int64_t autodetect_separator_rows = 10;
+// Parses a single record, appending non-empty cells. Returns a pointer one-past the terminating newline.
+const char* parse_csv_record(const char *b, const char *e, int64_t row, char sep,
+                             std::vector<cell<std::string>> &cells){
+    bool inside_quote = false;
+    int64_t col = 0;
+    std::string val;
+
+    const auto push_cell = [&](){
+        val = Canonicalize_String2(val, CANONICALIZE::TRIM_ENDS);
+        if(!val.empty()) cells.emplace_back(row, col, val);
+        ++col;
+        val.clear();
+    };
 
-    // Buffer the input stream into a stringstream, checking for the presence of priority separators.
-    bool use_pseps = false;
-    for(int64_t i = 0; i < autodetect_separator_rows; ++i){
-        std::string line;
-        if(std::getline(is, line)){
-            // Avoid newline at end, which can appear as an extra empty row later.
-            ss << ((i==0) ? "" : "\n") << line;
-
-            const bool has_pseps = (line.find_first_of(pseps) != std::string::npos);
-            if(has_pseps){
-                use_pseps = true;
+    const char *c = b;
+    for( ; c != e; ++c){
+        const bool is_print = std::isprint(static_cast<unsigned char>(*c));
+        if(inside_quote){
+            if(*c == csv_quote){
+                inside_quote = false;
+            }else if(*c == csv_esc){
+                if(std::next(c) == e){
+                    throw std::runtime_error("Nothing to escape (row "_s + std::to_string(row) + ")");
+                }
+                ++c;
+                val.push_back( *c );
+            }else if(is_print || (*c == '\n')){
+                val.push_back( *c );
+            }
+        }else{
+            if(*c == csv_quote){
+                inside_quote = true;
+            }else if(*c == '\n'){
                 break;
+            }else if(*c == sep){
+                push_cell();
+            }else if(is_print){
+                val.push_back( *c );
             }
         }
     }
-    if(use_pseps){
-        seps = pseps;
-        YLOGINFO("Detected alternative separators, switching acceptable separators");
+    if(inside_quote){
+        throw std::invalid_argument("Unable to parse row "_s + std::to_string(row));
     }
+    push_cell();
+    return (c == e) ? e : std::next(c);
+}
 
-    // -------------------------------------
-
-    const auto clean_string = [](const std::string &in){
-        return Canonicalize_String2(in, CANONICALIZE::TRIM_ENDS);
-    };
+} // namespace
 
-    int64_t row_num = -1;
-    std::string line;
-    while(std::getline(ss, line) || std::getline(is, line)){
-        ++row_num;
-        bool inside_quote;
-        std::string cell;
-
-        int64_t col_num = 0;
-        auto c_it = std::begin(line);
-        const auto end = std::end(line);
-        for( ; c_it != end; ++c_it){
-            const bool is_quote = (quotes.find_first_of(*c_it) != std::string::npos);
-            const bool is_print = std::isprint(static_cast<unsigned char>(*c_it));
-            auto c_next_it = std::next(c_it);
-
-            if(inside_quote){
-                const bool is_esc = (escs.find_first_of(*c_it) != std::string::npos);
-
-                if(is_quote){
-                    // Close the quote.
-                    inside_quote = false;
-
-                }else if(is_esc){
-                    // Implement escape of next character.
-                    if(c_next_it == end){
-                        throw std::runtime_error("Nothing to escape (row "_s + std::to_string(row_num) + ")");
-                    }
-                    cell.push_back( *c_next_it );
-                    ++c_it;
-                    ++c_next_it;
 
-                }else if(is_print){
-                    cell.push_back( *c_it );
-                }
-                
-            }else{
-                const bool is_sep = (seps.find_first_of(*c_it) != std::string::npos);
+void
+table2::read_csv( std::istream &is ){
+    const std::string buf( (std::istreambuf_iterator<char>(is)),
+                           std::istreambuf_iterator<char>() );
+    this->read_csv(buf.data(), buf.size());
+    return;
+}
 
-                if(is_quote){
-                    // Open the quote.
-                    inside_quote = true;
+void
+table2::read_csv( const char *begin, size_t size ){
+    this->data.clear();
+    this->metadata.clear();
 
-                }else if( is_sep ){
-                    // Push cell into table.
-                    cell = clean_string(cell);
-                    if(!cell.empty()) this->inject(row_num, col_num, cell);
-                    ++col_num;
-                    cell.clear();
+    const char *end = begin + size;
 
-                }else if(is_print){
-                    cell.push_back( *c_it );
-                }
+    // --- Automatic separator detection ---
+    //
+    // Tabs take priority over commas if they appear in any of the first few lines.
+    const int64_t autodetect_separator_rows = 10;
+    char sep = ',';
+    {
+        const char *c = begin;
+        for(int64_t i = 0; (i < autodetect_separator_rows) && (c != end); ++i){
+            const auto *nl = static_cast<const char *>(std::memchr(c, '\n', static_cast<size_t>(end - c)));
+            const char *line_end = (nl == nullptr) ? end : nl;
+            if(std::find(c, line_end, '\t') != line_end){
+                sep = '\t';
+                YLOGINFO("Detected alternative separators, switching acceptable separators");
+                break;
             }
+            c = (nl == nullptr) ? end : std::next(nl);
+        }
+    }
 
-            if( c_next_it == end ){
-                // Push cell into table.
-                cell = clean_string(cell);
-                if(!cell.empty()) this->inject(row_num, col_num, cell);
-                ++col_num;
-                cell.clear();
+    // --- Partition into chunks ---
+    //
+    // Chunks begin after newlines, but a newline may be quoted so records can straddle chunks.
+    constexpr size_t target_chunk_size = static_cast<size_t>(1) << 20;
+    std::vector<std::pair<const char *, const char *>> chunks;
+    for(const char *b = begin; b != end; ){
+        const char *c = end;
+        if(target_chunk_size < static_cast<size_t>(end - b)){
+            const auto *nl = static_cast<const char *>(std::memchr(b + target_chunk_size, '\n',
+                                                                   static_cast<size_t>(end - b) - target_chunk_size));
+            c = (nl == nullptr) ? end : std::next(nl);
+        }
+        chunks.emplace_back(b, c);
+        b = c;
+    }
+    const size_t N_chunks = chunks.size();
+
+    // Runs the tasks, concurrently if there are several.
+    std::mutex saver_printer;
+    std::exception_ptr failure;
+    const auto run_over_chunks = [&](const std::function<void(size_t)> &f){
+        const auto task = [&](size_t n){
+            try{
+                f(n);
+            }catch(const std::exception &){
+                std::lock_guard<std::mutex> lock(saver_printer);
+                if(!failure) failure = std::current_exception();
+            }
+        };
+        if(N_chunks < 2){
+            for(size_t n = 0; n < N_chunks; ++n) task(n);
+        }else{
+            work_queue<std::function<void(void)>> wq;
+            for(size_t n = 0; n < N_chunks; ++n){
+                wq.submit_task([&task,n]() -> void { task(n); });
             }
+        } // Wait for all tasks to complete.
+        if(failure) std::rethrow_exception(failure);
+    };
+
+    // --- Find record boundaries ---
+    //
+    // The quote state at the start of each chunk is unknown, so each chunk is speculatively summarized for both
+    // possible states. The actual states are then resolved sequentially.
+    std::vector<std::array<csv_chunk_summary, 2>> summaries(N_chunks);
+    run_over_chunks([&](size_t n){
+        for(const auto s : { csv_state::outside, csv_state::inside }){
+            summaries[n][static_cast<size_t>(s)] = summarize_csv_chunk(chunks[n].first, chunks[n].second, s, sep);
+        }
+    });
+
+    std::vector<csv_state> start_states(N_chunks, csv_state::outside);
+    std::vector<int64_t> start_rows(N_chunks, 0);
+    std::vector<int64_t> est_cells(N_chunks, 0);
+    {
+        csv_state s = csv_state::outside;
+        int64_t row = 0;
+        for(size_t n = 0; n < N_chunks; ++n){
+            start_states[n] = s;
+            start_rows[n] = row;
+            const auto &summary = summaries[n][static_cast<size_t>(s)];
+            est_cells[n] = summary.seps + summary.records + 1;
+            s = summary.end_state;
+            row += summary.records;
         }
+    }
 
-        // Add any outstanding contents as a cell.
-        cell = clean_string(cell);
-        if( !cell.empty()
-        ||  inside_quote ){
-            throw std::invalid_argument("Unable to parse row "_s + std::to_string(row_num));
+    // --- Parse ---
+    //
+    // Each chunk parses the records that begin inside it, continuing past the end of the chunk if needed.
+    std::vector<std::vector<cell<std::string>>> chunk_cells(N_chunks);
+    run_over_chunks([&](size_t n){
+        auto &cells = chunk_cells[n];
+        cells.reserve(static_cast<size_t>(est_cells[n]));
+
+        const char *c = chunks[n].first;
+        int64_t row = start_rows[n];
+        if(start_states[n] == csv_state::inside){
+            // The record began in an earlier chunk.
+            c = skip_quoted_csv_record(c, end);
+            ++row;
+        }
+        while(c < chunks[n].second){
+            c = parse_csv_record(c, end, row, sep, cells);
+            ++row;
+        }
+    });
+
+    // --- Bulk load ---
+    //
+    // Cells are already sorted, so inserting at the end avoids searching the tree.
+    for(auto &cells : chunk_cells){
+        for(auto &c : cells){
+            this->data.emplace_hint(std::end(this->data), std::move(c));
         }
+        cells.clear();
+        cells.shrink_to_fit();
     }
 
     if(this->data.empty()){
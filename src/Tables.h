@@ -10,6 +10,7 @@
 #include <utility>
 #include <istream>
 #include <ostream>
+#include <cstddef>
 
 namespace tables {
 
@@ -96,6 +97,10 @@ struct table2 {
     // Throws on error or if nothing was read. Should work equally well with binary and text mode streams.
     void read_csv( std::istream &is );
 
+    // Read from a memory buffer, e.g., a memory-mapped file. Same as the stream variant, but large buffers are parsed
+    // concurrently. Quoted cells may span multiple lines.
+    void read_csv( const char *begin, size_t size );
+
     // Write to a stream.
     //
     // Quotes cells for maxmimum portability. Best to use with binary streams to avoid platform-specific line endings.
@@ -0,0 +1,635 @@
+//Texture_Features.cc - A part of DICOMautomaton 2026.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+#include "YgorMisc.h"
+#include "YgorLog.h"
+
+#include "Thread_Pool.h"
+#include "Texture_Features.h"
+
+
+// The 13 unique directions in a 26-connected 3D neighbourhood, as (image, row, column) offsets. The opposing
+// directions are implied by symmetry.
+static const std::array<std::array<int64_t, 3>, 13> texture_directions {{
+    {{ 0,  0,  1 }}, {{ 0,  1, -1 }}, {{ 0,  1,  0 }}, {{ 0,  1,  1 }},
+    {{ 1, -1, -1 }}, {{ 1, -1,  0 }}, {{ 1, -1,  1 }},
+    {{ 1,  0, -1 }}, {{ 1,  0,  0 }}, {{ 1,  0,  1 }},
+    {{ 1,  1, -1 }}, {{ 1,  1,  0 }}, {{ 1,  1,  1 }},
+}};
+
+
+int64_t texture_volume::index(int64_t img, int64_t row, int64_t col) const {
+    return ((img * this->rows) + row) * this->columns + col;
+}
+
+bool texture_volume::in_bounds(int64_t img, int64_t row, int64_t col) const {
+    return (0 <= img) && (img < this->images)
+        && (0 <= row) && (row < this->rows)
+        && (0 <= col) && (col < this->columns);
+}
+
+int32_t texture_volume::level(int64_t img, int64_t row, int64_t col) const {
+    if(!this->in_bounds(img, row, col)) return -1;
+    return this->voxels[ this->index(img, row, col) ];
+}
+
+int64_t texture_volume::count_roi_voxels() const {
+    return static_cast<int64_t>( std::count_if( std::begin(this->voxels), std::end(this->voxels),
+                                                [](int32_t l){ return (0 <= l); } ) );
+}
+
+
+texture_volume
+Quantise_Texture_Volume( std::list<std::reference_wrapper<planar_image<float,double>>> imgs,
+                         std::list<std::reference_wrapper<contour_collection<double>>> ccsl,
+                         int64_t levels,
+                         int64_t channel ){
+
+    if(levels < 1){
+        throw std::invalid_argument("At least one grey level is required. Cannot continue.");
+    }
+    if(static_cast<int64_t>(std::numeric_limits<int32_t>::max()) < levels){
+        throw std::invalid_argument("Too many grey levels requested. Cannot continue.");
+    }
+    if(imgs.empty()){
+        throw std::invalid_argument("No images provided. Cannot continue.");
+    }
+    if(ccsl.empty()){
+        throw std::invalid_argument("No contours provided. Cannot continue.");
+    }
+    if(!Images_Form_Rectilinear_Grid(imgs)){
+        throw std::invalid_argument("Images do not form a rectilinear grid. Cannot continue.");
+    }
+
+    const auto GridZ = imgs.front().get().image_plane().N_0;
+    planar_image_adjacency<float,double> img_adj( imgs, {}, GridZ );
+    const auto [img_num_min, img_num_max] = img_adj.get_min_max_indices();
+
+    const int64_t N_imgs = img_num_max - img_num_min + 1;
+    const int64_t N_rows = imgs.front().get().rows;
+    const int64_t N_cols = imgs.front().get().columns;
+
+    Mutate_Voxels_Opts mv_opts;
+    mv_opts.editstyle      = Mutate_Voxels_Opts::EditStyle::InPlace;
+    mv_opts.inclusivity    = Mutate_Voxels_Opts::Inclusivity::Centre;
+    mv_opts.contouroverlap = Mutate_Voxels_Opts::ContourOverlap::Ignore;
+    mv_opts.aggregate      = Mutate_Voxels_Opts::Aggregate::First;
+    mv_opts.adjacency      = Mutate_Voxels_Opts::Adjacency::SingleVoxel;
+    mv_opts.maskmod        = Mutate_Voxels_Opts::MaskMod::Noop;
+
+    // Pass 1: determine which voxels are interior to the ROI, the ROI bounding box, and the ROI intensity range.
+    std::vector<std::vector<uint8_t>> masks(N_imgs);
+
+    std::mutex saver;
+    std::exception_ptr failure;
+    double I_min = std::numeric_limits<double>::infinity();
+    double I_max = -I_min;
+    int64_t img_lo = std::numeric_limits<int64_t>::max();
+    int64_t img_hi = std::numeric_limits<int64_t>::lowest();
+    int64_t row_lo = img_lo;
+    int64_t row_hi = img_hi;
+    int64_t col_lo = img_lo;
+    int64_t col_hi = img_hi;
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(int64_t n = 0; n < N_imgs; ++n){
+            wq.submit_task([&,n]() -> void {
+                try{
+                    auto img_refw = img_adj.index_to_image(n + img_num_min);
+                    auto &mask = masks[n];
+                    mask.assign(N_rows * N_cols, 0);
+
+                    double l_I_min = std::numeric_limits<double>::infinity();
+                    double l_I_max = -l_I_min;
+                    int64_t l_row_lo = std::numeric_limits<int64_t>::max();
+                    int64_t l_row_hi = std::numeric_limits<int64_t>::lowest();
+                    int64_t l_col_lo = l_row_lo;
+                    int64_t l_col_hi = l_row_hi;
+
+                    auto f_bounded = [&](int64_t E_row,
+                                         int64_t E_col,
+                                         int64_t E_chan,
+                                         std::reference_wrapper<planar_image<float,double>> /*l_img_refw*/,
+                                         std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
+                                         float &voxel_val) {
+                        if( (E_chan != channel) || !std::isfinite(voxel_val) ) return;
+                        mask[E_row * N_cols + E_col] = 1;
+                        l_I_min = std::min<double>(l_I_min, voxel_val);
+                        l_I_max = std::max<double>(l_I_max, voxel_val);
+                        l_row_lo = std::min(l_row_lo, E_row);
+                        l_row_hi = std::max(l_row_hi, E_row);
+                        l_col_lo = std::min(l_col_lo, E_col);
+                        l_col_hi = std::max(l_col_hi, E_col);
+                        return;
+                    };
+
+                    Mutate_Voxels<float,double>( img_refw,
+                                                 { img_refw },
+                                                 ccsl,
+                                                 mv_opts,
+                                                 f_bounded );
+
+                    if(l_row_lo <= l_row_hi){
+                        std::lock_guard<std::mutex> lock(saver);
+                        I_min  = std::min(I_min, l_I_min);
+                        I_max  = std::max(I_max, l_I_max);
+                        img_lo = std::min(img_lo, n);
+                        img_hi = std::max(img_hi, n);
+                        row_lo = std::min(row_lo, l_row_lo);
+                        row_hi = std::max(row_hi, l_row_hi);
+                        col_lo = std::min(col_lo, l_col_lo);
+                        col_hi = std::max(col_hi, l_col_hi);
+                    }
+                }catch(const std::exception &){
+                    std::lock_guard<std::mutex> lock(saver);
+                    if(!failure) failure = std::current_exception();
+                }
+                return;
+            });
+        }
+    } // Wait for all tasks to complete.
+    if(failure) std::rethrow_exception(failure);
+
+    if(img_hi < img_lo){
+        throw std::domain_error("No voxels identified interior to the selected ROI(s). Cannot continue.");
+    }
+
+    // Pass 2: quantise the voxels within the ROI bounding box.
+    texture_volume out;
+    out.images  = img_hi - img_lo + 1;
+    out.rows    = row_hi - row_lo + 1;
+    out.columns = col_hi - col_lo + 1;
+    out.levels  = levels;
+    out.intensity_min = I_min;
+    out.intensity_max = I_max;
+    out.voxels.assign(out.images * out.rows * out.columns, -1);
+
+    const double I_range = I_max - I_min;
+    const auto quantise = [&](double I) -> int32_t {
+        if(!(0.0 < I_range)) return 0;
+        const auto l = static_cast<int64_t>( std::floor( static_cast<double>(levels) * (I - I_min) / I_range ) );
+        return static_cast<int32_t>( std::clamp<int64_t>(l, 0, levels - 1) );
+    };
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(int64_t k = 0; k < out.images; ++k){
+            wq.submit_task([&,k]() -> void {
+                try{
+                    const int64_t n = k + img_lo;
+                    auto img_refw = img_adj.index_to_image(n + img_num_min);
+                    const auto &mask = masks[n];
+                    for(int64_t r = 0; r < out.rows; ++r){
+                        for(int64_t c = 0; c < out.columns; ++c){
+                            const auto row = r + row_lo;
+                            const auto col = c + col_lo;
+                            if(mask[row * N_cols + col] == 0) continue;
+                            out.voxels[ out.index(k, r, c) ] = quantise( img_refw.get().value(row, col, channel) );
+                        }
+                    }
+                }catch(const std::exception &){
+                    std::lock_guard<std::mutex> lock(saver);
+                    if(!failure) failure = std::current_exception();
+                }
+                return;
+            });
+        }
+    } // Wait for all tasks to complete.
+    if(failure) std::rethrow_exception(failure);
+
+    return out;
+}
+
+
+texture_matrices
+Compute_Texture_Matrices( const texture_volume &vol ){
+    const int64_t L = vol.levels;
+    if(L < 1){
+        throw std::invalid_argument("Volume has not been quantised. Cannot continue.");
+    }
+    if(static_cast<int64_t>(vol.voxels.size()) != (vol.images * vol.rows * vol.columns)){
+        throw std::invalid_argument("Volume dimensions are inconsistent. Cannot continue.");
+    }
+
+    texture_matrices out;
+    out.levels = L;
+    out.max_run_length = std::max({ vol.images, vol.rows, vol.columns, static_cast<int64_t>(1) });
+    const int64_t R = out.max_run_length;
+    const auto N_dirs = static_cast<int64_t>(texture_directions.size());
+    out.glcm.assign(N_dirs, std::vector<double>(L * L, 0.0));
+    out.glrlm.assign(N_dirs, std::vector<double>(L * R, 0.0));
+
+    // Partition the volume into slabs of adjacent images. Each slab accumulates into private partial matrices, which
+    // are reduced into the output when the slab is complete. Voxels are only ever read, so slabs can freely inspect
+    // neighbouring voxels in other slabs.
+    const auto N_threads = static_cast<int64_t>( std::max(1U, std::thread::hardware_concurrency()) );
+    const int64_t N_slabs = std::clamp<int64_t>(N_threads * 2, 1, std::max<int64_t>(vol.images, 1));
+    const int64_t slab_thickness = (vol.images + N_slabs - 1) / N_slabs;
+
+    std::mutex saver;
+    std::exception_ptr failure;
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(int64_t s = 0; s < N_slabs; ++s){
+            const int64_t k_begin = s * slab_thickness;
+            const int64_t k_end = std::min(vol.images, k_begin + slab_thickness);
+            if(k_end <= k_begin) continue;
+
+            wq.submit_task([&,k_begin,k_end]() -> void {
+                try{
+                    std::vector<std::vector<double>> l_glcm(N_dirs, std::vector<double>(L * L, 0.0));
+                    std::vector<std::vector<double>> l_glrlm(N_dirs, std::vector<double>(L * R, 0.0));
+
+                    for(int64_t k = k_begin; k < k_end; ++k){
+                        for(int64_t r = 0; r < vol.rows; ++r){
+                            for(int64_t c = 0; c < vol.columns; ++c){
+                                const int32_t i = vol.voxels[ vol.index(k, r, c) ];
+                                if(i < 0) continue;
+
+                                for(int64_t d = 0; d < N_dirs; ++d){
+                                    const auto dk = texture_directions[d][0];
+                                    const auto dr = texture_directions[d][1];
+                                    const auto dc = texture_directions[d][2];
+
+                                    // Co-occurrence with the forward neighbour, recorded symmetrically.
+                                    const int32_t j = vol.level(k + dk, r + dr, c + dc);
+                                    if(0 <= j){
+                                        l_glcm[d][i * L + j] += 1.0;
+                                        l_glcm[d][j * L + i] += 1.0;
+                                    }
+
+                                    // Runs are only counted from their first voxel, so each voxel is walked at most once per
+                                    // direction.
+                                    if(vol.level(k - dk, r - dr, c - dc) != i){
+                                        int64_t n = 1;
+                                        while(vol.level(k + n * dk, r + n * dr, c + n * dc) == i) ++n;
+                                        l_glrlm[d][i * R + (n - 1)] += 1.0;
+                                    }
+                                }
+                            }
+                        }
+                    }
+
+                    std::lock_guard<std::mutex> lock(saver);
+                    for(int64_t d = 0; d < N_dirs; ++d){
+                        std::transform( std::begin(l_glcm[d]), std::end(l_glcm[d]),
+                                        std::begin(out.glcm[d]), std::begin(out.glcm[d]), std::plus<double>() );
+                        std::transform( std::begin(l_glrlm[d]), std::end(l_glrlm[d]),
+                                        std::begin(out.glrlm[d]), std::begin(out.glrlm[d]), std::plus<double>() );
+                    }
+                }catch(const std::exception &){
+                    std::lock_guard<std::mutex> lock(saver);
+                    if(!failure) failure = std::current_exception();
+                }
+                return;
+            });
+        }
+
+        // Size zones are connected components, which are extracted with a flood fill concurrently with the above.
+        wq.submit_task([&]() -> void {
+            try{
+                std::map<std::pair<int64_t, int64_t>, double> l_glszm;
+                std::vector<uint8_t> visited(vol.voxels.size(), 0);
+                std::vector<std::array<int64_t, 3>> stack;
+
+                for(int64_t k = 0; k < vol.images; ++k){
+                    for(int64_t r = 0; r < vol.rows; ++r){
+                        for(int64_t c = 0; c < vol.columns; ++c){
+                            const auto seed_index = vol.index(k, r, c);
+                            const int32_t i = vol.voxels[seed_index];
+                            if( (i < 0) || (visited[seed_index] != 0) ) continue;
+
+                            int64_t zone_size = 0;
+                            visited[seed_index] = 1;
+                            stack.clear();
+                            stack.push_back({{ k, r, c }});
+                            while(!stack.empty()){
+                                const auto v = stack.back();
+                                stack.pop_back();
+                                ++zone_size;
+
+                                for(int64_t nk = -1; nk <= 1; ++nk){
+                                    for(int64_t nr = -1; nr <= 1; ++nr){
+                                        for(int64_t nc = -1; nc <= 1; ++nc){
+                                            const auto ak = v[0] + nk;
+                                            const auto ar = v[1] + nr;
+                                            const auto ac = v[2] + nc;
+                                            if(vol.level(ak, ar, ac) != i) continue;
+                                            const auto a_index = vol.index(ak, ar, ac);
+                                            if(visited[a_index] != 0) continue;
+                                            visited[a_index] = 1;
+                                            stack.push_back({{ ak, ar, ac }});
+                                        }
+                                    }
+                                }
+                            }
+                            l_glszm[ std::make_pair(static_cast<int64_t>(i), zone_size) ] += 1.0;
+                        }
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(saver);
+                out.glszm.swap(l_glszm);
+            }catch(const std::exception &){
+                std::lock_guard<std::mutex> lock(saver);
+                if(!failure) failure = std::current_exception();
+            }
+            return;
+        });
+    } // Wait for all tasks to complete.
+    if(failure) std::rethrow_exception(failure);
+
+    return out;
+}
+
+
+// Features common to run-length and size-zone matrices, which share the same structure: a count of 'groups' (runs or
+// zones) indexed by grey level (i) and group size (j). Levels and sizes are both 1-based.
+struct group_matrix_features {
+    double SmallEmphasis = 0.0;
+    double LargeEmphasis = 0.0;
+    double LowGreyLevelEmphasis = 0.0;
+    double HighGreyLevelEmphasis = 0.0;
+    double SmallLowGreyLevelEmphasis = 0.0;
+    double SmallHighGreyLevelEmphasis = 0.0;
+    double LargeLowGreyLevelEmphasis = 0.0;
+    double LargeHighGreyLevelEmphasis = 0.0;
+    double GreyLevelNonUniformity = 0.0;
+    double GreyLevelNonUniformityNormalised = 0.0;
+    double SizeNonUniformity = 0.0;
+    double SizeNonUniformityNormalised = 0.0;
+    double Percentage = 0.0;
+    double GreyLevelVariance = 0.0;
+    double SizeVariance = 0.0;
+    double Entropy = 0.0;
+};
+
+// Entries are (grey level index, group size, count).
+static
+group_matrix_features
+compute_group_matrix_features( const std::vector<std::array<double, 3>> &entries,
+                               double N_roi_voxels ){
+    group_matrix_features f;
+
+    double N_s = 0.0;
+    std::map<double, double> by_level;
+    std::map<double, double> by_size;
+    for(const auto &e : entries){
+        N_s += e[2];
+        by_level[e[0]] += e[2];
+        by_size[e[1]] += e[2];
+    }
+    if(!(0.0 < N_s)){
+        const auto nan = std::numeric_limits<double>::quiet_NaN();
+        return { nan, nan, nan, nan, nan, nan, nan, nan, nan, nan, nan, nan, nan, nan, nan, nan };
+    }
+
+    double mu_i = 0.0;
+    double mu_j = 0.0;
+    for(const auto &e : entries){
+        const auto i = e[0] + 1.0;
+        const auto j = e[1];
+        const auto n = e[2];
+        const auto p = n / N_s;
+        const auto i2 = i * i;
+        const auto j2 = j * j;
+
+        f.SmallEmphasis              += n / j2;
+        f.LargeEmphasis              += n * j2;
+        f.LowGreyLevelEmphasis       += n / i2;
+        f.HighGreyLevelEmphasis      += n * i2;
+        f.SmallLowGreyLevelEmphasis  += n / (i2 * j2);
+        f.SmallHighGreyLevelEmphasis += n * i2 / j2;
+        f.LargeLowGreyLevelEmphasis  += n * j2 / i2;
+        f.LargeHighGreyLevelEmphasis += n * i2 * j2;
+        f.Entropy                    -= p * std::log2(p);
+        mu_i += i * p;
+        mu_j += j * p;
+    }
+    for(const auto &e : entries){
+        const auto p = e[2] / N_s;
+        f.GreyLevelVariance += std::pow(e[0] + 1.0 - mu_i, 2.0) * p;
+        f.SizeVariance      += std::pow(e[1] - mu_j, 2.0) * p;
+    }
+    for(const auto &p : by_level) f.GreyLevelNonUniformity += p.second * p.second;
+    for(const auto &p : by_size)  f.SizeNonUniformity      += p.second * p.second;
+
+    f.SmallEmphasis              /= N_s;
+    f.LargeEmphasis              /= N_s;
+    f.LowGreyLevelEmphasis       /= N_s;
+    f.HighGreyLevelEmphasis      /= N_s;
+    f.SmallLowGreyLevelEmphasis  /= N_s;
+    f.SmallHighGreyLevelEmphasis /= N_s;
+    f.LargeLowGreyLevelEmphasis  /= N_s;
+    f.LargeHighGreyLevelEmphasis /= N_s;
+    f.GreyLevelNonUniformityNormalised = f.GreyLevelNonUniformity / (N_s * N_s);
+    f.GreyLevelNonUniformity          /= N_s;
+    f.SizeNonUniformityNormalised      = f.SizeNonUniformity / (N_s * N_s);
+    f.SizeNonUniformity               /= N_s;
+    f.Percentage = N_s / N_roi_voxels;
+    return f;
+}
+
+
+std::vector<std::pair<std::string, double>>
+Compute_Texture_Features( const texture_matrices &tm,
+                          int64_t N_roi_voxels ){
+    std::vector<std::pair<std::string, double>> out;
+    const int64_t L = tm.levels;
+    const int64_t R = tm.max_run_length;
+    const auto Ng = static_cast<double>(L);
+    const auto nan = std::numeric_limits<double>::quiet_NaN();
+
+    // Co-occurrence features, averaged over all directions with at least one co-occurrence.
+    {
+        const std::vector<std::string> names = {
+            "JointMaximum", "JointAverage", "JointVariance", "JointEntropy",
+            "DifferenceAverage", "DifferenceVariance", "DifferenceEntropy",
+            "SumAverage", "SumVariance", "SumEntropy",
+            "AngularSecondMoment", "Contrast", "Dissimilarity",
+            "InverseDifference", "InverseDifferenceNormalised",
+            "InverseDifferenceMoment", "InverseDifferenceMomentNormalised",
+            "InverseVariance", "Correlation", "Autocorrelation",
+            "ClusterTendency", "ClusterShade", "ClusterProminence" };
+        std::vector<double> sums(names.size(), 0.0);
+        int64_t N_valid_dirs = 0;
+
+        for(const auto &M : tm.glcm){
+            const auto N = std::accumulate(std::begin(M), std::end(M), 0.0);
+            if(!(0.0 < N)) continue;
+            ++N_valid_dirs;
+
+            std::vector<double> p_x(L, 0.0);
+            std::vector<double> p_diff(L, 0.0);
+            std::vector<double> p_sum(2 * L, 0.0);
+            double joint_max = 0.0;
+            for(int64_t a = 0; a < L; ++a){
+                for(int64_t b = 0; b < L; ++b){
+                    const auto p = M[a * L + b] / N;
+                    p_x[a] += p;
+                    p_diff[ std::abs(a - b) ] += p;
+                    p_sum[a + b] += p;
+                    joint_max = std::max(joint_max, p);
+                }
+            }
+            double mu = 0.0;
+            for(int64_t a = 0; a < L; ++a) mu += static_cast<double>(a + 1) * p_x[a];
+
+            std::vector<double> f(names.size(), 0.0);
+            f[0] = joint_max;
+            f[1] = mu;
+            for(int64_t a = 0; a < L; ++a){
+                for(int64_t b = 0; b < L; ++b){
+                    const auto p = M[a * L + b] / N;
+                    if(p <= 0.0) continue;
+                    const auto i = static_cast<double>(a + 1);
+                    const auto j = static_cast<double>(b + 1);
+                    const auto d = std::abs(i - j);
+                    const auto t = i + j - 2.0 * mu;
+                    f[2]  += (i - mu) * (i - mu) * p;
+                    f[3]  -= p * std::log2(p);
+                    f[10] += p * p;
+                    f[11] += d * d * p;
+                    f[12] += d * p;
+                    f[13] += p / (1.0 + d);
+                    f[14] += p / (1.0 + d / Ng);
+                    f[15] += p / (1.0 + d * d);
+                    f[16] += p / (1.0 + d * d / (Ng * Ng));
+                    f[18] += (i - mu) * (j - mu) * p;
+                    f[19] += i * j * p;
+                    f[20] += t * t * p;
+                    f[21] += t * t * t * p;
+                    f[22] += t * t * t * t * p;
+                }
+            }
+            for(int64_t k = 0; k < L; ++k){
+                const auto p = p_diff[k];
+                f[4] += static_cast<double>(k) * p;
+                if(0.0 < p) f[6] -= p * std::log2(p);
+                if(0 < k) f[17] += p / static_cast<double>(k * k);
+            }
+            for(int64_t k = 0; k < L; ++k){
+                f[5] += std::pow(static_cast<double>(k) - f[4], 2.0) * p_diff[k];
+            }
+            for(int64_t k = 0; k < (2 * L); ++k){
+                const auto p = p_sum[k];
+                f[7] += static_cast<double>(k + 2) * p;
+                if(0.0 < p) f[9] -= p * std::log2(p);
+            }
+            for(int64_t k = 0; k < (2 * L); ++k){
+                f[8] += std::pow(static_cast<double>(k + 2) - f[7], 2.0) * p_sum[k];
+            }
+
+            // Since the matrix is symmetric, the marginal variances are equal to the joint variance.
+            f[18] = (0.0 < f[2]) ? f[18] / f[2] : nan;
+
+            for(size_t n = 0; n < names.size(); ++n) sums[n] += f[n];
+        }
+
+        for(size_t n = 0; n < names.size(); ++n){
+            out.emplace_back( "GLCM_" + names[n],
+                              (0 < N_valid_dirs) ? sums[n] / static_cast<double>(N_valid_dirs) : nan );
+        }
+    }
+
+    const auto emit_group_features = [&](const std::string &prefix,
+                                         const std::string &group,
+                                         const std::string &size,
+                                         const std::string &small,
+                                         const std::string &large,
+                                         const group_matrix_features &f){
+        out.emplace_back( prefix + small + group + "Emphasis", f.SmallEmphasis );
+        out.emplace_back( prefix + large + group + "Emphasis", f.LargeEmphasis );
+        out.emplace_back( prefix + "LowGreyLevel" + group + "Emphasis", f.LowGreyLevelEmphasis );
+        out.emplace_back( prefix + "HighGreyLevel" + group + "Emphasis", f.HighGreyLevelEmphasis );
+        out.emplace_back( prefix + small + group + "LowGreyLevelEmphasis", f.SmallLowGreyLevelEmphasis );
+        out.emplace_back( prefix + small + group + "HighGreyLevelEmphasis", f.SmallHighGreyLevelEmphasis );
+        out.emplace_back( prefix + large + group + "LowGreyLevelEmphasis", f.LargeLowGreyLevelEmphasis );
+        out.emplace_back( prefix + large + group + "HighGreyLevelEmphasis", f.LargeHighGreyLevelEmphasis );
+        out.emplace_back( prefix + "GreyLevelNonUniformity", f.GreyLevelNonUniformity );
+        out.emplace_back( prefix + "GreyLevelNonUniformityNormalised", f.GreyLevelNonUniformityNormalised );
+        out.emplace_back( prefix + size + "NonUniformity", f.SizeNonUniformity );
+        out.emplace_back( prefix + size + "NonUniformityNormalised", f.SizeNonUniformityNormalised );
+        out.emplace_back( prefix + group + "Percentage", f.Percentage );
+        out.emplace_back( prefix + "GreyLevelVariance", f.GreyLevelVariance );
+        out.emplace_back( prefix + size + "Variance", f.SizeVariance );
+        out.emplace_back( prefix + group + "Entropy", f.Entropy );
+        return;
+    };
+
+    // Run-length features, averaged over all directions.
+    {
+        group_matrix_features avg;
+        int64_t N_valid_dirs = 0;
+        std::vector<std::array<double, 3>> entries;
+        for(const auto &M : tm.glrlm){
+            entries.clear();
+            for(int64_t a = 0; a < L; ++a){
+                for(int64_t b = 0; b < R; ++b){
+                    const auto n = M[a * R + b];
+                    if(0.0 < n) entries.push_back({{ static_cast<double>(a), static_cast<double>(b + 1), n }});
+                }
+            }
+            if(entries.empty()) continue;
+            ++N_valid_dirs;
+
+            const auto f = compute_group_matrix_features(entries, static_cast<double>(N_roi_voxels));
+            avg.SmallEmphasis                    += f.SmallEmphasis;
+            avg.LargeEmphasis                    += f.LargeEmphasis;
+            avg.LowGreyLevelEmphasis             += f.LowGreyLevelEmphasis;
+            avg.HighGreyLevelEmphasis            += f.HighGreyLevelEmphasis;
+            avg.SmallLowGreyLevelEmphasis        += f.SmallLowGreyLevelEmphasis;
+            avg.SmallHighGreyLevelEmphasis       += f.SmallHighGreyLevelEmphasis;
+            avg.LargeLowGreyLevelEmphasis        += f.LargeLowGreyLevelEmphasis;
+            avg.LargeHighGreyLevelEmphasis       += f.LargeHighGreyLevelEmphasis;
+            avg.GreyLevelNonUniformity           += f.GreyLevelNonUniformity;
+            avg.GreyLevelNonUniformityNormalised += f.GreyLevelNonUniformityNormalised;
+            avg.SizeNonUniformity                += f.SizeNonUniformity;
+            avg.SizeNonUniformityNormalised      += f.SizeNonUniformityNormalised;
+            avg.Percentage                       += f.Percentage;
+            avg.GreyLevelVariance                += f.GreyLevelVariance;
+            avg.SizeVariance                     += f.SizeVariance;
+            avg.Entropy                          += f.Entropy;
+        }
+        const auto w = (0 < N_valid_dirs) ? 1.0 / static_cast<double>(N_valid_dirs) : nan;
+        for(auto *x : { &avg.SmallEmphasis, &avg.LargeEmphasis, &avg.LowGreyLevelEmphasis,
+                        &avg.HighGreyLevelEmphasis, &avg.SmallLowGreyLevelEmphasis, &avg.SmallHighGreyLevelEmphasis,
+                        &avg.LargeLowGreyLevelEmphasis, &avg.LargeHighGreyLevelEmphasis,
+                        &avg.GreyLevelNonUniformity, &avg.GreyLevelNonUniformityNormalised,
+                        &avg.SizeNonUniformity, &avg.SizeNonUniformityNormalised, &avg.Percentage,
+                        &avg.GreyLevelVariance, &avg.SizeVariance, &avg.Entropy }){
+            *x *= w;
+        }
+        emit_group_features("GLRLM_", "Run", "RunLength", "Short", "Long", avg);
+    }
+
+    // Size-zone features.
+    {
+        std::vector<std::array<double, 3>> entries;
+        for(const auto &p : tm.glszm){
+            entries.push_back({{ static_cast<double>(p.first.first), static_cast<double>(p.first.second), p.second }});
+        }
+        emit_group_features("GLSZM_", "Zone", "ZoneSize", "Small", "Large",
+                            compute_group_matrix_features(entries, static_cast<double>(N_roi_voxels)));
+    }
+
+    return out;
+}
+
@@ -0,0 +1,81 @@
+//Texture_Features.h.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+
+
+// A quantised, masked, rectilinear voxel volume suitable for texture matrix extraction.
+//
+// Only the bounding box of the ROI is retained. Voxels outside of the ROI are marked with a negative grey level.
+struct texture_volume {
+    int64_t images  = 0;
+    int64_t rows    = 0;
+    int64_t columns = 0;
+    int64_t levels  = 0; // Number of distinct grey levels; valid levels are [0, levels).
+
+    double intensity_min = 0.0; // ROI intensity range used for quantisation.
+    double intensity_max = 0.0;
+
+    std::vector<int32_t> voxels; // Indexed as ((img * rows) + row) * columns + col.
+
+    int64_t index(int64_t img, int64_t row, int64_t col) const;
+    bool in_bounds(int64_t img, int64_t row, int64_t col) const;
+
+    // Returns the grey level, or a negative value if the voxel is outside of the ROI or outside of the volume.
+    int32_t level(int64_t img, int64_t row, int64_t col) const;
+
+    int64_t count_roi_voxels() const;
+};
+
+
+// Extract and quantise the voxels interior to the provided contours using a fixed number of bins.
+//
+// The images must form a rectilinear grid. They are ordered along the average contour normal. Voxels are classified
+// using their centre. Voxels are harvested and quantised in parallel.
+texture_volume
+Quantise_Texture_Volume( std::list<std::reference_wrapper<planar_image<float,double>>> imgs,
+                         std::list<std::reference_wrapper<contour_collection<double>>> ccsl,
+                         int64_t levels,
+                         int64_t channel = 0 );
+
+
+// Texture matrices for all 13 unique 3D directions.
+//
+// Co-occurrence and run-length matrices are stored densely in row-major order, one per direction.
+struct texture_matrices {
+    int64_t levels = 0;
+    int64_t max_run_length = 0;
+
+    std::vector<std::vector<double>> glcm;  // [direction][i * levels + j], symmetric.
+    std::vector<std::vector<double>> glrlm; // [direction][i * max_run_length + (run_length - 1)].
+
+    // Zone sizes are unbounded, so the size-zone matrix is stored sparsely.
+    std::map<std::pair<int64_t, int64_t>, double> glszm; // (grey level, zone size) -> number of zones. 26-connectivity.
+};
+
+// Compute the grey level co-occurrence, run-length, and size-zone matrices in a single pass over the volume for all
+// directions simultaneously. The volume is partitioned into slabs which are processed in parallel, each with private
+// partial matrices, which are summed afterward.
+texture_matrices
+Compute_Texture_Matrices( const texture_volume &vol );
+
+
+// Compute a standard (IBSI-aligned) set of features from the texture matrices.
+//
+// GLCM and GLRLM features are computed separately for each direction and then averaged. Feature names are prefixed
+// with the matrix type, e.g., 'GLCM_Contrast'. The order of the returned features is stable. Empty (default)
+// matrices produce the full set of features, all NaN.
+std::vector<std::pair<std::string, double>>
+Compute_Texture_Features( const texture_matrices &tm,
+                          int64_t N_roi_voxels );
+
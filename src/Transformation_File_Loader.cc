@@ -110,7 +110,8 @@ ReadTransform3(Transform3 &t3,
 // Write the transformation to a custom file format.
 bool
 WriteTransform3(const Transform3 &t3,
-                std::ostream &os ){
+                std::ostream &os,
+                const deformation_field_write_opts &dfwo ){
 
     os << "DCMA_TRANSFORM" << std::endl;
 
@@ -132,7 +133,7 @@ WriteTransform3(const Transform3 &t3,
             YLOGINFO("Exporting affine transformation now");
             os << "TRANSFORM_VARIANT_AFFINE_3" << std::endl;
             if(!(t.write_to(os))){
-                std::runtime_error("Unable to write to file. Cannot continue.");
+                throw std::runtime_error("Unable to write to file. Cannot continue.");
             }
 
         // Thin-plate spline transformations.
@@ -140,15 +141,15 @@ WriteTransform3(const Transform3 &t3,
             YLOGINFO("Exporting thin-plate spline transformation now");
             os << "TRANSFORM_VARIANT_THIN_PLATE_SPLINE_3" << std::endl;
             if(!(t.write_to(os))){
-                std::runtime_error("Unable to write to file. Cannot continue.");
+                throw std::runtime_error("Unable to write to file. Cannot continue.");
             }
 
         // Vector deformation fields.
         }else if constexpr (std::is_same_v<V, deformation_field>){
             YLOGINFO("Exporting vector deformation field now");
             os << "TRANSFORM_VARIANT_DEFORMATION_FIELD_3" << std::endl;
-            if(!(t.write_to(os))){
-                std::runtime_error("Unable to write to file. Cannot continue.");
+            if(!(t.write_to(os, dfwo))){
+                throw std::runtime_error("Unable to write to file. Cannot continue.");
             }
 
         }else{
@@ -190,7 +191,7 @@ bool Load_Transforms_From_Files( Drover &DICOM_data,
         try{
             //////////////////////////////////////////////////////////////
             // Attempt to load the file.
-            std::ifstream FI(Filename, std::ios::in);
+            std::ifstream FI(Filename, std::ios::in | std::ios::binary);
             const bool read_ok = ReadTransform3(*(DICOM_data.trans_data.back()), FI);
 
             if(!read_ok){
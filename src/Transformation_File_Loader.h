@@ -17,9 +17,12 @@ ReadTransform3(Transform3 &t3,
                std::istream &is );
 
 // Write the transformation to a custom file format.
+//
+// Note: some transformations are written in binary, so the stream should be opened in binary mode.
 bool
 WriteTransform3(const Transform3 &t3,
-                std::ostream &os );
+                std::ostream &os,
+                const deformation_field_write_opts &dfwo = deformation_field_write_opts() );
 
 
 bool Load_Transforms_From_Files( Drover &DICOM_data,
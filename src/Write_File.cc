@@ -4,11 +4,19 @@
 #include <boost/interprocess/sync/named_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <fstream>
+#include <mutex>
+#include <sstream>
 #include <stdexcept>
 #include <string>    
 #include <memory>
 #include <filesystem>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "YgorFilesDirs.h"
 #include "YgorMisc.h"
@@ -72,3 +80,128 @@ void Append_File( const std::function<std::string(void)>& gen_file_name,
 
     return;
 }
+
+
+// The process-wide write-behind queue.
+//
+// The worker thread is detached and only lives while there are pending writers. This avoids joining at static
+// destruction time and leaves no worker behind after a flush, which keeps fork() safe.
+namespace {
+
+struct write_behind_task {
+    std::string description;
+    size_t bytes = 0;
+    std::function<bool(void)> writer;
+};
+
+struct write_behind_queue {
+    // Limit on the memory (approximately) held by pending writers. A single writer larger than the budget is still
+    // accepted, but only once the queue has drained.
+    static constexpr size_t byte_budget = static_cast<size_t>(512) * 1024 * 1024;
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<write_behind_task> tasks;
+    size_t pending_bytes = 0;   // Includes the task currently being written.
+    bool worker_running = false;
+    std::vector<std::string> failures;
+
+    void work(){
+        std::unique_lock<std::mutex> lock(this->m);
+        while(!this->tasks.empty()){
+            auto t = std::move(this->tasks.front());
+            this->tasks.pop_front();
+            lock.unlock();
+
+            std::string failure;
+            try{
+                if(!t.writer()) failure = t.description + ": writer reported failure";
+            }catch(const std::exception &e){
+                failure = t.description + ": " + e.what();
+            }catch(...){
+                failure = t.description + ": unknown error";
+            }
+            t.writer = nullptr; // Release the snapshot before reporting completion.
+            if(failure.empty()){
+                YLOGINFO("Finished writing " << t.description);
+            }else{
+                YLOGWARN("Deferred write failed: " << failure);
+            }
+
+            lock.lock();
+            if(!failure.empty()) this->failures.emplace_back(failure);
+            this->pending_bytes -= t.bytes;
+            this->cv.notify_all();
+        }
+        this->worker_running = false;
+        this->cv.notify_all();
+        return;
+    }
+};
+
+write_behind_queue& get_write_behind_queue(){
+    static write_behind_queue q;
+    return q;
+}
+
+} // namespace
+
+
+void Write_Behind( const std::filesystem::path &filename,
+                   size_t bytes,
+                   std::function<bool(void)> writer ){
+    if(!writer){
+        throw std::invalid_argument("No writer provided. Cannot continue.");
+    }
+
+    // Reserve the filename. Existing files are left untouched since the writer might append to them.
+    if(!std::filesystem::exists(filename)){
+        std::ofstream of(filename, std::ios::out | std::ios::app | std::ios::binary);
+        if(!of){
+            throw std::runtime_error("Unable to create file '" + filename.string() + "'. Cannot continue.");
+        }
+    }
+
+    auto &q = get_write_behind_queue();
+    std::unique_lock<std::mutex> lock(q.m);
+    q.cv.wait(lock, [&](){
+        return (q.pending_bytes == 0)
+            || (q.pending_bytes + bytes <= write_behind_queue::byte_budget);
+    });
+
+    write_behind_task t;
+    t.description = "'" + filename.string() + "'";
+    t.bytes = bytes;
+    t.writer = std::move(writer);
+    q.tasks.emplace_back(std::move(t));
+    q.pending_bytes += bytes;
+
+    if(!q.worker_running){
+        q.worker_running = true;
+        try{
+            std::thread([&q](){ q.work(); }).detach();
+        }catch(const std::exception &){
+            q.worker_running = false;
+            q.pending_bytes -= bytes;
+            q.tasks.pop_back();
+            throw;
+        }
+    }
+    return;
+}
+
+
+void Flush_Write_Behind(){
+    auto &q = get_write_behind_queue();
+    std::unique_lock<std::mutex> lock(q.m);
+    q.cv.wait(lock, [&](){
+        return q.tasks.empty() && !q.worker_running;
+    });
+
+    if(q.failures.empty()) return;
+    std::stringstream ss;
+    ss << "Unable to write " << q.failures.size() << " file(s):";
+    for(const auto &f : q.failures) ss << " " << f << ";";
+    q.failures.clear();
+    throw std::runtime_error(ss.str());
+}
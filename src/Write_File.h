@@ -37,3 +37,21 @@ void Append_File( const std::function<std::string(void)>& gen_file_name,
                   const std::string& mutex_name,
                   const std::string& iff_newfile,
                   const std::string& body );
+
+// Write-behind file writing.
+//
+// Writers are queued and run in submission order on a background thread so that callers can return before the data
+// reach the disk. Writers should own an immutable snapshot of everything they need, and signal failure by returning
+// false or throwing. 'bytes' is an estimate of the memory held by the writer; submission blocks while the pending
+// writers hold more than a fixed budget, which bounds the memory held by the queue.
+//
+// The file is created (if it does not already exist) before the writer is queued. This reserves the filename for
+// routines that probe for unused filenames and surfaces unwritable paths immediately.
+void Write_Behind( const std::filesystem::path &filename,
+                   size_t bytes,
+                   std::function<bool(void)> writer );
+
+// Blocks until all queued writers have completed. Throws if any writer failed since the last flush.
+//
+// Note: this should be called at the end of a script, before any step that reads exported files, and before forking.
+void Flush_Write_Behind();
@@ -7,19 +7,21 @@
 #include <map>
 #include <vector>
 #include <list>
-#include <fstream>
+#include <algorithm>
+#include <array>
 #include <cctype>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <exception>
+#include <functional>
 #include <numeric>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <filesystem>
 #include <cstdlib>            //Needed for exit() calls.
-#include <cstdint>
 
-#include "YgorIO.h"
 #include "YgorTime.h"
 #include "YgorImages.h"
 #include "YgorImagesIO.h"
@@ -31,99 +33,138 @@
 
 #include "Metadata.h"
 #include "Structs.h"
+#include "Thread_Pool.h"
+#include "Raw_Volume_IO.h"    //Needed for mapped_file.
 //#include "Imebra_Shim.h"      //Needed for Collate_Image_Arrays().
 
 
-planar_image<float,double> read_xim_file( std::istream &is ){
-    planar_image<float,double> img;
-    constexpr bool debug = false;
+// Bounds-checked, little-endian reader for an in-memory XIM file.
+class xim_reader {
+    private:
+        const unsigned char *d;
+        size_t size;
+        size_t pos = 0;
 
-    const auto extract_uint8 = [](std::istream &is){
-        uint8_t o;
-        if(!ygor::io::read_binary<decltype(o), YgorEndianness::Little>(is, o)){
-            throw std::invalid_argument("Unable to read uint8");
-        }
-        return o;
-    };
-    const auto extract_int8 = [](std::istream &is){
-        int8_t o;
-        if(!ygor::io::read_binary<decltype(o), YgorEndianness::Little>(is, o)){
-            throw std::invalid_argument("Unable to read int8");
-        }
-        return o;
-    };
-    const auto extract_int16 = [](std::istream &is){
-        int16_t o;
-        if(!ygor::io::read_binary<decltype(o), YgorEndianness::Little>(is, o)){
-            throw std::invalid_argument("Unable to read int16");
-        }
-        return o;
-    };
-    const auto extract_int32 = [](std::istream &is){
-        int32_t o;
-        if(!ygor::io::read_binary<decltype(o), YgorEndianness::Little>(is, o)){
-            throw std::invalid_argument("Unable to read int32");
+    public:
+        xim_reader(const unsigned char *data, size_t n) : d(data), size(n) {}
+
+        size_t position() const {
+            return this->pos;
         }
-        return o;
-    };
-    const auto extract_double = [](std::istream &is){
-        double_t o;
-        if(!ygor::io::read_binary<decltype(o), YgorEndianness::Little>(is, o)){
-            throw std::invalid_argument("Unable to read double");
+
+        size_t remaining() const {
+            return this->size - this->pos;
         }
-        return o;
-    };
-    /*
-    const auto extract_uint8_vec = [](std::istream &is, int64_t n){
-        std::vector<uint8_t> out;
-        for(int64_t i = 0; i < n; ++i){
-            out.emplace_back();
-            if(!ygor::io::read_binary<decltype(out.back()), YgorEndianness::Little>(is, out.back())){
-                throw std::invalid_argument("Unable to read uint8");
+
+        const unsigned char* skip(size_t n, const char *desc){
+            if(this->remaining() < n){
+                throw std::invalid_argument("Unable to read "_s + desc);
             }
+            const auto *out = this->d + this->pos;
+            this->pos += n;
+            return out;
         }
-        return out;
-    };
-    */
-    const auto extract_int32_vec = [](std::istream &is, int64_t n){
-        std::vector<int32_t> out;
-        for(int64_t i = 0; i < n; ++i){
-            out.emplace_back();
-            if(!ygor::io::read_binary<decltype(out.back()), YgorEndianness::Little>(is, out.back())){
-                throw std::invalid_argument("Unable to read int32");
-            }
+
+        template <class T>
+        T read(const char *desc){
+            const auto *p = this->skip(sizeof(T), desc);
+            std::array<unsigned char, sizeof(T)> b;
+            std::copy(p, p + sizeof(T), std::begin(b));
+            if(!host_is_little_endian()) std::reverse(std::begin(b), std::end(b));
+            T o;
+            std::memcpy(&o, b.data(), sizeof(T));
+            return o;
         }
-        return out;
-    };
-    const auto extract_string = [](std::istream &is, int64_t n){
-        std::string out;
-        for(int64_t i = 0; i < n; ++i){
-            char c = '\0';
-            if(!ygor::io::read_binary<decltype(c), YgorEndianness::Little>(is, c)){
-                throw std::invalid_argument("Unable to read char");
+
+        std::string read_string(int64_t n){
+            if(n < 0){
+                throw std::invalid_argument("Unable to read string with negative length");
             }
-            out.push_back(c);
+            const auto *p = this->skip(static_cast<size_t>(n), "string");
+            std::string out(reinterpret_cast<const char *>(p), static_cast<size_t>(n));
+            out.erase(std::remove_if(std::begin(out),
+                                     std::end(out),
+                                     [](unsigned char c){ return !std::isprint(c); } ),
+                      std::end(out) );
+            return out;
         }
-        out.erase(std::remove_if(std::begin(out),
-                                 std::end(out),
-                                 [](unsigned char c){ return !std::isprint(c); } ),
-                  std::end(out) );
-        return out;
+};
+
+// Pixel differences are stored using 1, 2, or 4 bytes. The width of each difference is encoded with 2 bits, four per
+// LUT byte. These tables are indexed by the 2-bit code.
+constexpr std::array<uint32_t, 4> xim_diff_widths = {{ 1, 2, 4, 4 }};
+constexpr std::array<uint32_t, 4> xim_diff_shifts = {{ 24, 16, 0, 0 }}; // Used to sign-extend narrow differences.
+
+// Total number of compressed bytes used by the four pixels described by each LUT byte.
+static const std::array<uint32_t, 256> xim_lut_byte_widths = [](){
+    std::array<uint32_t, 256> out;
+    for(uint32_t b = 0; b < 256; ++b){
+        out[b] = xim_diff_widths[(b >> 0) & 0b11]
+               + xim_diff_widths[(b >> 2) & 0b11]
+               + xim_diff_widths[(b >> 4) & 0b11]
+               + xim_diff_widths[(b >> 6) & 0b11];
+    }
+    return out;
+}();
+
+// Decompresses the pixel data. Each pixel is predicted from its left, upper, and upper-left neighbours, and the stored
+// differences correct the prediction. The first row and the first pixel of the second row are stored uncompressed.
+//
+// The caller must ensure at least 3 readable bytes follow the compressed pixel data, since differences are always
+// loaded using 4 bytes and then truncated.
+static void xim_decompress( const unsigned char *lut,
+                            const unsigned char *pxls,
+                            int64_t image_width,
+                            std::vector<int32_t> &pixel_data ){
+    const auto load_le_u32 = [](const unsigned char *p) -> uint32_t {
+        return  static_cast<uint32_t>(p[0])
+             | (static_cast<uint32_t>(p[1]) <<  8)
+             | (static_cast<uint32_t>(p[2]) << 16)
+             | (static_cast<uint32_t>(p[3]) << 24);
     };
 
-    const auto magic_number = extract_string(is,8);
+    const auto W = static_cast<size_t>(image_width);
+    const size_t N = pixel_data.size();
+    uint32_t *out = reinterpret_cast<uint32_t *>(pixel_data.data()); // Unsigned to make overflow well-defined.
+    for(size_t k = 0; k <= W; ++k){
+        out[k] = load_le_u32(pxls);
+        pxls += 4;
+    }
+
+    size_t k = W + 1;
+    for(size_t lut_num = 0; k < N; ++lut_num){
+        const uint32_t code = (lut[lut_num / 4] >> (2 * (lut_num % 4))) & 0b11;
+        const uint32_t shift = xim_diff_shifts[code];
+        const auto diff = static_cast<uint32_t>( static_cast<int32_t>(load_le_u32(pxls) << shift) >> shift );
+        pxls += xim_diff_widths[code];
+
+        out[k] = diff + out[k - 1] + out[k - W] - out[k - W - 1];
+        ++k;
+    }
+    return;
+}
+
+planar_image<float,double> read_xim_file( const unsigned char *data, size_t size ){
+    planar_image<float,double> img;
+    constexpr bool debug = false;
+
+    xim_reader r(data, size);
+    const auto extract_int32 = [&](){ return r.read<int32_t>("int32"); };
+    const auto extract_double = [&](){ return r.read<double>("double"); };
+
+    const auto magic_number = r.read_string(8);
     if(magic_number != "VMS.XI"){
         throw std::invalid_argument("Unrecognized file magic number: '"_s + magic_number + "'");
     }
     if(debug) YLOGINFO("Format ID: '" << magic_number << "'");
 
 
-    const auto format_version = extract_int32(is);
-    const auto image_width = extract_int32(is);
-    const auto image_height = extract_int32(is);
-    const auto bits_per_pixel = extract_int32(is);
-    const auto bytes_per_pixel = extract_int32(is);
-    const bool decompression_reqd = (extract_int32(is) != 0);
+    const auto format_version = extract_int32();
+    const auto image_width = extract_int32();
+    const auto image_height = extract_int32();
+    const auto bits_per_pixel = extract_int32();
+    const auto bytes_per_pixel = extract_int32();
+    const bool decompression_reqd = (extract_int32() != 0);
 
     if(debug) YLOGINFO("format_version = " << format_version);
     if(debug) YLOGINFO("image_width = " << image_width);
@@ -142,7 +183,7 @@ planar_image<float,double> read_xim_file( std::istream &is ){
     if(!isininc(1,image_width,10'000)){
         throw std::runtime_error("Unexpected image width");
     }
-    if(!isininc(1,image_height,10'000)){
+    if(!isininc(2,image_height,10'000)){
         throw std::runtime_error("Unexpected image height");
     }
     if( (bytes_per_pixel != 2)
@@ -155,74 +196,48 @@ planar_image<float,double> read_xim_file( std::istream &is ){
     if(!decompression_reqd){
         throw std::invalid_argument("Uncompressed data encountered. This routine expects compressed data");
     }
+    const int64_t N_pixels = static_cast<int64_t>(image_width) * static_cast<int64_t>(image_height);
 
     // Lookup table.
-    const auto lut_byte_length = extract_int32(is); // in bytes.
-    if((4 * lut_byte_length) != (image_width * image_height - image_width)){
+    //
+    // The number of bytes to read for each pixel are encoded in 2-bits, four per byte. Note that the table describes
+    // one more pixel than is stored.
+    const auto lut_byte_length = extract_int32(); // in bytes.
+    if((4 * static_cast<int64_t>(lut_byte_length)) != (N_pixels - image_width)){
         throw std::runtime_error("Unexpected LUT length ("_s + std::to_string(lut_byte_length) + ")");
     }
-
-    // The number of bytes to read for each pixel are encoded in 2-bits. We have to read as 8-bit and unpack them.
-    std::vector<uint8_t> lut_vec;
-    lut_vec.reserve(4 * lut_byte_length);
-    for(int64_t i = 0; i < lut_byte_length; ++i){
-        const auto raw = extract_uint8(is);
-        lut_vec.emplace_back( (raw & 0b00000011) >> 0 );
-        lut_vec.emplace_back( (raw & 0b00001100) >> 2 );
-        lut_vec.emplace_back( (raw & 0b00110000) >> 4 );
-        lut_vec.emplace_back( (raw & 0b11000000) >> 6 );
-    }
-    const auto pxl_buf_size = extract_int32(is); // number of bytes holding compressed pixel data.
-    int64_t num_bytes_read = 4 * (image_width + 1L);
-
-    if(debug) YLOGINFO("LUT vector length = " << lut_vec.size());
-
-    // Pixel data.
-    // read the first row.
-    auto pixel_data = extract_int32_vec(is, image_width + 1L);
-    pixel_data.reserve(image_width * image_height);
-
-    int64_t lut_num = 0;
-    for(int64_t pix_num = image_width + 2L; pix_num <= (image_width * image_height); ++pix_num){
-        const auto lut_curr = lut_vec.at(lut_num);
-        int32_t diff = 0;
-        if(lut_curr == 0){
-            diff = static_cast<int32_t>(extract_int8(is));
-            num_bytes_read += 1;
-        }else if(lut_curr == 1){
-            diff = static_cast<int32_t>(extract_int16(is));
-            num_bytes_read += 2;
-        }else{
-            diff = extract_int32(is);
-            num_bytes_read += 4;
+    const auto *lut = r.skip(static_cast<size_t>(lut_byte_length), "LUT");
+    const int64_t N_diffs = N_pixels - image_width - 1L;
+
+    // Determine the size of the compressed pixel data from the table before decompressing, so that decompression
+    // does not need to check bounds for every pixel.
+    int64_t num_bytes_reqd = 4 * (image_width + 1L);
+    {
+        const int64_t N_full = N_diffs / 4;
+        for(int64_t i = 0; i < N_full; ++i){
+            num_bytes_reqd += xim_lut_byte_widths[lut[i]];
         }
-        if(pxl_buf_size < num_bytes_read){
-            throw std::logic_error("Ran out of pixel data to read");
+        for(int64_t j = N_full * 4; j < N_diffs; ++j){
+            num_bytes_reqd += xim_diff_widths[(lut[j / 4] >> (2 * (j % 4))) & 0b11];
         }
-        pixel_data.emplace_back( diff + pixel_data.at(pix_num - 2L)
-                                      + pixel_data.at(pix_num - image_width - 1L)
-                                      - pixel_data.at(pix_num - image_width - 2L) );
-        lut_num += 1;
     }
 
-    const auto expanded_pxl_buf_size = extract_int32(is); // number of bytes holding uncompressed pixel data.
-
+    const auto pxl_buf_size = extract_int32(); // number of bytes holding compressed pixel data.
     if(debug) YLOGINFO("pxl_buf_size = " << pxl_buf_size);
-    if(debug) YLOGINFO("num_bytes_read = " << num_bytes_read);
-    if( pxl_buf_size != num_bytes_read ){
+    if(debug) YLOGINFO("num_bytes_reqd = " << num_bytes_reqd);
+    if(pxl_buf_size < num_bytes_reqd){
+        throw std::logic_error("Ran out of pixel data to read");
+    }
+    if( pxl_buf_size != num_bytes_reqd ){
         throw std::runtime_error("Number of pixels read does not match expected number of bytes present");
     }
+    const auto *pxls = r.skip(static_cast<size_t>(pxl_buf_size), "pixel data");
 
-    // Note: these don't seem to match at the end. Not off by one either, since the image garbles otherwise.
-    // Not sure if it's intentional?
-    if(debug) YLOGINFO("lut_num = " << lut_num);
-    if(debug) YLOGINFO("lut_vec.size() = " << lut_vec.size());
+    // The uncompressed size immediately follows the pixel data, so the decompressor can safely over-read.
+    const auto expanded_pxl_buf_size = extract_int32(); // number of bytes holding uncompressed pixel data.
 
-    if(debug) YLOGINFO("pixel_data.size() = " << pixel_data.size());
-    if(debug) YLOGINFO("image_width * image_height = " << image_width * image_height);
-    if( static_cast<int64_t>(pixel_data.size()) != static_cast<int64_t>(image_width * image_height) ){
-        throw std::runtime_error("Expanded pixel data does not match expected image dimensions");
-    }
+    std::vector<int32_t> pixel_data(static_cast<size_t>(N_pixels));
+    xim_decompress(lut, pxls, image_width, pixel_data);
 
     if(debug) YLOGINFO("expanded_pxl_buf_size = " << expanded_pxl_buf_size);
     if(debug) YLOGINFO("pixel_data.size() * bytes_per_pixel = " << pixel_data.size() * bytes_per_pixel);
@@ -232,54 +247,52 @@ planar_image<float,double> read_xim_file( std::istream &is ){
 
     if(debug) YLOGINFO("Done reading pixel data");
 
-    // Embedded histogram.
-    const auto num_hist_bins = extract_int32(is);
+    // Embedded histogram. It is not used, so it is skipped.
+    const auto num_hist_bins = extract_int32();
     if(debug) YLOGINFO("num_hist_bins = " << num_hist_bins);
-
-    std::vector<int32_t> hist_data;
     if(0 < num_hist_bins){
-        hist_data = extract_int32_vec(is, num_hist_bins);
+        r.skip(4 * static_cast<size_t>(num_hist_bins), "histogram");
     }
     if(debug) YLOGINFO("Done reading histogram data");
 
     // Metadata.
-    const auto num_metadata = extract_int32(is);
+    const auto num_metadata = extract_int32();
     for(auto i = 0; i < num_metadata; ++i){
-        const auto key_length = extract_int32(is);
-        const auto key = extract_string(is, key_length);
-        const auto val_type = extract_int32(is);
+        const auto key_length = extract_int32();
+        const auto key = r.read_string(key_length);
+        const auto val_type = extract_int32();
         std::string val;
 
         // Scalars.
         if(val_type == 0){
-            val = std::to_string( extract_int32(is) );
+            val = std::to_string( extract_int32() );
 
         }else if(val_type == 1){
-            val = std::to_string( extract_double(is) );
+            val = std::to_string( extract_double() );
 
         // Arrays.
         }else if(val_type == 2){
-            const auto val_length = extract_int32(is); // in bytes.
-            val = extract_string(is, val_length);
+            const auto val_length = extract_int32(); // in bytes.
+            val = r.read_string(val_length);
 
         }else if(val_type == 4){
-            const auto val_length = extract_int32(is); // in bytes.
+            const auto val_length = extract_int32(); // in bytes.
             if( (val_length % 8) != 0){
                 throw std::runtime_error("unexpected byte length for 'double' encoded metadata value array"); 
             }
             for(int64_t j = 0; (j * 8) < val_length; ++j){
                 if(!val.empty()) val += ", ";
-                val += std::to_string( extract_double(is) );
+                val += std::to_string( extract_double() );
             }
 
         }else if(val_type == 5){
-            const auto val_length = extract_int32(is); // in bytes.
+            const auto val_length = extract_int32(); // in bytes.
             if( (val_length % 4) != 0){
                 throw std::runtime_error("unexpected byte length for 'int32' encoded metadata value array"); 
             }
             for(int64_t j = 0; (j * 4) < val_length; ++j){
                 if(!val.empty()) val += ", ";
-                val += std::to_string( extract_int32(is) );
+                val += std::to_string( extract_int32() );
             }
             
         }else{
@@ -352,11 +365,8 @@ planar_image<float,double> read_xim_file( std::istream &is ){
     img.init_spatial(pxl_dx, pxl_dy, 1.0, anchor, offset);
     img.init_buffer(image_height, image_width, 1);
 
-    for(int64_t row = 0; row < image_height; ++row){
-        for(int64_t col = 0; col < image_width; ++col){
-            img.reference(row, col, 0) = static_cast<float>( pixel_data.at(row * image_width + col ) );
-        }
-    }
+    std::transform( std::begin(pixel_data), std::end(pixel_data), std::begin(img.data),
+                    [](int32_t x){ return static_cast<float>(x); } );
 
     // // Write the image to disk as a FITS file for easier viewing.
     // if(!WriteToFITS<float,double>(img, "/tmp/test.fits")){
@@ -379,46 +389,53 @@ bool Load_From_XIM_Files( Drover &DICOM_data,
     //
     if(Filenames.empty()) return true;
 
-    DICOM_data.image_data.emplace_back( std::make_shared<Image_Array>() );
+    // Decode all files concurrently. Results are collected afterward so the image order matches the file order.
+    const std::vector<std::filesystem::path> paths(std::begin(Filenames), std::end(Filenames));
+    std::vector<std::optional<planar_image<float,double>>> imgs(paths.size());
+    std::vector<std::string> errors(paths.size());
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(size_t i = 0; i < paths.size(); ++i){
+            wq.submit_task([&,i]() -> void {
+                try{
+                    const mapped_file mf(paths[i]);
+                    auto animg = read_xim_file(mf.data(), mf.size());
+
+                    // Ensure a minimal amount of metadata is present for image purposes.
+                    auto l_meta = coalesce_metadata_for_basic_image(animg.metadata);
+                    l_meta.merge(animg.metadata);
+                    animg.metadata = l_meta;
+                    animg.metadata["Filename"] = paths[i].string();
+                    imgs[i] = std::move(animg);
+                }catch(const std::exception &e){
+                    errors[i] = e.what();
+                }
+            });
+        }
+    } // Wait for all tasks to complete.
 
-    size_t i = 0;
+    auto IA = std::make_shared<Image_Array>();
     const size_t N = Filenames.size();
-
+    size_t i = 0;
     auto bfit = Filenames.begin();
     while(bfit != Filenames.end()){
         YLOGINFO("Parsing file #" << i+1 << "/" << N << " = " << 100*(i+1)/N << "%");
-        ++i;
-        const auto Filename = *bfit;
-
-        try{
-            std::ifstream is(Filename.string(), std::ios::in | std::ios::binary);
-            auto animg = read_xim_file(is);
-
-            // Ensure a minimal amount of metadata is present for image purposes.
-            auto l_meta = coalesce_metadata_for_basic_image(animg.metadata);
-            l_meta.merge(animg.metadata);
-            animg.metadata = l_meta;
-            animg.metadata["Filename"] = Filename.string();
-
+        if(imgs[i]){
             YLOGINFO("Loaded XIM file with dimensions " 
-                     << animg.rows << " x " << animg.columns);
-
-            DICOM_data.image_data.back()->imagecoll.images.emplace_back( animg );
+                     << imgs[i]->rows << " x " << imgs[i]->columns);
+            IA->imagecoll.images.emplace_back( std::move(imgs[i].value()) );
             bfit = Filenames.erase( bfit ); 
-            continue;
-        }catch(const std::exception &e){
-            YLOGINFO("Unable to load as XIM file: '" << e.what() << "'");
-        };
-
-        //Skip the file. It might be destined for some other loader.
-        ++bfit;
+        }else{
+            //Skip the file. It might be destined for some other loader.
+            YLOGINFO("Unable to load as XIM file: '" << errors[i] << "'");
+            ++bfit;
+        }
+        ++i;
     }
-            
+
     //If nothing was loaded, do not post-process.
-    const size_t N2 = Filenames.size();
-    if(N == N2){
-        DICOM_data.image_data.pop_back();
-        return true;
+    if(!IA->imagecoll.images.empty()){
+        DICOM_data.image_data.emplace_back( IA );
     }
 
     return true;
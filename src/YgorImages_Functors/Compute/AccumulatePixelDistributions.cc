@@ -1,15 +1,25 @@
 //AccumulatePixelDistributions.cc.
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <exception>
 #include <any>
 #include <optional>
 #include <functional>
+#include <limits>
 #include <list>
 #include <map>
+#include <mutex>
 #include <ostream>
 #include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "../../Thread_Pool.h"
 #include "../Grouping/Misc_Functors.h"
+#include "../Processing/Partitioned_Image_Voxel_Visitor_Mutator.h"
 #include "AccumulatePixelDistributions.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
@@ -18,7 +28,228 @@
 #include "YgorStats.h"       //Needed for Stats:: namespace.
 
 
+dose_histogram::dose_histogram(double l_bin_width) : bin_width(l_bin_width) {
+    if(std::isnan(this->bin_width)){
+        throw std::invalid_argument("Histogram bin width is not valid");
+    }
+}
+
+bool dose_histogram::is_exact() const {
+    return !(0.0 < this->bin_width);
+}
+
+void dose_histogram::add(double value, double weight){
+    // Non-finite values cannot be binned and are ignored.
+    if(!std::isfinite(value) || !std::isfinite(weight) || (weight <= 0.0)) return;
+
+    if(this->samples == 0){
+        this->min_value = value;
+        this->max_value = value;
+    }else{
+        this->min_value = std::min(this->min_value, value);
+        this->max_value = std::max(this->max_value, value);
+    }
+    ++this->samples;
+    this->total_weight += weight;
+    this->total_sum    += weight * value;
+    this->total_sum_sq += weight * value * value;
+
+    if(this->is_exact()){
+        this->exact.emplace_back(value, weight);
+        this->exact_sorted = false;
+        return;
+    }
+
+    // Extreme values share the outermost bins rather than overflowing the key. Bins track their own value range, so
+    // quantiles remain bounded by the values actually present.
+    const auto key_limit = static_cast<double>(std::numeric_limits<int64_t>::max() / 2);
+    const auto key = static_cast<int64_t>(std::clamp(std::floor(value / this->bin_width), -key_limit, key_limit));
+    auto &b = this->bins[key];
+    if(b.weight <= 0.0){
+        b.min = value;
+        b.max = value;
+    }else{
+        b.min = std::min(b.min, value);
+        b.max = std::max(b.max, value);
+    }
+    b.weight += weight;
+    b.sum    += weight * value;
+}
+
+void dose_histogram::merge(const dose_histogram &other){
+    if(other.samples == 0) return;
+    if( (this->is_exact() != other.is_exact())
+    ||  (!this->is_exact() && (this->bin_width != other.bin_width)) ){
+        throw std::invalid_argument("Unable to merge histograms with differing bin widths");
+    }
+
+    if(this->samples == 0){
+        this->min_value = other.min_value;
+        this->max_value = other.max_value;
+    }else{
+        this->min_value = std::min(this->min_value, other.min_value);
+        this->max_value = std::max(this->max_value, other.max_value);
+    }
+    this->samples      += other.samples;
+    this->total_weight += other.total_weight;
+    this->total_sum    += other.total_sum;
+    this->total_sum_sq += other.total_sum_sq;
+
+    if(this->is_exact()){
+        this->exact.insert(std::end(this->exact), std::begin(other.exact), std::end(other.exact));
+        this->exact_sorted = false;
+        return;
+    }
+
+    for(const auto &kb : other.bins){
+        const auto &ob = kb.second;
+        if(ob.weight <= 0.0) continue;
+        auto &b = this->bins[kb.first];
+        if(b.weight <= 0.0){
+            b.min = ob.min;
+            b.max = ob.max;
+        }else{
+            b.min = std::min(b.min, ob.min);
+            b.max = std::max(b.max, ob.max);
+        }
+        b.weight += ob.weight;
+        b.sum    += ob.sum;
+    }
+}
+
+void dose_histogram::finalize(){
+    if(!this->exact_sorted){
+        std::sort(std::begin(this->exact), std::end(this->exact));
+        this->exact_sorted = true;
+    }
+}
+
+int64_t dose_histogram::Voxel_Count() const {
+    return this->samples;
+}
+
+double dose_histogram::Total_Weight() const {
+    return this->total_weight;
+}
+
+double dose_histogram::Min() const {
+    return (this->samples == 0) ? std::numeric_limits<double>::quiet_NaN() : this->min_value;
+}
+
+double dose_histogram::Max() const {
+    return (this->samples == 0) ? std::numeric_limits<double>::quiet_NaN() : this->max_value;
+}
+
+double dose_histogram::Mean() const {
+    return (this->total_weight <= 0.0) ? std::numeric_limits<double>::quiet_NaN()
+                                       : this->total_sum / this->total_weight;
+}
 
+double dose_histogram::Unbiased_Var_Est() const {
+    if(this->total_weight <= 1.0) return std::numeric_limits<double>::quiet_NaN();
+
+    // Use a two-pass computation when the values are available since it is more numerically stable.
+    const auto mean = this->Mean();
+    if(this->is_exact()){
+        double ss = 0.0;
+        for(const auto &p : this->exact) ss += p.second * (p.first - mean) * (p.first - mean);
+        return ss / (this->total_weight - 1.0);
+    }
+    const auto ss = this->total_sum_sq - this->total_weight * mean * mean;
+    return std::max(0.0, ss) / (this->total_weight - 1.0);
+}
+
+double dose_histogram::Percentile(double fraction) const {
+    if( (this->samples == 0) || !std::isfinite(fraction) ) return std::numeric_limits<double>::quiet_NaN();
+    fraction = std::clamp(fraction, 0.0, 1.0);
+
+    if(this->is_exact()){
+        if(!this->exact_sorted){
+            throw std::logic_error("Histogram must be finalized before querying");
+        }
+        // Linear interpolation between adjacent values. With unit weights, this is position fraction*(N-1).
+        const auto t = fraction * (this->total_weight - this->exact.back().second);
+        double cumulative = 0.0;
+        for(size_t i = 0; i < this->exact.size(); ++i){
+            const auto &p = this->exact[i];
+            if( (t < (cumulative + p.second)) || ((i + 1) == this->exact.size()) ){
+                if((i + 1) == this->exact.size()) return p.first;
+                const auto f = std::clamp((t - cumulative) / p.second, 0.0, 1.0);
+                return p.first + f * (this->exact[i + 1].first - p.first);
+            }
+            cumulative += p.second;
+        }
+        return this->max_value;
+    }
+
+    // Interpolate within the range of values actually present in the containing bin.
+    const auto t = fraction * this->total_weight;
+    double cumulative = 0.0;
+    for(const auto &kb : this->bins){
+        const auto &b = kb.second;
+        if(b.weight <= 0.0) continue;
+        if(t <= (cumulative + b.weight)){
+            const auto f = std::clamp((t - cumulative) / b.weight, 0.0, 1.0);
+            return b.min + f * (b.max - b.min);
+        }
+        cumulative += b.weight;
+    }
+    return this->max_value;
+}
+
+double dose_histogram::Median() const {
+    return this->Percentile(0.5);
+}
+
+double dose_histogram::Fraction_Above(double threshold) const {
+    if(this->total_weight <= 0.0) return std::numeric_limits<double>::quiet_NaN();
+
+    double above = 0.0;
+    if(this->is_exact()){
+        for(const auto &p : this->exact){
+            if(threshold < p.first) above += p.second;
+        }
+    }else{
+        for(const auto &kb : this->bins){
+            const auto &b = kb.second;
+            if(b.weight <= 0.0) continue;
+            if(threshold < b.min){
+                above += b.weight;
+            }else if(threshold < b.max){
+                // Assume values are uniformly distributed within the bin.
+                above += b.weight * (b.max - threshold) / (b.max - b.min);
+            }
+        }
+    }
+    return above / this->total_weight;
+}
+
+double dose_histogram::Mean_Of(const std::function<double(double)> &f) const {
+    if(this->total_weight <= 0.0) return std::numeric_limits<double>::quiet_NaN();
+
+    double accumulated = 0.0;
+    if(this->is_exact()){
+        for(const auto &p : this->exact) accumulated += p.second * f(p.first);
+    }else{
+        for(const auto &kb : this->bins){
+            const auto &b = kb.second;
+            if(b.weight <= 0.0) continue;
+            accumulated += b.weight * f(b.sum / b.weight);
+        }
+    }
+    return accumulated / this->total_weight;
+}
+
+double dose_histogram::gEUD(double alpha) const {
+    const auto mean_scaled = this->Mean_Of([alpha](double D) -> double {
+        return std::pow(D, alpha);
+    });
+    return std::pow(mean_scaled, 1.0 / alpha);
+}
+
+double dose_histogram::Max_Bin_Error() const {
+    return this->is_exact() ? 0.0 : this->bin_width;
+}
 
 
 bool AccumulatePixelDistributions(planar_image_collection<float,double> &imagecoll,
@@ -37,6 +268,10 @@ bool AccumulatePixelDistributions(planar_image_collection<float,double> &imageco
     // the same number of rows and columns. If something more exotic or robust is needed, images muct be combined prior 
     // to calling this routine. In any case, it is best to combine images prior to this routine.
     //
+    // Rather than retaining every voxel, histograms can be accumulated instead (or additionally). Each group of
+    // spatially-overlapping images is processed in parallel with private distributions, which are merged afterward in
+    // a deterministic order.
+    //
     // This routine does not modify the images it uses to compute ROIs, so there is no need to create copies.
     //
 
@@ -48,6 +283,13 @@ bool AccumulatePixelDistributions(planar_image_collection<float,double> &imageco
         YLOGWARN("Unable to cast user_data to appropriate format. Cannot continue with computation");
         return false;
     }
+    const bool retain_voxels = user_data_s->retain_voxels;
+    const bool use_histograms = !std::isnan(user_data_s->histogram_bin_width);
+    const auto bin_width = user_data_s->histogram_bin_width;
+    const bool fractional_occupancy = user_data_s->fractional_occupancy;
+    if(fractional_occupancy && (retain_voxels || !use_histograms)){
+        throw std::invalid_argument("Fractional occupancy requires histograms and cannot retain individual voxels");
+    }
 
     //Figure out if there are any contours for which are within the spatial extent of the image. 
     // There are many ways to do this! Since we are merely highlighting the contours, we scan 
@@ -60,12 +302,10 @@ bool AccumulatePixelDistributions(planar_image_collection<float,double> &imageco
         return false;
     }
 
-    //Generate a comprehensive list of iterators to all as-of-yet-unused images. This list will be
-    // pruned after images have been successfully operated on.
+    //Partition the images into groups of spatially-overlapping images.
+    std::vector<std::list<planar_image_collection<float,double>::images_list_it_t>> groups;
     auto all_images = imagecoll.get_all_images();
     while(!all_images.empty()){
-        YLOGINFO("Images still to be processed: " << all_images.size());
-
         // Find the images which spatially overlap with this image.
         auto curr_img_it = all_images.front();
         auto selected_imgs = GroupSpatiallyOverlappingImages(curr_img_it, std::ref(imagecoll));
@@ -98,108 +338,161 @@ bool AccumulatePixelDistributions(planar_image_collection<float,double> &imageco
         for(auto &an_img_it : selected_imgs){
              all_images.remove(an_img_it); //std::list::remove() erases all elements equal to input value.
         }
+        groups.emplace_back(selected_imgs);
+    }
 
-        planar_image<float,double> &img = std::ref(*selected_imgs.front());
-        //Loop over the rois, rows, columns, channels, and finally any selected images (if applicable).
-        const auto row_unit   = img.row_unit;
-        const auto col_unit   = img.col_unit;
-        const auto ortho_unit = row_unit.Cross( col_unit ).unit();
-    
-        //Loop over the ccsl, rois, rows, columns, channels, and finally any selected images (if applicable).
-        //for(const auto &roi : rois){
-        for(auto &ccs : ccsl){
-            for(auto & contour : ccs.get().contours){
-                if(contour.points.empty()) continue;
-                if(! img.encompasses_contour_of_points(contour)) continue;
-    
-                const auto ROIName =  contour.GetMetadataValueAs<std::string>("ROIName");
-                if(!ROIName){
-                    YLOGWARN("Missing necessary tags for reporting analysis results. Cannot continue");
-                    return false;
-                }
-                
-        /*
-                //Construct a bounding box to reduce computational demand of checking every voxel.
-                auto BBox = roi_it->Bounding_Box_Along(row_unit, 1.0);
-                auto BBoxBestFitPlane = BBox.Least_Squares_Best_Fit_Plane(vec3<double>(0.0,0.0,1.0));
-                auto BBoxProjectedContour = BBox.Project_Onto_Plane_Orthogonally(BBoxBestFitPlane);
-                const bool BBoxAlreadyProjected = true;
-        */
-        
-                //Prepare a contour for fast is-point-within-the-polygon checking.
-                auto BestFitPlane = contour.Least_Squares_Best_Fit_Plane(ortho_unit);
-                auto ProjectedContour = contour.Project_Onto_Plane_Orthogonally(BestFitPlane);
-                const bool AlreadyProjected = true;
-        
-                for(auto row = 0; row < img.rows; ++row){
-                    for(auto col = 0; col < img.columns; ++col){
-                        //Figure out the spatial location of the present voxel.
-                        const auto point = img.position(row,col);
-        
-        /*
-                        //Check if within the bounding box. It will generally be cheaper than the full contour (4 points vs. ? points).
-                        auto BBoxProjectedPoint = BBoxBestFitPlane.Project_Onto_Plane_Orthogonally(point);
-                        if(!BBoxProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BBoxBestFitPlane,
-                                                                                            BBoxProjectedPoint,
-                                                                                            BBoxAlreadyProjected)) continue;
-        */
-        
-                        //Perform a more detailed check to see if we are in the ROI.
-                        auto ProjectedPoint = BestFitPlane.Project_Onto_Plane_Orthogonally(point);
-                        if(ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
-                                                                                       ProjectedPoint,
-                                                                                       AlreadyProjected)){
-                            for(auto chan = 0; chan < img.channels; ++chan){
-                                //Cycle over the grouped images, accumulating the voxel intensity.
-                                double combined_voxel_intensity = 0.0;
-                                for(auto & img_it : selected_imgs){
-
-                                    //Collect the datum of voxels and nearby voxels for an average.
-                                    std::list<double> in_pixs;
-                                    const auto boxr = 0;
-                                    const auto min_datum = 1;
-                                    for(auto lrow = (row-boxr); lrow <= (row+boxr); ++lrow){
-                                        for(auto lcol = (col-boxr); lcol <= (col+boxr); ++lcol){
-                                            //Check if the coordinates are legal and in the ROI.
-                                            if( !isininc(0,lrow,img_it->rows-1) || !isininc(0,lcol,img_it->columns-1) ) continue;
-        
-                                            //const auto boxpoint = first_img_it->spatial_location(row,col);  //For standard contours(?).
-                                            //const auto neighbourpoint = vec3<double>(lrow*1.0, lcol*1.0, SliceLocation*1.0);  //For the pixel integer contours.
-                                            const auto neighbourpoint = img.position(lrow,lcol);
-                                            auto ProjectedNeighbourPoint = BestFitPlane.Project_Onto_Plane_Orthogonally(neighbourpoint);
-                                            if(!ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
-                                                                                                            ProjectedNeighbourPoint,
-                                                                                                            AlreadyProjected)) continue;
-                                            const auto val = static_cast<double>(img_it->value(lrow, lcol, chan));
-                                            in_pixs.push_back(val);
+    //Per-group partial distributions.
+    struct partial_distributions {
+        std::map<std::string, std::vector<double>> voxels;
+        std::map<std::string, dose_histogram> histograms;
+        bool missing_metadata = false;
+    };
+    std::vector<partial_distributions> partials(groups.size());
+
+    std::mutex saver_printer;
+    std::exception_ptr err_ptr;
+    int64_t completed = 0;
+    const auto group_count = static_cast<int64_t>(groups.size());
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(size_t g = 0; g < groups.size(); ++g){
+            wq.submit_task([&,g]() -> void {
+                try{
+                    const auto &selected_imgs = groups[g];
+                    auto &partial = partials[g];
+
+                    const planar_image<float,double> &img = *selected_imgs.front();
+                    const auto row_unit   = img.row_unit;
+                    const auto col_unit   = img.col_unit;
+                    const auto ortho_unit = row_unit.Cross( col_unit ).unit();
+
+                    //Fractional occupancy is computed per ROI so that overlapping contours of the same ROI are not
+                    // counted twice.
+                    if(fractional_occupancy){
+                        std::map<std::string, contour_collection<double>> rois;
+                        for(auto &ccs : ccsl){
+                            for(auto & contour : ccs.get().contours){
+                                if(contour.points.empty()) continue;
+                                if(! img.encompasses_contour_of_points(contour)) continue;
+
+                                const auto ROIName =  contour.GetMetadataValueAs<std::string>("ROIName");
+                                if(!ROIName){
+                                    partial.missing_metadata = true;
+                                    return;
+                                }
+                                rois[ ROIName.value() ].contours.push_back(contour);
+                            }
+                        }
+                        for(auto &roi : rois){
+                            auto &histogram = partial.histograms.emplace(roi.first, dose_histogram(bin_width)).first->second;
+                            const auto occupancy = Compute_Fractional_Voxel_Occupancy(img, { std::ref(roi.second) },
+                                                                    Mutate_Voxels_Opts::ContourOverlap::Ignore);
+                            for(int64_t row = 0; row < img.rows; ++row){
+                                for(int64_t col = 0; col < img.columns; ++col){
+                                    const auto weight = occupancy[static_cast<size_t>(row * img.columns + col)];
+                                    if(weight <= 0.0) continue;
+                                    for(int64_t chan = 0; chan < img.channels; ++chan){
+                                        double combined_voxel_intensity = 0.0;
+                                        for(const auto &img_it : selected_imgs){
+                                            combined_voxel_intensity += static_cast<double>(img_it->value(row, col, chan));
                                         }
+                                        histogram.add(combined_voxel_intensity, weight);
                                     }
-                                    if(in_pixs.size() < min_datum) continue; //If contours are too narrow so that there is too few datum for meaningful results.
-                                    const auto combined_val = Stats::Sum(in_pixs);
-                                    combined_voxel_intensity += combined_val;
                                 }
-        
-                                // --------------- Incorporate the data into the user_data struct ------------------
-                                user_data_s->accumulated_voxels[ ROIName.value() ].emplace_back(combined_voxel_intensity);
-        
-                                // ----------------------------------------------------------------------------
-        
-                            }//Loop over channels.
-        
-                        //If we're in the bounding box but not the ROI, do something.
-                        }else{
-                            //for(auto chan = 0; chan < first_img_it->channels; ++chan){
-                            //    const auto curr_val = working.value(row, col, chan);
-                            //    if(curr_val != 0) YLOGERR("There are overlapping ROI bboxes. This code currently cannot handle this. "
-                            //                              "You will need to run the functor individually on the overlapping ROIs.");
-                            //    working.reference(row, col, chan) = static_cast<float>(10);
-                            //}
-                        } // If is in ROI or ROI bbox.
-                    } //Loop over cols
-                } //Loop over rows
-            } //Loop over ROIs.
-        } //Loop over contour_collections.
+                            }
+                        }
+                    }else{
+                        //Loop over the ccsl, rois, rows, columns, channels, and finally any selected images.
+                        for(auto &ccs : ccsl){
+                            for(auto & contour : ccs.get().contours){
+                                if(contour.points.empty()) continue;
+                                if(! img.encompasses_contour_of_points(contour)) continue;
+
+                                const auto ROIName =  contour.GetMetadataValueAs<std::string>("ROIName");
+                                if(!ROIName){
+                                    partial.missing_metadata = true;
+                                    return;
+                                }
+                                std::vector<double> *voxels = nullptr;
+                                dose_histogram *histogram = nullptr;
+                                if(retain_voxels) voxels = &(partial.voxels[ ROIName.value() ]);
+                                if(use_histograms){
+                                    histogram = &(partial.histograms.emplace(ROIName.value(), dose_histogram(bin_width)).first->second);
+                                }
+
+                                //Prepare a contour for fast is-point-within-the-polygon checking.
+                                auto BestFitPlane = contour.Least_Squares_Best_Fit_Plane(ortho_unit);
+                                auto ProjectedContour = contour.Project_Onto_Plane_Orthogonally(BestFitPlane);
+                                const bool AlreadyProjected = true;
+
+                                for(auto row = 0; row < img.rows; ++row){
+                                    for(auto col = 0; col < img.columns; ++col){
+                                        //Figure out the spatial location of the present voxel.
+                                        const auto point = img.position(row,col);
+
+                                        //Perform a detailed check to see if we are in the ROI.
+                                        auto ProjectedPoint = BestFitPlane.Project_Onto_Plane_Orthogonally(point);
+                                        if(!ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
+                                                                                                        ProjectedPoint,
+                                                                                                        AlreadyProjected)) continue;
 
+                                        for(auto chan = 0; chan < img.channels; ++chan){
+                                            //Cycle over the grouped images, accumulating the voxel intensity.
+                                            double combined_voxel_intensity = 0.0;
+                                            for(const auto &img_it : selected_imgs){
+                                                combined_voxel_intensity += static_cast<double>(img_it->value(row, col, chan));
+                                            }
+
+                                            // --------------- Incorporate the data into the partial distributions ------------------
+                                            if(voxels != nullptr) voxels->emplace_back(combined_voxel_intensity);
+                                            if(histogram != nullptr) histogram->add(combined_voxel_intensity);
+                                        }//Loop over channels.
+                                    } //Loop over cols
+                                } //Loop over rows
+                            } //Loop over ROIs.
+                        } //Loop over contour_collections.
+                    }
+
+                }catch(const std::exception &){
+                    std::lock_guard<std::mutex> lock(saver_printer);
+                    if(!err_ptr) err_ptr = std::current_exception();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(saver_printer);
+                    ++completed;
+                    YLOGINFO("Completed " << completed << " of " << group_count
+                          << " --> " << static_cast<int>(1000.0*(completed)/group_count)/10.0 << "% done");
+                }
+            });
+        }
+    } // Complete tasks and terminate thread pool.
+    if(err_ptr) std::rethrow_exception(err_ptr);
+
+    //Merge the partial distributions in order so the result does not depend on task scheduling.
+    for(auto &partial : partials){
+        if(partial.missing_metadata){
+            YLOGWARN("Missing necessary tags for reporting analysis results. Cannot continue");
+            return false;
+        }
+        for(auto &v : partial.voxels){
+            auto &dest = user_data_s->accumulated_voxels[v.first];
+            dest.insert(std::end(dest), std::begin(v.second), std::end(v.second));
+            v.second.clear();
+            v.second.shrink_to_fit();
+        }
+        for(auto &h : partial.histograms){
+            auto dest_it = user_data_s->histograms.find(h.first);
+            if(dest_it == std::end(user_data_s->histograms)){
+                user_data_s->histograms.emplace(h.first, std::move(h.second));
+            }else{
+                dest_it->second.merge(h.second);
+            }
+        }
+        partial.histograms.clear();
+    }
+    for(auto &h : user_data_s->histograms){
+        h.second.finalize();
     }
 
     return true;
@@ -2,10 +2,13 @@
 #pragma once
 
 #include <any>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <list>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 
@@ -13,8 +16,87 @@ template <class T, class R> class planar_image_collection;
 template <class T> class contour_collection;
 
 
+// A volume-weighted dose (or generic voxel intensity) histogram.
+//
+// Voxels are accumulated into fixed-width bins. Each bin also tracks the weighted sum of the voxel values it holds, so
+// the mean and variance are exact regardless of the bin width, and the bin's own value range, so quantiles are
+// interpolated over the values actually present. Quantities that depend non-linearly on the voxel value (e.g., gEUD,
+// NTCP, TCP) are evaluated at each bin's mean value, so the error is bounded by the bin width.
+//
+// If the bin width is not positive, every voxel value is retained and all quantities are computed exactly.
+struct dose_histogram {
+    struct bin {
+        double weight = 0.0;
+        double sum    = 0.0; // Weighted sum of voxel values.
+        double min    = 0.0;
+        double max    = 0.0;
+    };
+
+    double bin_width = 0.0;
+
+    std::map<int64_t, bin> bins;      // Sparse, keyed by floor(value / bin_width), so outliers cost a single bin.
+    std::vector<std::pair<double, double>> exact; // (value, weight). Only used if the bin width is not positive.
+    bool exact_sorted = true;
+
+    int64_t samples     = 0;   // Number of voxels added, regardless of weight.
+    double total_weight = 0.0;
+    double total_sum    = 0.0;
+    double total_sum_sq = 0.0;
+    double min_value    = 0.0;
+    double max_value    = 0.0;
+
+    explicit dose_histogram(double bin_width = 0.0);
+
+    bool is_exact() const;
+
+    void add(double value, double weight = 1.0);
+    void merge(const dose_histogram &other);
+
+    // Sorts retained voxel values. Must be called after accumulation and before any queries in exact mode.
+    void finalize();
+
+    int64_t Voxel_Count() const;
+    double Total_Weight() const;
+    double Min() const;
+    double Max() const;
+    double Mean() const;
+    double Unbiased_Var_Est() const;
+
+    // The value below which the given weight fraction of voxels lie, with linear interpolation. Matches the convention
+    // of Stats::Percentile() in the exact mode, so 'D_{x%}' (the minimum dose covering the hottest x% of the volume) is
+    // Percentile(1.0 - x).
+    double Percentile(double fraction) const;
+    double Median() const;
+
+    // The weight fraction of voxels with values strictly above the threshold, i.e., 'V_{x}'.
+    double Fraction_Above(double threshold) const;
+
+    // The weight-averaged value of f(voxel value). Used for gEUD, NTCP, and TCP integrands.
+    double Mean_Of(const std::function<double(double)> &f) const;
+
+    // Generalized equivalent uniform dose.
+    double gEUD(double alpha) const;
+
+    // An upper bound on the error of quantiles due to binning (zero in exact mode).
+    double Max_Bin_Error() const;
+};
+
+
 struct AccumulatePixelDistributionsUserData {
+    // Whether to retain every voxel value in accumulated_voxels. Needed by routines that require the full distribution
+    // (e.g., to dump it), but memory-intensive for large ROIs.
+    bool retain_voxels = true;
+
+    // If not NaN, a histogram with this bin width is also accumulated. See dose_histogram for the meaning of a
+    // non-positive bin width.
+    double histogram_bin_width = std::numeric_limits<double>::quiet_NaN();
+
+    // If true, voxels are weighted in the histograms by the fraction of their in-plane footprint covered by the ROI
+    // rather than being classified as in or out by their centre. Requires histograms and cannot retain voxels.
+    bool fractional_occupancy = false;
+
     std::map<std::string, std::vector<double>> accumulated_voxels; // key: RawROIName.
+    std::map<std::string, dose_histogram> histograms;              // key: RawROIName.
 };
 
 bool AccumulatePixelDistributions(planar_image_collection<float,double> &,
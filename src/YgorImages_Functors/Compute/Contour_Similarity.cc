@@ -1,12 +1,22 @@
-
 #include <exception>
 #include <any>
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <limits>
+#include <cmath>
 #include <functional>
 #include <list>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <ostream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 #include <cstdint>
 
+#include "../../Thread_Pool.h"
 #include "../Grouping/Misc_Functors.h"
 #include "Contour_Similarity.h"
 #include "YgorImages.h"
@@ -15,6 +25,219 @@
 #include "YgorLog.h"
 
 
+double contour_overlap_counts::Dice_Coefficient() const {
+    if( (this->A_voxels == 0) && (this->B_voxels == 0) ) return std::numeric_limits<double>::quiet_NaN();
+    return (2.0*this->overlap_voxels) / ( (1.0*this->A_voxels) + (1.0*this->B_voxels) );
+}
+
+double contour_overlap_counts::Jaccard_Coefficient() const {
+    if( (this->A_voxels == 0) && (this->B_voxels == 0) ) return std::numeric_limits<double>::quiet_NaN();
+    return (1.0*this->overlap_voxels) / ( (1.0*this->A_voxels) + (1.0*this->B_voxels) - (1.0*this->overlap_voxels) );
+}
+
+
+// Set the bits for voxels interior to the contours on a single slice.
+//
+// Contour vertices are mapped to fractional (row, column) coordinates. For each row, the crossings of the contour
+// edges with the line through the row's voxel centres are sorted and the voxels between alternating pairs of
+// crossings are filled. Multiple contours are combined by union, so each contour is filled individually.
+static
+void rasterize_slice( const planar_image<float,double> &img,
+                      const contour_roi_group &roi,
+                      contour_bitmask_slice &slice ){
+    slice.rows = img.rows;
+    slice.columns = img.columns;
+    slice.words_per_row = (img.columns + 63) / 64;
+    slice.bits.assign(slice.rows * slice.words_per_row, static_cast<uint64_t>(0));
+    if( (img.rows <= 0) || (img.columns <= 0) ) return;
+
+    const auto P00 = img.position(0, 0);
+    const auto d_row = (1 < img.rows)    ? (img.position(1, 0) - P00) : (img.row_unit * img.pxl_dx);
+    const auto d_col = (1 < img.columns) ? (img.position(0, 1) - P00) : (img.col_unit * img.pxl_dy);
+    const auto d_row_sq = d_row.Dot(d_row);
+    const auto d_col_sq = d_col.Dot(d_col);
+
+    std::vector<std::array<double, 2>> verts;
+    std::vector<std::vector<double>> crossings(img.rows);
+
+    for(const auto &cc_refw : roi){
+        for(const auto &contour : cc_refw.get().contours){
+            if(contour.points.size() < 3) continue;
+            if(!img.encompasses_contour_of_points(contour)) continue;
+
+            verts.clear();
+            for(const auto &p : contour.points){
+                const auto dP = p - P00;
+                verts.push_back({{ dP.Dot(d_row) / d_row_sq, dP.Dot(d_col) / d_col_sq }});
+            }
+
+            for(auto &c : crossings) c.clear();
+            const auto N = verts.size();
+            for(size_t i = 0; i < N; ++i){
+                const auto &A = verts[i];
+                const auto &B = verts[(i + 1) % N];
+                if(A[0] == B[0]) continue; // Horizontal edges never cross a row centre line.
+
+                // Half-open interval so shared vertices are counted exactly once.
+                const auto r_lo = std::min(A[0], B[0]);
+                const auto r_hi = std::max(A[0], B[0]);
+                const auto row_begin = std::max<int64_t>(0, static_cast<int64_t>(std::ceil(r_lo)));
+                const auto row_end   = std::min<int64_t>(img.rows - 1, static_cast<int64_t>(std::ceil(r_hi)) - 1);
+                const auto slope = (B[1] - A[1]) / (B[0] - A[0]);
+                for(int64_t row = row_begin; row <= row_end; ++row){
+                    crossings[row].push_back( A[1] + (static_cast<double>(row) - A[0]) * slope );
+                }
+            }
+
+            for(int64_t row = 0; row < img.rows; ++row){
+                auto &xs = crossings[row];
+                if(xs.size() < 2) continue;
+                std::sort(std::begin(xs), std::end(xs));
+
+                uint64_t *row_bits = slice.bits.data() + row * slice.words_per_row;
+                for(size_t k = 0; (k + 1) < xs.size(); k += 2){
+                    // Fill columns with centres in [xs[k], xs[k+1]).
+                    const auto col_begin = std::max<int64_t>(0, static_cast<int64_t>(std::ceil(xs[k])));
+                    const auto col_end   = std::min<int64_t>(img.columns, static_cast<int64_t>(std::ceil(xs[k + 1])));
+                    if(col_end <= col_begin) continue;
+
+                    const auto w_begin = col_begin / 64;
+                    const auto w_last  = (col_end - 1) / 64;
+                    for(int64_t w = w_begin; w <= w_last; ++w){
+                        const auto b_lo = (w == w_begin) ? (col_begin % 64) : 0;
+                        const auto b_hi = (w == w_last) ? ((col_end - 1) % 64) : 63;
+                        const auto width = b_hi - b_lo + 1;
+                        const uint64_t mask = (width == 64) ? ~static_cast<uint64_t>(0)
+                                                            : (((static_cast<uint64_t>(1) << width) - 1) << b_lo);
+                        row_bits[w] |= mask;
+                    }
+                }
+            }
+        }
+    }
+    return;
+}
+
+
+std::vector<contour_roi_group>
+Group_Contour_Collections_By_ROIName( const std::list<std::reference_wrapper<contour_collection<double>>> &ccs ){
+    std::vector<contour_roi_group> out;
+    std::map<std::string, size_t> index_of;
+    for(const auto &cc_refw : ccs){
+        std::optional<std::string> ROIName;
+        for(const auto &c : cc_refw.get().contours){
+            ROIName = c.GetMetadataValueAs<std::string>("ROIName");
+            if(ROIName) break;
+        }
+
+        if(!ROIName){
+            out.emplace_back();
+            out.back().push_back(cc_refw);
+            continue;
+        }
+        auto it = index_of.find(ROIName.value());
+        if(it == std::end(index_of)){
+            it = index_of.emplace(ROIName.value(), out.size()).first;
+            out.emplace_back();
+        }
+        auto &group = out.at(it->second);
+        const auto already_present = std::any_of(std::begin(group), std::end(group),
+                                                 [&](const std::reference_wrapper<contour_collection<double>> &r){
+                                                     return &(r.get()) == &(cc_refw.get());
+                                                 });
+        if(!already_present) group.push_back(cc_refw);
+    }
+    return out;
+}
+
+
+std::vector<std::reference_wrapper<planar_image<float,double>>>
+Gather_Non_Overlapping_Images( planar_image_collection<float,double> &imagecoll ){
+    //Generate a comprehensive list of iterators to all as-of-yet-unused images. This list will be
+    // pruned after images have been successfully operated on.
+    auto all_images = imagecoll.get_all_images();
+    std::vector<std::reference_wrapper<planar_image<float,double>>> selected_img_refws;
+    while(!all_images.empty()){
+        YLOGINFO("Images still to be processed: " << all_images.size());
+
+        //Find the images which spatially overlap with this image.
+        auto curr_img_it = all_images.front();
+        auto selected_imgs = GroupSpatiallyOverlappingImages(curr_img_it, std::ref(imagecoll));
+
+        if(selected_imgs.empty()){
+            throw std::logic_error("No spatially-overlapping images found. There should be at least one"
+                                   " image (the 'seed' image) which should match. Verify the spatial" 
+                                   " overlap grouping routine.");
+        }
+        if(selected_imgs.size() != 1){
+            throw std::logic_error("Spatially-overlapping images found. The similarity metric requires"
+                                   " a uniform spatial grid without any overlap. Please trim all"
+                                   " unnecessary images (or average, or something else).");
+            // NOTE: We *could* just proceed using only the first image, but it is better to be explicit
+            //       about what the routine should accept. 
+        }
+        for(auto &an_img_it : selected_imgs){
+             all_images.remove(an_img_it); //std::list::remove() erases all elements equal to input value.
+        }
+
+        selected_img_refws.emplace_back( std::ref(*selected_imgs.front()) );
+    }
+    return selected_img_refws;
+}
+
+
+std::vector<contour_bitmask>
+Rasterize_Contour_Bitmasks( const std::vector<std::reference_wrapper<planar_image<float,double>>> &imgs,
+                            const std::vector<contour_roi_group> &rois ){
+    std::vector<contour_bitmask> out(rois.size());
+    for(auto &m : out) m.slices.resize(imgs.size());
+
+    std::mutex saver_printer;
+    std::exception_ptr failure;
+    {
+        work_queue<std::function<void(void)>> wq;
+        for(size_t r = 0; r < rois.size(); ++r){
+            for(size_t i = 0; i < imgs.size(); ++i){
+                wq.submit_task([&,r,i]() -> void {
+                    try{
+                        rasterize_slice(imgs[i].get(), rois[r], out[r].slices[i]);
+                    }catch(const std::exception &){
+                        std::lock_guard<std::mutex> lock(saver_printer);
+                        if(!failure) failure = std::current_exception();
+                    }
+                });
+            }
+        }
+    } // Wait for all tasks to complete.
+    if(failure) std::rethrow_exception(failure);
+    return out;
+}
+
+
+contour_overlap_counts
+Count_Bitmask_Overlap( const contour_bitmask &A,
+                       const contour_bitmask &B ){
+    if(A.slices.size() != B.slices.size()){
+        throw std::invalid_argument("Bitmasks were not rasterized on the same images. Cannot continue.");
+    }
+
+    contour_overlap_counts out;
+    const auto N_slices = A.slices.size();
+    for(size_t i = 0; i < N_slices; ++i){
+        const auto &a = A.slices[i].bits;
+        const auto &b = B.slices[i].bits;
+        if(a.size() != b.size()){
+            throw std::invalid_argument("Bitmask slices differ in size. Cannot continue.");
+        }
+        const auto N_words = a.size();
+        for(size_t w = 0; w < N_words; ++w){
+            out.A_voxels       += static_cast<uint64_t>( std::bitset<64>(a[w]).count() );
+            out.B_voxels       += static_cast<uint64_t>( std::bitset<64>(b[w]).count() );
+            out.overlap_voxels += static_cast<uint64_t>( std::bitset<64>(a[w] & b[w]).count() );
+        }
+    }
+    return out;
+}
 
 
 bool ComputeContourSimilarity(planar_image_collection<float,double> &imagecoll,
@@ -51,8 +274,11 @@ bool ComputeContourSimilarity(planar_image_collection<float,double> &imagecoll,
     //
     // NOTE: We only bother to grab individual contours here. You could alter this if you wanted 
     //       each contour_collection's contours to have an identifying colour.
-    if(ccsl.size() != 2){
-        YLOGWARN("This routine requires exactly two contour_collections. Cannot continue with computation");
+    // Contour collections are grouped by ROI, so an ROI split across several collections is treated as a whole.
+    const auto rois = Group_Contour_Collections_By_ROIName(ccsl);
+    if(rois.size() != 2){
+        YLOGWARN("This routine requires exactly two ROIs, but " << rois.size() << " were provided"
+                 " (from " << ccsl.size() << " contour_collections). Cannot continue with computation");
         return false;
     }
 
@@ -70,125 +296,14 @@ bool ComputeContourSimilarity(planar_image_collection<float,double> &imagecoll,
 */
 
 
-    //Generate a comprehensive list of iterators to all as-of-yet-unused images. This list will be
-    // pruned after images have been successfully operated on.
-    auto all_images = imagecoll.get_all_images();
-    while(!all_images.empty()){
-        YLOGINFO("Images still to be processed: " << all_images.size());
-
-        //Find the images which spatially overlap with this image.
-        auto curr_img_it = all_images.front();
-        auto selected_imgs = GroupSpatiallyOverlappingImages(curr_img_it, std::ref(imagecoll));
-
-        if(selected_imgs.empty()){
-            throw std::logic_error("No spatially-overlapping images found. There should be at least one"
-                                   " image (the 'seed' image) which should match. Verify the spatial" 
-                                   " overlap grouping routine.");
-        }
-        if(selected_imgs.size() != 1){
-            throw std::logic_error("Spatially-overlapping images found. The similarity metric requires"
-                                   " a uniform spatial grid without any overlap. Please trim all"
-                                   " unnecessary images (or average, or something else).");
-            // NOTE: We *could* just proceed using only the first image, but it is better to be explicit
-            //       about what the routine should accept. 
-        }
-        for(auto &an_img_it : selected_imgs){
-             all_images.remove(an_img_it); //std::list::remove() erases all elements equal to input value.
-        }
+    const auto selected_img_refws = Gather_Non_Overlapping_Images(imagecoll);
 
-        planar_image<float,double> &img = std::ref(*selected_imgs.front());
-        //Loop over the rois, rows, columns, channels, and finally any selected images (if applicable).
-        const auto row_unit   = img.row_unit;
-        const auto col_unit   = img.col_unit;
-        const auto ortho_unit = row_unit.Cross( col_unit ).unit();
-   
-        planar_image<float,double> img_L = (*selected_imgs.front()); //Create copies for blitting. Could be uint8_t or bool for space saving...
-        planar_image<float,double> img_R = (*selected_imgs.front());
-        img_L.fill_pixels(0.0); // 0.0 == boolean FALSE. Everything else == boolean TRUE.
-        img_R.fill_pixels(0.0);
-
-
-        //Loop over the ccsl, rois, rows, columns, channels, and finally any selected images (if applicable).
-        //for(const auto &roi : rois){
-        int64_t cc_number = 0;
-        for(auto &ccs : ccsl){
-            ++cc_number; // == 1 (L) or 2 (R).
-            for(auto & contour : ccs.get().contours){
-                if(contour.points.empty()) continue;
-                if(! img.encompasses_contour_of_points(contour)) continue;
-    
-                //const auto ROIName =  roi_it->GetMetadataValueAs<std::string>("ROIName");
-                //if(!ROIName){
-                //    YLOGWARN("Missing necessary tags for reporting analysis results. Cannot continue");
-                //    return false;
-                //}
-                
-        /*
-                //Construct a bounding box to reduce computational demand of checking every voxel.
-                auto BBox = roi_it->Bounding_Box_Along(row_unit, 1.0);
-                auto BBoxBestFitPlane = BBox.Least_Squares_Best_Fit_Plane(vec3<double>(0.0,0.0,1.0));
-                auto BBoxProjectedContour = BBox.Project_Onto_Plane_Orthogonally(BBoxBestFitPlane);
-                const bool BBoxAlreadyProjected = true;
-        */
-        
-                //Prepare a contour for fast is-point-within-the-polygon checking.
-                auto BestFitPlane = contour.Least_Squares_Best_Fit_Plane(ortho_unit);
-                auto ProjectedContour = contour.Project_Onto_Plane_Orthogonally(BestFitPlane);
-                const bool AlreadyProjected = true;
-        
-                for(auto row = 0; row < img.rows; ++row){
-                    for(auto col = 0; col < img.columns; ++col){
-                        //Figure out the spatial location of the present voxel.
-                        const auto point = img.position(row,col);
-        
-        /*
-                        //Check if within the bounding box. It will generally be cheaper than the full contour (4 points vs. ? points).
-                        auto BBoxProjectedPoint = BBoxBestFitPlane.Project_Onto_Plane_Orthogonally(point);
-                        if(!BBoxProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BBoxBestFitPlane,
-                                                                                            BBoxProjectedPoint,
-                                                                                            BBoxAlreadyProjected)) continue;
-        */
-        
-                        //Perform a more detailed check to see if we are in the ROI.
-                        auto ProjectedPoint = BestFitPlane.Project_Onto_Plane_Orthogonally(point);
-                        if(ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
-                                                                                       ProjectedPoint,
-                                                                                       AlreadyProjected)){
-                            //for(auto chan = 0; chan < img.channels; ++chan){
-                            //}//Loop over channels.
-
-                            if(cc_number == 1){
-                                img_L.reference(row,col,0) = 1.0;
-                            }else if(cc_number == 2){
-                                img_R.reference(row,col,0) = 1.0;
-                            }else{
-                                throw std::logic_error("Execution should never reach this point. Programming error.");
-                            }
- 
-                        //If we're in the bounding box but not the ROI, do something.
-                        }else{
-                            //for(auto chan = 0; chan < first_img_it->channels; ++chan){
-                            //    const auto curr_val = working.value(row, col, chan);
-                            //    if(curr_val != 0) YLOGERR("There are overlapping ROI bboxes. This code currently cannot handle this. "
-                            //                              "You will need to run the functor individually on the overlapping ROIs.");
-                            //    working.reference(row, col, chan) = static_cast<float>(10);
-                            //}
-                        } // If is in ROI or ROI bbox.
-                    } //Loop over cols
-                } //Loop over rows
-            } //Loop over ROIs.
-        } //Loop over contour_collections.
-
-        for(auto row = 0; row < img.rows; ++row){
-            for(auto col = 0; col < img.columns; ++col){
-                const bool isL = (img_L.value(row,col,0) != 0.0);
-                const bool isR = (img_R.value(row,col,0) != 0.0);
-                if(isL) user_data_s->contour_L_voxels++;
-                if(isR) user_data_s->contour_R_voxels++;
-                if(isL && isR) user_data_s->overlap_voxels++;
-            }
-        }   
-    }
+    // Rasterize both ROIs onto the selected images and count the overlap.
+    const auto masks = Rasterize_Contour_Bitmasks(selected_img_refws, rois);
+    const auto counts = Count_Bitmask_Overlap(masks.front(), masks.back());
+    user_data_s->contour_L_voxels += counts.A_voxels;
+    user_data_s->contour_R_voxels += counts.B_voxels;
+    user_data_s->overlap_voxels   += counts.overlap_voxels;
 
     return true;
 }
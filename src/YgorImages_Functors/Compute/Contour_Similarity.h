@@ -8,8 +8,10 @@
 #include <functional>
 #include <limits>
 #include <limits>
+#include <string>
 #include <list>
 #include <map>
+#include <vector>
 
 #include "YgorImages.h"
 #include "YgorMath.h"
@@ -61,6 +63,56 @@ struct ComputeContourSimilarityUserData {
 
 };
 
+
+// Bit-packed voxel occupancy of a contour collection sampled on a set of images (one slice per image).
+//
+// Voxels are considered interior when their centre is interior to any contour on the slice. Each row is padded to a
+// whole number of 64-bit words so spans can be filled, and masks compared, a word at a time.
+struct contour_bitmask_slice {
+    int64_t rows = 0;
+    int64_t columns = 0;
+    int64_t words_per_row = 0;
+    std::vector<uint64_t> bits;
+};
+
+struct contour_bitmask {
+    std::vector<contour_bitmask_slice> slices; // One per image, in the order provided.
+};
+
+struct contour_overlap_counts {
+    uint64_t A_voxels = 0;
+    uint64_t B_voxels = 0;
+    uint64_t overlap_voxels = 0;
+
+    double Dice_Coefficient() const;
+    double Jaccard_Coefficient() const;
+};
+
+// Contour collections that together comprise a single ROI.
+using contour_roi_group = std::vector<std::reference_wrapper<contour_collection<double>>>;
+
+// Group contour collections by their 'ROIName' metadata, preserving the order in which ROIs are first encountered.
+// Collections without an ROIName are treated as distinct ROIs.
+std::vector<contour_roi_group>
+Group_Contour_Collections_By_ROIName( const std::list<std::reference_wrapper<contour_collection<double>>> &ccs );
+
+// Gather the images that comprise a uniform grid. Throws if any images spatially overlap, since voxels would otherwise
+// be counted more than once.
+std::vector<std::reference_wrapper<planar_image<float,double>>>
+Gather_Non_Overlapping_Images( planar_image_collection<float,double> &imagecoll );
+
+// Rasterize each ROI onto the images using a scanline fill. The mask of an ROI is the union of all its contour
+// collections. Every (ROI, image) pair is processed in parallel. Images are not modified.
+std::vector<contour_bitmask>
+Rasterize_Contour_Bitmasks( const std::vector<std::reference_wrapper<planar_image<float,double>>> &imgs,
+                            const std::vector<contour_roi_group> &rois );
+
+// Count the voxels in each mask and their intersection. Both masks must have been rasterized on the same images.
+contour_overlap_counts
+Count_Bitmask_Overlap( const contour_bitmask &A,
+                       const contour_bitmask &B );
+
+
 bool ComputeContourSimilarity(planar_image_collection<float,double> &,
                               std::list<std::reference_wrapper<planar_image_collection<float,double>>>,
                               std::list<std::reference_wrapper<contour_collection<double>>>,
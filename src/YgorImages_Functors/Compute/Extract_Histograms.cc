@@ -16,6 +16,7 @@
 #include "../../Metadata.h"
 #include "../Grouping/Misc_Functors.h"
 #include "../ConvenienceRoutines.h"
+#include "../Processing/Partitioned_Image_Voxel_Visitor_Mutator.h"
 #include "Extract_Histograms.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
@@ -65,6 +66,43 @@ bool ComputeExtractHistograms(planar_image_collection<float,double> &imagecoll,
         return false;
     }
 
+    // Visit the bounded voxels of an image, either classifying them as wholly in or out, or weighting them by their
+    // fractional occupancy.
+    using ccsl_refw_t = std::list<std::reference_wrapper<contour_collection<double>>>;
+    const auto visit_bounded_voxels = [&](std::reference_wrapper<planar_image<float,double>> img_refw,
+                                          const ccsl_refw_t &l_ccsl,
+                                          const std::function<void(int64_t, float, double)> &f) -> void {
+        if(user_data_s->fractional_occupancy){
+            auto &img = img_refw.get();
+            const auto occupancy = Compute_Fractional_Voxel_Occupancy(img, l_ccsl,
+                                                                      user_data_s->mutation_opts.contouroverlap);
+            for(int64_t row = 0; row < img.rows; ++row){
+                for(int64_t col = 0; col < img.columns; ++col){
+                    const auto weight = occupancy[static_cast<size_t>(row * img.columns + col)];
+                    if(weight <= 0.0) continue;
+                    for(int64_t chan = 0; chan < img.channels; ++chan){
+                        f(chan, img.value(row, col, chan), weight);
+                    }
+                }
+            }
+        }else{
+            auto f_bounded = [&](int64_t /*E_row*/, 
+                                 int64_t /*E_col*/,
+                                 int64_t channel,
+                                 std::reference_wrapper<planar_image<float,double>> /*l_img_refw*/,
+                                 std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
+                                 float &voxel_val) {
+                f(channel, voxel_val, 1.0);
+            };
+            Mutate_Voxels<float,double>( img_refw,
+                                         { img_refw },
+                                         l_ccsl, 
+                                         user_data_s->mutation_opts, 
+                                         f_bounded );
+        }
+        return;
+    };
+
     // Logically partition the contours.
     //
     // Note: At the moment we exclusively use ROIName, but we *could* use any metadata tag here.
@@ -124,12 +162,8 @@ bool ComputeExtractHistograms(planar_image_collection<float,double> &imagecoll,
                     double local_minimum = std::numeric_limits<double>::infinity();
                     double local_maximum = -local_minimum;
 
-                    auto f_bounded = [&](int64_t /*E_row*/, 
-                                         int64_t /*E_col*/,
-                                         int64_t channel,
-                                         std::reference_wrapper<planar_image<float,double>> /*l_img_refw*/,
-                                         std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
-                                         float &voxel_val) {
+                    visit_bounded_voxels(img_refw, named_ccsl.second,
+                                         [&](int64_t channel, float voxel_val, double /*weight*/) -> void {
                         if( ( (user_data_s->channel < 0) || (user_data_s->channel == channel))
                         &&  std::isfinite(voxel_val)  // Ignore infinite and NaN voxels.
                         &&  (user_data_s->lower_threshold <= voxel_val)
@@ -138,13 +172,7 @@ bool ComputeExtractHistograms(planar_image_collection<float,double> &imagecoll,
                             if(local_maximum < voxel_val) local_maximum = voxel_val;
                         }
                         return;
-                    };
-
-                    Mutate_Voxels<float,double>( img_refw,
-                                                 { img_refw },
-                                                 named_ccsl.second, 
-                                                 user_data_s->mutation_opts, 
-                                                 f_bounded );
+                    });
 
                     // Merge the results.
                     if( std::isfinite(local_minimum) 
@@ -232,7 +260,7 @@ bool ComputeExtractHistograms(planar_image_collection<float,double> &imagecoll,
                 const auto pxl_dz = img_refw.get().pxl_dz;
                 const auto pxl_vol = pxl_dx * pxl_dy * pxl_dz;
 
-                std::vector<size_t> shuttle;  // Thread-specific storage buffer.
+                std::vector<std::pair<size_t, double>> shuttle;  // Thread-specific storage buffer of (bin, volume).
                 const size_t N_shuttle = 1000; // Size of buffer.
                 shuttle.reserve(N_shuttle);
 
@@ -249,18 +277,14 @@ bool ComputeExtractHistograms(planar_image_collection<float,double> &imagecoll,
                     // Sub-routine to add all counts from the buffer and then reset the buffer.
                     const auto add_counts = [&]() -> void {
                         std::lock_guard<std::mutex> lock(saver);
-                        for(const auto &bin_N : shuttle) raw_diff_hist[bin_N][2] += pxl_vol;
+                        for(const auto &p : shuttle) raw_diff_hist[p.first][2] += p.second;
                         shuttle.clear();
                         shuttle.reserve(N_shuttle);
                         return;
                     };
 
-                    auto f_bounded = [&](int64_t /*E_row*/, 
-                                         int64_t /*E_col*/,
-                                         int64_t channel,
-                                         std::reference_wrapper<planar_image<float,double>> /*l_img_refw*/,
-                                         std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
-                                         float &voxel_val){
+                    visit_bounded_voxels(img_refw, named_ccsl.second,
+                                         [&](int64_t channel, float voxel_val, double weight) -> void {
 
                         if( ( (user_data_s->channel < 0) || (user_data_s->channel == channel))
                         &&  std::isfinite(voxel_val)  // Ignore infinite and NaN voxels.
@@ -272,17 +296,11 @@ bool ComputeExtractHistograms(planar_image_collection<float,double> &imagecoll,
                                                                    static_cast<size_t>(0),
                                                                    static_cast<size_t>(bin_count-1) );
                             //raw_diff_hist.at(bin_N)[2] += pxl_vol;
-                            shuttle.push_back(bin_N);
+                            shuttle.emplace_back(bin_N, pxl_vol * weight);
                             if(N_shuttle == shuttle.size()) add_counts();
                         }
                         return;
-                    };
-
-                    Mutate_Voxels<float,double>( img_refw,
-                                                 { img_refw },
-                                                 named_ccsl.second, 
-                                                 user_data_s->mutation_opts, 
-                                                 f_bounded );
+                    });
 
                     add_counts(); // Commit all remaining bins from the shuttle.
                 } // Loop over all named ccs.
@@ -30,6 +30,12 @@ struct ComputeExtractHistogramsUserData {
     //mutation_opts.adjacency      = Mutate_Voxels_Opts::Adjacency::SingleVoxel;
     //mutation_opts.maskmod        = Mutate_Voxels_Opts::MaskMod::Noop;
 
+    // -----------------------------
+    // Whether voxels should be weighted by the fraction of their in-plane footprint covered by the contours. If enabled,
+    // the inclusivity option is ignored and boundary voxels contribute a partial volume.
+    //
+    bool fractional_occupancy = false;
+
     // -----------------------------
     // The width of histogram bins, in DICOM units (nominally Gy).
     //
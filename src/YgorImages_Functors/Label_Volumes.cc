@@ -0,0 +1,108 @@
+//Label_Volumes.cc - A part of DICOMautomaton 2026.
+
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "YgorMath.h"
+#include "YgorImages.h"
+#include "YgorMisc.h"
+#include "YgorLog.h"
+
+#include "../Thread_Pool.h"
+#include "Label_Volumes.h"
+
+
+bool label_volume::matches(const planar_image_collection<float,double> &imagecoll) const {
+    if(imagecoll.images.size() != this->geometry.size()) return false;
+
+    const auto eps = 1.0E-4;
+    auto g_it = std::begin(this->geometry);
+    for(const auto &img : imagecoll.images){
+        const auto &g = *(g_it++);
+        if( (img.rows != g.rows)
+        ||  (img.columns != g.columns)
+        ||  (eps < std::abs(img.pxl_dx - g.pxl_dx))
+        ||  (eps < std::abs(img.pxl_dy - g.pxl_dy))
+        ||  (eps < img.row_unit.distance(g.row_unit))
+        ||  (eps < img.col_unit.distance(g.col_unit))
+        ||  (eps < img.position(0, 0).distance(g.origin)) ){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+label_volume
+Rasterize_Label_Volume(planar_image_collection<float,double> &imagecoll,
+                       const std::vector<std::list<std::reference_wrapper<contour_collection<double>>>> &groups,
+                       const Mutate_Voxels_Opts &opts){
+    if(255 < groups.size()){
+        throw std::invalid_argument("Too many label groups provided");
+    }
+
+    label_volume out;
+    for(const auto &img : imagecoll.images){
+        out.geometry.emplace_back();
+        auto &g = out.geometry.back();
+        g.rows = img.rows;
+        g.columns = img.columns;
+        g.origin = img.position(0, 0);
+        g.row_unit = img.row_unit;
+        g.col_unit = img.col_unit;
+        g.pxl_dx = img.pxl_dx;
+        g.pxl_dy = img.pxl_dy;
+
+        out.labels.emplace_back(static_cast<size_t>(img.rows * img.columns), static_cast<uint8_t>(0));
+    }
+
+    std::mutex saver_printer;
+    std::exception_ptr failure;
+    {
+        work_queue<std::function<void(void)>> wq;
+        size_t n = 0;
+        for(auto &img : imagecoll.images){
+            auto *labels = &(out.labels[n++]);
+            wq.submit_task([&img,labels,&groups,&opts,&saver_printer,&failure]() -> void {
+                try{
+                    auto img_refw = std::ref(img);
+                    const auto N_cols = img.columns;
+                    for(size_t i = 0; i < groups.size(); ++i){
+                        if(groups[i].empty()) continue;
+                        const auto label = static_cast<uint8_t>(i + 1);
+
+                        // Voxel values are not altered.
+                        auto f_bounded = [&](int64_t E_row,
+                                             int64_t E_col,
+                                             int64_t /*E_chan*/,
+                                             std::reference_wrapper<planar_image<float,double>> /*l_img_refw*/,
+                                             std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
+                                             float &/*voxel_val*/) {
+                            (*labels)[static_cast<size_t>(E_row * N_cols + E_col)] = label;
+                            return;
+                        };
+
+                        Mutate_Voxels<float,double>( img_refw,
+                                                     { img_refw },
+                                                     groups[i],
+                                                     opts,
+                                                     f_bounded );
+                    }
+                }catch(...){
+                    std::lock_guard<std::mutex> lock(saver_printer);
+                    if(!failure) failure = std::current_exception();
+                }
+            });
+        }
+    } // Wait for all tasks to complete.
+
+    if(failure) std::rethrow_exception(failure);
+
+    return out;
+}
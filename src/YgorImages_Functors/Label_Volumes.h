@@ -0,0 +1,98 @@
+//Label_Volumes.h.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "YgorMath.h"
+#include "YgorImages.h"
+
+#include "../Thread_Pool.h"
+
+template <class T> class contour_collection;
+
+
+// Per-voxel integer labels for an image collection.
+//
+// Classifying voxels against contours is expensive, so this can be used to classify voxels once and then look up
+// per-label (e.g., per-ROI) model parameters in tight loops. The geometry of each image is retained so the labels can
+// be re-used for any other image collection with the same geometry.
+struct label_volume {
+    struct image_geometry {
+        int64_t rows = 0;
+        int64_t columns = 0;
+        vec3<double> origin;   // Position of voxel (0,0).
+        vec3<double> row_unit;
+        vec3<double> col_unit;
+        double pxl_dx = 0.0;
+        double pxl_dy = 0.0;
+    };
+
+    std::vector<image_geometry> geometry;      // One per image, in the image collection's order.
+    std::vector<std::vector<uint8_t>> labels;  // One per image, row-major (i.e., row * columns + column).
+
+    // Whether the labels were rasterized on images with the same geometry, in the same order.
+    bool matches(const planar_image_collection<float,double> &imagecoll) const;
+};
+
+
+// Rasterizes groups of contours into a label volume. Voxels bounded by group i are given label (i + 1), with later
+// groups taking precedence over earlier groups. All other voxels are given label zero. At most 255 groups are
+// supported.
+label_volume
+Rasterize_Label_Volume(planar_image_collection<float,double> &imagecoll,
+                       const std::vector<std::list<std::reference_wrapper<contour_collection<double>>>> &groups,
+                       const Mutate_Voxels_Opts &opts);
+
+
+// Replaces every voxel value v in the given channel (or all channels if negative) with f(v, label), in-place and in
+// parallel over images. The label volume must match the image collection.
+template <class F>
+void
+Transform_Voxels_By_Label(planar_image_collection<float,double> &imagecoll,
+                          const label_volume &lv,
+                          int64_t channel,
+                          F f){
+    if(!lv.matches(imagecoll)){
+        throw std::invalid_argument("Label volume does not match image geometry");
+    }
+
+    // Exceptions thrown by the functor are forwarded to the caller.
+    std::mutex saver_printer;
+    std::exception_ptr failure;
+    {
+        work_queue<std::function<void(void)>> wq;
+        size_t n = 0;
+        for(auto &img : imagecoll.images){
+            const auto *labels = &(lv.labels[n++]);
+            wq.submit_task([&img,labels,channel,&f,&saver_printer,&failure]() -> void {
+                try{
+                    const auto chan_lo = (channel < 0) ? 0 : channel;
+                    const auto chan_hi = (channel < 0) ? img.channels : std::min<int64_t>(channel + 1, img.channels);
+                    for(int64_t row = 0; row < img.rows; ++row){
+                        for(int64_t col = 0; col < img.columns; ++col){
+                            const auto label = (*labels)[static_cast<size_t>(row * img.columns + col)];
+                            for(int64_t chan = chan_lo; chan < chan_hi; ++chan){
+                                auto &v = img.reference(row, col, chan);
+                                v = f(v, label);
+                            }
+                        }
+                    }
+                }catch(...){
+                    std::lock_guard<std::mutex> lock(saver_printer);
+                    if(!failure) failure = std::current_exception();
+                }
+            });
+        }
+    } // Wait for all tasks to complete.
+
+    if(failure) std::rethrow_exception(failure);
+    return;
+}
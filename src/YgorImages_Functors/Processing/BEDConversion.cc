@@ -1,15 +1,18 @@
 
+#include <array>
 #include <exception>
 #include <functional>
 #include <limits>
 #include <list>
 #include <map>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <cstdint>
 
 #include "../../BED_Conversion.h"
 #include "../ConvenienceRoutines.h"
+#include "../Label_Volumes.h"
 #include "BEDConversion.h"
 #include "YgorImages.h"
 #include "YgorMisc.h"
@@ -17,10 +20,9 @@
 
 template <class T> class contour_collection;
 
-bool BEDConversion(planar_image_collection<float,double>::images_list_it_t first_img_it,
-                   std::list<planar_image_collection<float,double>::images_list_it_t> selected_img_its,
+bool BEDConversion(planar_image_collection<float,double> &imagecoll,
                    std::list<std::reference_wrapper<planar_image_collection<float,double>>>,
-                   std::list<std::reference_wrapper<contour_collection<double>>> ccsl, 
+                   std::list<std::reference_wrapper<contour_collection<double>>> ccsl,
                    std::any user_data){
 
     //This routine converts voxel intensities (dose) into Biologically Effective Dose (BED) or Equivalent Doses in
@@ -38,23 +40,31 @@ bool BEDConversion(planar_image_collection<float,double>::images_list_it_t first
         return false;
     }
 
-    if(selected_img_its.size() != 1) throw std::invalid_argument("This routine operates on individual images only");
-
     if(ccsl.empty()){
         YLOGWARN("Missing needed contour information. Cannot continue with computation");
         return false;
     }
 
-    Mutate_Voxels_Opts ebv_opts;
-    ebv_opts.editstyle      = Mutate_Voxels_Opts::EditStyle::InPlace;
-    ebv_opts.inclusivity    = Mutate_Voxels_Opts::Inclusivity::Centre;
-    ebv_opts.contouroverlap = Mutate_Voxels_Opts::ContourOverlap::Ignore;
-    ebv_opts.aggregate      = Mutate_Voxels_Opts::Aggregate::First;
-    ebv_opts.adjacency      = Mutate_Voxels_Opts::Adjacency::SingleVoxel;
-    ebv_opts.maskmod        = Mutate_Voxels_Opts::MaskMod::Noop;
+    // Classify voxels as early-responding (label 1) or late-responding (label 0), re-using a cached classification if
+    // the geometry matches.
+    if( (user_data_s->labels == nullptr)
+    ||  !user_data_s->labels->matches(imagecoll) ){
+        Mutate_Voxels_Opts ebv_opts;
+        ebv_opts.editstyle      = Mutate_Voxels_Opts::EditStyle::InPlace;
+        ebv_opts.inclusivity    = Mutate_Voxels_Opts::Inclusivity::Centre;
+        ebv_opts.contouroverlap = Mutate_Voxels_Opts::ContourOverlap::Ignore;
+        ebv_opts.aggregate      = Mutate_Voxels_Opts::Aggregate::First;
+        ebv_opts.adjacency      = Mutate_Voxels_Opts::Adjacency::SingleVoxel;
+        ebv_opts.maskmod        = Mutate_Voxels_Opts::MaskMod::Noop;
+
+        user_data_s->labels = std::make_shared<label_volume>( Rasterize_Label_Volume(imagecoll, { ccsl }, ebv_opts) );
+    }
+
+    // Per-label alpha/beta, indexed by label.
+    const std::array<double, 2> abrs = {{ user_data_s->AlphaBetaRatioLate,
+                                          user_data_s->AlphaBetaRatioEarly }};
 
-    Mutate_Voxels_Functor<float,double> f_bounded;
-    Mutate_Voxels_Functor<float,double> f_unbounded;
+    std::map<std::string, std::string> metadata;
 
     if(user_data_s->model == BEDConversionUserData::Model::BEDSimpleLinearQuadratic){
         if(user_data_s->NumberOfFractions <= 0){
@@ -65,35 +75,22 @@ bool BEDConversion(planar_image_collection<float,double>::images_list_it_t first
             throw std::invalid_argument("AlphaBetaRatioLate not specified or invalid.");
         }
 
-        f_bounded = [=](int64_t /*row*/, int64_t /*col*/, int64_t /*channel*/,
-                        std::reference_wrapper<planar_image<float,double>> /*img_refw*/,
-                        std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
-                        float &voxel_val) {
-            if(voxel_val <= 0.0) return; // No-op if there is no dose.
-
-            const auto D_voxel = voxel_val;
-            const auto BED = BEDabr_from_n_D_abr(user_data_s->NumberOfFractions, D_voxel, user_data_s->AlphaBetaRatioEarly).val;
-            voxel_val = BED;
-            return;
-        };
-
-        f_unbounded = [=](int64_t /*row*/, int64_t /*col*/, int64_t /*channel*/,
-                          std::reference_wrapper<planar_image<float,double>> /*img_refw*/,
-                          std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
-                          float &voxel_val) {
-            if(voxel_val <= 0.0) return; // No-op if there is no dose.
-
-            const auto D_voxel = voxel_val;
-            const auto BED = BEDabr_from_n_D_abr(user_data_s->NumberOfFractions, D_voxel, user_data_s->AlphaBetaRatioLate).val;
-            voxel_val = BED;
-            return;
-        };
-
-        first_img_it->metadata["BED_NumberOfFractions"] = std::to_string(user_data_s->NumberOfFractions);
-        first_img_it->metadata["BED_Model"] = "Simple LQ";
-        first_img_it->metadata["BED_DosePerFraction"] = std::to_string(user_data_s->TargetDosePerFraction);
-        first_img_it->metadata["BED_LateTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioLate);
-        first_img_it->metadata["BED_EarlyTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioEarly);
+        // BED = D (1 + d/abr) = D + D^2 / (n abr).
+        std::array<double, 2> k;
+        for(size_t l = 0; l < k.size(); ++l){
+            k[l] = 1.0 / (user_data_s->NumberOfFractions * abrs[l]);
+        }
+        Transform_Voxels_By_Label(imagecoll, *(user_data_s->labels), -1,
+                                  [&k](float D, uint8_t label) -> float {
+            if(D <= 0.0f) return D; // No-op if there is no dose.
+            return static_cast<float>( D + static_cast<double>(D) * D * k[label] );
+        });
+
+        metadata["BED_NumberOfFractions"] = std::to_string(user_data_s->NumberOfFractions);
+        metadata["BED_Model"] = "Simple LQ";
+        metadata["BED_DosePerFraction"] = std::to_string(user_data_s->TargetDosePerFraction);
+        metadata["BED_LateTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioLate);
+        metadata["BED_EarlyTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioEarly);
 
     }else if(user_data_s->model == BEDConversionUserData::Model::EQDXSimpleLinearQuadratic){
         if(user_data_s->NumberOfFractions <= 0){
@@ -106,39 +103,23 @@ bool BEDConversion(planar_image_collection<float,double>::images_list_it_t first
             throw std::invalid_argument("AlphaBetaRatioLate not specified or invalid.");
         }
 
-        f_bounded = [=](int64_t /*row*/, int64_t /*col*/, int64_t /*channel*/,
-                        std::reference_wrapper<planar_image<float,double>> /*img_refw*/,
-                        std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
-                        float &voxel_val) {
-            if(voxel_val <= 0.0) return; // No-op if there is no dose.
-
-            const auto D_voxel = voxel_val;
-            const auto numer = D_voxel * ( (D_voxel / user_data_s->NumberOfFractions) + user_data_s->AlphaBetaRatioEarly );
-            const auto denom = (user_data_s->TargetDosePerFraction + user_data_s->AlphaBetaRatioEarly );
-            const auto EQD = numer / denom;
-            voxel_val = EQD;
-            return;
-        };
-
-        f_unbounded = [=](int64_t /*row*/, int64_t /*col*/, int64_t /*channel*/,
-                          std::reference_wrapper<planar_image<float,double>> /*img_refw*/,
-                          std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
-                          float &voxel_val) {
-            if(voxel_val <= 0.0) return; // No-op if there is no dose.
-
-            const auto D_voxel = voxel_val;
-            const auto numer = D_voxel * ( (D_voxel / user_data_s->NumberOfFractions) + user_data_s->AlphaBetaRatioLate );
-            const auto denom = (user_data_s->TargetDosePerFraction + user_data_s->AlphaBetaRatioLate );
-            const auto EQD = numer / denom;
-            voxel_val = EQD;
-            return;
-        };
-
-        first_img_it->metadata["EQDx_NumberOfFractions"] = std::to_string(user_data_s->NumberOfFractions);
-        first_img_it->metadata["EQDx_Model"] = "Simple LQ";
-        first_img_it->metadata["EQDx_DosePerFraction"] = std::to_string(user_data_s->TargetDosePerFraction);
-        first_img_it->metadata["EQDx_LateTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioLate);
-        first_img_it->metadata["EQDx_EarlyTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioEarly);
+        // EQDx = D (D/n + abr) / (x + abr).
+        const auto inv_n = 1.0 / user_data_s->NumberOfFractions;
+        std::array<double, 2> inv_denom;
+        for(size_t l = 0; l < inv_denom.size(); ++l){
+            inv_denom[l] = 1.0 / (user_data_s->TargetDosePerFraction + abrs[l]);
+        }
+        Transform_Voxels_By_Label(imagecoll, *(user_data_s->labels), -1,
+                                  [&abrs,&inv_denom,inv_n](float D, uint8_t label) -> float {
+            if(D <= 0.0f) return D; // No-op if there is no dose.
+            return static_cast<float>( D * (D * inv_n + abrs[label]) * inv_denom[label] );
+        });
+
+        metadata["EQDx_NumberOfFractions"] = std::to_string(user_data_s->NumberOfFractions);
+        metadata["EQDx_Model"] = "Simple LQ";
+        metadata["EQDx_DosePerFraction"] = std::to_string(user_data_s->TargetDosePerFraction);
+        metadata["EQDx_LateTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioLate);
+        metadata["EQDx_EarlyTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioEarly);
 
     }else if(user_data_s->model == BEDConversionUserData::Model::EQDXPinnedLinearQuadratic){
 
@@ -171,68 +152,35 @@ bool BEDConversion(planar_image_collection<float,double>::images_list_it_t first
             EQD_n = EQD_D / user_data_s->TargetDosePerFraction;
         }
 
-        f_bounded = [=](int64_t /*row*/, int64_t /*col*/, int64_t /*channel*/,
-                        std::reference_wrapper<planar_image<float,double>> /*img_refw*/,
-                        std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
-                        float &voxel_val) {
-            if(voxel_val <= 0.0) return; // No-op if there is no dose.
-
-            BEDabr BED_voxel;
-            BED_voxel = BEDabr_from_n_D_abr(user_data_s->NumberOfFractions,
-                                            voxel_val,
-                                            user_data_s->AlphaBetaRatioEarly);
-            voxel_val = D_from_n_BEDabr(EQD_n, BED_voxel);
-            return;
-        };
-
-        f_unbounded = [=](int64_t /*row*/, int64_t /*col*/, int64_t /*channel*/,
-                          std::reference_wrapper<planar_image<float,double>> /*img_refw*/,
-                          std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
-                          float &voxel_val) {
-            if(voxel_val <= 0.0) return; // No-op if there is no dose.
-
-            BEDabr BED_voxel;
-            BED_voxel = BEDabr_from_n_D_abr(user_data_s->NumberOfFractions,
-                                            voxel_val,
-                                            user_data_s->AlphaBetaRatioLate);
-            voxel_val = D_from_n_BEDabr(EQD_n, BED_voxel);
-            return;
-        };
-
-        first_img_it->metadata["EQDx_PrescriptionDose"] = std::to_string(user_data_s->PrescriptionDose);
-        first_img_it->metadata["EQDx_NumberOfFractions"] = std::to_string(user_data_s->NumberOfFractions);
-        first_img_it->metadata["EQDx_PrescriptionDose"] = std::to_string(EQD_D);
-        first_img_it->metadata["EQDx_NumberOfFractions"] = std::to_string(EQD_n);
-        first_img_it->metadata["EQDx_Model"] = "Pinned LQ";
-        first_img_it->metadata["EQDx_DosePerFraction"] = std::to_string(user_data_s->TargetDosePerFraction);
-        first_img_it->metadata["EQDx_LateTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioLate);
-        first_img_it->metadata["EQDx_EarlyTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioEarly);
+        const auto n = user_data_s->NumberOfFractions;
+        Transform_Voxels_By_Label(imagecoll, *(user_data_s->labels), -1,
+                                  [&abrs,n,EQD_n](float D, uint8_t label) -> float {
+            if(D <= 0.0f) return D; // No-op if there is no dose.
+
+            const auto BED_voxel = BEDabr_from_n_D_abr(n, D, abrs[label]);
+            return static_cast<float>( D_from_n_BEDabr(EQD_n, BED_voxel) );
+        });
+
+        metadata["EQDx_PrescriptionDose"] = std::to_string(EQD_D);
+        metadata["EQDx_NumberOfFractions"] = std::to_string(EQD_n);
+        metadata["EQDx_Model"] = "Pinned LQ";
+        metadata["EQDx_DosePerFraction"] = std::to_string(user_data_s->TargetDosePerFraction);
+        metadata["EQDx_LateTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioLate);
+        metadata["EQDx_EarlyTissue_AlphaBetaRatio"] = std::to_string(user_data_s->AlphaBetaRatioEarly);
 
     }else{
         throw std::invalid_argument("Model not specified or invalid.");
     }
 
-    std::list<std::reference_wrapper<planar_image<float,double>>> selected_imgs;
-    for(auto &img_it : selected_img_its) selected_imgs.push_back( std::ref(*img_it) );
-
-    Mutate_Voxels<float,double>( std::ref(*first_img_it),
-                                 selected_imgs, 
-                                 ccsl, 
-                                 ebv_opts, 
-                                 f_bounded,
-                                 f_unbounded );
-
-    //Alter the first image's metadata to reflect that averaging has occurred. You might want to consider
+    //Alter the metadata to reflect that conversion has occurred. You might want to consider
     // a selective whitelist approach so that unique IDs are not duplicated accidentally.
-    if(user_data_s->model == BEDConversionUserData::Model::BEDSimpleLinearQuadratic){
-        UpdateImageDescription( std::ref(*first_img_it), "BED" );
-    }else if( (user_data_s->model == BEDConversionUserData::Model::EQDXSimpleLinearQuadratic)
-          ||  (user_data_s->model == BEDConversionUserData::Model::EQDXPinnedLinearQuadratic) ){
-        UpdateImageDescription( std::ref(*first_img_it), "EQDx" );
-    }else{
-        throw std::invalid_argument("Model not specified or invalid.");
+    const std::string description = (user_data_s->model == BEDConversionUserData::Model::BEDSimpleLinearQuadratic)
+                                  ? "BED" : "EQDx";
+    for(auto &img : imagecoll.images){
+        for(const auto &p : metadata) img.metadata[p.first] = p.second;
+        UpdateImageDescription( std::ref(img), description );
+        UpdateImageWindowCentreWidth( std::ref(img) );
     }
-    UpdateImageWindowCentreWidth( std::ref(*first_img_it) );
 
     return true;
 }
@@ -5,9 +5,12 @@
 #include <any>
 #include <functional>
 #include <list>
+#include <memory>
 
 #include "YgorImages.h"
 
+#include "../Label_Volumes.h"
+
 template <class T> class contour_collection;
 
 
@@ -45,12 +48,19 @@ struct BEDConversionUserData {
     // PinnedLinearQuadratic parameters.
     double PrescriptionDose = -1.0;
 
+    // -----------------------------
+    // Voxel classification.
+    //
+    // Voxels are classified as early- or late-responding once and the classification is cached here. It is re-used
+    // for subsequent image collections with the same geometry (e.g., multiple dose arrays on a common grid).
+    std::shared_ptr<label_volume> labels;
+
 };
 
 
-bool BEDConversion(planar_image_collection<float,double>::images_list_it_t first_img_it,
-                   std::list<planar_image_collection<float,double>::images_list_it_t> ,
+// Converts all voxels in-place. Voxels bounded by the contours are treated as early-responding tissues.
+bool BEDConversion(planar_image_collection<float,double> &,
                    std::list<std::reference_wrapper<planar_image_collection<float,double>>>,
-                   std::list<std::reference_wrapper<contour_collection<double>>>, 
+                   std::list<std::reference_wrapper<contour_collection<double>>>,
                    std::any );
 
@@ -3,32 +3,31 @@
 #include <exception>
 #include <functional>
 #include <list>
+#include <memory>
 #include <stdexcept>
 #include <cstdint>
 
 #include "../../BED_Conversion.h"
 #include "../ConvenienceRoutines.h"
+#include "../Label_Volumes.h"
 #include "DecayDoseOverTime.h"
 #include "YgorImages.h"
 #include "YgorMisc.h"
 #include "YgorLog.h"
 
+#include "../../Thread_Pool.h"
+
 template <class T> class contour_collection;
 
-bool DecayDoseOverTime(planar_image_collection<float,double>::images_list_it_t first_img_it,
-                       std::list<planar_image_collection<float,double>::images_list_it_t> selected_img_its,
+bool DecayDoseOverTime(planar_image_collection<float,double> &imagecoll,
                        std::list<std::reference_wrapper<planar_image_collection<float,double>>>,
-                       std::list<std::reference_wrapper<contour_collection<double>>> ccsl, 
+                       std::list<std::reference_wrapper<contour_collection<double>>> ccsl,
                        std::any user_data){
 
-    //This routine walks over all voxels in the first image, overwriting voxel values. The values are treated
+    //This routine walks over all voxels in all images, overwriting voxel values. The values are treated
     // as dose and decayed over time according to the selected model.
-    //
-    // NOTE: This routine currently ignores all except the first image. You can save computational effort by
-    //       only bothering to hand this routine time-independent image arrays (i.e., arrays with spatial but
-    //       not temporal indices).
 
-    //This routine requires a valid HighlightROIVoxelsUserData struct packed into the user_data. 
+    //This routine requires a valid DecayDoseOverTimeUserData struct packed into the user_data. 
     DecayDoseOverTimeUserData *user_data_s;
     try{
         user_data_s = std::any_cast<DecayDoseOverTimeUserData *>(user_data);
@@ -37,16 +36,32 @@ bool DecayDoseOverTime(planar_image_collection<float,double>::images_list_it_t f
         return false;
     }
 
-    if(selected_img_its.size() != 1) throw std::invalid_argument("This routine operates on individual images only");
-
     if(ccsl.empty()){
         YLOGWARN("Missing needed contour information. Cannot continue with computation");
         return false;
     }
 
-    //Allocate a second channel to store a mask.
-    if(first_img_it->channels == 1){
-        first_img_it->add_channel(0.0);
+    // Identify the voxels to decay, re-using a cached classification if the geometry matches. Since every voxel is
+    // classified exactly once, overlapping ROIs cannot cause a voxel to be decayed more than once.
+    if( (user_data_s->labels == nullptr)
+    ||  !user_data_s->labels->matches(imagecoll) ){
+        Mutate_Voxels_Opts ebv_opts;
+        ebv_opts.editstyle      = Mutate_Voxels_Opts::EditStyle::InPlace;
+        ebv_opts.inclusivity    = Mutate_Voxels_Opts::Inclusivity::Inclusive;
+        ebv_opts.contouroverlap = Mutate_Voxels_Opts::ContourOverlap::HonourOppositeOrientations;
+        ebv_opts.aggregate      = Mutate_Voxels_Opts::Aggregate::Mean;
+        ebv_opts.adjacency      = Mutate_Voxels_Opts::Adjacency::SingleVoxel;
+        ebv_opts.maskmod        = Mutate_Voxels_Opts::MaskMod::Noop;
+
+        user_data_s->labels = std::make_shared<label_volume>( Rasterize_Label_Volume(imagecoll, { ccsl }, ebv_opts) );
+    }
+
+    //Allocate a second channel to store a mask. Voxels are only decayed if the mask is not set, so that multiple passes
+    // (e.g., for different ROIs) will not erroneously decay dose.
+    for(auto &img : imagecoll.images){
+        if(img.channels == 1){
+            img.add_channel(0.0);
+        }
     }
 
     //Work out some model parameters.
@@ -65,83 +80,66 @@ bool DecayDoseOverTime(planar_image_collection<float,double>::images_list_it_t f
                      1.5 + std::exp(0.100000 * (user_data_s->TemporalGapMonths - 12.0)) : // (t-1y)*1.2 converted to mo.
                      2.8 + std::exp(0.139177 * (user_data_s->TemporalGapMonths - 12.0)) ;
     const double r_exp = 1.0 / (1.0 + r);
+    const auto n_c1 = user_data_s->Course1NumberOfFractions;
+    const auto abr = user_data_s->AlphaBetaRatio;
+    const auto model = user_data_s->model;
+    if( (model != DecayDoseOverTimeMethod::Halve)
+    &&  (model != DecayDoseOverTimeMethod::Jones_and_Grant_2014) ){
+        throw std::logic_error("Provided an invalid model. Cannot continue.");
+    }
 
-    //Record the min and max (outgoing) pixel values for windowing purposes.
-    Mutate_Voxels_Opts ebv_opts;
-    ebv_opts.editstyle      = Mutate_Voxels_Opts::EditStyle::InPlace; // Note: the mask scheme below requires in-place in order to decay with a single pass.
-    ebv_opts.inclusivity    = Mutate_Voxels_Opts::Inclusivity::Inclusive;
-    ebv_opts.contouroverlap = Mutate_Voxels_Opts::ContourOverlap::HonourOppositeOrientations;
-    ebv_opts.aggregate      = Mutate_Voxels_Opts::Aggregate::Mean;
-    ebv_opts.adjacency      = Mutate_Voxels_Opts::Adjacency::SingleVoxel;
-    ebv_opts.maskmod        = Mutate_Voxels_Opts::MaskMod::Noop;
-
-    auto f_bounded = [=](int64_t row, int64_t col, int64_t channel,
-                         std::reference_wrapper<planar_image<float,double>> /*img_refw*/,
-                         std::reference_wrapper<planar_image<float,double>> /*mask_img_refw*/,
-                         float &voxel_val) {
-
-        // First, check if the mask is set for this voxel. If it is, do NOT re-process.
-        // It means the voxel has been processed in a previous decay operation (e.g., for another overlapping ROI) and
-        // should not be decayed again.
-        const auto mask_val = first_img_it->value(row, col, 1);
-        if(mask_val != 0.0) return;
-
-        // If the voxel is in the mask channel, disregard it.
-        if(channel == 1) return;
-
-        // Otherwise, perform the decay and then mark the mask.
-        if(user_data_s->model == DecayDoseOverTimeMethod::Halve){
-            voxel_val *= 0.5;
-
-        }else if(user_data_s->model == DecayDoseOverTimeMethod::Jones_and_Grant_2014){
-            const auto BED_abr_c1 = BEDabr_from_n_D_abr(user_data_s->Course1NumberOfFractions, 
-                                                        voxel_val,
-                                                        user_data_s->AlphaBetaRatio);
-
-            //The model does not apply to doses beyond the tolerance dose, so the most conservative
-            // approach is to leave the dose in such voxels as-is.
-            double BED_ratio = (BED_abr_c1/BED_abr_tol);
-            if( (0 < BED_ratio) && (BED_ratio < 1) ){
-                const double time_scale_factor = std::pow((1.0 - BED_ratio),r_exp);
-                const auto BED_abr_c1_eff = BED_abr_tol * (1.0 - time_scale_factor);
-
-                const auto D_c1_eff = D_from_n_BEDabr(user_data_s->Course1NumberOfFractions,
-                                                      BED_abr_c1_eff);
-                voxel_val = D_c1_eff;
-
-                //Debugging/validation:
-                //if( ((row == 0) && (col == 19)) || ( (row == 9) && (col == 9)) ){
-                //    YLOGINFO("BED_abr_tol    = " << BED_abr_tol.val);
-                //    YLOGINFO("r              = " << r);
-                //    YLOGINFO("r_exp          = " << r_exp);
-                //    YLOGINFO("Dincoming      = " << voxel_val);
-                //    YLOGINFO("BED_abr_c1     = " << BED_abr_c1.val);
-                //    YLOGINFO("BED_ratio      = " << BED_ratio);
-                //    YLOGINFO("BED_C1_eff     = " << BED_abr_c1_eff.val);
-                //    YLOGINFO("Doutgoing      = " << D_c1_eff);
-                //}
-            }
-
-        }else{
-            throw std::logic_error("Provided an invalid model. Cannot continue.");
+    const auto decay = [=](float D) -> float {
+        if(model == DecayDoseOverTimeMethod::Halve){
+            return D * 0.5f;
         }
-        first_img_it->reference(row, col, 1) = 1.0;
-        return;
-    };
 
-    std::list<std::reference_wrapper<planar_image<float,double>>> selected_imgs;
-    for(auto &img_it : selected_img_its) selected_imgs.push_back( std::ref(*img_it) );
+        const auto BED_abr_c1 = BEDabr_from_n_D_abr(n_c1, D, abr);
+
+        //The model does not apply to doses beyond the tolerance dose, so the most conservative
+        // approach is to leave the dose in such voxels as-is.
+        const double BED_ratio = (BED_abr_c1/BED_abr_tol);
+        if( !(0 < BED_ratio) || !(BED_ratio < 1) ) return D;
+
+        const double time_scale_factor = std::pow((1.0 - BED_ratio), r_exp);
+        const auto BED_abr_c1_eff = BED_abr_tol * (1.0 - time_scale_factor);
+        return static_cast<float>( D_from_n_BEDabr(n_c1, BED_abr_c1_eff) );
+    };
 
-    Mutate_Voxels<float,double>( std::ref(*first_img_it),
-                                 selected_imgs, 
-                                 ccsl, 
-                                 ebv_opts, 
-                                 f_bounded );
+    // Decay all unmasked, bounded voxels in a single pass, then mark the mask.
+    const auto channel = user_data_s->channel;
+    const auto &lv = *(user_data_s->labels);
+    {
+        work_queue<std::function<void(void)>> wq;
+        size_t n = 0;
+        for(auto &img : imagecoll.images){
+            const auto *labels = &(lv.labels[n++]);
+            wq.submit_task([&img,labels,channel,&decay]() -> void {
+                for(int64_t row = 0; row < img.rows; ++row){
+                    for(int64_t col = 0; col < img.columns; ++col){
+                        if((*labels)[static_cast<size_t>(row * img.columns + col)] == 0) continue;
+
+                        auto &mask_val = img.reference(row, col, 1);
+                        if(mask_val != 0.0f) continue;
+
+                        for(int64_t chan = 0; chan < img.channels; ++chan){
+                            if( (chan == 1)
+                            ||  ((0 <= channel) && (chan != channel)) ) continue;
+                            auto &v = img.reference(row, col, chan);
+                            v = decay(v);
+                        }
+                        mask_val = 1.0f;
+                    }
+                }
+            });
+        }
+    } // Wait for all tasks to complete.
 
-    //Alter the first image's metadata to reflect that averaging has occurred. You might want to consider
+    //Alter the metadata to reflect that decay has occurred. You might want to consider
     // a selective whitelist approach so that unique IDs are not duplicated accidentally.
-    UpdateImageDescription( std::ref(*first_img_it), "DoseDecayedOverTime" );
-    UpdateImageWindowCentreWidth( std::ref(*first_img_it) );
+    for(auto &img : imagecoll.images){
+        UpdateImageDescription( std::ref(img), "DoseDecayedOverTime" );
+        UpdateImageWindowCentreWidth( std::ref(img) );
+    }
 
     return true;
 }
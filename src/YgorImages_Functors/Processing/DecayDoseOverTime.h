@@ -5,10 +5,13 @@
 #include <any>
 #include <functional>
 #include <list>
+#include <memory>
 #include <cstdint>
 
 #include "YgorImages.h"
 
+#include "../Label_Volumes.h"
+
 template <class T> class contour_collection;
 
 typedef enum { // Controls how dose is decayed (i.e., selects the model).
@@ -53,12 +56,17 @@ struct DecayDoseOverTimeUserData {
                                              // one is claimed to be more conservative. So
                                              // it should preferably be used.
 
+    // Voxels bounded by any contour are identified once and cached here. The cache is re-used for subsequent image
+    // collections with the same geometry.
+    std::shared_ptr<label_volume> labels;
+
 };
 
 
-bool DecayDoseOverTime(planar_image_collection<float,double>::images_list_it_t first_img_it,
-                    std::list<planar_image_collection<float,double>::images_list_it_t> ,
-                    std::list<std::reference_wrapper<planar_image_collection<float,double>>>,
-                    std::list<std::reference_wrapper<contour_collection<double>>>, 
-                    std::any );
+// Decays all voxels bounded by any contour in-place. Each voxel is decayed at most once, even if bounded by multiple
+// contours.
+bool DecayDoseOverTime(planar_image_collection<float,double> &,
+                       std::list<std::reference_wrapper<planar_image_collection<float,double>>>,
+                       std::list<std::reference_wrapper<contour_collection<double>>>,
+                       std::any );
 
@@ -1,8 +1,15 @@
+//Partitioned_Image_Voxel_Visitor_Mutator.cc.
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <exception>
 #include <functional>
+#include <limits>
 #include <list>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "../ConvenienceRoutines.h"
 #include "Partitioned_Image_Voxel_Visitor_Mutator.h"
@@ -12,6 +19,177 @@
 
 template <class T> class contour_collection;
 
+
+// Accumulates the signed area contribution of a line segment into the cells it crosses.
+//
+// Coordinates are in units of cells, with cell (y, x) spanning [y, y+1) x [x, x+1). After all edges of a closed polygon
+// have been accumulated, a running sum along each row yields the signed coverage of each cell. The buffer must extend at
+// least two cells beyond the largest x coordinate.
+static void accumulate_edge_coverage(std::vector<double> &acc,
+                                     int64_t width,
+                                     int64_t height,
+                                     double x_0, double y_0,
+                                     double x_1, double y_1){
+    if(std::abs(y_0 - y_1) <= 1.0E-12) return;
+
+    double dir = 1.0;
+    if(y_1 < y_0){
+        std::swap(x_0, x_1);
+        std::swap(y_0, y_1);
+        dir = -1.0;
+    }
+    if( (y_1 <= 0.0) || (static_cast<double>(height) <= y_0) ) return;
+
+    const double dxdy = (x_1 - x_0) / (y_1 - y_0);
+    double x = x_0;
+    int64_t y_begin = 0;
+    if(y_0 < 0.0){
+        x -= y_0 * dxdy;
+    }else{
+        y_begin = static_cast<int64_t>(std::floor(y_0));
+    }
+    const int64_t y_end = std::min<int64_t>(height, static_cast<int64_t>(std::ceil(y_1)));
+
+    for(int64_t y = y_begin; y < y_end; ++y){
+        double *row = acc.data() + (y * width);
+        const double dy = std::min(static_cast<double>(y + 1), y_1) - std::max(static_cast<double>(y), y_0);
+        const double x_next = x + dxdy * dy;
+        const double d = dy * dir;
+
+        const double x_lo = std::min(x, x_next);
+        const double x_hi = std::max(x, x_next);
+        const double x_lo_floor = std::floor(x_lo);
+        const auto x_lo_i = static_cast<int64_t>(x_lo_floor);
+        const double x_hi_ceil = std::ceil(x_hi);
+        const auto x_hi_i = static_cast<int64_t>(x_hi_ceil);
+
+        if(x_hi_i <= (x_lo_i + 1)){
+            // The segment lies within a single cell.
+            const double x_mid_f = 0.5 * (x + x_next) - x_lo_floor;
+            row[x_lo_i]     += d - d * x_mid_f;
+            row[x_lo_i + 1] += d * x_mid_f;
+        }else{
+            // The segment spans several cells. The area is distributed as a trapezoid.
+            const double s = 1.0 / (x_hi - x_lo);
+            const double x_lo_f = x_lo - x_lo_floor;
+            const double a_0 = 0.5 * s * (1.0 - x_lo_f) * (1.0 - x_lo_f);
+            const double x_hi_f = x_hi - x_hi_ceil + 1.0;
+            const double a_m = 0.5 * s * x_hi_f * x_hi_f;
+
+            row[x_lo_i] += d * a_0;
+            if(x_hi_i == (x_lo_i + 2)){
+                row[x_lo_i + 1] += d * (1.0 - a_0 - a_m);
+            }else{
+                const double a_1 = s * (1.5 - x_lo_f);
+                row[x_lo_i + 1] += d * (a_1 - a_0);
+                for(int64_t xi = x_lo_i + 2; xi < (x_hi_i - 1); ++xi){
+                    row[xi] += d * s;
+                }
+                const double a_2 = a_1 + static_cast<double>(x_hi_i - x_lo_i - 3) * s;
+                row[x_hi_i - 1] += d * (1.0 - a_2 - a_m);
+            }
+            row[x_hi_i] += d * a_m;
+        }
+        x = x_next;
+    }
+    return;
+}
+
+
+std::vector<double>
+Compute_Fractional_Voxel_Occupancy(const planar_image<float,double> &img,
+                                   const std::list<std::reference_wrapper<contour_collection<double>>> &ccsl,
+                                   Mutate_Voxels_Opts::ContourOverlap contouroverlap){
+
+    const int64_t rows = img.rows;
+    const int64_t columns = img.columns;
+    std::vector<double> occupancy(static_cast<size_t>(rows * columns), 0.0);
+    if( (rows <= 0) || (columns <= 0) ) return occupancy;
+
+    const bool signed_sum = (contouroverlap == Mutate_Voxels_Opts::ContourOverlap::HonourOppositeOrientations);
+    const bool cancel = (contouroverlap == Mutate_Voxels_Opts::ContourOverlap::ImplicitOrientations);
+
+    // Voxel (row, col) spans [row, row+1) x [col, col+1) in these coordinates.
+    const auto origin = img.position(0, 0);
+    const auto row_unit = img.row_unit.unit();
+    const auto col_unit = img.col_unit.unit();
+    const auto to_cell_coords = [&](const vec3<double> &P) -> std::pair<double, double> {
+        const auto d = P - origin;
+        return { d.Dot(row_unit) / img.pxl_dx + 0.5,
+                 d.Dot(col_unit) / img.pxl_dy + 0.5 };
+    };
+
+    std::vector<double> acc;
+    std::vector<std::pair<double, double>> verts;
+    for(const auto &cc_refw : ccsl){
+        for(const auto &c : cc_refw.get().contours){
+            if( (c.points.size() < 3) || !img.encompasses_contour_of_points(c) ) continue;
+
+            verts.clear();
+            double r_min = std::numeric_limits<double>::infinity();
+            double r_max = -r_min;
+            double c_min = r_min;
+            double c_max = -r_min;
+            for(const auto &P : c.points){
+                verts.emplace_back(to_cell_coords(P));
+                r_min = std::min(r_min, verts.back().first);
+                r_max = std::max(r_max, verts.back().first);
+                c_min = std::min(c_min, verts.back().second);
+                c_max = std::max(c_max, verts.back().second);
+            }
+            if( !std::isfinite(r_min) || !std::isfinite(r_max)
+            ||  !std::isfinite(c_min) || !std::isfinite(c_max) ) continue;
+
+            // Restrict the accumulation buffer to the rows of the image the contour spans. Columns cannot be clipped
+            // since coverage propagates along each row.
+            const int64_t y_lo = std::max<int64_t>(0, static_cast<int64_t>(std::floor(r_min)));
+            const int64_t y_hi = std::min<int64_t>(rows, static_cast<int64_t>(std::ceil(r_max)));
+            if(y_hi <= y_lo) continue;
+            const auto x_origin = static_cast<int64_t>(std::floor(c_min));
+            const int64_t width = static_cast<int64_t>(std::ceil(c_max)) - x_origin + 2;
+            const int64_t height = y_hi - y_lo;
+
+            acc.assign(static_cast<size_t>(width * height), 0.0);
+            const auto N = verts.size();
+            for(size_t i = 0; i < N; ++i){
+                const auto &A = verts[i];
+                const auto &B = verts[(i + 1) % N];
+                accumulate_edge_coverage(acc, width, height,
+                                         A.second - static_cast<double>(x_origin), A.first - static_cast<double>(y_lo),
+                                         B.second - static_cast<double>(x_origin), B.first - static_cast<double>(y_lo));
+            }
+
+            for(int64_t y = 0; y < height; ++y){
+                const int64_t row = y + y_lo;
+                double coverage = 0.0;
+                for(int64_t x = 0; x < width; ++x){
+                    coverage += acc[static_cast<size_t>(y * width + x)];
+                    const int64_t col = x + x_origin;
+                    if( (col < 0) || (columns <= col) ) continue;
+
+                    auto &o = occupancy[static_cast<size_t>(row * columns + col)];
+                    o += (signed_sum) ? coverage : std::min(1.0, std::abs(coverage));
+                }
+            }
+        }
+    }
+
+    for(auto &o : occupancy){
+        if(signed_sum){
+            o = std::abs(o);
+        }else if(cancel){
+            // Overlapping coverage cancels pairwise.
+            o = std::abs(o - 2.0 * std::round(0.5 * o));
+        }
+        // Round-off in the running sums is removed so interior voxels have a weight of exactly 1.
+        o = std::clamp(o, 0.0, 1.0);
+        if(o < 1.0E-9) o = 0.0;
+        if((1.0 - 1.0E-9) < o) o = 1.0;
+    }
+    return occupancy;
+}
+
+
 bool PartitionedImageVoxelVisitorMutator(planar_image_collection<float,double>::images_list_it_t first_img_it,
                         std::list<planar_image_collection<float,double>::images_list_it_t> selected_img_its,
                         std::list<std::reference_wrapper<planar_image_collection<float,double>>>,
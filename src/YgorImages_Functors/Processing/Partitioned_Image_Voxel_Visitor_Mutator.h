@@ -9,6 +9,7 @@
 #include <list>
 #include <map>
 #include <set>
+#include <vector>
 
 #include "YgorImages.h"
 #include "YgorMath.h"
@@ -18,6 +19,21 @@
 template <class T> class contour_collection;
 
 
+// Computes the fraction of each voxel's in-plane footprint that is covered by the contours which the image encompasses.
+//
+// Contours are projected onto the image plane and the exact coverage is computed by accumulating each contour edge's
+// signed area contribution into the cells it crosses, followed by a running sum along each row. Only voxels crossed by
+// contour edges receive fractional weights; interior voxels resolve to 1 with no per-voxel geometry. The
+// contour overlap option controls how contours are combined, as with Mutate_Voxels. Cancellation of overlapping
+// contours is exact except in voxels crossed by edges of several overlapping contours.
+//
+// The result is indexed as (row * columns + col).
+std::vector<double>
+Compute_Fractional_Voxel_Occupancy(const planar_image<float,double> &img,
+                                   const std::list<std::reference_wrapper<contour_collection<double>>> &ccsl,
+                                   Mutate_Voxels_Opts::ContourOverlap contouroverlap);
+
+
 struct PartitionedImageVoxelVisitorMutatorUserData {
 
     // Algorithmic changes passed through to the driver function.